@@ -46,8 +46,10 @@ SOURCES += \
 ../../../../tests/unit/main.cpp \
 ../../../../tests/unit/MediaProperties_test.cpp \
 ../../../../tests/unit/MegaApi_test.cpp \
+../../../../tests/unit/Node_test.cpp \
 ../../../../tests/unit/PayCrypter_test.cpp \
 ../../../../tests/unit/PendingContactRequest_test.cpp \
+../../../../tests/unit/Raid_test.cpp \
 ../../../../tests/unit/Serialization_test.cpp \
 ../../../../tests/unit/Share_test.cpp \
 ../../../../tests/unit/Sync_test.cpp \
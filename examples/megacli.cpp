@@ -1957,7 +1957,7 @@ static void dumptree(Node* n, bool recurse, int depth, const char* title, ofstre
 
     if (n->type != FILENODE)
     {
-        for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+        for (NodeChildren::iterator it = n->children.begin(); it != n->children.end(); it++)
         {
             dumptree(*it, recurse, depth + 1, NULL, toFile);
         }
@@ -3284,7 +3284,7 @@ void exec_setmaxconnections(autocomplete::ACState& s)
     {
         client->setmaxconnections(direction, atoi(s.words[2].s.c_str()));
     }
-    cout << "connections: " << (int)client->connections[direction] << endl;
+    cout << "connections: " << client->mTransferLimits.limits(direction).connections << endl;
 }
 
 
@@ -4282,7 +4282,7 @@ bool recursiveget(fs::path&& localpath, Node* n, bool folders, unsigned& queued)
                 return false;
             }
         }
-        for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+        for (NodeChildren::iterator it = n->children.begin(); it != n->children.end(); it++)
         {
             if (!recursiveget(std::move(newpath), *it, folders, queued))
             {
@@ -4303,7 +4303,7 @@ bool regexget(const string& expression, Node* n, unsigned& queued)
         if (n->type == FOLDERNODE || n->type == ROOTNODE)
         {
             TransferDbCommitter committer(client->tctable);
-            for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+            for (NodeChildren::iterator it = n->children.begin(); it != n->children.end(); it++)
             {
                 if ((*it)->type == FILENODE)
                 {
@@ -5139,7 +5139,7 @@ void exec_get(autocomplete::ACState& s)
                 else
                 {
                     // ...or all files in the specified folder (non-recursive)
-                    for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+                    for (NodeChildren::iterator it = n->children.begin(); it != n->children.end(); it++)
                     {
                         if ((*it)->type == FILENODE)
                         {
@@ -6045,7 +6045,7 @@ void exec_getfa(autocomplete::ACState& s)
         }
         else
         {
-            for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+            for (NodeChildren::iterator it = n->children.begin(); it != n->children.end(); it++)
             {
                 if ((*it)->type == FILENODE && (*it)->hasfileattribute(type))
                 {
@@ -7725,7 +7725,7 @@ void exec_mediainfo(autocomplete::ACState& s)
             case ROOTNODE:
             case VAULTNODE:
             case RUBBISHNODE:
-                for (node_list::iterator m = n->children.begin(); m != n->children.end(); ++m)
+                for (NodeChildren::iterator m = n->children.begin(); m != n->children.end(); ++m)
                 {
                     if ((*m)->type == FILENODE && (*m)->hasfileattribute(fa_media))
                     {
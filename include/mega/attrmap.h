@@ -26,20 +26,121 @@
 
 namespace mega {
 
-// maps attribute names to attribute values
-struct attr_map : map<nameid, string>
+// maps attribute names to attribute values.  Nodes have a handful of attributes, so
+// they are kept in a vector sorted by name, which takes less memory than a tree and
+// iterates in the same order.  Unlike a tree, inserting or erasing entries invalidates
+// iterators and references to the other entries.
+struct attr_map
 {
+    typedef nameid key_type;
+    typedef string mapped_type;
+    typedef pair<nameid, string> value_type;
+    typedef vector<value_type>::iterator iterator;
+    typedef vector<value_type>::const_iterator const_iterator;
+    typedef vector<value_type>::size_type size_type;
+
     attr_map() {}
 
     attr_map(nameid key, string value)
     {
-        (*this)[key] = value;
+        (*this)[key] = std::move(value);
     }
 
     attr_map(map<nameid, string>&& m)
     {
-        m.swap(*this);
+        mEntries.reserve(m.size());
+        for (auto& entry : m)
+        {
+            mEntries.emplace_back(entry.first, std::move(entry.second));
+        }
+    }
+
+    attr_map(std::initializer_list<value_type> entries)
+    {
+        for (auto& entry : entries)
+        {
+            (*this)[entry.first] = entry.second;
+        }
+    }
+
+    iterator begin() { return mEntries.begin(); }
+    iterator end() { return mEntries.end(); }
+    const_iterator begin() const { return mEntries.begin(); }
+    const_iterator end() const { return mEntries.end(); }
+
+    size_type size() const { return mEntries.size(); }
+    bool empty() const { return mEntries.empty(); }
+    void clear() { mEntries.clear(); }
+
+    iterator find(nameid key)
+    {
+        auto it = lowerBound(key);
+        return it != end() && it->first == key ? it : end();
+    }
+
+    const_iterator find(nameid key) const
+    {
+        return const_cast<attr_map*>(this)->find(key);
+    }
+
+    size_type count(nameid key) const
+    {
+        return find(key) != end();
+    }
+
+    string& operator[](nameid key)
+    {
+        auto it = lowerBound(key);
+        if (it == end() || it->first != key)
+        {
+            it = mEntries.emplace(it, key, string());
+        }
+        return it->second;
     }
+
+    pair<iterator, bool> emplace(nameid key, string value)
+    {
+        auto it = lowerBound(key);
+        if (it != end() && it->first == key)
+        {
+            return make_pair(it, false);
+        }
+        return make_pair(mEntries.emplace(it, key, std::move(value)), true);
+    }
+
+    size_type erase(nameid key)
+    {
+        auto it = find(key);
+        if (it == end())
+        {
+            return 0;
+        }
+        mEntries.erase(it);
+        return 1;
+    }
+
+    iterator erase(const_iterator it)
+    {
+        return mEntries.erase(it);
+    }
+
+    // release the spare capacity left by insertions
+    void shrink_to_fit()
+    {
+        mEntries.shrink_to_fit();
+    }
+
+    bool operator==(const attr_map& o) const { return mEntries == o.mEntries; }
+    bool operator!=(const attr_map& o) const { return mEntries != o.mEntries; }
+
+private:
+    iterator lowerBound(nameid key)
+    {
+        return std::lower_bound(mEntries.begin(), mEntries.end(), key,
+                                [](const value_type& entry, nameid k) { return entry.first < k; });
+    }
+
+    vector<value_type> mEntries;
 };
 
 struct MEGA_API AttrMap
@@ -61,6 +61,10 @@ public:
     // some commands are guaranteed to work if we query without specifying a SID (eg. gmf)
     bool suppressSID;
 
+    // commands whose response can be parsed while it downloads (when they are alone in their batch)
+    // set the filters for the JSONSplitter here
+    JSONSplitter::FilterMap mFilters;
+
     void cmd(const char*);
     void notself(MegaClient*);
     virtual void cancel(void);
@@ -412,6 +416,14 @@ public:
     bool procresult(Result) override;
 
     CommandFetchNodes(MegaClient*, int tag, bool nocache);
+
+private:
+    bool parsemember(nameid, JSON*);
+    bool parsingfinished();
+
+    // state kept across nodes while the response is parsed as it downloads
+    node_vector mDelayedParents;
+    handle mPreviousHandleForAlert = UNDEF;
 };
 
 // update own node keys
@@ -617,6 +629,10 @@ private:
 
 public:
 
+    // tags of the uploads batched by PutnodesBatcher, one per node, whose pending transfer
+    // records and temporary files are removed as those of the command's own tag
+    vector<int> mBatchTags;
+
     bool procresult(Result) override;
 
     CommandPutNodes(MegaClient*, NodeHandle, const char*, VersioningOption, vector<NewNode>&&, int, putsource_t, const char *cauth, Completion&&, bool canChangeVault);
@@ -313,6 +313,46 @@ public:
 
     void ctr_crypt(byte *, unsigned, m_off_t, ctr_iv, byte *mac, bool encrypt, bool initmac = true);
 
+    /**
+     * @brief One independent run of CTR data with its own CBC-MAC (eg. one file chunk).
+     */
+    struct CtrLane
+    {
+        byte* data;
+        unsigned len;
+        m_off_t pos;
+        byte* mac;
+        bool initmac;
+    };
+
+    // number of lanes whose CBC-MACs are advanced together by a single (pipelined) AES call
+    static const unsigned MAXLANES = 8;
+
+    /**
+     * @brief Encrypt or decrypt several independent lanes using AES in CTR mode,
+     * updating each lane's CBC-MAC.
+     *
+     * Same result as calling ctr_crypt() on each lane, but the keystream is generated
+     * in bulk and the MACs of up to MAXLANES lanes are computed side by side, so
+     * the serial dependency of CBC-MAC does not limit throughput.
+     *
+     * @param lanes Lanes to process. Data must be NUL-padded to BLOCKSIZE.
+     * @param numlanes Number of lanes.
+     * @param ctriv CTR nonce shared by all lanes.
+     * @param encrypt True to encrypt (MAC over the input), false to decrypt (MAC over the output).
+     */
+    void ctr_crypt_lanes(CtrLane* lanes, size_t numlanes, ctr_iv ctriv, bool encrypt);
+
+private:
+    // counter blocks encrypted per AES call when generating the CTR keystream
+    static const unsigned CTRBATCHBLOCKS = 256;
+
+    void ctr_xor(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv);
+    void cbc_mac(const byte* data, unsigned len, byte* mac, bool padded);
+    void cbc_mac_lanes(CtrLane* lanes, size_t numlanes, bool padded);
+
+public:
+
     static void setint64(int64_t, byte*);
 
     static void xorblock(const byte*, byte*);
@@ -22,6 +22,11 @@
 #ifndef MEGA_DB_H
 #define MEGA_DB_H 1
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+
 #include "filesystem.h"
 #include "logging.h"
 
@@ -50,6 +55,9 @@ public:
     virtual bool next(uint32_t*, string*) = 0;
     bool next(uint32_t*, string*, SymmCipher*);
 
+    // keep nextid above a record read without decryption
+    void updateNextId(uint32_t);
+
     // get specific record by key
     virtual bool get(uint32_t, string*) = 0;
 
@@ -89,6 +97,204 @@ public:
     DBTableTransactionCommitter *getTransactionCommitter() const;
 };
 
+// Typed storage for the nodes of the state cache.  Besides the encrypted serialized node,
+// each row has the columns needed to query nodes by parent, fingerprint or name without
+// loading the whole account.  Implemented by DbTable flavours that support it.
+class MEGA_API DbTableNodes
+{
+public:
+    // queryable columns of a node (the name is only stored as a keyed hash)
+    struct NodeColumns
+    {
+        NodeHandle handle;
+        NodeHandle parent;
+        nodetype_t type = TYPE_UNKNOWN;
+        m_off_t size = 0;
+        m_time_t mtime = 0;
+        string fingerprint;
+        uint64_t nameHash = 0;
+    };
+
+    // handle and encrypted content of the rows returned by a query
+    using NodeRows = vector<pair<NodeHandle, string>>;
+
+    // add or update a node
+    virtual bool putNode(const NodeColumns&, const string& content) = 0;
+
+    // delete a node and all the nodes below it
+    virtual bool delNodeTree(NodeHandle) = 0;
+
+    virtual bool getNode(NodeHandle, string* content) = 0;
+    virtual bool getChildren(NodeHandle parent, NodeRows&) = 0;
+    virtual bool getChildrenByNameHash(NodeHandle parent, uint64_t nameHash, NodeRows&) = 0;
+    virtual bool getNodesByFingerprint(const string& fingerprint, NodeRows&) = 0;
+
+    // all the nodes below a node, parents before their children
+    virtual bool getSubtree(NodeHandle, NodeRows&) = 0;
+
+    // add the counts of all the nodes below a node (not the node itself) to a NodeCounter
+    virtual bool getSubtreeCounts(NodeHandle, bool isFile, NodeCounter&) = 0;
+
+    // the handles of all the nodes below a node
+    virtual bool getSubtreeHandles(NodeHandle, vector<NodeHandle>&) = 0;
+
+    // nodes whose parent is not stored (root nodes and inshares)
+    virtual bool getTopNodes(NodeRows&) = 0;
+
+    // for a full sequential get of the nodes
+    virtual void rewindNodes() = 0;
+    virtual bool nextNode(NodeHandle*, string*) = 0;
+
+    // whether the table was opened with the typed node table (DB_OPEN_FLAG_NODES); none of
+    // the above can be used otherwise
+    virtual bool hasNodesTable() const = 0;
+
+    virtual ~DbTableNodes() { }
+};
+
+// Fingerprints of local files, keyed by the file's identity on its filesystem, so that a
+// file whose metadata hasn't changed doesn't need to be read again to fingerprint it.
+// Implemented by DbTable flavours that support it.
+class MEGA_API DbTableFingerprints
+{
+public:
+    // what identifies a local file, and what tells whether it changed
+    struct FileColumns
+    {
+        fsfp_t fsfp = 0;
+        handle fsid = UNDEF;
+        m_off_t size = 0;
+        m_time_t mtime = 0;
+        m_time_t ctime = 0;
+    };
+
+    // add or update the CRCs of a file
+    virtual bool putFingerprint(const FileColumns&, const string& crc) = 0;
+
+    // the CRCs of the file if it's stored with the same size, mtime and ctime
+    virtual bool getFingerprint(const FileColumns&, string* crc) = 0;
+
+    virtual ~DbTableFingerprints() { }
+};
+
+// A state cache table whose writes are applied by a thread of its own, so that saving the
+// state doesn't make the thread that changed it wait for the database.  Records and nodes
+// are queued already serialized and encrypted, and the queue is bounded: writers wait
+// while it holds more than MAXQUEUEDBYTES.  A record written again before the next commit
+// replaces its queued write.  The thread applies everything queued while it was busy with
+// a single commit, the last one queued, so the stored state (and its scsn record) is
+// always that of one of the commits.  Reads are answered from the queue when possible, or
+// else wait for the queued writes to be applied.  The node queries read the stored nodes
+// without waiting and merge the queued ones into the result; they only wait while a
+// subtree deletion is queued, or when a queued node is in the subtree they read.  Once a
+// write fails, all the later ones fail too, so the caller finds out on its next write.
+class MEGA_API WriteBehindDbTable : public DbTable, public DbTableNodes
+{
+public:
+    static const size_t MAXQUEUEDBYTES = 64 << 20;
+
+    // the table must also be a DbTableNodes, with the typed node table
+    WriteBehindDbTable(PrnGen& rng, unique_ptr<DbTable> table);
+    ~WriteBehindDbTable();
+
+    void rewind() override;
+    bool next(uint32_t*, string*) override;
+    bool get(uint32_t, string*) override;
+    bool put(uint32_t, char*, unsigned) override;
+    bool del(uint32_t) override;
+    void truncate() override;
+    void begin() override;
+    void commit() override;
+    void abort() override;
+    void remove() override;
+    bool inTransaction() const override;
+
+    bool putNode(const NodeColumns&, const string& content) override;
+    bool delNodeTree(NodeHandle) override;
+    bool getNode(NodeHandle, string* content) override;
+    bool getChildren(NodeHandle parent, NodeRows&) override;
+    bool getChildrenByNameHash(NodeHandle parent, uint64_t nameHash, NodeRows&) override;
+    bool getNodesByFingerprint(const string& fingerprint, NodeRows&) override;
+    bool getSubtree(NodeHandle, NodeRows&) override;
+    bool getSubtreeCounts(NodeHandle, bool isFile, NodeCounter&) override;
+    bool getSubtreeHandles(NodeHandle, vector<NodeHandle>&) override;
+    bool getTopNodes(NodeRows&) override;
+    void rewindNodes() override;
+    bool nextNode(NodeHandle*, string*) override;
+    bool hasNodesTable() const override;
+
+    // wait until all the queued writes are applied (they may not be committed yet)
+    void flush();
+
+    // commits done by the thread
+    uint64_t commits() const { return mCommits; }
+
+private:
+    struct Write
+    {
+        enum { NONE, PUT, DEL, PUTNODE, DELNODETREE, BEGIN, COMMIT } type = NONE;
+        uint64_t seq = 0;
+        uint32_t id = 0;
+        NodeColumns columns;
+        shared_ptr<const string> data;
+    };
+
+    // the latest queued content of a record or node (null if deleted), its write, and the
+    // columns of a queued node
+    struct Latest
+    {
+        shared_ptr<const string> data;
+        uint64_t seq;
+        NodeColumns columns;
+    };
+
+    void enqueue(Write&&);
+    bool apply(const Write&);
+    void loop();
+
+    // with both mutexes locked: replace the stored rows of the queued nodes with their
+    // queued content, and add the queued nodes that match
+    void mergeQueuedNodes(NodeRows&, const std::function<bool(const NodeColumns&)>& matches) const;
+
+    // with both mutexes locked: whether a queued node is, or was, below a node, given the
+    // handles of the nodes stored below it
+    bool queuedInSubtree(NodeHandle, const vector<NodeHandle>& stored) const;
+
+    unique_ptr<DbTable> mTable;
+    DbTableNodes* mNodes;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<Write> mQueue;
+    size_t mQueuedBytes = 0;
+    uint64_t mSeq = 0;
+    bool mApplying = false;
+    bool mStop = false;
+    bool mInTransaction = false;
+    std::atomic<bool> mFailed{false};
+    std::atomic<uint64_t> mCommits{0};
+
+    // positions in mQueue of the puts that a later write can replace (since the last commit)
+    std::unordered_map<uint32_t, size_t> mRecordPuts;
+    std::unordered_map<handle, size_t> mNodePuts;
+
+    // the queued writes not yet applied, by record and by node
+    std::unordered_map<uint32_t, Latest> mLatestRecords;
+    std::unordered_map<handle, Latest> mLatestNodes;
+
+    // the last queued subtree deletion, which may remove nodes queued before it
+    uint64_t mLastTreeDeletion = 0;
+
+    // subtree deletions queued and not applied yet: only the table knows which nodes they
+    // remove, so the node queries wait for them
+    size_t mQueuedTreeDeletions = 0;
+
+    // the underlying table is used by a thread at a time
+    std::mutex mTableMutex;
+
+    std::thread mThread;
+};
+
 class MEGA_API DBTableTransactionCommitter
 {
     DbTable* mTable;
@@ -181,12 +387,18 @@ enum DbOpenFlag
     // Recycle legacy database, if present.
     DB_OPEN_FLAG_RECYCLE = 0x1,
     // Operations should always be transacted.
-    DB_OPEN_FLAG_TRANSACTED = 0x2
+    DB_OPEN_FLAG_TRANSACTED = 0x2,
+    // Create the typed node table (see DbTableNodes), for the state cache.
+    DB_OPEN_FLAG_NODES = 0x4,
+    // Create the table of local file fingerprints (see DbTableFingerprints), shared by
+    // the clients using the same base path.
+    DB_OPEN_FLAG_FINGERPRINTS = 0x8
 }; // DbOpenFlag
 
 struct MEGA_API DbAccess
 {
     static const int LEGACY_DB_VERSION;
+    static const int PREVIOUS_DB_VERSION;
     static const int DB_VERSION;
 
     DbAccess();
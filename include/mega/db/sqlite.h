@@ -27,7 +27,7 @@
 
 namespace mega {
 
-class MEGA_API SqliteDbTable : public DbTable
+class MEGA_API SqliteDbTable : public DbTable, public DbTableNodes, public DbTableFingerprints
 {
     sqlite3* db;
     sqlite3_stmt* pStmt;
@@ -35,6 +35,23 @@ class MEGA_API SqliteDbTable : public DbTable
     FileSystemAccess *fsaccess;
     sqlite3_stmt* mDelStmt = nullptr;
     sqlite3_stmt* mPutStmt = nullptr;
+    sqlite3_stmt* mNodesStmt = nullptr;
+    sqlite3_stmt* mPutNodeStmt = nullptr;
+    sqlite3_stmt* mDelNodeTreeStmt = nullptr;
+    sqlite3_stmt* mGetNodeStmt = nullptr;
+    sqlite3_stmt* mChildrenStmt = nullptr;
+    sqlite3_stmt* mChildrenByNameHashStmt = nullptr;
+    sqlite3_stmt* mFingerprintStmt = nullptr;
+    sqlite3_stmt* mPutFileFingerprintStmt = nullptr;
+    sqlite3_stmt* mGetFileFingerprintStmt = nullptr;
+
+    // whether the database has the typed node table, and the fingerprints table
+    bool mNodeTable;
+    bool mFingerprintTable;
+
+    // runs a query returning (handle, content) rows, preparing it the first time
+    bool getNodeRows(sqlite3_stmt*& stmt, const char* sql, NodeRows&, const std::function<int(sqlite3_stmt*)>& bind);
+    void finalizeStatements();
 
 public:
     void rewind() override;
@@ -48,7 +65,24 @@ public:
     void abort() override;
     void remove() override;
 
-    SqliteDbTable(PrnGen &rng, sqlite3*, FileSystemAccess &fsAccess, const LocalPath &path, const bool checkAlwaysTransacted);
+    bool putNode(const NodeColumns&, const string& content) override;
+    bool delNodeTree(NodeHandle) override;
+    bool getNode(NodeHandle, string* content) override;
+    bool getChildren(NodeHandle parent, NodeRows&) override;
+    bool getChildrenByNameHash(NodeHandle parent, uint64_t nameHash, NodeRows&) override;
+    bool getNodesByFingerprint(const string& fingerprint, NodeRows&) override;
+    bool getSubtree(NodeHandle, NodeRows&) override;
+    bool getSubtreeCounts(NodeHandle, bool isFile, NodeCounter&) override;
+    bool getSubtreeHandles(NodeHandle, vector<NodeHandle>&) override;
+    bool getTopNodes(NodeRows&) override;
+    void rewindNodes() override;
+    bool nextNode(NodeHandle*, string*) override;
+    bool hasNodesTable() const override { return mNodeTable; }
+
+    bool putFingerprint(const FileColumns&, const string& crc) override;
+    bool getFingerprint(const FileColumns&, string* crc) override;
+
+    SqliteDbTable(PrnGen &rng, sqlite3*, FileSystemAccess &fsAccess, const LocalPath &path, const bool checkAlwaysTransacted, const bool nodeTable, const bool fingerprintTable);
     ~SqliteDbTable();
 
     bool inTransaction() const override;
@@ -22,6 +22,9 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 
 #include "types.h"
 
@@ -52,6 +55,10 @@ struct MEGA_API FileFingerprint : public Cacheable
     // Generates a fingerprint by iterating through `is`
     bool genfingerprint(InputStreamAccess* is, m_time_t cmtime, bool ignoremtime = false);
 
+    // Takes over a fingerprint generated elsewhere for the same file (a size of -1
+    // meaning it couldn't be read), returning what genfingerprint() would have
+    bool takefingerprint(const FileFingerprint& generated);
+
     void serializefingerprint(string* d) const;
     int unserializefingerprint(string* d);
 
@@ -98,4 +105,44 @@ struct MEGA_API LightFileFingerprintCmp
 
 bool operator==(const LightFileFingerprint& lhs, const LightFileFingerprint& rhs);
 
+class DbTable;
+class DbTableFingerprints;
+
+// Remembers the fingerprints of local files in a database, keyed by the file's fsid on
+// its filesystem, so files whose size, mtime and ctime didn't change aren't read again.
+// Thread safe: the file reads themselves happen outside the lock.
+class MEGA_API LocalFingerprintCache
+{
+public:
+    // the table's flavour must support DbTableFingerprints, or nothing is cached
+    explicit LocalFingerprintCache(std::unique_ptr<DbTable> table);
+    ~LocalFingerprintCache();
+
+    MEGA_DISABLE_COPY_MOVE(LocalFingerprintCache)
+
+    // like f.genfingerprint(fa) for a file opened on the filesystem fsfp,
+    // but without reading it if its fingerprint is known
+    bool genfingerprint(FileFingerprint& f, FileAccess* fa, fsfp_t fsfp);
+
+    // commits the fingerprints added so far (at the end of a scan)
+    void flush();
+
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+
+private:
+    // fingerprints are added in transactions of up to this many, open up to this long,
+    // as other clients using the database wait for them
+    static const unsigned BATCH = 1024;
+    static const unsigned BATCH_MS = 500;
+
+    std::mutex mMutex;
+    std::unique_ptr<DbTable> mTable;
+    DbTableFingerprints* mFingerprints = nullptr;
+    unsigned mUncommitted = 0;
+    std::chrono::steady_clock::time_point mTransactionStart;
+
+    void commitIfDue();
+};
+
 } // mega
@@ -331,6 +331,9 @@ struct MEGA_API FileAccess
     // mtime of a file opened for reading
     m_time_t mtime = 0;
 
+    // inode change time, where the platform reports it (0 otherwise)
+    m_time_t ctime = 0;
+
     // local filesystem record id (survives renames & moves)
     handle fsid = 0;
     bool fsidvalid = false;
@@ -480,6 +483,16 @@ struct NotificationDeque : ThreadSafeDeque<Notification>
             }
         }
     }
+
+    using ThreadSafeDeque<Notification>::peekFront;
+
+    // copies of the first (up to) n notifications, for looking ahead
+    vector<Notification> peekFront(size_t n)
+    {
+        std::lock_guard<std::mutex> g(m);
+        n = std::min(n, mNotifications.size());
+        return vector<Notification>(mNotifications.begin(), mNotifications.begin() + static_cast<std::ptrdiff_t>(n));
+    }
 };
 
 // filesystem change notification, highly coupled to Syncs and LocalNodes.
@@ -891,6 +904,65 @@ public:
     // Issue a scan for the given target.
     RequestPtr queueScan(LocalPath targetPath, handle expectedFsid, bool followSymlinks, map<LocalPath, FSNode>&& priorScanChildren);
 
+    // Concrete representation of a fingerprint request.
+    class FingerprintRequest
+    {
+    public:
+        FingerprintRequest(Waiter& waiter, LocalPath targetPath, bool followSymLinks, shared_ptr<LocalFingerprintCache> cache, fsfp_t fsfp);
+
+        MEGA_DISABLE_COPY_MOVE(FingerprintRequest);
+
+        bool completed() const
+        {
+            return mCompleted;
+        }
+
+        // Completes the request without fingerprinting, if it hasn't started yet.
+        void cancel()
+        {
+            mCancelled = true;
+        }
+
+        // Path to the target.
+        const LocalPath mTargetPath;
+
+        // When the request was queued.
+        const dstime mQueued;
+
+        // Results, only meaningful once completed.
+        // mFingerprint was generated from the file as it was when opened,
+        // which was a file of mSize bytes modified at mMtime.
+        bool mIsFile = false;
+        m_off_t mSize = -1;
+        m_time_t mMtime = 0;
+        handle mFsid = UNDEF;
+        FileFingerprint mFingerprint;
+
+    private:
+        friend class ScanService;
+
+        // Waiter to notify when done
+        Waiter& mWaiter;
+
+        // Whether we should follow symbolic links.
+        const bool mFollowSymLinks;
+
+        // Where to look the fingerprint up first, if anywhere.
+        shared_ptr<LocalFingerprintCache> mCache;
+        fsfp_t mFsfp;
+
+        // Whether the fingerprint request is complete.
+        std::atomic<bool> mCompleted;
+
+        // Whether it's still wanted.
+        std::atomic<bool> mCancelled;
+    }; // FingerprintRequest
+
+    using FingerprintRequestPtr = std::shared_ptr<FingerprintRequest>;
+
+    // Issue a fingerprint computation for the given file, on the filesystem fsfp.
+    FingerprintRequestPtr queueFingerprint(LocalPath targetPath, bool followSymLinks, shared_ptr<LocalFingerprintCache> cache = nullptr, fsfp_t fsfp = 0);
+
     // Track performance (debug only)
     static CodeCounter::ScopeStats syncScanTime;
 
@@ -902,7 +974,7 @@ private:
     class Worker
     {
     public:
-        Worker(size_t numThreads = 1);
+        Worker(size_t numThreads);
 
         ~Worker();
 
@@ -911,18 +983,26 @@ private:
         // Queues a scan request for processing.
         void queue(ScanRequestPtr request);
 
+        // Queues a fingerprint request for processing.
+        void queue(FingerprintRequestPtr request);
+
     private:
+        // Something for a worker thread to do, with that thread's filesystem access.
+        using Job = std::function<void(FileSystemAccess&)>;
+
+        void queue(Job job);
+
         // Thread entry point.
         void loop();
 
         // Processes a scan request.
-        ScanResult scan(ScanRequestPtr request, unsigned& nFingerprinted);
+        ScanResult scan(FileSystemAccess& fsAccess, ScanRequestPtr request, unsigned& nFingerprinted);
 
-        // Filesystem access.
-        std::unique_ptr<FileSystemAccess> mFsAccess;
+        // Processes a fingerprint request.
+        void fingerprint(FileSystemAccess& fsAccess, FingerprintRequestPtr request);
 
-        // Pending scan requests.
-        std::deque<ScanRequestPtr> mPending;
+        // Pending jobs.  An empty job tells the threads to terminate.
+        std::deque<Job> mPending;
 
         // Guards access to the above.
         std::mutex mPendingLock;
@@ -215,6 +215,53 @@ extern std::mutex g_APIURL_default_mutex;
 extern string g_APIURL_default;
 extern bool g_disablepkp_default;
 
+// Pool of the chunk buffers of transfers (HttpReqDL downloads, http_buf_t and so raid FilePieces),
+// shared by all clients and threads.  Buffers come in size classes of four steps per power of two
+// from MINSIZE to MAXSIZE, so that the chunks of fast transfers reuse a few buffers instead of
+// allocating and faulting in new ones, and the workers that decrypt them don't contend on the
+// allocator.  Idle buffers are kept up to a configurable number of bytes; others are freed.
+class MEGA_API BufferPool
+{
+public:
+    static const size_t MINSIZE = 64 * 1024;
+    static const unsigned NUMCLASSES = 44;  // up to 112 MB
+
+    // room for the padding of ciphers and raid sectors beyond the nominal size
+    static const size_t PADDING = 64;
+
+    // a buffer of at least `size` bytes, to be returned with put() and the same size
+    byte* get(size_t size);
+    void put(byte*, size_t size);
+
+    // bytes kept in idle buffers (128 MB by default)
+    void setMaxIdleBytes(size_t);
+
+    struct Stats
+    {
+        // buffers reused, and buffers that had to be allocated
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+
+        size_t idleBytes = 0;
+    };
+
+    Stats stats() const;
+    string report(bool reset);
+
+    ~BufferPool();
+
+private:
+    static size_t classSize(unsigned c);
+    static unsigned sizeClass(size_t size);
+
+    mutable std::mutex mMutex;
+    vector<byte*> mIdle[NUMCLASSES];
+    size_t mMaxIdleBytes = 128 * 1024 * 1024;
+    Stats mStats;
+};
+
+extern BufferPool g_bufferPool;
+
 // generic host HTTP I/O interface
 struct MEGA_API HttpIO : public EventTrigger
 {
@@ -239,6 +286,14 @@ struct MEGA_API HttpIO : public EventTrigger
 
     virtual void disconnect() { }
 
+    // stop receiving the response of a request until it's resumed, eg. while nobody takes
+    // the data, so that it doesn't pile up in HttpReq::in
+    virtual void setpaused(HttpReq*, bool /*paused*/) { }
+
+    // whether requests can be read while they download: with HttpReq::mChunked set, the
+    // received data can be consumed through HttpReq::data()/size()/purge() on the client thread
+    virtual bool chunkedresponses() { return false; }
+
     // track Internet connectivity issues
     dstime noinetds;
     bool inetback;
@@ -300,6 +355,10 @@ struct MEGA_API HttpIO : public EventTrigger
     // get max upload speed
     virtual m_off_t getmaxuploadspeed();
 
+    // multiplex requests to the same host over shared HTTP/2 connections, with at most
+    // maxhostconnections connections per host (0 for no limit)
+    virtual void setmultiplexing(bool /*enable*/, unsigned /*maxhostconnections*/) { }
+
     virtual bool cacheresolvedurls(const std::vector<string>&, std::vector<string>&&) { return false; }
 
     HttpIO();
@@ -336,6 +395,9 @@ struct MEGA_API HttpReq
     // if the out payload includes a fetch nodes command
     bool includesFetchingNodes = false;
 
+    // the response is consumed while it downloads (purged as it's processed), see HttpIO::chunkedresponses()
+    bool mChunked = false;
+
     byte* buf;
     m_off_t buflen, bufpos, notifiedbufpos;
 
@@ -373,6 +435,10 @@ struct MEGA_API HttpReq
     // store chunk of incoming data with optional purging
     void put(void*, unsigned, bool = false);
 
+    // hold back or resume the response (see HttpIO::setpaused)
+    void setpaused(bool);
+    bool paused;
+
     // start and size of unpurged data block - must be called with !buf and httpio locked
     char* data();
     size_t size();
@@ -386,13 +452,14 @@ struct MEGA_API HttpReq
         size_t start;
         size_t end;
 
-        http_buf_t(byte* b, size_t s, size_t e);  // takes ownership of the byte*, which must have been allocated with new[]
+        http_buf_t(byte* b, size_t s, size_t e, size_t capacity);  // takes ownership of the byte*, which must have been obtained from g_bufferPool.get(capacity)
         ~http_buf_t();
         void swap(http_buf_t& other);
         bool isNull();
 
     private:
         byte* buf;
+        size_t capacity;
     };
 
     // give up ownership of the buffer for client to use.  The caller is the new owner of the http_buf_t, and the HttpReq no longer has the buffer or any info about it.
@@ -467,12 +534,18 @@ public:
 
     bool encrypt(m_off_t pos, m_off_t npos, string& urlSuffix);
 
+protected:
+    // true if buffers returned by nextbuffer() stay valid until encrypt() returns,
+    // so that several chunks can be encrypted (and their macs calculated) together
+    virtual bool buffersPersist() { return false; }
+
 private:
     SymmCipher* key;
     chunkmac_map* macs;
     uint64_t ctriv;     // initialization vector for CTR mode
     byte crc[CRCSIZE];
     void updateCRC(byte* data, unsigned size, unsigned offset);
+    void encryptPieces(vector<chunkmac_map::CtrPiece>& pieces, m_off_t pos);
 };
 
 class MEGA_API EncryptBufferByChunks : public EncryptByChunks
@@ -481,6 +554,7 @@ class MEGA_API EncryptBufferByChunks : public EncryptByChunks
     byte *chunkstart;
 
     byte* nextbuffer(unsigned bufsize) override;
+    bool buffersPersist() override { return true; }
 
 public:
     EncryptBufferByChunks(byte* b, SymmCipher* k, chunkmac_map* m, uint64_t iv);
@@ -171,6 +171,61 @@ private:
     signed char mLevel;
 }; // JSONWriter
 
+// Incremental JSON scanner for responses that are too large to buffer: it is fed the response
+// as it downloads and hands selected elements to filters as soon as they are complete.
+//
+// Elements are selected by path.  The root's path is its type character ('[' array, '{' object,
+// '"' string, '#' anything else), an array member appends its type character to the path of
+// the array, and an object member appends its type character followed by its name.  E.g. in
+// [{"f":[{"h":"..."}],"sn":"..."}] the objects in "f" are at "[{[f{" and "sn" is at "[{\"sn".
+//
+// A filter receives a JSON positioned at its complete element, NUL-terminated.  If some of the
+// element's descendants were already given to their own filters, it receives an empty
+// container ("[]" or "{}") instead.  Everything not needed for a pending filter is released as
+// soon as it has been scanned.  The special filter "<" is called before the first byte.
+class MEGA_API JSONSplitter
+{
+public:
+    using Filter = std::function<bool(JSON*)>;
+    using FilterMap = std::map<string, Filter>;
+
+    // Scan data[0, len): whatever processChunk() didn't release last time, followed by what arrived
+    // since.  Returns how many bytes from the start of data are not needed anymore.
+    size_t processChunk(const FilterMap& filters, const char* data, size_t len);
+
+    bool hasStarted() const { return mStarted; }
+    bool hasFinished() const { return mFinished; }
+    bool hasFailed() const { return mFailed; }
+
+    void clear();
+
+private:
+    struct Level
+    {
+        size_t pathLength;  // of mPath, including this level
+        size_t start;       // offset of the opening character
+        bool filtered;      // a filter wants this element when it ends
+        bool split;         // some descendant went to its own filter
+        bool object;
+        bool expectName;    // objects: the next string is a member name
+    };
+
+    // an element at data[start, end) has been scanned (if split, only its type is still known)
+    bool endElement(const FilterMap& filters, const char* data, size_t start, size_t end, bool filtered, bool split, bool object);
+
+    string mPath;
+    string mName;
+    vector<Level> mLevels;
+    string mElement;
+
+    // offset of the next byte to scan, relative to the data passed to processChunk()
+    size_t mPos = 0;
+
+    bool mStarted = false;
+    bool mFinished = false;
+    bool mFailed = false;
+};
+
 } // namespace
 
 #endif
@@ -81,6 +81,10 @@ struct MEGA_API MegaApp
     // remove versions result
     virtual void unlinkversions_result(error) { }
 
+    // a node has been queued for notification (its change may already be
+    // visible to request callbacks, before nodes_updated() is called)
+    virtual void node_pending(Node*) { }
+
     // nodes have been updated
     virtual void nodes_updated(Node**, int) { }
 
@@ -183,6 +187,15 @@ struct MEGA_API MegaApp
     virtual dstime pread_failure(const Error&, int, void*, dstime) { return ~(dstime)0; }
     virtual bool pread_data(byte*, m_off_t, m_off_t, m_off_t, m_off_t, void*) { return false; }
 
+    // pread result, with the buffer owner: apps keeping the shared pointer may use the data after returning
+    virtual bool pread_piece(byte* data, m_off_t len, m_off_t pos, m_off_t speed, m_off_t meanSpeed, void* appdata, const std::shared_ptr<void>&)
+    {
+        return pread_data(data, len, pos, speed, meanSpeed, appdata);
+    }
+
+    // whether the app can't take more pread data for now (the read is held, rather than aborted)
+    virtual bool pread_paused(void*) { return false; }
+
     // event reporting result
     virtual void reportevent_result(error) { }
 
@@ -558,8 +558,11 @@ public:
 
     MegaClientAsyncQueue mAsyncQueue;
 
-    // number of parallel connections per transfer (PUT/GET)
-    unsigned char connections[2];
+    // transfers and connections per transfer (PUT/GET), adapted to the measured throughput
+    TransferLimits mTransferLimits;
+
+    // putnodes of completed uploads, sent in batches
+    PutnodesBatcher mPutnodesBatcher;
 
     // helpfer function for preparing a putnodes call for new node
     error putnodes_prepareOneFile(NewNode* newnode, Node* parentNode, const char *utf8Name, const UploadToken& binaryUploadToken,
@@ -1062,6 +1065,48 @@ public:
     // returns true if drive monitor is started
     bool driveMonitorEnabled();
 
+    // fetch state serialize from local cache
+    bool fetchsc(DbTable*);
+
+    // Load nodes from the typed node table of the local cache when they are looked up
+    // (by handle, by name in a folder or by fingerprint), rather than all of them in
+    // fetchsc(), which then loads only the top nodes.  Code that walks Node::children
+    // sees the loaded nodes only: use pageInChildren() or pageInSubtree() first.  The
+    // node counters and subtree aggregates always cover all the nodes: those of the nodes
+    // not loaded come from the node table.  Once the nodes fetched from the API are
+    // written to the local cache, they are handled the same way.
+    bool mNodesOnDemand = false;
+
+    // set while nodes are loaded from the node table or evicted: they are part of the
+    // counts of their ancestors either way
+    bool mPagingNodes = false;
+
+    // approximate memory for the nodes loaded on demand (0: no limit).  The least
+    // recently used nodes that are stored unchanged in the local cache, and that
+    // nothing else refers to, are evicted when it is exceeded.
+    void setNodesMemoryBudget(size_t bytes);
+    size_t nodesMemory() const { return mNodesMemory; }
+
+    // release the least recently used nodes over the budget (done at the end of exec())
+    void evictnodes();
+
+    // least recently used nodes last (only when loaded on demand)
+    mutable node_list mNodeLru;
+    void lruAdd(Node*);
+    void lruRemove(Node*);
+    void lruMeasure(Node*);
+
+    // load all the children, or all the nodes below a node, if nodes are loaded on demand
+    void pageInChildren(Node*);
+    void pageInSubtree(Node*);
+
+    // load nodes from the typed node table, if not in memory yet (with their ancestors)
+    Node* loadNode(NodeHandle);
+    node_vector loadChildren(Node*);
+    node_vector loadChildrenByName(Node*, const string& name);
+    node_vector loadNodesByFingerprint(const FileFingerprint&);
+    size_t loadSubtree(Node*);
+
 private:
 #ifdef USE_DRIVE_NOTIFICATIONS
     DriveInfoCollector mDriveInfoCollector;
@@ -1132,9 +1177,12 @@ private:
     // maximum number of concurrent transfers (uploads + downloads)
     static const unsigned MAXTOTALTRANSFERS;
 
-    // maximum number of concurrent transfers (uploads or downloads)
+    // initial number of concurrent transfers (uploads or downloads)
     static const unsigned MAXTRANSFERS;
 
+    // ceiling of the concurrent transfers (uploads or downloads) that mTransferLimits can reach
+    static const unsigned MAXADAPTIVETRANSFERS;
+
     // maximum number of queued putfa before halting the upload queue
     static const int MAXQUEUEDFA;
 
@@ -1147,8 +1195,41 @@ private:
     // a TransferSlot chunk failed
     bool chunkfailed;
 
-    // fetch state serialize from local cache
-    bool fetchsc(DbTable*);
+    // records of the local cache being loaded by fetchsc()
+    struct CacheBatch;
+    static void decodeCacheBatch(CacheBatch&, SymmCipher&);
+
+    // whether the nodes in memory were loaded on demand by fetchsc() (or written by initsc())
+    bool mLoadedOnDemand = false;
+    void startLoadedOnDemand();
+
+    size_t mNodesMemory = 0;
+    size_t mNodesMemoryBudget = 0;
+
+    shared_ptr<const NodeNameSnapshot> mNameSnapshot;
+
+    // memory left by the last evictnodes(), that couldn't get below the budget
+    size_t mNodesMemoryFloor = 0;
+
+    bool isEvictable(const Node*) const;
+    size_t evictnode(Node*);
+
+    shared_ptr<LocalFingerprintCache> mFingerprintCache;
+    bool mFingerprintCacheOpened = false;
+
+    // typed node table of the local cache, if it was opened with DB_OPEN_FLAG_NODES
+    DbTableNodes* nodeTable() const;
+    bool updatenodetable(DbTableNodes&);
+    bool putNodeRecord(DbTableNodes&, Node*);
+    static string fingerprintColumn(const FileFingerprint&);
+    uint64_t nodeNameHash(const string&) const;
+    Node* loadNodeRecord(string& content);
+    // set the aggregates of a node loaded from the node table
+    void pagedIn(Node*);
+    node_vector loadNodeRows(DbTableNodes::NodeRows&);
+
+    // children by name, loading them on demand
+    vector<Node*> childrenByName(const Node*, const string& name) const;
 
     // fetch statusTable from local cache
     bool fetchStatusTable(DbTable*);
@@ -1256,9 +1337,17 @@ public:
     // DB access
     DbAccess* dbaccess = nullptr;
 
+    // fingerprints of local files, shared by all the sessions on this device
+    // (opened on first use, null without dbaccess)
+    shared_ptr<LocalFingerprintCache> fingerprintCache();
+
     // state cache table for logged in user
     unique_ptr<DbTable> sctable;
 
+    // write the state cache from a thread of its own (see WriteBehindDbTable), when the
+    // database supports it.  Read by opensctable()
+    bool mWriteBehindStateCache = true;
+
     // there is data to commit to the database when possible
     bool pendingsccommit;
 
@@ -1303,7 +1392,7 @@ public:
     pendinghttp_map pendinghttp;
 
     // record type indicator for sctable
-    enum { CACHEDSCSN, CACHEDNODE, CACHEDUSER, CACHEDLOCALNODE, CACHEDPCR, CACHEDTRANSFER, CACHEDFILE, CACHEDCHAT} sctablerectype;
+    enum { CACHEDSCSN, CACHEDNODE, CACHEDUSER, CACHEDLOCALNODE, CACHEDPCR, CACHEDTRANSFER, CACHEDFILE, CACHEDCHAT, CACHEDSEARCHINDEX} sctablerectype;
 
     // record type indicator for statusTable
     enum StatusTableRecType { CACHEDSTATUS };
@@ -1373,6 +1462,7 @@ public:
     dsdrn_map dsdrns;      // indicates the time at which DRNs should be retried
     dr_list drq;           // DirectReads that are in DirectReadNodes which have fectched URLs
     drs_list drss;         // DirectReadSlot for each DR in drq, up to Max
+    DirectReadCache directReadCache;   // recently streamed decrypted data, shared by all DirectReads
 
     // merge newly received share into nodes
     void mergenewshares(bool);
@@ -1413,6 +1503,21 @@ public:
     // FileFingerprint to node mapping
     Fingerprints mFingerprints;
 
+    // copy of the names of the nodes under the root nodes and the inshares, for searches
+    // that run without the client.  It is built on first use, and dropped when nodes are
+    // added, moved or renamed.
+    shared_ptr<const NodeNameSnapshot> nameSnapshot();
+    void invalidateNameSnapshot() { mNameSnapshot.reset(); }
+
+    // names and file categories of all the file and folder nodes, for searches that don't
+    // visit the tree.  Nodes are indexed when their attributes are decrypted and when they
+    // are notified (see notifypurge()), and the index is stored along with them.
+    NodeSearchIndex mSearchIndex;
+    void indexNode(Node* n);
+
+    // the NodeSearchIndex categories of a node, by extension
+    uint8_t searchCategories(const Node* n) const;
+
     // flag to skip removing nodes from mFingerprints when all nodes get deleted
     bool mOptimizePurgeNodes = false;
 
@@ -1675,6 +1780,8 @@ public:
 
     // process object arrays by the API server
     int readnodes(JSON*, int, putsource_t, vector<NewNode>*, int, bool applykeys);
+    int readnode(JSON*, int, putsource_t, vector<NewNode>*, int, bool applykeys, node_vector& dp, handle& previousHandleForAlert);
+    void readnodesfinish(node_vector& dp, int notify);
 
     void readok(JSON*);
     void readokelement(JSON*);
@@ -23,6 +23,9 @@
 #ifndef MEGA_NODE_H
 #define MEGA_NODE_H 1
 
+#include <unordered_map>
+#include <unordered_set>
+
 #include "filefingerprint.h"
 #include "file.h"
 #include "attrmap.h"
@@ -98,13 +101,11 @@ struct MEGA_API PublicLink
     bool isExpired();
 };
 
-// Container storing FileFingerprint* (Node* in practice) ordered by fingerprint.
+// Index of the file nodes by fingerprint: an open addressing hash table (linear probing)
+// whose slots hold the fingerprint next to the node, so lookups don't visit other nodes.
+// Nodes with the same fingerprint are returned in the order they were added.
 struct Fingerprints
 {
-    // maps FileFingerprints to node
-    using fingerprint_set = std::multiset<FileFingerprint*, FileFingerprintCmp>;
-    using iterator = fingerprint_set::iterator;
-
     void newnode(Node* n);
     void add(Node* n);
     void remove(Node* n);
@@ -114,11 +115,315 @@ struct Fingerprints
     Node* nodebyfingerprint(FileFingerprint* fingerprint);
     node_vector *nodesbyfingerprint(FileFingerprint* fingerprint);
 
+    size_t size() const { return mCount; }
+
 private:
-    fingerprint_set mFingerprints;
+    struct Slot
+    {
+        m_off_t size = -1;
+        m_time_t mtime = 0;
+        std::array<int32_t, 4> crc{};
+        Node* node = nullptr;
+
+        Slot() = default;
+        explicit Slot(const FileFingerprint&);
+
+        bool matches(const Slot&) const;
+    };
+
+    // grow when more than 3/4 of the slots are used
+    static const size_t MINSLOTS = 64;
+
+    static size_t hash(const Slot&);
+    size_t first(const Slot& key) const { return hash(key) & (mSlots.size() - 1); }
+    size_t next(size_t i) const { return (i + 1) & (mSlots.size() - 1); }
+
+    void insert(const Slot&);
+    void rehash(size_t slots);
+
+    vector<Slot> mSlots;
+    size_t mCount = 0;
     m_off_t mSumSizes = 0;
 };
 
+// A folder's children, linked through the child nodes themselves (Node::prevSibling and
+// Node::nextSibling), so that a child needs no allocation of its own.  Nodes are appended
+// by Node::setparent() and unlinked when they leave the folder.
+class MEGA_API NodeChildren
+{
+public:
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Node*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Node* const*;
+        using reference = Node* const&;
+
+        explicit const_iterator(Node* n = nullptr) : mNode(n) { }
+
+        reference operator*() const { return mNode; }
+        const_iterator& operator++();
+        const_iterator operator++(int);
+
+        bool operator==(const const_iterator& o) const { return mNode == o.mNode; }
+        bool operator!=(const const_iterator& o) const { return mNode != o.mNode; }
+
+    private:
+        Node* mNode;
+    };
+    using iterator = const_iterator;
+
+    iterator begin() const { return iterator(mFirst); }
+    iterator end() const { return iterator(); }
+
+    size_t size() const { return mSize; }
+    bool empty() const { return !mSize; }
+
+    // children of type FILENODE, and the rest
+    size_t files() const { return mFiles; }
+    size_t folders() const { return mSize - mFiles; }
+
+    Node* front() const { return mFirst; }
+    Node* back() const { return mLast; }
+
+    void push_back(Node*);
+    void erase(Node*);
+
+private:
+    Node* mFirst = nullptr;
+    Node* mLast = nullptr;
+    size_t mSize = 0;
+    size_t mFiles = 0;
+};
+
+// Index of a folder's children by name, so that looking a child up by name does not
+// need to walk the children list.  It is only built for folders with many children, the
+// first time one of them is looked up by name, and from then on it is kept up to date by
+// Node::setparent() and by everything that changes a node's decrypted name.
+class MEGA_API ChildNameIndex
+{
+public:
+    // folders with fewer children than this are just scanned
+    static const size_t MINCHILDREN = 64;
+
+    explicit ChildNameIndex(const NodeChildren& children);
+
+    void add(Node* n);
+    void remove(Node* n);
+
+    // children currently named `name` (UTF-8, normalized), in children order
+    vector<Node*> find(const string& name, const NodeChildren& children) const;
+
+    // displayname() placeholders, which can't be looked up in the index
+    static bool isPlaceholder(const string& name);
+
+private:
+    using name_map = std::unordered_multimap<string, Node*>;
+
+    // the name a node is indexed by, or nullptr if it has none
+    static const string* key(const Node* n);
+
+    name_map mNames;
+};
+
+// A large folder's children in each order they have been listed in, so that listing a page
+// of them does not sort the whole folder every time.  Built on demand by
+// Node::sortedChildren().  Children that are added, removed or changed in any way are just
+// marked by touch() (or forget(), for deleted nodes), and they are taken out of the sorted
+// orders and merged back in their new place the next time an order is read.
+class MEGA_API ChildSortIndex
+{
+public:
+    using Comparator = std::function<bool(Node*, Node*)>;
+
+    // folders with fewer children than this are just sorted
+    static const size_t MINCHILDREN = 64;
+
+    explicit ChildSortIndex(const Node* folder) : mFolder(folder) { }
+
+    // the children of the folder sorted by `less`, which identifies the order by `key`
+    const node_vector& sorted(int key, const Comparator& less);
+
+    void touch(Node* n);
+    void forget(Node* n);
+
+private:
+    struct Order
+    {
+        Comparator less;
+        node_vector nodes;
+    };
+
+    void merge();
+
+    const Node* mFolder;
+    std::map<int, Order> mOrders;
+
+    // children to place again, and deleted nodes among them (not to be dereferenced)
+    std::unordered_set<Node*> mPending;
+    std::unordered_set<Node*> mGone;
+};
+
+// Read-only copy of the display names of the nodes below some top nodes, for searches that
+// run without the client (and its lock).  Names are stored case-folded, one after another,
+// in the order MegaApiImpl::processTree() visits the nodes: children before their parent.
+// So the nodes below any node are the range of positions right before its own, and a
+// search is a scan of contiguous memory that can be split between threads.
+// It has the nodes loaded in memory: MegaClient::nameSnapshot() loads the subtrees first.
+class MEGA_API NodeNameSnapshot
+{
+public:
+    // positions [first, last) of some nodes in the snapshot
+    using Range = std::pair<size_t, size_t>;
+
+    // handles of the nodes matched by a search, in snapshot order
+    using Matches = vector<NodeHandle>;
+
+    // called with the matches of each part of a search, from the thread that searched it,
+    // as soon as that part is done (so parts may arrive in any order)
+    using PartCallback = std::function<void(size_t part, const Matches&)>;
+
+    // searches smaller than this are not split
+    static const size_t MINNODESPERTHREAD = 32768;
+
+    // copies the subtrees of the top nodes, in the order given
+    explicit NodeNameSnapshot(const node_vector& tops);
+
+    size_t size() const { return mHandles.size(); }
+
+    // the range of a node's subtree: the nodes below it, followed by the node itself
+    // (false if the node is not in the snapshot)
+    bool subtree(NodeHandle h, Range& range) const;
+
+    // file and folder nodes in the ranges whose name contains `text` (ignoring ASCII case,
+    // like strcasestr()), split between up to `threads` threads
+    Matches search(const vector<Range>& ranges, const string& text, CancelToken cancelToken,
+                   unsigned threads = 0, PartCallback onPart = nullptr) const;
+
+    // ASCII lowercase, as the names are stored
+    static void fold(string& s);
+
+private:
+    // matches within a contiguous range
+    void searchRange(Range range, const string& text, const CancelToken& cancelToken, Matches& matches) const;
+
+    // folded names, each followed by a '\0'
+    string mNames;
+
+    // start of each node's name in mNames (plus the end of the last one)
+    vector<size_t> mNameStart;
+
+    // position of the first node of each node's subtree
+    vector<uint32_t> mFirst;
+
+    vector<NodeHandle> mHandles;
+    vector<nodetype_t> mTypes;
+
+    // position of each node, sorted by handle
+    vector<std::pair<NodeHandle, uint32_t>> mPositions;
+};
+
+// Inverted index of the names and file categories of all the file and folder nodes, so that
+// searches by name (prefix or substring, ignoring ASCII case like NodeNameSnapshot) and by
+// FILE_TYPE_* category don't visit the tree, nor need the nodes loaded.  Names are indexed
+// by their trigrams, the first one starting with a marker so that prefixes are indexed too.
+// Postings are only appended: the ones left behind by renames and removals are skipped by
+// the queries, until they outnumber the live ones and all postings are rebuilt.
+// The entries are persisted in records of the state cache (MegaClient::updatesc()), so the
+// index is available without loading the nodes.
+class MEGA_API NodeSearchIndex
+{
+public:
+    // file categories, by extension (see MegaClient::searchCategories())
+    enum : uint8_t { PHOTO = 1, AUDIO = 2, VIDEO = 4, DOCUMENT = 8 };
+
+    // entries per state cache record
+    static const uint32_t RECORDENTRIES = 1024;
+
+    // adds or updates a node (`name` as displayed), or removes it
+    void set(NodeHandle h, nodetype_t type, const string& name, uint8_t categories);
+    void remove(NodeHandle h);
+
+    // empties the index, which is then complete (there are no nodes)
+    void clear();
+
+    size_t size() const { return mIds.size(); }
+
+    // nodes whose name starts with (`prefix`) or contains `text`, if any, and having any
+    // of the `categories`, if any, in no particular order
+    vector<NodeHandle> find(const char* text, bool prefix, uint8_t categories) const;
+
+    // false if some nodes may be missing, eg. loaded from a cache without a valid index
+    bool complete() const { return mComplete; }
+    void setComplete(bool complete) { mComplete = complete; }
+
+    // writes the changed records and the scsn they correspond to (nothing if not complete)
+    bool store(DbTable& table, uint32_t type, SymmCipher* key, handle scsn);
+
+    // all the records must be stored again, eg. after truncating the table
+    void forgetStored();
+
+    // reads a stored record; when all are read, loaded() checks that they correspond to
+    // the cache's scsn, otherwise the index is emptied and left incomplete
+    bool unserializeRecord(const string& data, uint32_t dbid);
+    bool loaded(handle scsn);
+
+private:
+    struct Entry
+    {
+        NodeHandle handle;
+        nodetype_t type = TYPE_UNKNOWN;
+        uint8_t categories = 0;
+        bool used = false;
+
+        // case-folded
+        string name;
+    };
+
+    struct Record : public Cacheable
+    {
+        Record(const NodeSearchIndex& index, uint32_t number) : mIndex(index), mNumber(number) { }
+        bool serialize(string* d) override;
+
+        const NodeSearchIndex& mIndex;
+        uint32_t mNumber;
+    };
+
+    // the record holding the scsn
+    static const uint32_t SCSNRECORD = ~uint32_t(0);
+
+    // a name's trigrams, unique and sorted
+    static vector<uint32_t> grams(const string& folded, bool prefix);
+
+    void addPostings(uint32_t id, const vector<uint32_t>& grams, uint8_t categories);
+    void rebuildPostings();
+    void changed(uint32_t id);
+
+    bool matches(const Entry& e, const string& text, bool prefix, uint8_t categories) const;
+
+    vector<Entry> mEntries;
+    vector<uint32_t> mFreeIds;
+    std::unordered_map<handle, uint32_t> mIds;
+
+    // entry ids by trigram and by category
+    std::unordered_map<uint32_t, vector<uint32_t>> mGramPostings;
+    vector<uint32_t> mCategoryPostings[4];
+    size_t mLivePostings = 0;
+    size_t mStalePostings = 0;
+
+    bool mComplete = true;
+
+    // database ids of the records (0 if not stored), and the records changed since stored
+    vector<uint32_t> mRecordIds;
+    std::set<uint32_t> mChangedRecords;
+    uint32_t mScsnRecordId = 0;
+    handle mStoredScsn = UNDEF;
+
+    // stored records not to be used anymore (unreadable, repeated or incomplete), to delete
+    vector<uint32_t> mDiscardedRecordIds;
+};
 
 // filesystem node
 struct MEGA_API Node : public NodeCore, FileFingerprint
@@ -228,6 +533,9 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
 
     } changed;
 
+    // source tag.  The tag of the request or transfer that last modified this node (available in MegaApi)
+    int tag = 0;
+
     void setkey(const byte* = NULL);
 
     void setkeyfromjson(const char*);
@@ -236,19 +544,56 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
 
     void faspec(string*);
 
+    // counts of the node and everything below it: kept in subtreeCounts for folders and
+    // root nodes, and added up from the versions for files
     NodeCounter subnodeCounts() const;
 
+    // aggregated counts of a folder's or root node's subtree (null for files), updated
+    // by setparent(), by the destructor and by whoever changes a file's size
+    unique_ptr<NodeCounter> subtreeCounts;
+
+    // add (or subtract) counts to those of every ancestor, as its subtree changes
+    void countInAncestors(const NodeCounter&, bool add) const;
+
     // parent
     Node* parent = nullptr;
 
     // children
-    node_list children;
+    NodeChildren children;
+
+    // neighbours in parent's children
+    Node* prevSibling = nullptr;
+    Node* nextSibling = nullptr;
+
+    // children by name (only for large folders, built on demand, see ChildNameIndex)
+    mutable unique_ptr<ChildNameIndex> childNames;
+
+    // the parent's index of children by name, if any.  Whoever changes this node's name
+    // removes it from that index before the change and adds it back afterwards
+    ChildNameIndex* parentNameIndex() const;
+
+    // children whose display name is `name` (UTF-8, normalized), in children order
+    vector<Node*> childrenByName(const string& name) const;
+
+    // children in the orders they have been listed in (only for large folders, see ChildSortIndex)
+    mutable unique_ptr<ChildSortIndex> childOrders;
+
+    // the parent's sorted children, if any.  Whoever changes anything of this node that
+    // children can be sorted by touches it there
+    ChildSortIndex* parentSortIndex() const;
 
-    // own position in parent's children
-    node_list::iterator child_it;
+    // up to `limit` children from position `offset` of the children sorted by `less`, which
+    // identifies the order by `key` (the sorted orders are kept for large folders)
+    node_vector sortedChildren(int key, const ChildSortIndex::Comparator& less,
+                               size_t offset = 0, size_t limit = SIZE_MAX) const;
 
-    // own position in fingerprint set (only valid for file nodes)
-    Fingerprints::iterator fingerprint_it;
+    // whether the node is in the client's fingerprint index (only file nodes are)
+    bool fingerprintIndexed = false;
+
+    // position in the client's list of least recently used nodes, and approximate
+    // memory used by the node (only when nodes are loaded on demand)
+    node_list::iterator lru_it;
+    size_t lruMemory = 0;
 
 #ifdef ENABLE_SYNC
     // related synced item or NULL
@@ -268,9 +613,6 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     unlink_or_debris_set::iterator tounlink_it;
 #endif
 
-    // source tag.  The tag of the request or transfer that last modified this node (available in MegaApi)
-    int tag = 0;
-
     // check if node is below this node
     bool isbelow(Node*) const;
     bool isbelow(NodeHandle) const;
@@ -283,9 +625,42 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     bool serialize(string*) override;
     static Node* unserialize(MegaClient*, const string*, node_vector*);
 
+    // a serialized node, parsed without touching the client (so on any thread)
+    struct MEGA_API Unserialized
+    {
+        handle h = UNDEF;
+        handle ph = UNDEF;
+        nodetype_t type = TYPE_UNKNOWN;
+        m_off_t size = 0;
+        handle owner = UNDEF;
+        m_time_t ctime = 0;
+        string key;
+        string fileattrstring;
+        AttrMap attrs;
+
+        // inshare, outshares, or pending shares
+        vector<unique_ptr<NewShare>> shares;
+
+        bool isExported = false;
+        handle plinkHandle = UNDEF;
+        m_time_t plinkCts = 0;
+        m_time_t plinkEts = 0;
+        bool plinkTakendown = false;
+        string plinkAuthKey;
+    };
+
+    static bool unserialize(const string*, Unserialized&);
+
+    // create the node, updating nodes hash and parent mismatch vector
+    static Node* unserialize(MegaClient*, Unserialized&, node_vector*);
+
     Node(MegaClient*, vector<Node*>*, NodeHandle, NodeHandle, nodetype_t, m_off_t, handle, const char*, m_time_t);
     ~Node();
 
+    // nodes are allocated from slabs of many nodes rather than one by one
+    static void* operator new(size_t);
+    static void operator delete(void*, size_t);
+
 #ifdef ENABLE_SYNC
     void detach(const bool recreate = false);
 #endif // ENABLE_SYNC
@@ -297,6 +672,19 @@ private:
     string nodekeydata;
 };
 
+inline NodeChildren::const_iterator& NodeChildren::const_iterator::operator++()
+{
+    mNode = mNode->nextSibling;
+    return *this;
+}
+
+inline NodeChildren::const_iterator NodeChildren::const_iterator::operator++(int)
+{
+    const_iterator previous = *this;
+    mNode = mNode->nextSibling;
+    return previous;
+}
+
 inline const string& Node::nodekey() const
 {
     assert(keyApplied() || type == ROOTNODE || type == VAULTNODE || type == RUBBISHNODE);
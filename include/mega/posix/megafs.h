@@ -43,11 +43,19 @@
 #include <aio.h>
 #endif
 
+#ifdef USE_IOURING
+#include <liburing.h>
+#endif
+
 #include "mega.h"
 
 #define DEBRISFOLDER ".debris"
 
 namespace mega {
+#ifdef USE_IOURING
+class PosixIOUring;
+#endif
+
 struct MEGA_API PosixDirAccess : public DirAccess
 {
     DIR* dp;
@@ -89,6 +97,13 @@ public:
     int defaultfilepermissions;
     int defaultfolderpermissions;
 
+#ifdef USE_IOURING
+    // shared by all the files opened through this object, set up on the first async access
+    // so that the instances used only for synchronous I/O don't get one (null if io_uring
+    // is unavailable)
+    PosixIOUring* asyncRing();
+#endif
+
     unique_ptr<FileAccess> newfileaccess(bool followSymLinks = true) override;
     unique_ptr<DirAccess>  newdiraccess() override;
 #ifdef ENABLE_SYNC
@@ -148,16 +163,62 @@ public:
     bool hardLink(const LocalPath& source, const LocalPath& target) override;
 
     m_off_t availableDiskSpace(const LocalPath& drivePath) override;
+
+#ifdef USE_IOURING
+private:
+    unique_ptr<PosixIOUring> ioUring;
+    bool ioUringSetUp = false;
+#endif
 };
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
 struct MEGA_API PosixAsyncIOContext : public AsyncIOContext
 {
     PosixAsyncIOContext();
     virtual ~PosixAsyncIOContext();
     virtual void finish();
 
+#ifdef HAVE_AIO_RT
     struct aiocb *aiocb;
+#endif
+
+#ifdef USE_IOURING
+    // set while the operation is queued on (or running in) an io_uring
+    PosixIOUring* ring = nullptr;
+#endif
+};
+#endif
+
+#ifdef USE_IOURING
+// Asynchronous file I/O through one io_uring shared by all the files of a PosixFileSystemAccess.
+// Reads and writes are queued as the transfer slots request them and submitted together with a
+// single syscall when the client is about to wait.  Completions wake the Waiter through an eventfd
+// and are processed on the client thread by checkevents(), so no helper threads are involved.
+class MEGA_API PosixIOUring
+{
+public:
+    // returns nullptr if io_uring can't be used here (old kernel, seccomp filters, ...)
+    static unique_ptr<PosixIOUring> create(unsigned entries = 256);
+    ~PosixIOUring();
+
+    // queue a read or write of the context's buffer.  Returns false if that was not possible
+    bool queue(int fd, PosixAsyncIOContext* context);
+
+    // submit everything queued so far, and wake up the waiter on completions
+    void addevents(Waiter* w);
+
+    // process finished operations, or block until waitFor has finished.  Returns Waiter::NEEDEXEC if any finished
+    int reap(PosixAsyncIOContext* waitFor = nullptr);
+
+private:
+    PosixIOUring() = default;
+    void submit();
+    void complete(const io_uring_cqe* cqe);
+
+    io_uring ring;
+    int eventfd = -1;
+    unsigned queued = 0;
+    std::mutex mutex;
 };
 #endif
 
@@ -190,6 +251,11 @@ public:
 
     PosixFileAccess(Waiter *w, int defaultfilepermissions = 0600, bool followSymLinks = true);
 
+#ifdef USE_IOURING
+    // if it has a ring, async reads and writes go through it instead of POSIX AIO
+    PosixFileSystemAccess* ioUringOwner = nullptr;
+#endif
+
     // async interface
     bool asyncavailable() override;
     void asyncsysopen(AsyncIOContext* context) override;
@@ -198,9 +264,11 @@ public:
 
     ~PosixFileAccess();
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
 protected:
     virtual AsyncIOContext* newasynccontext();
+#endif
+#ifdef HAVE_AIO_RT
     static void asyncopfinished(union sigval sigev_value);
 #endif
 
@@ -179,6 +179,12 @@ protected:
     WAIT_CLASS* waiter;
     bool disconnecting;
 
+    // HTTP/2 multiplexing, applied to the multi handles whenever they are created
+    // (HTTP/1.1 without pipelining when disabled)
+    bool multiplexing;
+    unsigned maxhostconnections;
+    void setmultiplexingoptions();
+
     typedef std::map<curl_socket_t, SockInfo> SockInfoMap;
 
 #ifdef MEGA_USE_C_ARES
@@ -203,6 +209,7 @@ protected:
 public:
     void post(HttpReq*, const char* = 0, unsigned = 0) override;
     void cancel(HttpReq*) override;
+    void setpaused(HttpReq*, bool paused) override;
 
     m_off_t postpos(void*) override;
 
@@ -218,6 +225,8 @@ public:
 #endif
     void disconnect() override;
 
+    bool chunkedresponses() override { return true; }
+
     // set max download speed
     bool setmaxdownloadspeed(m_off_t bpslimit) override;
 
@@ -230,6 +239,8 @@ public:
     // get max upload speed
     m_off_t getmaxuploadspeed() override;
 
+    void setmultiplexing(bool enable, unsigned maxhostconnections) override;
+
     bool cacheresolvedurls(const std::vector<string>& urls, std::vector<string>&& ips) override;
 
     CurlHttpIO();
@@ -31,6 +31,10 @@ namespace mega {
     enum { RAIDSECTOR = 16 };
     enum { RAIDLINE = ((RAIDPARTS - 1)*RAIDSECTOR) };
 
+    // Rebuild whole raid lines from the parts, partslen bytes of each: interleaves the sectors of data parts 1-5,
+    // recovering one missing data part (NULL in inputbufs) from the parity part 0.  Uses SSE2/AVX2 where available.
+    void combineRaidLines(byte* dest, byte* const inputbufs[RAIDPARTS], size_t partslen);
+
 
     // Holds the latest download data received.   Raid-aware.   Suitable for file transfers, or direct streaming.
     // For non-raid files, supplies the received buffer back to the same connection for writing to file (having decrypted and mac'd it),
@@ -176,7 +180,6 @@ namespace mega {
         // take raid input part buffers and combine to form the asyncoutputbuffers
         void combineRaidParts(unsigned connectionNum);
         FilePiece* combineRaidParts(size_t partslen, size_t bufflen, m_off_t filepos, FilePiece& prevleftoverchunk);
-        void recoverSectorFromParity(byte* dest, byte* inputbufs[], unsigned offset);
         void combineLastRaidLine(byte* dest, size_t nbytes);
         void rollInputBuffers(size_t dataToDiscard);
         virtual void bufferWriteCompletedAction(FilePiece& r);
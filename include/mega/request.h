@@ -36,6 +36,9 @@ private:
     JSON json;
     size_t processindex = 0;
 
+    // for responses parsed while they download
+    JSONSplitter mSplitter;
+
 public:
     void add(Command*);
 
@@ -56,6 +59,17 @@ public:
 
     // if contains only one command and that command is FetchNodes
     bool isFetchNodes() const;
+
+    // if contains only one command and that command can parse its response while it downloads
+    bool isChunked() const;
+
+    // parse the part of the response received so far, returns how much of it can be released
+    size_t processChunk(const char* data, size_t len, MegaClient* client);
+
+    // the rest of the response arrived (only when chunked processing started)
+    void processLastChunk(const char* data, size_t len, MegaClient* client);
+
+    bool chunksStarted() const { return mSplitter.hasStarted(); }
 };
 
 
@@ -95,6 +109,13 @@ public:
     void serverresponse(string&& movestring, MegaClient*);
     void servererror(const std::string &e, MegaClient*);
 
+    // alternatively, when the request is chunked, feed the response as it arrives
+    // serverchunk() returns how much of the data it doesn't need anymore
+    bool inflightchunked() const { return inflightreq.isChunked(); }
+    bool chunksstarted() const { return inflightreq.chunksStarted(); }
+    size_t serverchunk(const char* data, size_t len, MegaClient*);
+    void serverlastchunk(const char* data, size_t len, MegaClient*);
+
     void clear();
 
 #ifdef MEGA_MEASURE_CODE
@@ -300,6 +300,16 @@ public:
     // scan specific path
     LocalNode* checkpath(LocalNode*, LocalPath*, string* const, dstime*, bool wejustcreatedthisfolder, DirAccess* iteratingDir);
 
+    // queue fingerprints for the files named by the next few notifications in queue q
+    void prefetchFingerprints(int q);
+
+    // true if the fingerprint of the file at path is being computed off this thread
+    // (queueing it if it wasn't already), so the caller should come back later
+    bool fingerprintPending(const LocalPath& path);
+
+    // like f.genfingerprint(fa), but using the precomputed fingerprint if there is one
+    bool genfingerprint(FileFingerprint& f, FileAccess* fa, const LocalPath& path);
+
     m_off_t localbytes = 0;
     unsigned localnodes[2]{};
 
@@ -367,6 +377,9 @@ public:
     static const int FILE_UPDATE_DELAY_DS;
     static const int FILE_UPDATE_MAX_DELAY_SECS;
     static const dstime RECENT_VERSION_INTERVAL_SECS;
+    static const size_t FINGERPRINT_LOOKAHEAD;
+    static const int FINGERPRINT_RETRY_DS;
+    static const dstime FINGERPRINT_MAX_AGE_DS;
 
     // Change state to (DISABLED, BACKUP_MODIFIED).
     void backupModified();
@@ -395,6 +408,15 @@ protected :
 
 private:
     LocalPath mLocalPath;
+
+    // computes fingerprints on the ScanService worker threads (started on first use)
+    unique_ptr<ScanService> mScanService;
+
+    // fingerprints queued or computed ahead of the notifications that need them
+    map<LocalPath, ScanService::FingerprintRequestPtr> mFingerprintRequests;
+
+    // whether the last genfingerprint() had to read the file on this thread
+    bool mFingerprintedInline = false;
 };
 
 class SyncConfigIOContext;
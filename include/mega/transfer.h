@@ -42,6 +42,128 @@ struct TransferCategory
     unsigned directionIndex();
 };
 
+// Limits on the transfers that MegaClient::dispatchTransfers() starts and on the connections
+// of new transfer slots, adapted to the goodput and request times measured in each direction.
+// Every ADJUSTDS with transfers active, update() compares them with the last adjustment:
+// - a raised limit that brought more goodput is raised again
+// - a raised limit that only made requests slower is lowered back (over-subscription)
+// - requests much slower with no more goodput lower the number of transfers
+// - otherwise, the limit that is binding is raised: transfers when all are in use, and
+//   connections per transfer when few transfers are active
+// Limits stay between the minimums and the configured ceilings, and every change is logged
+// with its reason.
+class MEGA_API TransferLimits
+{
+public:
+    struct Limits
+    {
+        // transfers active in the direction
+        unsigned transfers = 0;
+
+        // connections of each new transfer slot (for files that are not transferred in one request)
+        unsigned connections = 0;
+
+        // why they are what they are
+        string reason;
+    };
+
+    static const dstime ADJUSTDS = 100;
+    static const unsigned MINTRANSFERS = 4;
+
+    // intervals without changes after lowering a raised limit
+    static const unsigned HOLDINTERVALS = 3;
+
+    // initial limits and ceilings of a direction
+    void setDefaults(direction_t, unsigned transfers, unsigned connections);
+    void setCeilings(direction_t, unsigned transfers, unsigned connections);
+
+    // ceiling of the data kept queued per transfer category
+    void setOutstandingCeiling(m_off_t bytes) { mMaxOutstanding = bytes; }
+
+    const Limits& limits(direction_t d) const { return mDirections[d].limits; }
+
+    // data to keep queued per transfer category: 30 seconds of goodput, clamped
+    // between 2 MB and the ceiling
+    m_off_t targetOutstanding(m_off_t goodput) const;
+
+    // a chunk request of the direction completed
+    void requestCompleted(direction_t, m_off_t bytes, dstime elapsed);
+
+    // adjust the limits of a direction to its goodput (bytes per second) and number of active
+    // transfers.  Returns whether they changed
+    bool update(direction_t, m_off_t goodput, unsigned active, dstime now);
+
+private:
+    enum Knob { NOKNOB, TRANSFERS, CONNECTIONS };
+
+    struct Direction
+    {
+        Limits limits;
+        unsigned maxTransfers = 0;
+        unsigned maxConnections = 0;
+
+        // mean time of the requests (ds per MB), and the number of them since the last adjustment
+        double requestTime = 0;
+        unsigned requests = 0;
+
+        // what was measured at the last adjustment, and what it changed
+        m_off_t lastGoodput = 0;
+        double lastRequestTime = 0;
+        dstime lastAdjustment = 0;
+        Knob raised = NOKNOB;
+        unsigned hold = 0;
+    };
+
+    bool raise(Direction&, Knob);
+    bool lower(Direction&, Knob);
+
+    std::array<Direction, 2> mDirections;
+    m_off_t mMaxOutstanding = 1024 * 1024 * 1024;
+};
+
+// Putnodes of the uploads completed to the same folder, sent as one command of up to
+// MegaClient::MAX_NEWNODES nodes when the batch is full or at flush(), once per exec() loop,
+// instead of one command per file.  Each upload still gets the result of its own node, with
+// its own tag: the nodes of a failed batch, and those the API didn't create, are put again
+// one by one so that each upload gets its own error.
+class MEGA_API PutnodesBatcher
+{
+public:
+    void add(MegaClient*, NodeHandle target, VersioningOption, NewNode&&, int tag, putsource_t, CommandPutNodes::Completion&&, bool canChangeVault);
+
+    // queue the commands of all the batches
+    void flush(MegaClient*);
+
+    // discard the batches without sending them
+    void clear();
+
+    // nodes waiting to be sent
+    size_t size() const { return mNumNodes; }
+
+private:
+    struct Target
+    {
+        NodeHandle handle;
+        VersioningOption versioning;
+        putsource_t source;
+        bool canChangeVault;
+
+        bool operator<(const Target&) const;
+    };
+
+    struct Batch
+    {
+        vector<NewNode> nodes;
+        vector<int> tags;
+        vector<CommandPutNodes::Completion> completions;
+    };
+
+    void send(MegaClient*, const Target&, Batch&&);
+
+    map<Target, Batch> mBatches;
+    size_t mNumNodes = 0;
+};
+
 class TransferDbCommitter;
 
 // pending/active up/download ordered by file fingerprint (size - mtime - sparse CRC)
@@ -250,6 +372,9 @@ struct MEGA_API DirectRead
     m_off_t progress;
     m_off_t nextrequestpos;
 
+    // once the app stops reading, we keep going up to here into the cache (appdata is then null)
+    m_off_t readaheadpos = 0;
+
     DirectReadBufferManager drbuf;
 
     DirectReadNode* drn;
@@ -264,10 +389,62 @@ struct MEGA_API DirectRead
 
     void abort();
 
+    // deliver what the cache has at the current position.  false if that completed
+    // (or the app aborted) the read, which is then deleted
+    bool serveFromCache();
+
+    // whether a read-ahead of the same file is about to deliver the current position
+    bool readaheadPending() const;
+
+    // whether the app asked to hold the data back for now
+    bool paused() const;
+
     DirectRead(DirectReadNode*, m_off_t, m_off_t, int, void*);
     ~DirectRead();
 };
 
+// Decrypted content recently streamed, shared by all the direct reads of the client
+// (and so by every streaming transfer and HTTP/FTP server connection), in blocks keyed
+// by file, the least recently used going first when over the byte budget.
+// Blocks are filled sequentially from their start.
+class MEGA_API DirectReadCache
+{
+public:
+    static const m_off_t BLOCKSIZE = 1 << 20;
+
+    // how far past the last position delivered to the app we keep reading
+    static const m_off_t READAHEAD = 8 << 20;
+
+    void setMaxBytes(size_t);
+    size_t maxBytes() const { return mMaxBytes; }
+    size_t bytes() const { return mBytes; }
+
+    // stores data of file h at pos
+    void put(handle h, m_off_t pos, const byte* data, size_t len);
+
+    // the contiguous data of file h cached at pos, within one block (valid until the next put)
+    size_t get(handle h, m_off_t pos, const byte** data);
+
+    void clear();
+
+private:
+    using BlockKey = pair<handle, m_off_t>;
+
+    struct Block
+    {
+        string data;
+        list<BlockKey>::iterator lru;
+    };
+
+    map<BlockKey, Block> mBlocks;
+    list<BlockKey> mLru;  // most recently used first
+
+    size_t mBytes = 0;
+    size_t mMaxBytes = 32 << 20;
+
+    void trim();
+};
+
 struct MEGA_API DirectReadNode
 {
     handle h;
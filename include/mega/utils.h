@@ -532,6 +532,19 @@ public:
     void ctr_encrypt(m_off_t chunkid, SymmCipher *cipher, byte *chunkstart, unsigned chunksize, m_off_t startpos, int64_t ctriv, bool finishesChunk);
     void ctr_decrypt(m_off_t chunkid, SymmCipher *cipher, byte *chunkstart, unsigned chunksize, m_off_t startpos, int64_t ctriv, bool finishesChunk);
 
+    // a piece of a single chunk, for processing several independent chunks in one go
+    struct CtrPiece
+    {
+        m_off_t chunkid;
+        byte* chunkstart;
+        unsigned chunksize;
+        m_off_t startpos;
+    };
+
+    // as above, but the macs of the (distinct) chunks are calculated side by side
+    void ctr_encrypt(const vector<CtrPiece>& pieces, SymmCipher *cipher, int64_t ctriv, bool finishesChunk);
+    void ctr_decrypt(const vector<CtrPiece>& pieces, SymmCipher *cipher, int64_t ctriv, bool finishesChunk);
+
     size_t size() const
     {
         return mMacMap.size();
@@ -63,6 +63,7 @@ public:
 
     void post(HttpReq*, const char* = 0, unsigned = 0);
     void cancel(HttpReq*);
+    void setpaused(HttpReq*, bool);
 
     m_off_t postpos(void*);
 
@@ -94,6 +95,8 @@ struct MEGA_API WinHttpContext
     unsigned postlen;
     const char* postdata;
     
+    bool held;                      // a read completed while the request was paused
+
     bool gzip;
     z_stream z;
     string zin;
@@ -11555,6 +11555,25 @@ class MegaApi
          */
         void fetchNodes(MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Limit the memory used by the nodes of the account
+         *
+         * With a budget, the nodes stored in the local cache are loaded from it when they
+         * are needed, instead of all of them at once, and the least recently used ones are
+         * released when their approximate memory exceeds the budget. Nodes that are in use
+         * (eg. synced, shared, or being changed) are kept in memory anyway.
+         *
+         * Listings, searches and paths load the nodes they need, and the counts and sizes of
+         * folders and of the account always include the nodes that are not loaded.
+         *
+         * It takes effect from the next call to MegaApi::fetchNodes, and requires the local
+         * cache (see MegaApi::MegaApi basePath).
+         *
+         * @param bytes Approximate memory for the nodes, in bytes.
+         *              Use 0 to load and keep all nodes in memory (default).
+         */
+        void setNodesMemoryBudget(long long bytes);
+
         /**
          * @brief Get the sum of sizes of all the files stored in the MEGA cloud.
          *
@@ -12929,6 +12948,21 @@ class MegaApi
          */
         void setStreamingMinimumRate(int bytesPerSecond);
 
+        /**
+         * @brief Set the size of the in-memory cache of recently streamed data
+         *
+         * Data received by startStreaming() (and by the local HTTP/FTP proxy servers, that use it)
+         * is kept decrypted in memory, in blocks, so that other connections reading the same part
+         * of a file (typical of video players, that often open several ranges) are served without
+         * downloading it again. When the cache is large enough, a stream that is paused or dropped
+         * also keeps reading ahead for a while into the cache.
+         *
+         * The default size is 32 MB.
+         *
+         * @param bytes Maximum amount of memory used by the cache. Use 0 to disable it.
+         */
+        void setStreamingCacheSize(long long bytes);
+
         /**
          * @brief Cancel a transfer
          *
@@ -14699,6 +14733,35 @@ class MegaApi
          */
         MegaNodeList* getChildren(MegaNodeList *parentNodes, int order = 1);
 
+        /**
+         * @brief Get a page of the children of a MegaNode
+         *
+         * The children are sorted as MegaApi::getChildren would return them, and only those
+         * in positions [offset, offset + limit) of that list are returned, so that listing a
+         * large folder a page at a time takes memory for the page only. The SDK keeps large
+         * folders sorted in the orders they are listed in, so the following pages of the same
+         * order do not sort the folder again. Use MegaApi::getNumChildren to know the number
+         * of pages.
+         *
+         * Only the positions of the nodes are taken by this function: each MegaNode of the
+         * list is created the first time it is requested with MegaNodeList::get, with the
+         * state of the node at that moment. MegaNodeList::get returns NULL for the nodes that
+         * have been removed since the page was listed. The returned list must not be used
+         * after this MegaApi is deleted.
+         *
+         * If the parent node doesn't exist or it isn't a folder, this function
+         * returns an empty list
+         *
+         * You take the ownership of the returned value
+         *
+         * @param parent Parent node
+         * @param order Order for the returned list, see MegaApi::getChildren for the valid values
+         * @param offset Position of the first child to return
+         * @param limit Maximum number of children to return
+         * @return List with the child MegaNode objects of the page
+         */
+        MegaNodeList* getChildrenPage(MegaNode *parent, int order, int offset, int limit);
+
         /**
          * @brief Get all versions of a file
          * @param node Node to check
@@ -16757,6 +16820,23 @@ class MegaApi
          */
         void setPublicKeyPinning(bool enable);
 
+        /**
+         * @brief Enable / disable HTTP/2 multiplexing of API and transfer requests
+         *
+         * When enabled, requests to the same host share HTTP/2 connections where the
+         * server supports it, instead of opening one connection per request. Requests
+         * to plain HTTP URLs and to servers without HTTP/2 keep using HTTP/1.1.
+         *
+         * This mode is disabled by default: requests then use HTTP/1.1 and never share
+         * a connection while in flight, whatever the defaults of the cURL version in use.
+         * Enabling it has no effect if the SDK was built without HTTP/2 support in cURL.
+         *
+         * @param enable true to enable HTTP/2 multiplexing, false to disable it
+         * @param maxConnectionsPerHost Maximum number of connections to a single host,
+         * or 0 for no limit
+         */
+        void setHttpMultiplexing(bool enable, int maxConnectionsPerHost = 0);
+
         /**
          * @brief Pause the reception of action packets
          *
@@ -17217,9 +17297,14 @@ class MegaApi
          * @param certificatepath path to certificate (PEM format)
          * @param keypath path to certificate key
          * @param useIPv6 true to use [::1] as host, false to use 127.0.0.1
+         * @param numThreads Number of threads serving the connections (default 1).
+         * Use 0 to get one thread per CPU core. Connections are spread across the threads,
+         * so with more than one, streaming callbacks can be received from any of them at the
+         * same time. This value is ignored on Windows, where a single thread is used.
+         * If the server is already running on the same port, it is kept with its current threads.
          * @return True if the server is ready, false if the initialization failed
          */
-        bool httpServerStart(bool localOnly = true, int port = 4443, bool useTLS = false, const char *certificatepath = NULL, const char * keypath = NULL, bool useIPv6 = false);
+        bool httpServerStart(bool localOnly = true, int port = 4443, bool useTLS = false, const char *certificatepath = NULL, const char * keypath = NULL, bool useIPv6 = false, int numThreads = 1);
 
         /**
          * @brief Stop the HTTP proxy server
@@ -18817,6 +18902,30 @@ class MegaApi
          */
         MegaApiLock* getMegaApiLock(bool lockNow);
 
+        /**
+         * @brief Get statistics about the contention on the lock of the MegaApi
+         *
+         * The lock is held by the SDK thread while it processes requests and action packets,
+         * and by the synchronous calls that have to access the state of the account.
+         * getNodeByHandle, getParentNode, getChildren, getNumChildren, getNumChildFiles,
+         * getNumChildFolders and getNodeByPath are answered without the lock whenever the
+         * result published from a previous call is still valid.
+         *
+         * The returned map contains the following keys, with decimal values counted since
+         * the MegaApi was created:
+         * - "acquisitions": Number of times the lock was taken
+         * - "contended": Number of times a caller had to wait for the lock
+         * - "waitMicroseconds": Total time spent waiting for the lock
+         * - "maxWaitMicroseconds": Longest single wait for the lock
+         * - "snapshotReads": Synchronous calls answered without the lock
+         * - "lockedReads": Synchronous calls that had to take the lock
+         *
+         * You take the ownership of the returned value
+         *
+         * @return Map with the statistics
+         */
+        MegaStringMap* getMutexStats();
+
         /**
          * @brief Call the low level function setrlimit() for NOFILE, needed for some platforms.
          *
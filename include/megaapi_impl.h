@@ -384,6 +384,26 @@ protected:
     enum scanFolder_result { scanFolder_succeeded, scanFolder_cancelled, scanFolder_failed };
     scanFolder_result scanFolder(Tree& tree, LocalPath& localPath, uint32_t& foldercount, uint32_t& filecount);
 
+    // Files are fingerprinted on the ScanService threads while the scan goes on,
+    // looking their fingerprints up in the client's cache first.
+    // Only used by the worker thread (the cache itself is thread safe).
+    struct PendingFingerprint
+    {
+        Tree* tree;
+        size_t file;
+        ScanService::FingerprintRequestPtr request;
+    };
+    std::deque<PendingFingerprint> mPendingFingerprints;
+    shared_ptr<LocalFingerprintCache> mFingerprintCache;
+    WAIT_CLASS mFingerprintWaiter;
+    unique_ptr<ScanService> mScanService;
+
+    // at most this many files are queued for fingerprinting at any time
+    static const size_t MAX_PENDING_FINGERPRINTS = 4096;
+
+    // waits for pending fingerprints, until no more than maxPending are left
+    scanFolder_result completeFingerprints(size_t maxPending);
+
     // Gathers up enough (but not too many) newnode records that are all descendants of a single folder
     // and can be created in a single operation.
     // Called from the main thread just before we send the next set of folder creation commands.
@@ -890,6 +910,8 @@ class MegaTransferPrivate : public MegaTransfer, public Cacheable
         void setForceNewUpload(bool forceNewUpload);
         void setStreamingTransfer(bool streamingTransfer);
         void setLastBytes(char *lastBytes);
+        void setLastBytes(char *lastBytes, const std::shared_ptr<void>& owner);
+        void setStreamingPaused(bool paused);
         void setLastError(const MegaError *e);
         void setFolderTransferTag(int tag);
         void setNotificationNumber(long long notificationNumber);
@@ -933,6 +955,8 @@ class MegaTransferPrivate : public MegaTransfer, public Cacheable
         bool isForeignOverquota() const override;
         bool isForceNewUpload() const override;
         char *getLastBytes() const override;
+        const std::shared_ptr<void>& getLastBytesOwner() const;
+        bool isStreamingPaused() const;
         MegaError getLastError() const override;
         const MegaError *getLastErrorExtended() const override;
         bool isFolderTransfer() const override;
@@ -998,6 +1022,8 @@ protected:
         const char* parentPath; //used as targetUser for uploads
         const char* fileName;
         char *lastBytes;
+        std::shared_ptr<void> lastBytesOwner;  // keeps lastBytes valid, when set
+        std::atomic<bool> streamingPaused{false};
         MegaNode *publicNode;
         long long startPos;
         long long endPos;
@@ -1898,6 +1924,8 @@ class MegaNodeListPrivate : public MegaNodeList
         MegaNodeListPrivate();
         MegaNodeListPrivate(node_vector& v);
         MegaNodeListPrivate(Node** newlist, int size);
+        // takes the ownership of the given nodes
+        MegaNodeListPrivate(vector<std::unique_ptr<MegaNode>>&& nodes);
         MegaNodeListPrivate(const MegaNodeListPrivate *nodeList, bool copyChildren = false);
         virtual ~MegaNodeListPrivate();
         MegaNodeList *copy() const override;
@@ -1914,6 +1942,24 @@ class MegaNodeListPrivate : public MegaNodeList
 		int s;
 };
 
+// A page of a folder's children (see MegaApi::getChildrenPage): it holds the handles of
+// the nodes, and creates each MegaNode the first time it is requested
+class MegaNodeListLazyPrivate : public MegaNodeList
+{
+    public:
+        MegaNodeListLazyPrivate(MegaApiImpl* api, vector<MegaHandle>&& handles);
+        MegaNodeList *copy() const override;
+        MegaNode* get(int i) const override;
+        int size() const override;
+
+        void addNode(MegaNode* node) override;
+
+    protected:
+        MegaApiImpl* mApi;
+        vector<MegaHandle> mHandles;
+        mutable vector<std::unique_ptr<MegaNode>> mNodes;
+};
+
 class MegaChildrenListsPrivate : public MegaChildrenLists
 {
     public:
@@ -2197,33 +2243,6 @@ class PendingOutShareProcessor : public TreeProcessor
         vector<handle> handles;
 };
 
-class SizeProcessor : public TreeProcessor
-{
-    protected:
-        long long totalBytes;
-
-    public:
-        SizeProcessor();
-        virtual bool processNode(Node* node);
-        long long getTotalBytes();
-};
-
-class TreeProcFolderInfo : public TreeProc
-{
-    public:
-        TreeProcFolderInfo();
-        virtual void proc(MegaClient*, Node*);
-        virtual ~TreeProcFolderInfo() {}
-        MegaFolderInfo *getResult();
-
-    protected:
-        int numFiles;
-        int numFolders;
-        int numVersions;
-        long long currentSize;
-        long long versionsSize;
-};
-
 class FavouriteProcessor : public TreeProcessor
 {
 public:
@@ -2285,6 +2304,128 @@ class TransferQueue
         void setAllCancelled(CancelToken t, int direction);
 };
 
+// The recursive mutex shared by the SDK thread and the synchronous getters,
+// counting how often (and for how long) callers had to wait for it
+class SdkMutex
+{
+    public:
+        void lock();
+        void unlock();
+        bool try_lock();
+
+        template<class Rep, class Period>
+        bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout)
+        {
+            if (mMutex.try_lock())
+            {
+                ++mAcquisitions;
+                return true;
+            }
+            auto start = std::chrono::steady_clock::now();
+            bool locked = mMutex.try_lock_for(timeout);
+            contended(start, locked);
+            return locked;
+        }
+
+        uint64_t acquisitions() const { return mAcquisitions; }
+        uint64_t contentions() const { return mContentions; }
+        uint64_t waitMicroseconds() const { return mWaitMicroseconds; }
+        uint64_t maxWaitMicroseconds() const { return mMaxWaitMicroseconds; }
+
+    private:
+        void contended(std::chrono::steady_clock::time_point start, bool locked);
+
+        std::recursive_timed_mutex mMutex;
+        std::atomic<uint64_t> mAcquisitions{0};
+        std::atomic<uint64_t> mContentions{0};
+        std::atomic<uint64_t> mWaitMicroseconds{0};
+        std::atomic<uint64_t> mMaxWaitMicroseconds{0};
+};
+
+// Node metadata published by the SDK thread so that the synchronous getters
+// can answer without taking the SdkMutex.
+// Entries are only published with the SdkMutex held and while no node
+// notification is pending. As soon as the MegaClient queues a node for
+// notification (before any request callback runs), its entries and those of
+// its parents are dropped and every lookup misses until nodes_updated() has
+// invalidated the whole batch, so the getters fall back to the locked path
+// while the MegaClient is changing.
+// Children lists and paths remember the serials of the entries they were
+// built from and are discarded as soon as one of them is gone.
+class PublishedNodes
+{
+    public:
+        // a copy of the published node, or nullptr if it has to be looked up
+        MegaNode* node(MegaHandle h);
+        bool parent(MegaHandle h, MegaHandle& parentHandle);
+        MegaNodeList* children(MegaHandle parentHandle, int order);
+        bool childCounts(MegaHandle parentHandle, int& files, int& folders);
+        MegaNode* path(MegaHandle base, const char* path);
+
+        // SdkMutex held
+        void publish(Node* n);
+        void publishChildren(Node* parent, int order, const node_vector& children);
+        void publishPath(Node* base, const char* path, Node* result);
+        void invalidate(Node* n);
+        void pending(Node* n);
+        void notified();
+        void clear();
+
+        static bool cacheableOrder(int order);
+        static bool cacheablePath(const char* path);
+
+        uint64_t hits() const { return mHits; }
+        uint64_t misses() const { return mMisses; }
+
+    private:
+        struct Entry
+        {
+            shared_ptr<MegaNode> node;
+            MegaHandle parent;
+            uint64_t serial;
+        };
+
+        // (handle, serial) of the entries a list or a path was built from
+        typedef vector<pair<MegaHandle, uint64_t>> Chain;
+
+        struct Bucket
+        {
+            std::mutex mutex;
+            std::unordered_map<MegaHandle, shared_ptr<const Entry>> nodes;
+            std::unordered_map<MegaHandle, std::map<int, Chain>> children;
+            std::map<pair<MegaHandle, string>, Chain> paths;
+        };
+
+        static const size_t BUCKETS = 64;
+        static const size_t MAX_NODES = 100000;
+        static const size_t MAX_PATHS = 10000;
+
+        Bucket& bucket(MegaHandle h) { return mBuckets[(h ^ (h >> 29)) % BUCKETS]; }
+        Bucket& bucket(MegaHandle base, const string& path);
+
+        static bool publishable(Node* n);
+        shared_ptr<const Entry> entry(MegaHandle h);
+        uint64_t serial(Node* n);
+        bool resolve(const Chain& chain, vector<shared_ptr<const Entry>>& entries);
+        void drop(MegaHandle h);
+        void clearPaths();
+
+        template<class T> T* hit(T* result)
+        {
+            ++(result ? mHits : mMisses);
+            return result;
+        }
+
+        std::array<Bucket, BUCKETS> mBuckets;
+        std::atomic<size_t> mNodeCount{0};
+        std::atomic<size_t> mPathCount{0};
+        std::atomic<uint64_t> mNextSerial{1};
+        std::atomic<uint64_t> mHits{0};
+        std::atomic<uint64_t> mMisses{0};
+        std::atomic<bool> mPending{false};
+        bool mNewLinkFormat = false;
+};
+
 
 class MegaApiImpl : public MegaApp
 {
@@ -2494,6 +2635,7 @@ class MegaApiImpl : public MegaApp
         void exportNode(MegaNode *node, int64_t expireTime, bool writable, bool megaHosted, MegaRequestListener *listener = NULL);
         void disableExport(MegaNode *node, MegaRequestListener *listener = NULL);
         void fetchNodes(MegaRequestListener *listener = NULL);
+        void setNodesMemoryBudget(long long bytes);
         void getPricing(MegaRequestListener *listener = NULL);
         void getPaymentId(handle productHandle, handle lastPublicHandle, int lastPublicHandleType, int64_t lastAccessTimestamp, MegaRequestListener *listener = NULL);
         void upgradeAccount(MegaHandle productHandle, int paymentMethod, MegaRequestListener *listener = NULL);
@@ -2546,6 +2688,10 @@ class MegaApiImpl : public MegaApp
         MegaTransferPrivate* createDownloadTransfer(bool startFirst, MegaNode *node, const char* localPath, const char *customName, int folderTransferTag, const char *appData, CancelToken cancelToken, MegaTransferListener *listener, FileSystemType fsType);
         void startStreaming(MegaNode* node, m_off_t startPos, m_off_t size, MegaTransferListener *listener);
         void setStreamingMinimumRate(int bytesPerSecond);
+        void setStreamingCacheSize(long long bytes);
+
+        // holds a streaming transfer back (or lets it go on), from any thread.  The transfer must be alive
+        void pauseStreaming(MegaTransferPrivate* transfer, bool pause);
         void retryTransfer(MegaTransfer *transfer, MegaTransferListener *listener = NULL);
         void cancelTransfer(MegaTransfer *transfer, MegaRequestListener *listener=NULL);
         void cancelTransferByTag(int transferTag, MegaRequestListener *listener = NULL);
@@ -2653,6 +2799,7 @@ class MegaApiImpl : public MegaApp
         int getNumChildFolders(MegaNode* parent);
         MegaNodeList* getChildren(MegaNode *parent, int order);
         MegaNodeList* getChildren(MegaNodeList *parentNodes, int order);
+        MegaNodeList* getChildrenPage(MegaNode *parent, int order, int offset, int limit);
         MegaNodeList* getVersions(MegaNode *node);
         int getNumVersions(MegaNode *node);
         bool hasVersions(MegaNode *node);
@@ -2780,6 +2927,7 @@ class MegaApiImpl : public MegaApp
 
         void retrySSLerrors(bool enable);
         void setPublicKeyPinning(bool enable);
+        void setHttpMultiplexing(bool enable, int maxConnectionsPerHost);
         void pauseActionPackets();
         void resumeActionPackets();
 
@@ -2834,7 +2982,7 @@ class MegaApiImpl : public MegaApp
 
 #ifdef HAVE_LIBUV
         // start/stop
-        bool httpServerStart(bool localOnly = true, int port = 4443, bool useTLS = false, const char *certificatepath = NULL, const char *keypath = NULL, bool useIPv6 = false);
+        bool httpServerStart(bool localOnly = true, int port = 4443, bool useTLS = false, const char *certificatepath = NULL, const char *keypath = NULL, bool useIPv6 = false, int numThreads = 1);
         void httpServerStop();
         int httpServerIsRunning();
 
@@ -3013,6 +3161,7 @@ class MegaApiImpl : public MegaApp
         void lockMutex();
         void unlockMutex();
         bool tryLockMutexFor(long long time);
+        MegaStringMap* getMutexStats();
 
 protected:
         void init(MegaApi *api, const char *appKey, MegaGfxProcessor* processor, const char *basePath /*= NULL*/, const char *userAgent /*= NULL*/, unsigned clientWorkerThreadCount /*= 1*/);
@@ -3132,8 +3281,9 @@ protected:
         vector<string> excludedPaths;
         long long syncLowerSizeLimit;
         long long syncUpperSizeLimit;
-        std::recursive_timed_mutex sdkMutex;
-        using SdkMutexGuard = std::unique_lock<std::recursive_timed_mutex>;   // (equivalent to typedef)
+        SdkMutex sdkMutex;
+        using SdkMutexGuard = std::unique_lock<SdkMutex>;   // (equivalent to typedef)
+        PublishedNodes publishedNodes;
         std::atomic<bool> syncPathStateLockTimeout{ false };
         MegaTransferPrivate *currentTransfer;
         MegaRequestPrivate *activeRequest;
@@ -3216,6 +3366,7 @@ protected:
 
         void unlink_result(handle, error) override;
         void unlinkversions_result(error) override;
+        void node_pending(Node*) override;
         void nodes_updated(Node**, int) override;
         void users_updated(User**, int) override;
         void useralerts_updated(UserAlert::Base**, int) override;
@@ -3307,6 +3458,8 @@ protected:
 
         dstime pread_failure(const Error&, int, void*, dstime) override;
         bool pread_data(byte*, m_off_t, m_off_t, m_off_t, m_off_t, void*) override;
+        bool pread_piece(byte*, m_off_t, m_off_t, m_off_t, m_off_t, void*, const std::shared_ptr<void>&) override;
+        bool pread_paused(void*) override;
 
         void reportevent_result(error) override;
         void sessions_killed(handle sessionid, error e) override;
@@ -3442,6 +3595,14 @@ protected:
         Node *getNodeByFingerprintInternal(const char *fingerprint, Node *parent);
 
         bool processTree(Node* node, TreeProcessor* processor, bool recursive, CancelToken cancelToken);
+
+        // results of a SearchTreeProcessor over the subtrees of `tops` (their children only, unless
+        // includeTops).  Recursive name searches scan the client's name snapshot in parallel, with
+        // sdkMutex released: `guard` must be the caller's lock on it.  So the results are handles,
+        // to be looked up (see nodesByHandle()) once the caller is done with all its searches.
+        vector<NodeHandle> searchNodes(SdkMutexGuard& guard, const node_vector& tops, bool includeTops, bool recursive,
+                                       const char* searchString, int type, CancelToken cancelToken);
+        node_vector nodesByHandle(const vector<NodeHandle>&);
         void getNodeAttribute(MegaNode* node, int type, const char *dstFilePath, MegaRequestListener *listener = NULL);
 		    void cancelGetNodeAttribute(MegaNode *node, int type, MegaRequestListener *listener = NULL);
         void setNodeAttribute(MegaNode* node, int type, const char *srcFilePath, MegaHandle attributehandle, MegaRequestListener *listener = NULL);
@@ -3502,20 +3663,27 @@ class StreamingBuffer
 public:
     StreamingBuffer();
     ~StreamingBuffer();
-    // Allocate buffer and reset class members
+    // Set the capacity and reset class members
     void init(size_t capacity);
-    // Add data to the buffer. This will mainly come from the Transfer (or from a cache file if it's included someday).
+    // Add a copy of the data to the buffer (headers, or data whose owner isn't known)
     size_t append(const char *buf, size_t len);
+    // Add data to the buffer without copying it: owner keeps it valid. This will mainly come from the Transfer.
+    size_t append(const char *buf, size_t len, const std::shared_ptr<void>& owner);
     // Get buffered data size
     size_t availableData() const;
     // Get free space available in buffer
     size_t availableSpace() const;
     // Get total buffer capacity
     size_t availableCapacity() const;
-    // Get the uv_buf_t for the consumer with as much buffered data as possible
-    uv_buf_t nextBuffer();
-    // Increase the free data counter
+    // Get up to maxBuffers uv_buf_t (scatter/gather) for the consumer with as much buffered data as possible, returns their total length.
+    // They stay valid until freeData() is called for them
+    size_t nextBuffers(std::vector<uv_buf_t>& bufs, size_t maxBuffers);
+    // Release data written by the consumer
     void freeData(size_t len);
+    // Whether the producer has to be paused when len bytes arrive, with remaining bytes (len included) still to come
+    bool isFullFor(size_t len, m_off_t remaining) const;
+    // Whether a paused producer can be resumed after the consumer has written len bytes
+    bool canResumeAfter(size_t len) const;
     // Set upper bound limit for capacity
     void setMaxBufferSize(unsigned int bufferSize);
     // Set upper bound limit for chunk size to write to the consumer
@@ -3531,24 +3699,31 @@ public:
 
     static const unsigned int MAX_BUFFER_SIZE = 2097152;
     static const unsigned int MAX_OUTPUT_SIZE = MAX_BUFFER_SIZE / 10;
+    static const unsigned int MAX_OUTPUT_BUFFERS = 16;
 
 private:
     // Rate between partial file size and its duration (only for media files)
     m_off_t partialDuration(m_off_t partialSize) const;
 
 protected:
-    // Circular buffer to store data to feed the consumer
-    char* buffer;
+    // Buffered data, shared with its owner (a downloaded piece, or a copy)
+    struct Segment
+    {
+        std::shared_ptr<void> owner;
+        const char* data;
+        size_t len;
+    };
+
+    // Data to feed the consumer
+    std::deque<Segment> pending;
+    // Data handed to the consumer, until it's written
+    std::deque<Segment> inflight;
     // Total buffer size
     size_t capacity;
     // Buffered data size
     size_t size;
-    // Available free space in buffer
-    size_t free;
-    // Index for last buffered data
-    size_t inpos;
-    // Index for last written data (to the consumer)
-    size_t outpos;
+    // Data size handed to the consumer, not written yet
+    size_t inflightSize;
     // Upper bound limit for capacity
     size_t maxBufferSize;
     // Upper bound limit for chunk size to write to the consumer
@@ -3561,6 +3736,33 @@ protected:
 };
 
 class MegaTCPServer;
+class MegaTCPContext;
+
+// One of the event loops of a MegaTCPServer, running on its own thread, with the connections it serves
+class MegaTCPLoop
+{
+public:
+    MegaTCPLoop(MegaTCPServer *server, int index);
+
+    MegaTCPServer *server;
+    // The first loop binds the port, the others listen on a duplicate of its socket
+    int index;
+    uv_loop_t uv_loop;
+    uv_async_t exit_handle;
+    uv_tcp_t listener;
+    MegaThread thread;
+    list<MegaTCPContext*> connections;
+    // Same as connections.size(), readable from other threads
+    std::atomic<int> numConnections;
+    bool running;
+    bool closing;
+    int remainingcloseevents;
+
+#ifdef ENABLE_EVT_TLS
+    evt_ctx_t evtctx;
+#endif
+};
+
 class MegaTCPContext : public MegaTransferListener, public MegaRequestListener
 {
 public:
@@ -3569,6 +3771,7 @@ public:
 
     // Connection management
     MegaTCPServer *server;
+    MegaTCPLoop *loop;
     uv_tcp_t tcphandle;
     uv_async_t asynchandle;
     uv_mutex_t mutex;
@@ -3582,6 +3785,14 @@ public:
     bool failed;
     bool pause;
 
+    // The streaming transfer feeding this connection while it runs, held back when the buffer is full (protected by mutex)
+    MegaTransferPrivate *streamingTransfer;
+    // Hold back (or let go on) the streaming transfer. Call with mutex locked
+    void pauseStreaming(bool pause);
+
+    // Buffers of the ongoing write
+    std::vector<uv_buf_t> writeBuffers;
+
 #ifdef ENABLE_EVT_TLS
     //tls stuff:
     evt_tls_t *evt_tls;
@@ -3610,31 +3821,24 @@ protected:
     static void *threadEntryPoint(void *param);
     static http_parser_settings parsercfg;
 
-    uv_loop_t uv_loop;
-
     set<handle> allowedHandles;
     handle lastHandle;
-    list<MegaTCPContext*> connections;
-    uv_async_t exit_handle;
     MegaApiImpl *megaApi;
     bool semaphoresdestroyed;
     uv_sem_t semaphoreStartup;
     uv_sem_t semaphoreEnd;
-    MegaThread *thread;
-    uv_tcp_t server;
+    // Event loops serving the connections, the first one owns the listening socket
+    std::vector<std::unique_ptr<MegaTCPLoop>> loops;
+    int numLoops;
     int maxBufferSize;
     int maxOutputSize;
     int restrictedMode;
     bool localOnly;
     bool started;
     int port;
-    bool closing;
-    int remainingcloseevents;
 
 #ifdef ENABLE_EVT_TLS
     // TLS
-    bool evtrequirescleaning;
-    evt_ctx_t evtctx;
     std::string certificatepath;
     std::string keypath;
 #endif
@@ -3670,8 +3874,9 @@ protected:
     static void closeConnection(MegaTCPContext *tcpctx);
     static void closeTCPConnection(MegaTCPContext *tcpctx);
 
-    void run();
-    void initializeAndStartListening();
+    void run(MegaTCPLoop *loop);
+    bool listen(MegaTCPLoop *loop);
+    void joinLoops();
 
     void answer(MegaTCPContext* tcpctx, const char *rsp, size_t rlen);
 
@@ -3698,6 +3903,11 @@ public:
     void stop(bool doNotWait = false);
     int getPort();
     bool isLocalOnly();
+    // Number of event loop threads to serve connections with (applied by start)
+    void setNumLoops(int numLoops);
+    int getNumLoops();
+    // Current number of connections served by each loop
+    std::vector<int> getConnectionsPerLoop();
     void setMaxBufferSize(int bufferSize);
     void setMaxOutputSize(int outputSize);
     int getMaxBufferSize();
@@ -3707,9 +3917,7 @@ public:
     bool isHandleAllowed(handle h);
     void clearAllowedHandles();
     char* getLink(MegaNode *node, std::string protocol = "http");
-    bool isCurrentThread() {
-        return thread->isCurrentThread();
-    }
+    bool isCurrentThread();
 
     set<handle> getAllowedHandles();
     void removeAllowedHandle(MegaHandle handle);
@@ -3735,7 +3943,6 @@ public:
     size_t lastBufferLen;
     bool nodereceived;
     bool failed;
-    bool pause;
 
     // Request information
     bool range;
@@ -4028,7 +4235,6 @@ public:
     size_t lastBufferLen;
     bool failed;
     int ecode;
-    bool pause;
     MegaNode *node;
 
     m_off_t rangeStart;
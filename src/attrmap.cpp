@@ -153,6 +153,7 @@ const char* AttrMap::unserialize(const char* ptr , const char *end)
         ptr += ll;
     }
 
+    map.shrink_to_fit();
     return ptr;
 }
 
@@ -1156,32 +1156,38 @@ CommandPutNodes::CommandPutNodes(MegaClient* client, NodeHandle th,
 // add new nodes and handle->node handle mapping
 void CommandPutNodes::removePendingDBRecordsAndTempFiles()
 {
-    pendingdbid_map::iterator it = client->pendingtcids.find(tag);
-    if (it != client->pendingtcids.end())
+    vector<int> tags(1, tag);
+    tags.insert(tags.end(), mBatchTags.begin(), mBatchTags.end());
+
+    for (int t : tags)
     {
-        if (client->tctable)
+        pendingdbid_map::iterator it = client->pendingtcids.find(t);
+        if (it != client->pendingtcids.end())
         {
-            client->mTctableRequestCommitter->beginOnce();
-            vector<uint32_t> &ids = it->second;
-            for (unsigned int i = 0; i < ids.size(); i++)
+            if (client->tctable)
             {
-                if (ids[i])
+                client->mTctableRequestCommitter->beginOnce();
+                vector<uint32_t> &ids = it->second;
+                for (unsigned int i = 0; i < ids.size(); i++)
                 {
-                    client->tctable->del(ids[i]);
+                    if (ids[i])
+                    {
+                        client->tctable->del(ids[i]);
+                    }
                 }
             }
+            client->pendingtcids.erase(it);
         }
-        client->pendingtcids.erase(it);
-    }
-    pendingfiles_map::iterator pit = client->pendingfiles.find(tag);
-    if (pit != client->pendingfiles.end())
-    {
-        vector<LocalPath> &pfs = pit->second;
-        for (unsigned int i = 0; i < pfs.size(); i++)
+        pendingfiles_map::iterator pit = client->pendingfiles.find(t);
+        if (pit != client->pendingfiles.end())
         {
-            client->fsaccess->unlinklocal(pfs[i]);
+            vector<LocalPath> &pfs = pit->second;
+            for (unsigned int i = 0; i < pfs.size(); i++)
+            {
+                client->fsaccess->unlinklocal(pfs[i]);
+            }
+            client->pendingfiles.erase(pit);
         }
-        client->pendingfiles.erase(pit);
     }
 }
 
@@ -5750,6 +5756,57 @@ CommandFetchNodes::CommandFetchNodes(MegaClient* client, int tag, bool nocache)
     batchSeparately = true;
 
     this->tag = tag;
+
+    // The response can also be parsed while it downloads (see Request::processChunk).
+    // Nodes are then read one by one, and every other member of the response object in one go.
+    mFilters.emplace("<", [this](JSON*)
+    {
+        // (re)started: a retried request starts from scratch
+        this->client->purgenodesusersabortsc(true);
+        mDelayedParents.clear();
+        mPreviousHandleForAlert = UNDEF;
+        return true;
+    });
+
+    for (const char* nodes : { "f", "f2" })
+    {
+        mFilters.emplace(string("[{[") + nodes + "{", [this](JSON* json)
+        {
+            return json->enterobject()
+                && this->client->readnode(json, 0, PUTNODES_APP, nullptr, 0, false, mDelayedParents, mPreviousHandleForAlert);
+        });
+
+        mFilters.emplace(string("[{[") + nodes, [this](JSON*)
+        {
+            this->client->readnodesfinish(mDelayedParents, 0);
+            mDelayedParents.clear();
+            mPreviousHandleForAlert = UNDEF;
+            return true;
+        });
+    }
+
+    for (const char* member : { "ok", "s", "ps", "u", "cr", "sr", "sn", "ipc", "opc", "ph"
+#ifdef ENABLE_CHAT
+                              , "mcf", "mcpna", "mcna"
+#endif
+                              })
+    {
+        nameid name = AttrMap::string2nameid(member);
+        for (char type : { '[', '{', '"', '#' })
+        {
+            mFilters.emplace(string("[{") + type + member, [this, name](JSON* json)
+            {
+                return parsemember(name, json);
+            });
+        }
+    }
+
+    mFilters.emplace("[{", [this](JSON*)
+    {
+        WAIT_CLASS::bumpds();
+        this->client->fnstats.timeToLastByte = Waiter::ds - this->client->fnstats.startTime;
+        return parsingfinished();
+    });
 }
 
 // purge and rebuild node/user tree
@@ -5769,126 +5826,115 @@ bool CommandFetchNodes::procresult(Result r)
 
     for (;;)
     {
-        switch (client->json.getnameid())
+        nameid name = client->json.getnameid();
+
+        if (name == EOO ? !parsingfinished() : !parsemember(name, &client->json))
         {
-            case 'f':
-                // nodes
-                if (!client->readnodes(&client->json, 0, PUTNODES_APP, nullptr, 0, false))
-                {
-                    client->fetchingnodes = false;
-                    client->app->fetchnodes_result(API_EINTERNAL);
-                    return false;
-                }
-                break;
+            client->fetchingnodes = false;
+            client->app->fetchnodes_result(API_EINTERNAL);
+            return false;
+        }
 
-            case MAKENAMEID2('f', '2'):
-                // old versions
-                if (!client->readnodes(&client->json, 0, PUTNODES_APP, nullptr, 0, false))
-                {
-                    client->fetchingnodes = false;
-                    client->app->fetchnodes_result(API_EINTERNAL);
-                    return false;
-                }
-                break;
+        if (name == EOO)
+        {
+            return true;
+        }
+    }
+}
 
-            case MAKENAMEID2('o', 'k'):
-                // outgoing sharekeys
-                client->readok(&client->json);
-                break;
+// one member of the response object (json is positioned at its value)
+bool CommandFetchNodes::parsemember(nameid name, JSON* json)
+{
+    switch (name)
+    {
+        case 'f':
+            // nodes
+            return client->readnodes(json, 0, PUTNODES_APP, nullptr, 0, false);
 
-            case 's':
-                // Fall through
-            case MAKENAMEID2('p', 's'):
-                // outgoing or pending shares
-                client->readoutshares(&client->json);
-                break;
+        case MAKENAMEID2('f', '2'):
+            // old versions
+            return client->readnodes(json, 0, PUTNODES_APP, nullptr, 0, false);
 
-            case 'u':
-                // users/contacts
-                if (!client->readusers(&client->json, false))
-                {
-                    client->fetchingnodes = false;
-                    client->app->fetchnodes_result(API_EINTERNAL);
-                    return false;
-                }
-                break;
+        case MAKENAMEID2('o', 'k'):
+            // outgoing sharekeys
+            client->readok(json);
+            return true;
 
-            case MAKENAMEID2('c', 'r'):
-                // crypto key request
-                client->proccr(&client->json);
-                break;
+        case 's':
+            // Fall through
+        case MAKENAMEID2('p', 's'):
+            // outgoing or pending shares
+            client->readoutshares(json);
+            return true;
 
-            case MAKENAMEID2('s', 'r'):
-                // sharekey distribution request
-                client->procsr(&client->json);
-                break;
+        case 'u':
+            // users/contacts
+            return client->readusers(json, false);
 
-            case MAKENAMEID2('s', 'n'):
-                // sequence number
-                if (!client->scsn.setScsn(&client->json))
-                {
-                    client->fetchingnodes = false;
-                    client->app->fetchnodes_result(API_EINTERNAL);
-                    return false;
-                }
-                break;
+        case MAKENAMEID2('c', 'r'):
+            // crypto key request
+            client->proccr(json);
+            return true;
 
-            case MAKENAMEID3('i', 'p', 'c'):
-                // Incoming pending contact
-                client->readipc(&client->json);
-                break;
+        case MAKENAMEID2('s', 'r'):
+            // sharekey distribution request
+            client->procsr(json);
+            return true;
 
-            case MAKENAMEID3('o', 'p', 'c'):
-                // Outgoing pending contact
-                client->readopc(&client->json);
-                break;
+        case MAKENAMEID2('s', 'n'):
+            // sequence number
+            return client->scsn.setScsn(json);
 
-            case MAKENAMEID2('p', 'h'):
-                // Public links handles
-                client->procph(&client->json);
-                break;
+        case MAKENAMEID3('i', 'p', 'c'):
+            // Incoming pending contact
+            client->readipc(json);
+            return true;
+
+        case MAKENAMEID3('o', 'p', 'c'):
+            // Outgoing pending contact
+            client->readopc(json);
+            return true;
+
+        case MAKENAMEID2('p', 'h'):
+            // Public links handles
+            client->procph(json);
+            return true;
 
 #ifdef ENABLE_CHAT
-            case MAKENAMEID3('m', 'c', 'f'):
-                // List of chatrooms
-                client->procmcf(&client->json);
-                break;
+        case MAKENAMEID3('m', 'c', 'f'):
+            // List of chatrooms
+            client->procmcf(json);
+            return true;
 
-            case MAKENAMEID5('m', 'c', 'p', 'n', 'a'):   // fall-through
-            case MAKENAMEID4('m', 'c', 'n', 'a'):
-                // nodes shared in chatrooms
-                client->procmcna(&client->json);
-                break;
+        case MAKENAMEID5('m', 'c', 'p', 'n', 'a'):   // fall-through
+        case MAKENAMEID4('m', 'c', 'n', 'a'):
+            // nodes shared in chatrooms
+            client->procmcna(json);
+            return true;
 #endif
-            case EOO:
-            {
-                if (!client->scsn.ready())
-                {
-                    client->fetchingnodes = false;
-                    client->app->fetchnodes_result(API_EINTERNAL);
-                    return false;
-                }
-
-                client->mergenewshares(0);
-                client->applykeys();
-                client->initsc();
-                client->pendingsccommit = false;
-                client->fetchnodestag = tag;
+        default:
+            return json->storeobject();
+    }
+}
 
-                WAIT_CLASS::bumpds();
-                client->fnstats.timeToCached = Waiter::ds - client->fnstats.startTime;
-                client->fnstats.nodesCached = client->nodes.size();
-                return true;
-            }
-            default:
-                if (!client->json.storeobject())
-                {
-                    client->fetchingnodes = false;
-                    client->app->fetchnodes_result(API_EINTERNAL);
-                    return false;
-                }
-        }
+// the whole response has been read
+bool CommandFetchNodes::parsingfinished()
+{
+    if (!client->scsn.ready())
+    {
+        return false;
     }
+
+    client->mergenewshares(0);
+    client->applykeys();
+    client->initsc();
+    client->pendingsccommit = false;
+    client->fetchnodestag = tag;
+
+    WAIT_CLASS::bumpds();
+    client->fnstats.timeToCached = Waiter::ds - client->fnstats.startTime;
+    client->fnstats.nodesCached = client->nodes.size();
+    return true;
 }
 
 // report event to server logging facility
@@ -468,54 +468,198 @@ void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv,
 {
     assert(!(pos & (KEYLENGTH - 1)));
 
-    byte ctr[BLOCKSIZE], tmp[BLOCKSIZE];
+    if (!mac)
+    {
+        ctr_xor(data, len, pos, ctriv);
+        return;
+    }
 
-    MemAccess::set<int64_t>(ctr,ctriv);
-    setint64(pos / BLOCKSIZE, ctr + sizeof ctriv);
+    CtrLane lane = { data, len, pos, mac, initmac };
+    ctr_crypt_lanes(&lane, 1, ctriv, encrypt);
+}
 
-    if (mac && initmac)
+void SymmCipher::ctr_crypt_lanes(CtrLane* lanes, size_t numlanes, ctr_iv ctriv, bool encrypt)
+{
+    for (size_t i = 0; i < numlanes; i++)
     {
-        memcpy(mac, ctr, sizeof ctriv);
-        memcpy(mac + sizeof ctriv, ctr, sizeof ctriv);
+        assert(!(lanes[i].pos & (KEYLENGTH - 1)));
+
+        if (lanes[i].initmac)
+        {
+            memcpy(lanes[i].mac, &ctriv, sizeof ctriv);
+            memcpy(lanes[i].mac + sizeof ctriv, &ctriv, sizeof ctriv);
+        }
+
+        if (!encrypt)
+        {
+            // the MAC is always calculated over the plaintext
+            ctr_xor(lanes[i].data, lanes[i].len, lanes[i].pos, ctriv);
+        }
     }
 
-    while ((int)len > 0)
+    // encryption input is NUL-padded, so a trailing partial block is MACed as a whole one
+    for (size_t i = 0; i < numlanes; i += MAXLANES)
     {
-        if (encrypt)
-        {
-            if(mac)
-            {
-                xorblock(data, mac);
-                ecb_encrypt(mac);
-            }
+        size_t n = numlanes - i < MAXLANES ? numlanes - i : MAXLANES;
 
-            ecb_encrypt(ctr, tmp);
-            xorblock(tmp, data);
+        if (n == 1)
+        {
+            cbc_mac(lanes[i].data, lanes[i].len, lanes[i].mac, encrypt);
         }
         else
         {
-            ecb_encrypt(ctr, tmp);
-            xorblock(tmp, data);
+            cbc_mac_lanes(lanes + i, n, encrypt);
+        }
+    }
+
+    if (encrypt)
+    {
+        for (size_t i = 0; i < numlanes; i++)
+        {
+            ctr_xor(lanes[i].data, lanes[i].len, lanes[i].pos, ctriv);
+        }
+    }
+}
+
+static void xorbytes(const byte* src, byte* dst, size_t len)
+{
+    uint64_t s, d;
+
+    for (; len >= sizeof s; len -= sizeof s, src += sizeof s, dst += sizeof s)
+    {
+        memcpy(&s, src, sizeof s);
+        memcpy(&d, dst, sizeof d);
+        d ^= s;
+        memcpy(dst, &d, sizeof d);
+    }
+
+    while (len--)
+    {
+        dst[len] ^= src[len];
+    }
+}
+
+// xor the CTR keystream for the (padded) blocks of data starting at pos
+// counters are encrypted in batches so that AES-NI/VAES can pipeline them
+void SymmCipher::ctr_xor(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv)
+{
+    alignas(16) byte keystream[CTRBATCHBLOCKS * BLOCKSIZE];
+    int64_t blockid = pos / BLOCKSIZE;
+    unsigned numblocks = (len + BLOCKSIZE - 1) / BLOCKSIZE;
+
+    while (numblocks)
+    {
+        unsigned batch = std::min(numblocks, unsigned(CTRBATCHBLOCKS));
+
+        for (unsigned i = 0; i < batch; i++)
+        {
+            byte* ctr = keystream + i * BLOCKSIZE;
+            MemAccess::set<int64_t>(ctr, ctriv);
+            setint64(blockid++, ctr + sizeof ctriv);
+        }
+
+        aesecb_e.ProcessData(keystream, keystream, batch * BLOCKSIZE);
+        xorbytes(keystream, data, batch * BLOCKSIZE);
+
+        data += batch * BLOCKSIZE;
+        numblocks -= batch;
+    }
+}
+
+// CBC-MAC of a single lane
+// padded: a trailing partial block is processed as a whole (NUL-padded) block
+void SymmCipher::cbc_mac(const byte* data, unsigned len, byte* mac, bool padded)
+{
+    alignas(16) byte out[CTRBATCHBLOCKS * BLOCKSIZE];
+    unsigned numblocks = padded ? (len + BLOCKSIZE - 1) / BLOCKSIZE : len / BLOCKSIZE;
+
+    if (numblocks)
+    {
+        unsigned batch = 0;
+
+        // the CBC register carries the MAC from one batch to the next
+        aescbc_e.Resynchronize(mac);
+
+        while (numblocks)
+        {
+            batch = std::min(numblocks, unsigned(CTRBATCHBLOCKS));
+            aescbc_e.ProcessData(out, data, batch * BLOCKSIZE);
+
+            data += batch * BLOCKSIZE;
+            numblocks -= batch;
+        }
+
+        memcpy(mac, out + (batch - 1) * BLOCKSIZE, BLOCKSIZE);
+    }
+
+    unsigned tail = padded ? 0 : len % BLOCKSIZE;
+
+    if (tail)
+    {
+        xorblock(data, mac, int(tail));
+        ecb_encrypt(mac);
+    }
+}
 
-            if (mac)
+// CBC-MAC of up to MAXLANES independent lanes: each step xors the next block of every
+// lane into its MAC and then encrypts all MACs with a single call
+void SymmCipher::cbc_mac_lanes(CtrLane* lanes, size_t numlanes, bool padded)
+{
+    assert(numlanes <= MAXLANES);
+
+    // longest lanes first, so that the ones still running always form a prefix
+    CtrLane* order[MAXLANES];
+    alignas(16) byte macs[MAXLANES * BLOCKSIZE];
+
+    for (size_t i = 0; i < numlanes; i++)
+    {
+        order[i] = lanes + i;
+    }
+
+    std::sort(order, order + numlanes, [](const CtrLane* a, const CtrLane* b)
+    {
+        return a->len > b->len;
+    });
+
+    for (size_t i = 0; i < numlanes; i++)
+    {
+        memcpy(macs + i * BLOCKSIZE, order[i]->mac, BLOCKSIZE);
+    }
+
+    size_t active = numlanes;
+
+    for (unsigned offset = 0; ; offset += BLOCKSIZE)
+    {
+        while (active && offset >= order[active - 1]->len)
+        {
+            active--;
+        }
+
+        if (!active)
+        {
+            break;
+        }
+
+        for (size_t i = 0; i < active; i++)
+        {
+            unsigned remaining = order[i]->len - offset;
+
+            if (padded || remaining >= (unsigned)BLOCKSIZE)
+            {
+                xorblock(order[i]->data + offset, macs + i * BLOCKSIZE);
+            }
+            else
             {
-                if (len >= (unsigned)BLOCKSIZE)
-                {
-                    xorblock(data, mac);
-                }
-                else
-                {
-                    xorblock(data, mac, len);
-                }
-
-                ecb_encrypt(mac);
+                xorblock(order[i]->data + offset, macs + i * BLOCKSIZE, int(remaining));
             }
         }
 
-        len -= BLOCKSIZE;
-        data += BLOCKSIZE;
+        aesecb_e.ProcessData(macs, macs, active * BLOCKSIZE);
+    }
 
-        incblock(ctr);
+    for (size_t i = 0; i < numlanes; i++)
+    {
+        memcpy(order[i]->mac, macs + i * BLOCKSIZE, BLOCKSIZE);
     }
 }
 
@@ -23,6 +23,9 @@
 #include "mega/utils.h"
 #include "mega/logging.h"
 
+#include <algorithm>
+#include <unordered_set>
+
 namespace mega {
 DbTable::DbTable(PrnGen &rng, bool checkAlwaysTransacted)
     : rng(rng), mCheckAlwaysTransacted(checkAlwaysTransacted)
@@ -69,10 +72,7 @@ bool DbTable::next(uint32_t* type, string* data, SymmCipher* key)
             return true;
         }
 
-        if (*type > nextid)
-        {
-            nextid = *type & - IDSPACING;
-        }
+        updateNextId(*type);
 
         return PaddedCBC::decrypt(data, key);
     }
@@ -80,6 +80,14 @@ bool DbTable::next(uint32_t* type, string* data, SymmCipher* key)
     return false;
 }
 
+void DbTable::updateNextId(uint32_t id)
+{
+    if (id > nextid)
+    {
+        nextid = id & - IDSPACING;
+    }
+}
+
 DBTableTransactionCommitter *DbTable::getTransactionCommitter() const
 {
     return mTransactionCommitter;
@@ -118,8 +126,608 @@ void DbTable::checkCommitter(DBTableTransactionCommitter*)
     assert(mTransactionCommitter);
 }
 
+WriteBehindDbTable::WriteBehindDbTable(PrnGen& rng, unique_ptr<DbTable> table)
+    : DbTable(rng, false)
+    , mTable(std::move(table))
+    , mNodes(dynamic_cast<DbTableNodes*>(mTable.get()))
+{
+    assert(mNodes && mNodes->hasNodesTable());
+    mThread = std::thread([this]() { loop(); });
+}
+
+WriteBehindDbTable::~WriteBehindDbTable()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mCondition.notify_all();
+
+    // the queued writes are applied before the thread ends
+    mThread.join();
+    resetCommitter();
+}
+
+void WriteBehindDbTable::enqueue(Write&& w)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    mCondition.wait(lock, [this]() { return mQueuedBytes < MAXQUEUEDBYTES || mFailed; });
+
+    w.seq = ++mSeq;
+    size_t position = mQueue.size();
+
+    // a put that is not applied yet is replaced by a later write of the same record
+    auto replace = [this](size_t queued)
+    {
+        Write& previous = mQueue[queued];
+        mQueuedBytes -= previous.data->size();
+        previous.type = Write::NONE;
+        previous.data.reset();
+    };
+
+    switch (w.type)
+    {
+        case Write::PUT:
+        case Write::DEL:
+        {
+            auto it = mRecordPuts.find(w.id);
+            if (it != mRecordPuts.end())
+            {
+                replace(it->second);
+                mRecordPuts.erase(it);
+            }
+            if (w.type == Write::PUT)
+            {
+                mRecordPuts[w.id] = position;
+            }
+            mLatestRecords[w.id] = Latest{ w.data, w.seq, NodeColumns() };
+            break;
+        }
+
+        case Write::PUTNODE:
+        case Write::DELNODETREE:
+        {
+            handle h = w.columns.handle.as8byte();
+            auto it = mNodePuts.find(h);
+            if (it != mNodePuts.end())
+            {
+                replace(it->second);
+                mNodePuts.erase(it);
+            }
+            if (w.type == Write::PUTNODE)
+            {
+                mNodePuts[h] = position;
+            }
+            else
+            {
+                mLastTreeDeletion = w.seq;
+                ++mQueuedTreeDeletions;
+            }
+            mLatestNodes[h] = Latest{ w.data, w.seq, w.columns };
+            break;
+        }
+
+        case Write::COMMIT:
+            // what is queued before a commit must be stored by it
+            mRecordPuts.clear();
+            mNodePuts.clear();
+            break;
+
+        default:
+            break;
+    }
+
+    if (w.data)
+    {
+        mQueuedBytes += w.data->size();
+    }
+    mQueue.push_back(std::move(w));
+
+    lock.unlock();
+    mCondition.notify_all();
+}
+
+bool WriteBehindDbTable::apply(const Write& w)
+{
+    switch (w.type)
+    {
+        case Write::PUT:
+            return mTable->put(w.id, const_cast<char*>(w.data->data()), unsigned(w.data->size()));
+
+        case Write::DEL:
+            return mTable->del(w.id);
+
+        case Write::PUTNODE:
+            return mNodes->putNode(w.columns, *w.data);
+
+        case Write::DELNODETREE:
+            return mNodes->delNodeTree(w.columns.handle);
+
+        default:
+            return true;
+    }
+}
+
+void WriteBehindDbTable::loop()
+{
+    for (;;)
+    {
+        std::deque<Write> writes;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]() { return mStop || !mQueue.empty(); });
+            if (mQueue.empty())
+            {
+                return;
+            }
+
+            writes.swap(mQueue);
+            mQueuedBytes = 0;
+            mRecordPuts.clear();
+            mNodePuts.clear();
+            mApplying = true;
+        }
+        mCondition.notify_all();
+
+        // all the commits queued become the last one
+        size_t lastCommit = writes.size();
+        for (size_t i = writes.size(); i--; )
+        {
+            if (writes[i].type == Write::COMMIT)
+            {
+                lastCommit = i;
+                break;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mTableMutex);
+
+            for (size_t i = 0; i < writes.size() && !mFailed; i++)
+            {
+                const Write& w = writes[i];
+                if (w.type == Write::BEGIN)
+                {
+                    if (!mTable->inTransaction())
+                    {
+                        mTable->begin();
+                    }
+                }
+                else if (w.type == Write::COMMIT)
+                {
+                    if (i == lastCommit)
+                    {
+                        mTable->commit();
+                        ++mCommits;
+                    }
+                }
+                else if (!apply(w))
+                {
+                    LOG_err << "Deferred state cache write failed";
+                    mFailed = true;
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (const Write& w : writes)
+            {
+                if (w.type == Write::PUT || w.type == Write::DEL)
+                {
+                    auto it = mLatestRecords.find(w.id);
+                    if (it != mLatestRecords.end() && it->second.seq == w.seq)
+                    {
+                        mLatestRecords.erase(it);
+                    }
+                }
+                else if (w.type == Write::PUTNODE || w.type == Write::DELNODETREE)
+                {
+                    if (w.type == Write::DELNODETREE)
+                    {
+                        --mQueuedTreeDeletions;
+                    }
+
+                    auto it = mLatestNodes.find(w.columns.handle.as8byte());
+                    if (it != mLatestNodes.end() && it->second.seq == w.seq)
+                    {
+                        mLatestNodes.erase(it);
+                    }
+                }
+            }
+            mApplying = false;
+        }
+        mCondition.notify_all();
+    }
+}
+
+void WriteBehindDbTable::flush()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this]() { return mQueue.empty() && !mApplying; });
+}
+
+void WriteBehindDbTable::rewind()
+{
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    mTable->rewind();
+}
+
+bool WriteBehindDbTable::next(uint32_t* id, string* data)
+{
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    return mTable->next(id, data);
+}
+
+bool WriteBehindDbTable::get(uint32_t id, string* data)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mLatestRecords.find(id);
+        if (it != mLatestRecords.end())
+        {
+            if (!it->second.data)
+            {
+                return false;
+            }
+            *data = *it->second.data;
+            return true;
+        }
+    }
+
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    return mTable->get(id, data);
+}
+
+bool WriteBehindDbTable::put(uint32_t id, char* data, unsigned len)
+{
+    if (mFailed)
+    {
+        return false;
+    }
+
+    Write w;
+    w.type = Write::PUT;
+    w.id = id;
+    w.data = std::make_shared<const string>(data, len);
+    enqueue(std::move(w));
+    return true;
+}
+
+bool WriteBehindDbTable::del(uint32_t id)
+{
+    if (mFailed)
+    {
+        return false;
+    }
+
+    Write w;
+    w.type = Write::DEL;
+    w.id = id;
+    enqueue(std::move(w));
+    return true;
+}
+
+void WriteBehindDbTable::truncate()
+{
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    mTable->truncate();
+}
+
+void WriteBehindDbTable::begin()
+{
+    Write w;
+    w.type = Write::BEGIN;
+    enqueue(std::move(w));
+    mInTransaction = true;
+}
+
+void WriteBehindDbTable::commit()
+{
+    // the thread commits once it has applied what was queued before
+    Write w;
+    w.type = Write::COMMIT;
+    enqueue(std::move(w));
+    mInTransaction = false;
+}
+
+void WriteBehindDbTable::abort()
+{
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    mTable->abort();
+    mInTransaction = false;
+}
+
+void WriteBehindDbTable::remove()
+{
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    mTable->remove();
+    mInTransaction = false;
+}
+
+bool WriteBehindDbTable::inTransaction() const
+{
+    return mInTransaction;
+}
+
+bool WriteBehindDbTable::putNode(const NodeColumns& columns, const string& content)
+{
+    if (mFailed)
+    {
+        return false;
+    }
+
+    Write w;
+    w.type = Write::PUTNODE;
+    w.columns = columns;
+    w.data = std::make_shared<const string>(content);
+    enqueue(std::move(w));
+    return true;
+}
+
+bool WriteBehindDbTable::delNodeTree(NodeHandle h)
+{
+    if (mFailed)
+    {
+        return false;
+    }
+
+    Write w;
+    w.type = Write::DELNODETREE;
+    w.columns.handle = h;
+    enqueue(std::move(w));
+    return true;
+}
+
+bool WriteBehindDbTable::getNode(NodeHandle h, string* content)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mLatestNodes.find(h.as8byte());
+
+        // a node queued before a subtree deletion may be one of the nodes it removes
+        if (it != mLatestNodes.end() && (!it->second.data || it->second.seq > mLastTreeDeletion))
+        {
+            if (!it->second.data)
+            {
+                return false;
+            }
+            *content = *it->second.data;
+            return true;
+        }
+    }
+
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    return mNodes->getNode(h, content);
+}
+
+void WriteBehindDbTable::mergeQueuedNodes(NodeRows& rows, const std::function<bool(const NodeColumns&)>& matches) const
+{
+    if (mLatestNodes.empty())
+    {
+        return;
+    }
+
+    // the queued version of a stored node may not match anymore
+    rows.erase(std::remove_if(rows.begin(), rows.end(), [this](const NodeRows::value_type& row)
+    {
+        return mLatestNodes.find(row.first.as8byte()) != mLatestNodes.end();
+    }), rows.end());
+
+    for (auto& it : mLatestNodes)
+    {
+        if (it.second.data && matches(it.second.columns))
+        {
+            rows.emplace_back(it.second.columns.handle, *it.second.data);
+        }
+    }
+}
+
+bool WriteBehindDbTable::queuedInSubtree(NodeHandle h, const vector<NodeHandle>& stored) const
+{
+    if (mLatestNodes.empty())
+    {
+        return false;
+    }
+
+    std::unordered_set<handle> below;
+    for (NodeHandle n : stored)
+    {
+        below.insert(n.as8byte());
+    }
+
+    // a queued node moved into the subtree has its new parent in it, and one moved out or
+    // changed in place is stored in it
+    for (auto& it : mLatestNodes)
+    {
+        if (below.count(it.first)
+                || it.second.columns.parent == h
+                || below.count(it.second.columns.parent.as8byte()))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool WriteBehindDbTable::getChildren(NodeHandle parent, NodeRows& rows)
+{
+    {
+        std::lock_guard<std::mutex> tableLock(mTableMutex);
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mQueuedTreeDeletions)
+        {
+            if (!mNodes->getChildren(parent, rows))
+            {
+                return false;
+            }
+            mergeQueuedNodes(rows, [parent](const NodeColumns& columns)
+            {
+                return columns.parent == parent;
+            });
+            return true;
+        }
+    }
+
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    return mNodes->getChildren(parent, rows);
+}
+
+bool WriteBehindDbTable::getChildrenByNameHash(NodeHandle parent, uint64_t nameHash, NodeRows& rows)
+{
+    {
+        std::lock_guard<std::mutex> tableLock(mTableMutex);
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mQueuedTreeDeletions)
+        {
+            if (!mNodes->getChildrenByNameHash(parent, nameHash, rows))
+            {
+                return false;
+            }
+            mergeQueuedNodes(rows, [parent, nameHash](const NodeColumns& columns)
+            {
+                return columns.parent == parent && columns.nameHash == nameHash;
+            });
+            return true;
+        }
+    }
+
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    return mNodes->getChildrenByNameHash(parent, nameHash, rows);
+}
+
+bool WriteBehindDbTable::getNodesByFingerprint(const string& fingerprint, NodeRows& rows)
+{
+    {
+        std::lock_guard<std::mutex> tableLock(mTableMutex);
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mQueuedTreeDeletions)
+        {
+            if (!mNodes->getNodesByFingerprint(fingerprint, rows))
+            {
+                return false;
+            }
+            mergeQueuedNodes(rows, [&fingerprint](const NodeColumns& columns)
+            {
+                return columns.fingerprint == fingerprint;
+            });
+            return true;
+        }
+    }
+
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    return mNodes->getNodesByFingerprint(fingerprint, rows);
+}
+
+bool WriteBehindDbTable::getSubtree(NodeHandle h, NodeRows& rows)
+{
+    {
+        std::lock_guard<std::mutex> tableLock(mTableMutex);
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mQueuedTreeDeletions)
+        {
+            NodeRows stored;
+            if (!mNodes->getSubtree(h, stored))
+            {
+                return false;
+            }
+
+            vector<NodeHandle> handles;
+            handles.reserve(stored.size());
+            for (auto& row : stored)
+            {
+                handles.push_back(row.first);
+            }
+
+            // the stored order of the nodes can't be kept if some are queued
+            if (!queuedInSubtree(h, handles))
+            {
+                rows.insert(rows.end(), std::make_move_iterator(stored.begin()), std::make_move_iterator(stored.end()));
+                return true;
+            }
+        }
+    }
+
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    return mNodes->getSubtree(h, rows);
+}
+
+bool WriteBehindDbTable::getSubtreeCounts(NodeHandle h, bool isFile, NodeCounter& counts)
+{
+    {
+        std::lock_guard<std::mutex> tableLock(mTableMutex);
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mQueuedTreeDeletions)
+        {
+            // the counts of the stored nodes are those of the subtree if none of it is queued
+            vector<NodeHandle> handles;
+            if (!mLatestNodes.empty() && !mNodes->getSubtreeHandles(h, handles))
+            {
+                return false;
+            }
+
+            if (!queuedInSubtree(h, handles))
+            {
+                return mNodes->getSubtreeCounts(h, isFile, counts);
+            }
+        }
+    }
+
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    return mNodes->getSubtreeCounts(h, isFile, counts);
+}
+
+bool WriteBehindDbTable::getSubtreeHandles(NodeHandle h, vector<NodeHandle>& handles)
+{
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    return mNodes->getSubtreeHandles(h, handles);
+}
+
+bool WriteBehindDbTable::getTopNodes(NodeRows& rows)
+{
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    return mNodes->getTopNodes(rows);
+}
+
+void WriteBehindDbTable::rewindNodes()
+{
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    mNodes->rewindNodes();
+}
+
+bool WriteBehindDbTable::nextNode(NodeHandle* h, string* content)
+{
+    flush();
+    std::lock_guard<std::mutex> lock(mTableMutex);
+    return mNodes->nextNode(h, content);
+}
+
+bool WriteBehindDbTable::hasNodesTable() const
+{
+    return mNodes && mNodes->hasNodesTable();
+}
+
 const int DbAccess::LEGACY_DB_VERSION = 11;
-const int DbAccess::DB_VERSION = DbAccess::LEGACY_DB_VERSION + 1;
+const int DbAccess::PREVIOUS_DB_VERSION = DbAccess::LEGACY_DB_VERSION + 1;
+// 13: node records of the state cache are stored in the typed nodes table
+const int DbAccess::DB_VERSION = DbAccess::PREVIOUS_DB_VERSION + 1;
 
 DbAccess::DbAccess()
 {
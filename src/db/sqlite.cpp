@@ -55,11 +55,49 @@ LocalPath SqliteDbAccess::databasePath(const FileSystemAccess& fsAccess,
     return path;
 }
 
+// renames a database with its -shm and -wal files
+static bool renameDatabase(FileSystemAccess& fsAccess, LocalPath from, LocalPath to)
+{
+    if (!fsAccess.renamelocal(from, to, false))
+    {
+        return false;
+    }
+
+    for (auto suffix : { LocalPath::fromRelativePath("-shm"), LocalPath::fromRelativePath("-wal") })
+    {
+        auto fromSuffixed = from + suffix;
+        auto toSuffixed = to + suffix;
+
+        fsAccess.renamelocal(fromSuffixed, toSuffixed);
+    }
+
+    return true;
+}
+
 bool SqliteDbAccess::checkDbFileAndAdjustLegacy(FileSystemAccess& fsAccess, const string& name, const int flags, LocalPath& dbPath)
 {
     dbPath = databasePath(fsAccess, name, DB_VERSION);
     auto upgraded = true;
 
+    // Databases of the previous version are taken over as they are: node records still in
+    // statecache are read as before, and move to the nodes table when they change. Renaming
+    // keeps older SDKs, which don't know the nodes table, from resuming a session without nodes.
+    if (!fsAccess.fileExistsAt(dbPath))
+    {
+        auto previousPath = databasePath(fsAccess, name, PREVIOUS_DB_VERSION);
+
+        if (fsAccess.fileExistsAt(previousPath))
+        {
+            LOG_debug << "Upgrading database: " << previousPath;
+
+            if (!renameDatabase(fsAccess, previousPath, dbPath))
+            {
+                LOG_debug << "Unable to upgrade database, deleting...";
+                fsAccess.unlinklocal(previousPath);
+            }
+        }
+    }
+
     {
         auto legacyPath = databasePath(fsAccess, name, LEGACY_DB_VERSION);
         auto fileAccess = fsAccess.newfileaccess();
@@ -78,20 +116,8 @@ bool SqliteDbAccess::checkDbFileAndAdjustLegacy(FileSystemAccess& fsAccess, cons
             {
                 LOG_debug << "Trying to recycle a legacy database.";
 
-                if (fsAccess.renamelocal(legacyPath, dbPath, false))
+                if (renameDatabase(fsAccess, legacyPath, dbPath))
                 {
-                    auto suffix = LocalPath::fromRelativePath("-shm");
-                    auto from = legacyPath + suffix;
-                    auto to = dbPath + suffix;
-
-                    fsAccess.renamelocal(from, to);
-
-                    suffix = LocalPath::fromRelativePath("-wal");
-                    from = legacyPath + suffix;
-                    to = dbPath + suffix;
-
-                    fsAccess.renamelocal(from, to);
-
                     LOG_debug << "Legacy database recycled.";
                 }
                 else
@@ -117,6 +143,9 @@ bool SqliteDbAccess::checkDbFileAndAdjustLegacy(FileSystemAccess& fsAccess, cons
     return fsAccess.fileExistsAt(dbPath);
 }
 
+// how long the fingerprints table waits for another connection's transaction
+static const int FINGERPRINT_BUSY_TIMEOUT_MS = 5000;
+
 SqliteDbTable* SqliteDbAccess::open(PrnGen &rng, FileSystemAccess& fsAccess, const string& name, const int flags)
 {
     LocalPath dbPath;
@@ -160,11 +189,64 @@ SqliteDbTable* SqliteDbAccess::open(PrnGen &rng, FileSystemAccess& fsAccess, con
         return nullptr;
     }
 
+    // typed node records (see DbTableNodes), only in the state cache
+    const bool nodeTable = (flags & DB_OPEN_FLAG_NODES) > 0;
+    sql =
+      "CREATE TABLE IF NOT EXISTS nodes ( "
+      "    nodehandle INTEGER PRIMARY KEY NOT NULL, "
+      "    parenthandle INTEGER NOT NULL, "
+      "    type INTEGER NOT NULL, "
+      "    size INTEGER NOT NULL, "
+      "    mtime INTEGER NOT NULL, "
+      "    fingerprint BLOB, "
+      "    namehash INTEGER NOT NULL, "
+      "    content BLOB NOT NULL "
+      ");"
+      "CREATE INDEX IF NOT EXISTS nodes_parenthandle ON nodes (parenthandle);"
+      "CREATE INDEX IF NOT EXISTS nodes_fingerprint ON nodes (fingerprint);"
+      "CREATE INDEX IF NOT EXISTS nodes_namehash ON nodes (namehash);"
+      "CREATE INDEX IF NOT EXISTS nodes_type_size_mtime ON nodes (type, size, mtime);";
+
+    result = nodeTable ? sqlite3_exec(db, sql, nullptr, nullptr, nullptr) : SQLITE_OK;
+    if (result)
+    {
+        sqlite3_close(db);
+        return nullptr;
+    }
+
+    // local file fingerprints (see DbTableFingerprints), in their own database
+    const bool fingerprintTable = (flags & DB_OPEN_FLAG_FINGERPRINTS) > 0;
+    sql =
+      "CREATE TABLE IF NOT EXISTS fingerprints ( "
+      "    fsfp INTEGER NOT NULL, "
+      "    fsid INTEGER NOT NULL, "
+      "    size INTEGER NOT NULL, "
+      "    mtime INTEGER NOT NULL, "
+      "    ctime INTEGER NOT NULL, "
+      "    crc BLOB NOT NULL, "
+      "    PRIMARY KEY (fsfp, fsid) "
+      ");";
+
+    result = fingerprintTable ? sqlite3_exec(db, sql, nullptr, nullptr, nullptr) : SQLITE_OK;
+    if (result)
+    {
+        sqlite3_close(db);
+        return nullptr;
+    }
+
+    if (fingerprintTable)
+    {
+        // other clients and threads write to it too: wait for them rather than fail
+        sqlite3_busy_timeout(db, FINGERPRINT_BUSY_TIMEOUT_MS);
+    }
+
     return new SqliteDbTable(rng,
                              db,
                              fsAccess,
                              dbPath,
-                             (flags & DB_OPEN_FLAG_TRANSACTED) > 0);
+                             (flags & DB_OPEN_FLAG_TRANSACTED) > 0,
+                             nodeTable,
+                             fingerprintTable);
 }
 
 bool SqliteDbAccess::probe(FileSystemAccess& fsAccess, const string& name) const
@@ -178,6 +260,13 @@ bool SqliteDbAccess::probe(FileSystemAccess& fsAccess, const string& name) const
         return true;
     }
 
+    dbPath = databasePath(fsAccess, name, PREVIOUS_DB_VERSION);
+
+    if (fileAccess->isfile(dbPath))
+    {
+        return true;
+    }
+
     dbPath = databasePath(fsAccess, name, LEGACY_DB_VERSION);
 
     return fileAccess->isfile(dbPath);
@@ -188,12 +277,14 @@ const LocalPath& SqliteDbAccess::rootPath() const
     return mRootPath;
 }
 
-SqliteDbTable::SqliteDbTable(PrnGen &rng, sqlite3* db, FileSystemAccess &fsAccess, const LocalPath &path, const bool checkAlwaysTransacted)
+SqliteDbTable::SqliteDbTable(PrnGen &rng, sqlite3* db, FileSystemAccess &fsAccess, const LocalPath &path, const bool checkAlwaysTransacted, const bool nodeTable, const bool fingerprintTable)
   : DbTable(rng, checkAlwaysTransacted)
   , db(db)
   , pStmt(nullptr)
   , dbfile(path)
   , fsaccess(&fsAccess)
+  , mNodeTable(nodeTable)
+  , mFingerprintTable(fingerprintTable)
 {
 }
 
@@ -206,9 +297,7 @@ SqliteDbTable::~SqliteDbTable()
         return;
     }
 
-    sqlite3_finalize(pStmt);
-    sqlite3_finalize(mDelStmt);
-    sqlite3_finalize(mPutStmt);
+    finalizeStatements();
 
     if (inTransaction())
     {
@@ -219,6 +308,17 @@ SqliteDbTable::~SqliteDbTable()
     LOG_debug << "Database closed " << dbfile;
 }
 
+void SqliteDbTable::finalizeStatements()
+{
+    for (auto stmt : { &pStmt, &mDelStmt, &mPutStmt, &mNodesStmt, &mPutNodeStmt, &mDelNodeTreeStmt,
+                       &mGetNodeStmt, &mChildrenStmt, &mChildrenByNameHashStmt, &mFingerprintStmt,
+                       &mPutFileFingerprintStmt, &mGetFileFingerprintStmt })
+    {
+        sqlite3_finalize(*stmt);
+        *stmt = nullptr;
+    }
+}
+
 bool SqliteDbTable::inTransaction() const
 {
     return sqlite3_get_autocommit(db) == 0;
@@ -419,7 +519,17 @@ void SqliteDbTable::truncate()
 
     checkTransaction();
 
-    int rc = sqlite3_exec(db, "DELETE FROM statecache", 0, 0, NULL);
+    string sql = "DELETE FROM statecache;";
+    if (mNodeTable)
+    {
+        sql += " DELETE FROM nodes;";
+    }
+    if (mFingerprintTable)
+    {
+        sql += " DELETE FROM fingerprints;";
+    }
+
+    int rc = sqlite3_exec(db, sql.c_str(), 0, 0, NULL);
     if (rc != API_OK)
     {
         string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(rc));
@@ -491,12 +601,7 @@ void SqliteDbTable::remove()
         return;
     }
 
-    sqlite3_finalize(pStmt);
-    pStmt = nullptr;
-    sqlite3_finalize(mDelStmt);
-    mDelStmt = nullptr;
-    sqlite3_finalize(mPutStmt);
-    mPutStmt = nullptr;
+    finalizeStatements();
 
     if (inTransaction())
     {
@@ -509,6 +614,454 @@ void SqliteDbTable::remove()
 
     fsaccess->unlinklocal(dbfile);
 }
+
+// add/update typed node record
+bool SqliteDbTable::putNode(const NodeColumns& columns, const string& content)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    checkTransaction();
+
+    int sqlResult = SQLITE_OK;
+    if (!mPutNodeStmt)
+    {
+        sqlResult = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO nodes (nodehandle, parenthandle, type, size, mtime, fingerprint, namehash, content) "
+                                           "VALUES (?, ?, ?, ?, ?, ?, ?, ?)", -1, &mPutNodeStmt, nullptr);
+    }
+
+    if (sqlResult == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mPutNodeStmt, 1, sqlite3_int64(columns.handle.as8byte()))) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mPutNodeStmt, 2, sqlite3_int64(columns.parent.as8byte()))) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int(mPutNodeStmt, 3, columns.type)) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mPutNodeStmt, 4, columns.size)) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mPutNodeStmt, 5, columns.mtime)) == SQLITE_OK
+            && (sqlResult = columns.fingerprint.empty()
+                    ? sqlite3_bind_null(mPutNodeStmt, 6)
+                    : sqlite3_bind_blob(mPutNodeStmt, 6, columns.fingerprint.data(), int(columns.fingerprint.size()), SQLITE_STATIC)) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mPutNodeStmt, 7, sqlite3_int64(columns.nameHash))) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_blob(mPutNodeStmt, 8, content.data(), int(content.size()), SQLITE_STATIC)) == SQLITE_OK)
+    {
+        sqlResult = sqlite3_step(mPutNodeStmt);
+    }
+
+    bool ok = sqlResult == SQLITE_DONE;
+
+    if (!ok)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to put node into database: " << dbfile << err;
+        assert(!"Unable to put node into database.");
+    }
+
+    sqlite3_reset(mPutNodeStmt);
+
+    return ok;
+}
+
+// delete typed node record and the records of the nodes below it
+bool SqliteDbTable::delNodeTree(NodeHandle h)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    checkTransaction();
+
+    int sqlResult = SQLITE_OK;
+    if (!mDelNodeTreeStmt)
+    {
+        sqlResult = sqlite3_prepare_v2(db, "WITH RECURSIVE subtree(nodehandle) AS ( "
+                                           "    SELECT ? "
+                                           "    UNION ALL "
+                                           "    SELECT nodes.nodehandle FROM nodes JOIN subtree ON nodes.parenthandle = subtree.nodehandle) "
+                                           "DELETE FROM nodes WHERE nodehandle IN subtree", -1, &mDelNodeTreeStmt, nullptr);
+    }
+
+    if (sqlResult == SQLITE_OK)
+    {
+        sqlResult = sqlite3_bind_int64(mDelNodeTreeStmt, 1, sqlite3_int64(h.as8byte()));
+        if (sqlResult == SQLITE_OK)
+        {
+            sqlResult = sqlite3_step(mDelNodeTreeStmt);
+        }
+    }
+
+    bool ok = sqlResult == SQLITE_DONE || sqlResult == SQLITE_ROW;
+
+    if (!ok)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to delete nodes from database: " << dbfile << err;
+        assert(!"Unable to delete nodes from database.");
+    }
+
+    sqlite3_reset(mDelNodeTreeStmt);
+
+    return ok;
+}
+
+bool SqliteDbTable::getNodeRows(sqlite3_stmt*& stmt, const char* sql, NodeRows& rows, const std::function<int(sqlite3_stmt*)>& bind)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    int sqlResult = SQLITE_OK;
+    if (!stmt)
+    {
+        sqlResult = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    }
+
+    if (sqlResult == SQLITE_OK)
+    {
+        sqlResult = bind(stmt);
+    }
+
+    if (sqlResult == SQLITE_OK)
+    {
+        while ((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            // an empty or NULL blob has no data pointer
+            const char* content = static_cast<const char*>(sqlite3_column_blob(stmt, 1));
+            rows.emplace_back(NodeHandle().set6byte(uint64_t(sqlite3_column_int64(stmt, 0))),
+                              content ? string(content, size_t(sqlite3_column_bytes(stmt, 1))) : string());
+        }
+    }
+
+    bool ok = sqlResult == SQLITE_DONE;
+
+    if (!ok)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to get nodes from database: " << dbfile << err;
+        assert(!"Unable to get nodes from database.");
+    }
+
+    sqlite3_reset(stmt);
+
+    return ok;
+}
+
+bool SqliteDbTable::getNode(NodeHandle h, string* content)
+{
+    NodeRows rows;
+    bool ok = getNodeRows(mGetNodeStmt, "SELECT nodehandle, content FROM nodes WHERE nodehandle = ?", rows, [h](sqlite3_stmt* stmt)
+    {
+        return sqlite3_bind_int64(stmt, 1, sqlite3_int64(h.as8byte()));
+    });
+
+    if (!ok || rows.empty())
+    {
+        return false;
+    }
+
+    *content = std::move(rows.front().second);
+    return true;
+}
+
+bool SqliteDbTable::getChildren(NodeHandle parent, NodeRows& rows)
+{
+    return getNodeRows(mChildrenStmt, "SELECT nodehandle, content FROM nodes WHERE parenthandle = ?", rows, [parent](sqlite3_stmt* stmt)
+    {
+        return sqlite3_bind_int64(stmt, 1, sqlite3_int64(parent.as8byte()));
+    });
+}
+
+bool SqliteDbTable::getChildrenByNameHash(NodeHandle parent, uint64_t nameHash, NodeRows& rows)
+{
+    return getNodeRows(mChildrenByNameHashStmt, "SELECT nodehandle, content FROM nodes WHERE namehash = ? AND parenthandle = ?", rows, [parent, nameHash](sqlite3_stmt* stmt)
+    {
+        int result = sqlite3_bind_int64(stmt, 1, sqlite3_int64(nameHash));
+        return result == SQLITE_OK ? sqlite3_bind_int64(stmt, 2, sqlite3_int64(parent.as8byte())) : result;
+    });
+}
+
+bool SqliteDbTable::getNodesByFingerprint(const string& fingerprint, NodeRows& rows)
+{
+    return getNodeRows(mFingerprintStmt, "SELECT nodehandle, content FROM nodes WHERE fingerprint = ?", rows, [&fingerprint](sqlite3_stmt* stmt)
+    {
+        return sqlite3_bind_blob(stmt, 1, fingerprint.data(), int(fingerprint.size()), SQLITE_STATIC);
+    });
+}
+
+bool SqliteDbTable::getSubtree(NodeHandle h, NodeRows& rows)
+{
+    // not cached, it is not expected to be frequent
+    sqlite3_stmt* stmt = nullptr;
+    bool ok = getNodeRows(stmt, "WITH RECURSIVE subtree(nodehandle, content, depth) AS ( "
+                                "    SELECT nodehandle, content, 1 FROM nodes WHERE parenthandle = ? "
+                                "    UNION ALL "
+                                "    SELECT nodes.nodehandle, nodes.content, subtree.depth + 1 FROM nodes JOIN subtree ON nodes.parenthandle = subtree.nodehandle) "
+                                "SELECT nodehandle, content FROM subtree ORDER BY depth", rows, [h](sqlite3_stmt* stmt)
+    {
+        return sqlite3_bind_int64(stmt, 1, sqlite3_int64(h.as8byte()));
+    });
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+bool SqliteDbTable::getSubtreeCounts(NodeHandle h, bool isFile, NodeCounter& counts)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    // like Node::subnodeCounts(): files below a file are versions
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = sqlite3_prepare_v2(db, "WITH RECURSIVE subtree(nodehandle, type, size, version) AS ( "
+                                           "    SELECT nodehandle, type, size, ? FROM nodes WHERE parenthandle = ? "
+                                           "    UNION ALL "
+                                           "    SELECT nodes.nodehandle, nodes.type, nodes.size, subtree.type = ? FROM nodes JOIN subtree ON nodes.parenthandle = subtree.nodehandle) "
+                                           "SELECT type, version, COUNT(*), SUM(size) FROM subtree GROUP BY type, version", -1, &stmt, nullptr);
+
+    if (sqlResult == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int(stmt, 1, isFile)) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(stmt, 2, sqlite3_int64(h.as8byte()))) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int(stmt, 3, FILENODE)) == SQLITE_OK)
+    {
+        while ((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            auto count = size_t(sqlite3_column_int64(stmt, 2));
+            auto size = m_off_t(sqlite3_column_int64(stmt, 3));
+
+            if (sqlite3_column_int(stmt, 0) == FILENODE)
+            {
+                counts.files += count;
+                counts.storage += size;
+
+                if (sqlite3_column_int(stmt, 1))
+                {
+                    counts.versions += count;
+                    counts.versionStorage += size;
+                }
+            }
+            else if (sqlite3_column_int(stmt, 0) == FOLDERNODE)
+            {
+                counts.folders += count;
+            }
+        }
+    }
+
+    bool ok = sqlResult == SQLITE_DONE;
+
+    if (!ok)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to get node counts from database: " << dbfile << err;
+        assert(!"Unable to get node counts from database.");
+    }
+
+    sqlite3_finalize(stmt);
+
+    return ok;
+}
+
+bool SqliteDbTable::getSubtreeHandles(NodeHandle h, vector<NodeHandle>& handles)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    int sqlResult = sqlite3_prepare_v2(db, "WITH RECURSIVE subtree(nodehandle) AS ( "
+                                           "    SELECT nodehandle FROM nodes WHERE parenthandle = ? "
+                                           "    UNION ALL "
+                                           "    SELECT nodes.nodehandle FROM nodes JOIN subtree ON nodes.parenthandle = subtree.nodehandle) "
+                                           "SELECT nodehandle FROM subtree", -1, &stmt, nullptr);
+
+    if (sqlResult == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(stmt, 1, sqlite3_int64(h.as8byte()))) == SQLITE_OK)
+    {
+        while ((sqlResult = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            handles.push_back(NodeHandle().set6byte(uint64_t(sqlite3_column_int64(stmt, 0))));
+        }
+    }
+
+    bool ok = sqlResult == SQLITE_DONE;
+
+    if (!ok)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to get nodes from database: " << dbfile << err;
+        assert(!"Unable to get nodes from database.");
+    }
+
+    sqlite3_finalize(stmt);
+
+    return ok;
+}
+
+bool SqliteDbTable::getTopNodes(NodeRows& rows)
+{
+    sqlite3_stmt* stmt = nullptr;
+    bool ok = getNodeRows(stmt, "SELECT nodehandle, content FROM nodes WHERE parenthandle NOT IN (SELECT nodehandle FROM nodes)", rows, [](sqlite3_stmt*)
+    {
+        return SQLITE_OK;
+    });
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+// set cursor to first typed node record
+void SqliteDbTable::rewindNodes()
+{
+    if (!db)
+    {
+        return;
+    }
+
+    int result;
+
+    if (mNodesStmt)
+    {
+        result = sqlite3_reset(mNodesStmt);
+    }
+    else
+    {
+        result = sqlite3_prepare_v2(db, "SELECT nodehandle, content FROM nodes", -1, &mNodesStmt, NULL);
+    }
+
+    if (result != SQLITE_OK)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(result));
+        LOG_err << "Unable to rewind nodes: " << dbfile << err;
+        assert(!"Unable to rewind nodes.");
+    }
+}
+
+// retrieve next typed node record through cursor
+bool SqliteDbTable::nextNode(NodeHandle* h, string* content)
+{
+    if (!db || !mNodesStmt)
+    {
+        return false;
+    }
+
+    int rc = sqlite3_step(mNodesStmt);
+
+    if (rc != SQLITE_ROW)
+    {
+        sqlite3_finalize(mNodesStmt);
+        mNodesStmt = NULL;
+
+        if (rc != SQLITE_DONE)
+        {
+            string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(rc));
+            LOG_err << "Unable to get next node from database: " << dbfile << err;
+            assert(!"Unable to get next node from database.");
+        }
+
+        return false;
+    }
+
+    h->set6byte(uint64_t(sqlite3_column_int64(mNodesStmt, 0)));
+
+    const char* blob = static_cast<const char*>(sqlite3_column_blob(mNodesStmt, 1));
+    if (blob)
+    {
+        content->assign(blob, size_t(sqlite3_column_bytes(mNodesStmt, 1)));
+    }
+    else
+    {
+        content->clear();
+    }
+
+    return true;
+}
+
+// add/update the fingerprint of a local file
+bool SqliteDbTable::putFingerprint(const FileColumns& file, const string& crc)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    checkTransaction();
+
+    int sqlResult = SQLITE_OK;
+    if (!mPutFileFingerprintStmt)
+    {
+        sqlResult = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO fingerprints (fsfp, fsid, size, mtime, ctime, crc) "
+                                           "VALUES (?, ?, ?, ?, ?, ?)", -1, &mPutFileFingerprintStmt, nullptr);
+    }
+
+    if (sqlResult == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mPutFileFingerprintStmt, 1, sqlite3_int64(file.fsfp))) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mPutFileFingerprintStmt, 2, sqlite3_int64(file.fsid))) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mPutFileFingerprintStmt, 3, file.size)) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mPutFileFingerprintStmt, 4, file.mtime)) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mPutFileFingerprintStmt, 5, file.ctime)) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_blob(mPutFileFingerprintStmt, 6, crc.data(), int(crc.size()), SQLITE_STATIC)) == SQLITE_OK)
+    {
+        sqlResult = sqlite3_step(mPutFileFingerprintStmt);
+    }
+
+    bool ok = sqlResult == SQLITE_DONE;
+
+    if (!ok)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to put fingerprint into database: " << dbfile << err;
+    }
+
+    sqlite3_reset(mPutFileFingerprintStmt);
+
+    return ok;
+}
+
+// get the fingerprint of a local file, if its metadata is still the same
+bool SqliteDbTable::getFingerprint(const FileColumns& file, string* crc)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    int sqlResult = SQLITE_OK;
+    if (!mGetFileFingerprintStmt)
+    {
+        sqlResult = sqlite3_prepare_v2(db, "SELECT crc FROM fingerprints "
+                                           "WHERE fsfp = ? AND fsid = ? AND size = ? AND mtime = ? AND ctime = ?", -1, &mGetFileFingerprintStmt, nullptr);
+    }
+
+    if (sqlResult == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mGetFileFingerprintStmt, 1, sqlite3_int64(file.fsfp))) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mGetFileFingerprintStmt, 2, sqlite3_int64(file.fsid))) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mGetFileFingerprintStmt, 3, file.size)) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mGetFileFingerprintStmt, 4, file.mtime)) == SQLITE_OK
+            && (sqlResult = sqlite3_bind_int64(mGetFileFingerprintStmt, 5, file.ctime)) == SQLITE_OK)
+    {
+        sqlResult = sqlite3_step(mGetFileFingerprintStmt);
+    }
+
+    bool found = sqlResult == SQLITE_ROW;
+
+    if (found)
+    {
+        // an empty blob reads as NULL
+        const void* blob = sqlite3_column_blob(mGetFileFingerprintStmt, 0);
+        int bytes = sqlite3_column_bytes(mGetFileFingerprintStmt, 0);
+        crc->assign(blob ? static_cast<const char*>(blob) : "", blob ? size_t(bytes) : 0);
+    }
+    else if (sqlResult != SQLITE_DONE)
+    {
+        string err = string(" Error: ") + (sqlite3_errmsg(db) ? sqlite3_errmsg(db) : std::to_string(sqlResult));
+        LOG_err << "Unable to get fingerprint from database: " << dbfile << err;
+    }
+
+    sqlite3_reset(mGetFileFingerprintStmt);
+
+    return found;
+}
 } // namespace
 
 #endif
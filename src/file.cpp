@@ -389,12 +389,20 @@ void File::sendPutnodes(MegaClient* client, UploadHandle fileAttrMatchHandle, co
             }
         }
 
-        client->reqs.add(new CommandPutNodes(client,
-                                             th, NULL,
-                                             mVersioningOption,
-                                             move(newnodes),
-                                             tag,
-                                             source, nullptr, move(completion), canChangeVault));
+        if (l)
+        {
+            client->reqs.add(new CommandPutNodes(client,
+                                                 th, NULL,
+                                                 mVersioningOption,
+                                                 move(newnodes),
+                                                 tag,
+                                                 source, nullptr, move(completion), canChangeVault));
+        }
+        else
+        {
+            // sent along with the other uploads completed to the same folder
+            client->mPutnodesBatcher.add(client, th, mVersioningOption, move(*newnode), tag, source, move(completion), canChangeVault);
+        }
     }
 }
 
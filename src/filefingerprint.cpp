@@ -20,6 +20,7 @@
  */
 
 #include "mega/filesystem.h"
+#include "mega/db.h"
 #include "mega/serialize64.h"
 #include "mega/base64.h"
 #include "mega/logging.h"
@@ -230,6 +231,43 @@ bool FileFingerprint::genfingerprint(FileAccess* fa, bool ignoremtime)
     return changed;
 }
 
+bool FileFingerprint::takefingerprint(const FileFingerprint& generated)
+{
+    bool changed = false;
+
+    if (mtime != generated.mtime)
+    {
+        mtime = generated.mtime;
+        changed = true;
+    }
+
+    if (generated.size < 0)
+    {
+        size = -1;
+        return true;
+    }
+
+    if (size != generated.size)
+    {
+        size = generated.size;
+        changed = true;
+    }
+
+    if (crc != generated.crc)
+    {
+        crc = generated.crc;
+        changed = true;
+    }
+
+    if (!isvalid)
+    {
+        isvalid = true;
+        changed = true;
+    }
+
+    return changed;
+}
+
 bool FileFingerprint::genfingerprint(InputStreamAccess *is, m_time_t cmtime, bool ignoremtime)
 {
     bool changed = false;
@@ -446,4 +484,107 @@ bool operator==(const LightFileFingerprint& lhs, const LightFileFingerprint& rhs
     return std::tie(lhs.mtime, lhs.size) == std::tie(rhs.mtime, rhs.size);
 }
 
+const unsigned LocalFingerprintCache::BATCH_MS;
+
+LocalFingerprintCache::LocalFingerprintCache(std::unique_ptr<DbTable> table)
+    : mTable(std::move(table))
+    , mFingerprints(dynamic_cast<DbTableFingerprints*>(mTable.get()))
+{
+    if (!mFingerprints)
+    {
+        LOG_warn << "Fingerprint cache not supported by the database";
+    }
+}
+
+LocalFingerprintCache::~LocalFingerprintCache()
+{
+    flush();
+}
+
+bool LocalFingerprintCache::genfingerprint(FileFingerprint& f, FileAccess* fa, fsfp_t fsfp)
+{
+    if (!mFingerprints || !fa->fsidvalid || fa->type != FILENODE)
+    {
+        return f.genfingerprint(fa);
+    }
+
+    DbTableFingerprints::FileColumns file;
+    file.fsfp = fsfp;
+    file.fsid = fa->fsid;
+    file.size = fa->size;
+    file.mtime = fa->mtime;
+    file.ctime = fa->ctime;
+
+    FileFingerprint generated;
+    string crc;
+    bool found;
+
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        found = mFingerprints->getFingerprint(file, &crc) && crc.size() == sizeof generated.crc;
+        commitIfDue();
+    }
+
+    if (found)
+    {
+        ++hits;
+
+        generated.size = fa->size;
+        generated.mtime = fa->mtime;
+        memcpy(generated.crc.data(), crc.data(), sizeof generated.crc);
+        generated.isvalid = true;
+
+        return f.takefingerprint(generated);
+    }
+
+    ++misses;
+
+    generated.genfingerprint(fa);
+
+    if (generated.isvalid && generated.size >= 0)
+    {
+        crc.assign(reinterpret_cast<const char*>(generated.crc.data()), sizeof generated.crc);
+
+        std::lock_guard<std::mutex> g(mMutex);
+
+        if (!mTable->inTransaction())
+        {
+            mTable->begin();
+            mTransactionStart = std::chrono::steady_clock::now();
+        }
+
+        if (mFingerprints->putFingerprint(file, crc))
+        {
+            ++mUncommitted;
+        }
+
+        commitIfDue();
+    }
+
+    return f.takefingerprint(generated);
+}
+
+// (with mMutex held)
+void LocalFingerprintCache::commitIfDue()
+{
+    if (mTable->inTransaction()
+            && (mUncommitted >= BATCH
+                || std::chrono::steady_clock::now() - mTransactionStart >= std::chrono::milliseconds(BATCH_MS)))
+    {
+        mTable->commit();
+        mUncommitted = 0;
+    }
+}
+
+void LocalFingerprintCache::flush()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+
+    if (mTable && mTable->inTransaction())
+    {
+        mTable->commit();
+    }
+    mUncommitted = 0;
+}
+
 } // mega
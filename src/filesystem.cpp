@@ -1740,7 +1740,8 @@ ScanService::ScanService(Waiter& waiter)
 
     if (++mNumServices == 1)
     {
-        mWorker.reset(new Worker());
+        // Fingerprinting is read-bound: use every core we have.
+        mWorker.reset(new Worker(std::max(1u, std::thread::hardware_concurrency())));
     }
 }
 
@@ -1764,6 +1765,27 @@ auto ScanService::queueScan(LocalPath targetPath, handle expectedFsid, bool foll
     return request;
 }
 
+auto ScanService::queueFingerprint(LocalPath targetPath, bool followSymLinks, shared_ptr<LocalFingerprintCache> cache, fsfp_t fsfp) -> FingerprintRequestPtr
+{
+    auto request = std::make_shared<FingerprintRequest>(mWaiter, std::move(targetPath), followSymLinks, std::move(cache), fsfp);
+
+    mWorker->queue(request);
+
+    return request;
+}
+
+ScanService::FingerprintRequest::FingerprintRequest(Waiter& waiter, LocalPath targetPath, bool followSymLinks, shared_ptr<LocalFingerprintCache> cache, fsfp_t fsfp)
+    : mTargetPath(std::move(targetPath))
+    , mQueued(Waiter::ds)
+    , mWaiter(waiter)
+    , mFollowSymLinks(followSymLinks)
+    , mCache(std::move(cache))
+    , mFsfp(fsfp)
+    , mCompleted(false)
+    , mCancelled(false)
+{
+}
+
 ScanService::ScanRequest::ScanRequest(Waiter& waiter,
     bool followSymLinks,
     LocalPath targetPath,
@@ -1780,8 +1802,7 @@ ScanService::ScanRequest::ScanRequest(Waiter& waiter,
 }
 
 ScanService::Worker::Worker(size_t numThreads)
-    : mFsAccess(new FSACCESS_CLASS())
-    , mPending()
+    : mPending()
     , mPendingLock()
     , mPendingNotifier()
     , mThreads()
@@ -1834,10 +1855,56 @@ ScanService::Worker::~Worker()
 
 void ScanService::Worker::queue(ScanRequestPtr request)
 {
-    // Queue the request.
+    queue([this, request](FileSystemAccess& fsAccess)
+    {
+        LOG_verbose << "Directory scan begins: " << request->mTargetPath;
+        using namespace std::chrono;
+        auto scanStart = high_resolution_clock::now();
+
+        // Process the request.
+        unsigned nFingerprinted = 0;
+        auto result = scan(fsAccess, request, nFingerprinted);
+        auto scanEnd = high_resolution_clock::now();
+
+        if (result == SCAN_SUCCESS)
+        {
+            LOG_verbose << "Directory scan complete for: " << request->mTargetPath
+                << " entries: " << request->mResults.size()
+                << " taking " << duration_cast<milliseconds>(scanEnd - scanStart).count() << "ms"
+                << " fingerprinted: " << nFingerprinted;
+        }
+        else
+        {
+            LOG_verbose << "Directory scan FAILED (" << result << "): " << request->mTargetPath;
+        }
+
+        request->mScanResult = result;
+        request->mWaiter.notify();
+    });
+}
+
+void ScanService::Worker::queue(FingerprintRequestPtr request)
+{
+    queue([this, request](FileSystemAccess& fsAccess)
+    {
+        if (!request->mCancelled)
+        {
+            fingerprint(fsAccess, request);
+        }
+
+        request->mCompleted = true;
+        request->mWaiter.notify();
+    });
+}
+
+void ScanService::Worker::queue(Job job)
+{
+    assert(job);
+
+    // Queue the job.
     {
         std::unique_lock<std::mutex> lock(mPendingLock);
-        mPending.emplace_back(std::move(request));
+        mPending.emplace_back(std::move(job));
     }
 
     // Tell the lucky thread it has something to do.
@@ -1846,12 +1913,15 @@ void ScanService::Worker::queue(ScanRequestPtr request)
 
 void ScanService::Worker::loop()
 {
+    // Each thread has its own filesystem access.
+    FSACCESS_CLASS fsAccess;
+
     // We're ready when we have some work to do.
     auto ready = [this]() { return mPending.size(); };
 
     for ( ; ; )
     {
-        ScanRequestPtr request;
+        Job job;
 
         {
             // Wait for something to do.
@@ -1865,33 +1935,11 @@ void ScanService::Worker::loop()
                 return;
             }
 
-            request = std::move(mPending.front());
+            job = std::move(mPending.front());
             mPending.pop_front();
         }
 
-        LOG_verbose << "Directory scan begins: " << request->mTargetPath;
-        using namespace std::chrono;
-        auto scanStart = high_resolution_clock::now();
-
-        // Process the request.
-        unsigned nFingerprinted = 0;
-        auto result = scan(request, nFingerprinted);
-        auto scanEnd = high_resolution_clock::now();
-
-        if (result == SCAN_SUCCESS)
-        {
-            LOG_verbose << "Directory scan complete for: " << request->mTargetPath
-                << " entries: " << request->mResults.size()
-                << " taking " << duration_cast<milliseconds>(scanEnd - scanStart).count() << "ms"
-                << " fingerprinted: " << nFingerprinted;
-        }
-        else
-        {
-            LOG_verbose << "Directory scan FAILED (" << result << "): " << request->mTargetPath;
-        }
-
-        request->mScanResult = result;
-        request->mWaiter.notify();
+        job(fsAccess);
     }
 }
 
@@ -1899,11 +1947,11 @@ void ScanService::Worker::loop()
 // regardless of multiple clients too - there is only one filesystem after all (but not singleton!!)
 CodeCounter::ScopeStats ScanService::syncScanTime = { "folderScan" };
 
-auto ScanService::Worker::scan(ScanRequestPtr request, unsigned& nFingerprinted) -> ScanResult
+auto ScanService::Worker::scan(FileSystemAccess& fsAccess, ScanRequestPtr request, unsigned& nFingerprinted) -> ScanResult
 {
     CodeCounter::ScopeTimer rst(syncScanTime);
 
-    auto result = mFsAccess->directoryScan(request->mTargetPath,
+    auto result = fsAccess.directoryScan(request->mTargetPath,
         request->mExpectedFsid,
         request->mKnown,
         request->mResults,
@@ -1916,6 +1964,30 @@ auto ScanService::Worker::scan(ScanRequestPtr request, unsigned& nFingerprinted)
     return result;
 }
 
+void ScanService::Worker::fingerprint(FileSystemAccess& fsAccess, FingerprintRequestPtr request)
+{
+    auto fa = fsAccess.newfileaccess(request->mFollowSymLinks);
+
+    if (!fa->fopen(request->mTargetPath, true, false) || fa->type != FILENODE)
+    {
+        return;
+    }
+
+    request->mIsFile = true;
+    request->mSize = fa->size;
+    request->mMtime = fa->mtime;
+    request->mFsid = fa->fsidvalid ? fa->fsid : UNDEF;
+
+    if (request->mCache)
+    {
+        request->mCache->genfingerprint(request->mFingerprint, fa.get(), request->mFsfp);
+    }
+    else
+    {
+        request->mFingerprint.genfingerprint(fa.get());
+    }
+}
+
 
 } // namespace
 
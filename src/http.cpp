@@ -52,6 +52,129 @@ const int HttpIO::SCREQUESTTIMEOUT = 400;
 // connect timeout (ds)
 const int HttpIO::CONNECTTIMEOUT = 120;
 
+BufferPool g_bufferPool;
+
+// download buffers are padded to the cipher's block size
+static size_t paddedbuflen(size_t len)
+{
+    return (len + SymmCipher::BLOCKSIZE - 1) & ~size_t(SymmCipher::BLOCKSIZE - 1);
+}
+
+size_t BufferPool::classSize(unsigned c)
+{
+    size_t base = MINSIZE << (c / 4);
+    return base + base / 4 * (c % 4) + PADDING;
+}
+
+unsigned BufferPool::sizeClass(size_t size)
+{
+    unsigned c = 0;
+    while (c < NUMCLASSES && classSize(c) < size)
+    {
+        c++;
+    }
+    return c;
+}
+
+byte* BufferPool::get(size_t size)
+{
+    unsigned c = sizeClass(size);
+    if (size < MINSIZE || c == NUMCLASSES)
+    {
+        return new byte[size];
+    }
+
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        if (!mIdle[c].empty())
+        {
+            byte* b = mIdle[c].back();
+            mIdle[c].pop_back();
+            mStats.idleBytes -= classSize(c);
+            mStats.hits++;
+            return b;
+        }
+        mStats.misses++;
+    }
+
+    return new byte[classSize(c)];
+}
+
+void BufferPool::put(byte* b, size_t size)
+{
+    unsigned c = sizeClass(size);
+    if (size >= MINSIZE && c < NUMCLASSES)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        if (mStats.idleBytes + classSize(c) <= mMaxIdleBytes)
+        {
+            mIdle[c].push_back(b);
+            mStats.idleBytes += classSize(c);
+            return;
+        }
+    }
+
+    delete[] b;
+}
+
+void BufferPool::setMaxIdleBytes(size_t bytes)
+{
+    vector<byte*> excess;
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mMaxIdleBytes = bytes;
+
+        // free the largest buffers first
+        for (unsigned c = NUMCLASSES; c-- && mStats.idleBytes > mMaxIdleBytes; )
+        {
+            while (!mIdle[c].empty() && mStats.idleBytes > mMaxIdleBytes)
+            {
+                excess.push_back(mIdle[c].back());
+                mIdle[c].pop_back();
+                mStats.idleBytes -= classSize(c);
+            }
+        }
+    }
+
+    for (byte* b : excess)
+    {
+        delete[] b;
+    }
+}
+
+BufferPool::Stats BufferPool::stats() const
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    return mStats;
+}
+
+string BufferPool::report(bool reset)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    uint64_t total = mStats.hits + mStats.misses;
+
+    std::ostringstream s;
+    s << "transfer buffers reused/allocated: " << mStats.hits << "/" << mStats.misses
+      << " (" << (total ? mStats.hits * 100 / total : 0) << "% hits) idle: " << mStats.idleBytes << " bytes";
+
+    if (reset)
+    {
+        mStats.hits = mStats.misses = 0;
+    }
+    return s.str();
+}
+
+BufferPool::~BufferPool()
+{
+    for (auto& idle : mIdle)
+    {
+        for (byte* b : idle)
+        {
+            delete[] b;
+        }
+    }
+}
+
 #ifdef _WIN32
 const char* mega_inet_ntop(int af, const void* src, char* dst, int cnt)
 {
@@ -402,6 +525,7 @@ void HttpReq::post(MegaClient* client, const char* data, unsigned len)
     outpos = 0;
     notifiedbufpos = 0;
     inpurge = 0;
+    paused = false;
     method = METHOD_POST;
     contentlength = -1;
     lastdata = Waiter::ds;
@@ -425,6 +549,7 @@ void HttpReq::get(MegaClient *client)
     outpos = 0;
     notifiedbufpos = 0;
     inpurge = 0;
+    paused = false;
     method = METHOD_GET;
     contentlength = -1;
     lastdata = Waiter::ds;
@@ -446,6 +571,7 @@ void HttpReq::dns(MegaClient *client)
     outpos = 0;
     notifiedbufpos = 0;
     inpurge = 0;
+    paused = false;
     method = METHOD_NONE;
     contentlength = -1;
     lastdata = Waiter::ds;
@@ -453,6 +579,19 @@ void HttpReq::dns(MegaClient *client)
     httpio->post(this);
 }
 
+void HttpReq::setpaused(bool p)
+{
+    if (paused != p)
+    {
+        paused = p;
+
+        if (httpio)
+        {
+            httpio->setpaused(this, p);
+        }
+    }
+}
+
 void HttpReq::disconnect()
 {
     if (httpio)
@@ -477,6 +616,7 @@ HttpReq::HttpReq(bool b)
     buflen = 0;
     protect = false;
     minspeed = false;
+    paused = false;
 
     init();
 }
@@ -488,7 +628,10 @@ HttpReq::~HttpReq()
         httpio->cancel(this);
     }
 
-    delete[] buf;
+    if (buf)
+    {
+        g_bufferPool.put(buf, paddedbuflen(buflen));
+    }
 }
 
 void HttpReq::init()
@@ -543,14 +686,17 @@ void HttpReq::put(void* data, unsigned len, bool purge)
 }
 
 
-HttpReq::http_buf_t::http_buf_t(byte* b, size_t s, size_t e)
-    : start(s), end(e), buf(b)
+HttpReq::http_buf_t::http_buf_t(byte* b, size_t s, size_t e, size_t c)
+    : start(s), end(e), buf(b), capacity(c)
 {
 }
 
 HttpReq::http_buf_t::~http_buf_t()
 {
-    delete[] buf;
+    if (buf)
+    {
+        g_bufferPool.put(buf, capacity);
+    }
 }
 
 void HttpReq::http_buf_t::swap(http_buf_t& other)
@@ -558,6 +704,7 @@ void HttpReq::http_buf_t::swap(http_buf_t& other)
     byte* tb = buf; buf = other.buf; other.buf = tb;
     size_t ts = start; start = other.start; other.start = ts;
     size_t te = end; end = other.end; other.end = te;
+    size_t tc = capacity; capacity = other.capacity; other.capacity = tc;
 }
 
 bool HttpReq::http_buf_t::isNull()
@@ -579,7 +726,7 @@ size_t HttpReq::http_buf_t::datalen()
 // give up ownership of the buffer for client to use.
 struct HttpReq::http_buf_t* HttpReq::release_buf()
 {
-    HttpReq::http_buf_t* result = new HttpReq::http_buf_t(buf, inpurge, (size_t)bufpos);
+    HttpReq::http_buf_t* result = new HttpReq::http_buf_t(buf, inpurge, (size_t)bufpos, paddedbuflen(buflen));
     buf = NULL;
     inpurge = 0;
     buflen = 0;
@@ -611,7 +758,7 @@ void HttpReq::purge(size_t numbytes)
 // set total response size
 void HttpReq::setcontentlength(m_off_t len)
 {
-    if (!buf && type != REQ_BINARY)
+    if (!buf && type != REQ_BINARY && !mChunked)
     {
         in.reserve(static_cast<size_t>(len));
     }
@@ -690,13 +837,13 @@ void HttpReqDL::prepare(const char* tempurl, SymmCipher* /*key*/,
         // (re)allocate buffer
         if (buf)
         {
-            delete[] buf;
+            g_bufferPool.put(buf, paddedbuflen(buflen));
             buf = NULL;
         }
 
         if (size)
         {
-            buf = new byte[(size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE];
+            buf = g_bufferPool.get(paddedbuflen(size));
         }
         buflen = size;
     }
@@ -760,23 +907,24 @@ bool EncryptByChunks::encrypt(m_off_t pos, m_off_t npos, string& urlSuffix)
     m_off_t finalpos = npos;
     m_off_t endpos = ChunkedHash::chunkceil(startpos, finalpos);
     m_off_t chunksize = endpos - startpos;
+    vector<chunkmac_map::CtrPiece> pieces;
     while (chunksize)
     {
         buf = nextbuffer(unsigned(chunksize));
         if (!buf) return false;
 
-        // The chunk is fully encrypted but finished==false for now,
-        // we only set finished after confirmation of the chunk uploading.
-        macs->ctr_encrypt(startpos, key, buf, unsigned(chunksize), startpos, ctriv, false);
-
-        LOG_debug << "Encrypted chunk: " << startpos << " - " << endpos << "   Size: " << chunksize;
+        pieces.push_back({ startpos, buf, unsigned(chunksize), startpos });
 
-        updateCRC(buf, unsigned(chunksize), unsigned(startpos - pos));
+        if (!buffersPersist() || pieces.size() >= SymmCipher::MAXLANES)
+        {
+            encryptPieces(pieces, pos);
+        }
 
         startpos = endpos;
         endpos = ChunkedHash::chunkceil(startpos, finalpos);
         chunksize = endpos - startpos;
     }
+    encryptPieces(pieces, pos);
     assert(endpos == finalpos);
     buf = nextbuffer(0);   // last call in case caller does buffer post-processing (such as write to file as we go)
 
@@ -788,6 +936,27 @@ bool EncryptByChunks::encrypt(m_off_t pos, m_off_t npos, string& urlSuffix)
 }
 
 
+void EncryptByChunks::encryptPieces(vector<chunkmac_map::CtrPiece>& pieces, m_off_t pos)
+{
+    if (pieces.empty())
+    {
+        return;
+    }
+
+    // The chunks are fully encrypted but finished==false for now,
+    // we only set finished after confirmation of the chunk uploading.
+    macs->ctr_encrypt(pieces, key, ctriv, false);
+
+    for (auto& p : pieces)
+    {
+        LOG_debug << "Encrypted chunk: " << p.startpos << " - " << p.startpos + p.chunksize << "   Size: " << p.chunksize;
+
+        updateCRC(p.chunkstart, p.chunksize, unsigned(p.startpos - pos));
+    }
+
+    pieces.clear();
+}
+
 EncryptBufferByChunks::EncryptBufferByChunks(byte* b, SymmCipher* k, chunkmac_map* m, uint64_t iv)
     : EncryptByChunks(k, m, iv)
     , chunkstart(b)
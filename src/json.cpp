@@ -1048,5 +1048,226 @@ string JSONWriter::escape(const char* data, size_t length) const
     return result;
 }
 
-} // namespace
+void JSONSplitter::clear()
+{
+    mPath.clear();
+    mName.clear();
+    mLevels.clear();
+    mElement.clear();
+    mPos = 0;
+    mStarted = false;
+    mFinished = false;
+    mFailed = false;
+}
+
+// returns the offset just past the closing quote of the string starting at data[pos],
+// or string::npos if it hasn't arrived yet
+static size_t stringEnd(const char* data, size_t pos, size_t len)
+{
+    for (pos++; pos < len; pos++)
+    {
+        if (data[pos] == '\\')
+        {
+            pos++;
+        }
+        else if (data[pos] == '"')
+        {
+            return pos + 1;
+        }
+    }
+    return string::npos;
+}
+
+size_t JSONSplitter::processChunk(const FilterMap& filters, const char* data, size_t len)
+{
+    if (mFinished || mFailed)
+    {
+        return len;
+    }
+
+    if (!mStarted)
+    {
+        mStarted = true;
+
+        auto it = filters.find("<");
+        JSON json("");
+        if (it != filters.end() && !it->second(&json))
+        {
+            mFailed = true;
+            return len;
+        }
+    }
+
+    while (mPos < len && !mFinished)
+    {
+        char c = data[mPos];
+        Level* level = mLevels.empty() ? nullptr : &mLevels.back();
+
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ':')
+        {
+            mPos++;
+        }
+        else if (c == ',')
+        {
+            if (level && level->object)
+            {
+                level->expectName = true;
+            }
+            mPos++;
+        }
+        else if (c == '}' || c == ']')
+        {
+            if (!level || level->object != (c == '}'))
+            {
+                LOG_err << "Parse error (unexpected " << c << ") at " << mPath;
+                mFailed = true;
+                break;
+            }
+
+            Level ended = *level;
+            mLevels.pop_back();
+            mPos++;
+
+            mPath.resize(ended.pathLength);
+            if (!endElement(filters, data, ended.start, mPos, ended.filtered, ended.split, ended.object))
+            {
+                break;
+            }
+            mPath.resize(mLevels.empty() ? 0 : mLevels.back().pathLength);
+            mFinished = mLevels.empty();
+        }
+        else if (level && level->expectName)
+        {
+            size_t end;
+            if (c != '"')
+            {
+                LOG_err << "Parse error (member name expected) at " << mPath;
+                mFailed = true;
+                break;
+            }
+            if ((end = stringEnd(data, mPos, len)) == string::npos)
+            {
+                break;
+            }
+
+            mName.assign(data + mPos + 1, end - mPos - 2);
+            level->expectName = false;
+            mPos = end;
+        }
+        else
+        {
+            size_t parentLength = mPath.size();
+
+            if (c == '{' || c == '[')
+            {
+                mPath.push_back(c);
+                if (level && level->object)
+                {
+                    mPath.append(mName);
+                }
+
+                mLevels.push_back(Level{mPath.size(), mPos, filters.find(mPath) != filters.end(), false, c == '{', c == '{'});
+                mPos++;
+                continue;
+            }
+
+            size_t end;
+            if (c == '"')
+            {
+                end = stringEnd(data, mPos, len);
+            }
+            else
+            {
+                end = mPos;
+                while (end < len && !strchr(",:]} \t\r\n", data[end]))
+                {
+                    end++;
+                }
+                if (end == len)
+                {
+                    // can't tell if it's complete until the delimiter arrives
+                    end = string::npos;
+                }
+            }
+
+            if (end == string::npos)
+            {
+                break;
+            }
+
+            mPath.push_back(c == '"' ? '"' : '#');
+            if (level && level->object)
+            {
+                mPath.append(mName);
+            }
+
+            if (!endElement(filters, data, mPos, end, filters.find(mPath) != filters.end(), false, false))
+            {
+                break;
+            }
+
+            mPath.resize(parentLength);
+            mPos = end;
+            mFinished = mLevels.empty();
+        }
+    }
+
+    if (mFailed || mFinished)
+    {
+        return len;
+    }
+
+    // keep everything from the start of the outermost element still wanted whole by a filter
+    size_t keep = mPos;
+    for (const Level& level : mLevels)
+    {
+        if (level.filtered && !level.split)
+        {
+            keep = level.start;
+            break;
+        }
+    }
+
+    for (Level& level : mLevels)
+    {
+        level.start = level.start > keep ? level.start - keep : 0;
+    }
+    mPos -= keep;
+
+    return keep;
+}
+
+bool JSONSplitter::endElement(const FilterMap& filters, const char* data, size_t start, size_t end, bool filtered, bool split, bool object)
+{
+    if (!filtered)
+    {
+        return true;
+    }
+
+    if (split)
+    {
+        mElement = object ? "{}" : "[]";
+    }
+    else
+    {
+        mElement.assign(data + start, end - start);
+    }
+
+    JSON json(mElement);
+    if (!filters.at(mPath)(&json))
+    {
+        LOG_err << "Parse error (filter failed) at " << mPath;
+        mFailed = true;
+        return false;
+    }
 
+    // the enclosing elements can't be given whole anymore
+    for (Level& level : mLevels)
+    {
+        level.split = true;
+    }
+
+    return true;
+}
+
+} // namespace
@@ -2689,6 +2689,11 @@ void MegaApi::fetchNodes(MegaRequestListener *listener)
     pImpl->fetchNodes(listener);
 }
 
+void MegaApi::setNodesMemoryBudget(long long bytes)
+{
+    pImpl->setNodesMemoryBudget(bytes);
+}
+
 void MegaApi::getCloudStorageUsed(MegaRequestListener *listener)
 {
     pImpl->getCloudStorageUsed(listener);
@@ -3307,6 +3312,11 @@ void MegaApi::setStreamingMinimumRate(int bytesPerSecond)
     pImpl->setStreamingMinimumRate(bytesPerSecond);
 }
 
+void MegaApi::setStreamingCacheSize(long long bytes)
+{
+    pImpl->setStreamingCacheSize(bytes);
+}
+
 #ifdef ENABLE_SYNC
 
 //Move local files inside synced folders to the "Rubbish" folder.
@@ -3900,6 +3910,11 @@ void MegaApi::setPublicKeyPinning(bool enable)
     pImpl->setPublicKeyPinning(enable);
 }
 
+void MegaApi::setHttpMultiplexing(bool enable, int maxConnectionsPerHost)
+{
+    pImpl->setHttpMultiplexing(enable, maxConnectionsPerHost);
+}
+
 void MegaApi::pauseActionPackets()
 {
     pImpl->pauseActionPackets();
@@ -4181,6 +4196,11 @@ MegaNodeList *MegaApi::getChildren(MegaNodeList *parentNodes, int order)
     return pImpl->getChildren(parentNodes, order);
 }
 
+MegaNodeList *MegaApi::getChildrenPage(MegaNode* p, int order, int offset, int limit)
+{
+    return pImpl->getChildrenPage(p, order, offset, limit);
+}
+
 MegaNodeList *MegaApi::getVersions(MegaNode *node)
 {
     return pImpl->getVersions(node);
@@ -4331,6 +4351,11 @@ MegaApiLock* MegaApi::getMegaApiLock(bool lockNow)
     return new MegaApiLock(pImpl, lockNow);
 }
 
+MegaStringMap* MegaApi::getMutexStats()
+{
+    return pImpl->getMutexStats();
+}
+
 bool MegaApi::platformSetRLimitNumFile(int newNumFileLimit) const
 {
     return mega::platformSetRLimitNumFile(newNumFileLimit);
@@ -4363,9 +4388,9 @@ void MegaApi::getCountryCallingCodes(MegaRequestListener *listener)
 
 
 #ifdef HAVE_LIBUV
-bool MegaApi::httpServerStart(bool localOnly, int port, bool useTLS, const char * certificatepath, const char * keypath, bool useIPv6)
+bool MegaApi::httpServerStart(bool localOnly, int port, bool useTLS, const char * certificatepath, const char * keypath, bool useIPv6, int numThreads)
 {
-    return pImpl->httpServerStart(localOnly, port, useTLS, certificatepath, keypath, useIPv6);
+    return pImpl->httpServerStart(localOnly, port, useTLS, certificatepath, keypath, useIPv6, numThreads);
 }
 
 void MegaApi::httpServerStop()
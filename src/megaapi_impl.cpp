@@ -2437,6 +2437,16 @@ char * MegaTransferPrivate::getLastBytes() const
     return lastBytes;
 }
 
+const std::shared_ptr<void>& MegaTransferPrivate::getLastBytesOwner() const
+{
+    return lastBytesOwner;
+}
+
+bool MegaTransferPrivate::isStreamingPaused() const
+{
+    return streamingPaused;
+}
+
 MegaError MegaTransferPrivate::getLastError() const
 {
     return lastError ? *lastError.get() : MegaTransfer::getLastError();
@@ -2798,6 +2808,18 @@ void MegaTransferPrivate::setTotalBytes(long long totalBytes)
 void MegaTransferPrivate::setLastBytes(char *lastBytes)
 {
     this->lastBytes = lastBytes;
+    lastBytesOwner.reset();
+}
+
+void MegaTransferPrivate::setLastBytes(char *lastBytes, const std::shared_ptr<void>& owner)
+{
+    this->lastBytes = lastBytes;
+    lastBytesOwner = owner;
+}
+
+void MegaTransferPrivate::setStreamingPaused(bool paused)
+{
+    streamingPaused = paused;
 }
 
 void MegaTransferPrivate::setLastError(const MegaError *e)
@@ -4333,6 +4355,16 @@ MegaNodeListPrivate::MegaNodeListPrivate(Node** newlist, int size)
         list[i] = MegaNodePrivate::fromNode(newlist[i]);
 }
 
+MegaNodeListPrivate::MegaNodeListPrivate(vector<std::unique_ptr<MegaNode>>&& nodes)
+{
+    list = NULL; s = int(nodes.size());
+    if(!s) return;
+
+    list = new MegaNode*[s];
+    for(int i=0; i<s; i++)
+        list[i] = nodes[i].release();
+}
+
 MegaNodeListPrivate::MegaNodeListPrivate(const MegaNodeListPrivate *nodeList, bool copyChildren)
 {
     s = nodeList->size();
@@ -4421,6 +4453,51 @@ void MegaNodeListPrivate::addNode(MegaNode *node)
     }
 }
 
+MegaNodeListLazyPrivate::MegaNodeListLazyPrivate(MegaApiImpl* api, vector<MegaHandle>&& handles)
+    : mApi(api)
+    , mHandles(std::move(handles))
+    , mNodes(mHandles.size())
+{
+}
+
+MegaNodeList *MegaNodeListLazyPrivate::copy() const
+{
+    MegaNodeListLazyPrivate* list = new MegaNodeListLazyPrivate(mApi, vector<MegaHandle>(mHandles));
+    for (size_t i = 0; i < mNodes.size(); i++)
+    {
+        if (mNodes[i])
+        {
+            list->mNodes[i].reset(mNodes[i]->copy());
+        }
+    }
+    return list;
+}
+
+MegaNode *MegaNodeListLazyPrivate::get(int i) const
+{
+    if (i < 0 || i >= size())
+    {
+        return NULL;
+    }
+
+    if (!mNodes[i])
+    {
+        mNodes[i].reset(mApi->getNodeByHandle(mHandles[i]));
+    }
+    return mNodes[i].get();
+}
+
+int MegaNodeListLazyPrivate::size() const
+{
+    return int(mHandles.size());
+}
+
+void MegaNodeListLazyPrivate::addNode(MegaNode *node)
+{
+    mHandles.push_back(node->getHandle());
+    mNodes.emplace_back(node->copy());
+}
+
 MegaUserListPrivate::MegaUserListPrivate()
 {
     list = NULL;
@@ -7062,6 +7139,13 @@ void MegaApiImpl::fetchNodes(MegaRequestListener *listener)
     waiter->notify();
 }
 
+void MegaApiImpl::setNodesMemoryBudget(long long bytes)
+{
+    SdkMutexGuard g(sdkMutex);
+    client->mNodesOnDemand = bytes > 0;
+    client->setNodesMemoryBudget(bytes > 0 ? static_cast<size_t>(bytes) : 0);
+}
+
 void MegaApiImpl::getPricing(MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PRICING, listener);
@@ -8543,6 +8627,21 @@ void MegaApiImpl::setStreamingMinimumRate(int bytesPerSecond)
     client->minstreamingrate = bytesPerSecond;
 }
 
+void MegaApiImpl::setStreamingCacheSize(long long bytes)
+{
+    SdkMutexGuard g(sdkMutex);
+    client->directReadCache.setMaxBytes(bytes > 0 ? size_t(bytes) : 0);
+}
+
+void MegaApiImpl::pauseStreaming(MegaTransferPrivate* transfer, bool pause)
+{
+    transfer->setStreamingPaused(pause);
+    if (!pause)
+    {
+        waiter->notify();
+    }
+}
+
 void MegaApiImpl::retryTransfer(MegaTransfer *transfer, MegaTransferListener *listener)
 {
     MegaTransferPrivate *t = dynamic_cast<MegaTransferPrivate*>(transfer);
@@ -9385,7 +9484,7 @@ bool MegaApiImpl::isOnline()
 }
 
 #ifdef HAVE_LIBUV
-bool MegaApiImpl::httpServerStart(bool localOnly, int port, bool useTLS, const char *certificatepath, const char *keypath, bool useIPv6)
+bool MegaApiImpl::httpServerStart(bool localOnly, int port, bool useTLS, const char *certificatepath, const char *keypath, bool useIPv6, int numThreads)
 {
     #ifndef ENABLE_EVT_TLS
     if (useTLS)
@@ -9418,6 +9517,7 @@ bool MegaApiImpl::httpServerStart(bool localOnly, int port, bool useTLS, const c
     httpServer->enableFolderServer(httpServerEnableFolders);
     httpServer->setRestrictedMode(httpServerRestrictedMode);
     httpServer->enableSubtitlesSupport(httpServerRestrictedMode);
+    httpServer->setNumLoops(numThreads);
 
     bool result = httpServer->start(port, localOnly);
     if (!result)
@@ -11210,7 +11310,8 @@ bool MegaApiImpl::processMegaTree(MegaNode* n, MegaTreeProcessor* processor, boo
 
     if (node->type != FILENODE)
     {
-        for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
+        client->pageInChildren(node);
+        for (NodeChildren::iterator it = node->children.begin(); it != node->children.end(); )
         {
             MegaNode *megaNode = MegaNodePrivate::fromNode(*it++);
             if (recursive)
@@ -11265,36 +11366,21 @@ MegaNodeList *MegaApiImpl::search(const char *searchString, CancelToken cancelTo
         return new MegaNodeListPrivate();
     }
 
-    node_vector result;
-    Node *node;
-
     // rootnodes
-    auto searchRoot = [&](NodeHandle root)
-    {
-        node = client->nodeByHandle(root);
-        SearchTreeProcessor searchProcessor(client, searchString, type);
-        processTree(node, &searchProcessor, true, cancelToken);
-        node_vector& vNodes = searchProcessor.getResults();
-        result.insert(result.end(), vNodes.begin(), vNodes.end());
-    };
-
-    if (!cancelToken.isCancelled()) searchRoot(client->rootnodes.files);
-    if (!cancelToken.isCancelled()) searchRoot(client->rootnodes.vault);
-    if (!cancelToken.isCancelled()) searchRoot(client->rootnodes.rubbish);
+    node_vector tops;
+    tops.push_back(client->nodeByHandle(client->rootnodes.files));
+    tops.push_back(client->nodeByHandle(client->rootnodes.vault));
+    tops.push_back(client->nodeByHandle(client->rootnodes.rubbish));
 
     // inshares
     unique_ptr<MegaShareList> shares(getInSharesList(MegaApi::ORDER_NONE));
-    for (int i = 0; i < shares->size() && !cancelToken.isCancelled(); i++)
+    for (int i = 0; i < shares->size(); i++)
     {
-        node = client->nodebyhandle(shares->get(i)->getNodeHandle());
-
-        SearchTreeProcessor searchProcessor(client, searchString, type);
-        processTree(node, &searchProcessor, true, cancelToken);
-        vector<Node *>& vNodes  = searchProcessor.getResults();
-
-        result.insert(result.end(), vNodes.begin(), vNodes.end());
+        tops.push_back(client->nodebyhandle(shares->get(i)->getNodeHandle()));
     }
 
+    node_vector result = nodesByHandle(searchNodes(g, tops, true, true, searchString, type, cancelToken));
+
     sortByComparatorFunction(result, order, *client);
     MegaNodeList *nodeList = new MegaNodeListPrivate(result.data(), int(result.size()));
 
@@ -11721,6 +11807,12 @@ void MegaApiImpl::setPublicKeyPinning(bool enable)
     client->httpio->disablepkp = !enable;
 }
 
+void MegaApiImpl::setHttpMultiplexing(bool enable, int maxConnectionsPerHost)
+{
+    SdkMutexGuard g(sdkMutex);
+    client->httpio->setmultiplexing(enable, maxConnectionsPerHost > 0 ? unsigned(maxConnectionsPerHost) : 0);
+}
+
 void MegaApiImpl::pauseActionPackets()
 {
     sdkMutex.lock();
@@ -11769,7 +11861,8 @@ bool MegaApiImpl::processTree(Node* node, TreeProcessor* processor, bool recursi
 
     if (recursive && node->type != FILENODE)
     {
-        for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
+        client->pageInChildren(node);
+        for (NodeChildren::iterator it = node->children.begin(); it != node->children.end(); )
         {
             if (!processTree(*it++, processor, recursive, cancelToken))
             {
@@ -11782,6 +11875,164 @@ bool MegaApiImpl::processTree(Node* node, TreeProcessor* processor, bool recursi
     return result;
 }
 
+vector<NodeHandle> MegaApiImpl::searchNodes(SdkMutexGuard& guard, const node_vector& tops, bool includeTops, bool recursive,
+                                            const char* searchString, int type, CancelToken cancelToken)
+{
+    SearchTreeProcessor searchProcessor(client, searchString, type);
+
+    auto results = [&searchProcessor]()
+    {
+        vector<NodeHandle> handles;
+        handles.reserve(searchProcessor.getResults().size());
+        for (Node* n : searchProcessor.getResults())
+        {
+            handles.push_back(n->nodeHandle());
+        }
+        return handles;
+    };
+
+    uint8_t categories = 0;
+    switch (type)
+    {
+        case MegaApi::FILE_TYPE_PHOTO:      categories = NodeSearchIndex::PHOTO;    break;
+        case MegaApi::FILE_TYPE_AUDIO:      categories = NodeSearchIndex::AUDIO;    break;
+        case MegaApi::FILE_TYPE_VIDEO:      categories = NodeSearchIndex::VIDEO;    break;
+        case MegaApi::FILE_TYPE_DOCUMENT:   categories = NodeSearchIndex::DOCUMENT; break;
+    }
+
+    if (recursive && (searchString || categories) && client->mSearchIndex.complete())
+    {
+        // how many times each top is searched, as a node below several of them is found
+        // once per top
+        std::unordered_map<Node*, int> topCount;
+        for (Node* top : tops)
+        {
+            if (top)
+            {
+                topCount[top]++;
+            }
+        }
+        auto timesSearched = [&topCount](Node* n)
+        {
+            auto it = topCount.find(n);
+            return it == topCount.end() ? 0 : it->second;
+        };
+
+        for (NodeHandle h : client->mSearchIndex.find(searchString, false, categories))
+        {
+            if (cancelToken.isCancelled())
+            {
+                break;
+            }
+
+            Node* n = client->nodeByHandle(h);
+            if (!n)
+            {
+                continue;
+            }
+
+            // the tops processTree() would reach the node from: it doesn't go into files
+            // (file versions), unless the top is a file searched without itself
+            int count = includeTops ? timesSearched(n) : 0;
+            bool belowFile = false;
+            for (Node* p = n->parent; p; p = p->parent)
+            {
+                if (!belowFile && (p->type != FILENODE || !includeTops))
+                {
+                    count += timesSearched(p);
+                }
+                belowFile |= p->type == FILENODE;
+            }
+
+            // checked again on the node, for what the index doesn't know (media attributes)
+            while (count--)
+            {
+                searchProcessor.processNode(n);
+            }
+        }
+        return results();
+    }
+
+    shared_ptr<const NodeNameSnapshot> snapshot;
+    vector<NodeNameSnapshot::Range> ranges;
+    if (searchString && recursive)
+    {
+        snapshot = client->nameSnapshot();
+        for (Node* top : tops)
+        {
+            NodeNameSnapshot::Range range;
+            if (!top)
+            {
+                continue;
+            }
+            if (!snapshot->subtree(top->nodeHandle(), range))
+            {
+                // not below a root node or an inshare
+                snapshot.reset();
+                break;
+            }
+            if (!includeTops)
+            {
+                range.second--;
+            }
+            ranges.push_back(range);
+        }
+    }
+
+    if (!snapshot)
+    {
+        for (Node* top : tops)
+        {
+            if (!top || cancelToken.isCancelled())
+            {
+                continue;
+            }
+
+            if (includeTops)
+            {
+                processTree(top, &searchProcessor, recursive, cancelToken);
+                continue;
+            }
+
+            client->pageInChildren(top);
+            for (NodeChildren::iterator it = top->children.begin(); it != top->children.end()
+                 && !cancelToken.isCancelled(); )
+            {
+                processTree(*it++, &searchProcessor, recursive, cancelToken);
+            }
+        }
+        return results();
+    }
+
+    guard.unlock();
+    NodeNameSnapshot::Matches matches = snapshot->search(ranges, searchString, cancelToken);
+    guard.lock();
+
+    // the nodes may have changed meanwhile: they are checked again, as they are now
+    for (auto it = matches.begin(); it != matches.end() && !cancelToken.isCancelled(); ++it)
+    {
+        if (Node* n = client->nodeByHandle(*it))
+        {
+            searchProcessor.processNode(n);
+        }
+    }
+    return results();
+}
+
+node_vector MegaApiImpl::nodesByHandle(const vector<NodeHandle>& handles)
+{
+    node_vector nodes;
+    nodes.reserve(handles.size());
+    for (NodeHandle h : handles)
+    {
+        if (Node* n = client->nodeByHandle(h))
+        {
+            nodes.push_back(n);
+        }
+    }
+    return nodes;
+}
+
 MegaNodeList* MegaApiImpl::search(MegaNode *n, const char* searchString, CancelToken cancelToken, bool recursive, int order, int type, int target)
 {
     if (!n && !searchString && (type < MegaApi::FILE_TYPE_PHOTO || type > MegaApi::FILE_TYPE_DOCUMENT))
@@ -11824,21 +12075,14 @@ MegaNodeList* MegaApiImpl::search(MegaNode *n, const char* searchString, CancelT
         }
 
         // searchString and nodeType (if provided), are considered in search
-        SearchTreeProcessor searchProcessor(client, searchString, type);
-        for (node_list::iterator it = node->children.begin(); it != node->children.end()
-             && !cancelToken.isCancelled(); )
-        {
-            processTree(*it++, &searchProcessor, recursive, cancelToken);
-        }
-
-        vector<Node *>& vNodes = searchProcessor.getResults();
+        node_vector vNodes = nodesByHandle(searchNodes(g, node_vector{node}, false, recursive, searchString, type, cancelToken));
         sortByComparatorFunction(vNodes, order, *client);
         nodeList = new MegaNodeListPrivate(vNodes.data(), int(vNodes.size()));
     }
     else
     {
-        node_vector result;
-        Node *node;
+        // the nodes are looked up after all the searches, that may release sdkMutex
+        vector<NodeHandle> found;
 
         // Target parameter is only considered if node is not provided
         if (target < MegaApi::SEARCH_TARGET_INSHARE || target > MegaApi::SEARCH_TARGET_ALL)
@@ -11849,37 +12093,33 @@ MegaNodeList* MegaApiImpl::search(MegaNode *n, const char* searchString, CancelT
         if (target == MegaApi::SEARCH_TARGET_ROOTNODE || target == MegaApi::SEARCH_TARGET_ALL)
         {
             // Search on rootnode (Cloud and Vault, excludes Rubbish)
-            node = client->nodeByHandle(client->rootnodes.files);
-            SearchTreeProcessor searchProcessor(client, searchString, type);
-            processTree(node, &searchProcessor, recursive, cancelToken);
+            node_vector tops{client->nodeByHandle(client->rootnodes.files)};
 
             // also consider Vault, since backups are in there
-            node = client->nodeByHandle(client->rootnodes.vault);
-            processTree(node, &searchProcessor, recursive, cancelToken);
+            tops.push_back(client->nodeByHandle(client->rootnodes.vault));
 
-            node_vector& vNodes = searchProcessor.getResults();
-            result.insert(result.end(), vNodes.begin(), vNodes.end());
+            vector<NodeHandle> vNodes = searchNodes(g, tops, true, recursive, searchString, type, cancelToken);
+            found.insert(found.end(), vNodes.begin(), vNodes.end());
         }
 
         if (target == MegaApi::SEARCH_TARGET_INSHARE || target == MegaApi::SEARCH_TARGET_ALL)
         {
             // Search on inshares
+            node_vector tops;
             unique_ptr<MegaShareList> shares(getInSharesList(MegaApi::ORDER_NONE));
-            for (int i = 0; i < shares->size() && !cancelToken.isCancelled(); i++)
+            for (int i = 0; i < shares->size(); i++)
             {
-                node = client->nodebyhandle(shares->get(i)->getNodeHandle());
-
-                SearchTreeProcessor searchProcessor(client, searchString, type);
-                processTree(node, &searchProcessor, recursive, cancelToken);
-                vector<Node *>& vNodes  = searchProcessor.getResults();
-
-                result.insert(result.end(), vNodes.begin(), vNodes.end());
+                tops.push_back(client->nodebyhandle(shares->get(i)->getNodeHandle()));
             }
+
+            vector<NodeHandle> vNodes = searchNodes(g, tops, true, recursive, searchString, type, cancelToken);
+            found.insert(found.end(), vNodes.begin(), vNodes.end());
         }
 
         if (target == MegaApi::SEARCH_TARGET_OUTSHARE)
         {
             // Search on outshares
+            node_vector tops;
             std::set<MegaHandle> outsharesHandles;
             unique_ptr<MegaShareList>shares (getOutShares(MegaApi::ORDER_NONE));
             for (int i = 0; i < shares->size() && !cancelToken.isCancelled(); i++)
@@ -11891,30 +12131,27 @@ MegaNodeList* MegaApiImpl::search(MegaNode *n, const char* searchString, CancelT
                     continue;   // avoid duplicates
                 }
                 outsharesHandles.insert(h);
-                node = client->nodebyhandle(shares->get(i)->getNodeHandle());
-
-                SearchTreeProcessor searchProcessor(client, searchString, type);
-                processTree(node, &searchProcessor, recursive, cancelToken);
-                vector<Node *>& vNodes  = searchProcessor.getResults();
-
-                result.insert(result.end(), vNodes.begin(), vNodes.end());
+                tops.push_back(client->nodebyhandle(shares->get(i)->getNodeHandle()));
             }
+
+            vector<NodeHandle> vNodes = searchNodes(g, tops, true, recursive, searchString, type, cancelToken);
+            found.insert(found.end(), vNodes.begin(), vNodes.end());
         }
 
         if (target == MegaApi::SEARCH_TARGET_PUBLICLINK)
         {
             // Search on public links
-            for (auto it = client->mPublicLinks.begin(); it != client->mPublicLinks.end()
-                 && !cancelToken.isCancelled(); it++)
+            node_vector tops;
+            for (auto it = client->mPublicLinks.begin(); it != client->mPublicLinks.end(); it++)
             {
-                node = client->nodebyhandle(it->first);
-                SearchTreeProcessor searchProcessor(client, searchString, type);
-                processTree(node, &searchProcessor, true, cancelToken);
-                vector<Node *>& vNodes  = searchProcessor.getResults();
-                result.insert(result.end(), vNodes.begin(), vNodes.end());
+                tops.push_back(client->nodebyhandle(it->first));
             }
+
+            vector<NodeHandle> vNodes = searchNodes(g, tops, true, true, searchString, type, cancelToken);
+            found.insert(found.end(), vNodes.begin(), vNodes.end());
         }
 
+        node_vector result = nodesByHandle(found);
         sortByComparatorFunction(result, order, *client);
         nodeList = new MegaNodeListPrivate(result.data(), int(result.size()));
     }
@@ -11944,9 +12181,9 @@ long long MegaApiImpl::getSize(MegaNode *n)
         sdkMutex.unlock();
         return 0;
     }
-    SizeProcessor sizeProcessor;
-    processTree(node, &sizeProcessor, true, CancelToken());
-    long long result = sizeProcessor.getTotalBytes();
+    // the size of the current versions of the files
+    NodeCounter nc = node->subnodeCounts();
+    long long result = nc.storage - nc.versionStorage;
     sdkMutex.unlock();
 
     return result;
@@ -12219,7 +12456,7 @@ MegaNode *MegaApiImpl::getNodeByCRC(const char *crc, MegaNode *parent)
     byte binarycrc[sizeof(node->crc)];
     Base64::atob(crc, binarycrc, sizeof(binarycrc));
 
-    for (node_list::iterator it = node->children.begin(); it != node->children.end(); it++)
+    for (NodeChildren::iterator it = node->children.begin(); it != node->children.end(); it++)
     {
         Node *child = (*it);
         if(!memcmp(child->crc.data(), binarycrc, sizeof(node->crc)))
@@ -12321,23 +12558,6 @@ vector<Node *> &SearchTreeProcessor::getResults()
     return mResults;
 }
 
-SizeProcessor::SizeProcessor()
-{
-    totalBytes=0;
-}
-
-bool SizeProcessor::processNode(Node *node)
-{
-    if(node->type == FILENODE)
-        totalBytes += node->size;
-    return true;
-}
-
-long long SizeProcessor::getTotalBytes()
-{
-    return totalBytes;
-}
-
 void MegaApiImpl::file_added(File *f)
 {
     Transfer *t = f->transfer;
@@ -12592,7 +12812,12 @@ dstime MegaApiImpl::pread_failure(const Error &e, int retry, void* param, dstime
     }
 }
 
-bool MegaApiImpl::pread_data(byte *buffer, m_off_t len, m_off_t, m_off_t speed, m_off_t meanSpeed, void* param)
+bool MegaApiImpl::pread_data(byte *buffer, m_off_t len, m_off_t pos, m_off_t speed, m_off_t meanSpeed, void* param)
+{
+    return pread_piece(buffer, len, pos, speed, meanSpeed, param, nullptr);
+}
+
+bool MegaApiImpl::pread_piece(byte *buffer, m_off_t len, m_off_t, m_off_t speed, m_off_t meanSpeed, void* param, const std::shared_ptr<void>& owner)
 {
     MegaTransferPrivate *transfer = (MegaTransferPrivate *)param;
     dstime currentTime = Waiter::ds;
@@ -12600,7 +12825,7 @@ bool MegaApiImpl::pread_data(byte *buffer, m_off_t len, m_off_t, m_off_t speed,
     transfer->setState(MegaTransfer::STATE_ACTIVE);
     transfer->setUpdateTime(currentTime);
     transfer->setDeltaSize(len);
-    transfer->setLastBytes((char *)buffer);
+    transfer->setLastBytes((char *)buffer, owner);
     transfer->setTransferredBytes(transfer->getTransferredBytes() + len);
     transfer->setSpeed(speed);
     transfer->setMeanSpeed(meanSpeed);
@@ -12616,6 +12841,11 @@ bool MegaApiImpl::pread_data(byte *buffer, m_off_t len, m_off_t, m_off_t speed,
     return true;
 }
 
+bool MegaApiImpl::pread_paused(void* param)
+{
+    return static_cast<MegaTransferPrivate*>(param)->isStreamingPaused();
+}
+
 void MegaApiImpl::reportevent_result(error e)
 {
     if(requestMap.find(client->restag) == requestMap.end()) return;
@@ -13541,6 +13771,9 @@ void MegaApiImpl::unlinkversions_result(error e)
 
 void MegaApiImpl::fetchnodes_result(const Error &e)
 {
+    // nodes were not notified while they were being fetched
+    publishedNodes.clear();
+
     MegaRequestPrivate* request = NULL;
     if (!client->restag)
     {
@@ -14188,6 +14421,8 @@ void MegaApiImpl::copysession_result(string *session, error e)
 
 void MegaApiImpl::clearing()
 {
+    publishedNodes.clear();
+
 #ifdef ENABLE_SYNC
     mCachedMegaSyncPrivate.reset();
 #endif
@@ -14768,6 +15003,12 @@ void MegaApiImpl::openfilelink_result(handle ph, const byte* key, m_off_t size,
     }
 }
 
+// a node was queued for notification
+void MegaApiImpl::node_pending(Node* n)
+{
+    publishedNodes.pending(n);
+}
+
 // reload needed
 void MegaApiImpl::reload(const char*)
 {
@@ -14785,6 +15026,20 @@ void MegaApiImpl::nodes_updated(Node** n, int count)
         return;
     }
 
+    // drop what the app could otherwise still read after being notified
+    if (n != NULL)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            publishedNodes.invalidate(n[i]);
+        }
+    }
+    else
+    {
+        publishedNodes.clear();
+    }
+    publishedNodes.notified();
+
     MegaNodeList *nodeList = NULL;
     if (n != NULL)
     {
@@ -15996,8 +16251,16 @@ void MegaApiImpl::removeTransferListener(MegaTransferListener* listener)
     {
         MegaTransferPrivate* transfer = it->second;
         if(transfer->getListener() == listener)
+        {
             transfer->setListener(NULL);
 
+            // a held streaming transfer has to go on, to find it has no listener anymore and stop
+            if (transfer->isStreamingPaused())
+            {
+                pauseStreaming(transfer, false);
+            }
+        }
+
         it++;
     }
 
@@ -17494,8 +17757,15 @@ int MegaApiImpl::getNumChildren(MegaNode* p)
         return 0;
     }
 
+    int numFiles, numFolders;
+    if (publishedNodes.childCounts(p->getHandle(), numFiles, numFolders))
+    {
+        return numFiles + numFolders;
+    }
+
     sdkMutex.lock();
     Node *parent = client->nodebyhandle(p->getHandle());
+    client->pageInChildren(parent);
     if (!parent || parent->type == FILENODE)
     {
         sdkMutex.unlock();
@@ -17515,20 +17785,22 @@ int MegaApiImpl::getNumChildFiles(MegaNode* p)
         return 0;
     }
 
+    int numFiles, numFolders;
+    if (publishedNodes.childCounts(p->getHandle(), numFiles, numFolders))
+    {
+        return numFiles;
+    }
+
     sdkMutex.lock();
     Node *parent = client->nodebyhandle(p->getHandle());
+    client->pageInChildren(parent);
     if (!parent || parent->type == FILENODE)
     {
         sdkMutex.unlock();
         return 0;
     }
 
-    int numFiles = 0;
-    for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
-    {
-        if ((*it)->type == FILENODE)
-            numFiles++;
-    }
+    numFiles = int(parent->children.files());
     sdkMutex.unlock();
 
     return numFiles;
@@ -17541,20 +17813,22 @@ int MegaApiImpl::getNumChildFolders(MegaNode* p)
         return 0;
     }
 
+    int numFiles, numFolders;
+    if (publishedNodes.childCounts(p->getHandle(), numFiles, numFolders))
+    {
+        return numFolders;
+    }
+
     sdkMutex.lock();
     Node *parent = client->nodebyhandle(p->getHandle());
+    client->pageInChildren(parent);
     if (!parent || parent->type == FILENODE)
     {
         sdkMutex.unlock();
         return 0;
     }
 
-    int numFolders = 0;
-    for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
-    {
-        if ((*it)->type != FILENODE)
-            numFolders++;
-    }
+    numFolders = int(parent->children.folders());
     sdkMutex.unlock();
 
     return numFolders;
@@ -17568,22 +17842,31 @@ MegaNodeList *MegaApiImpl::getChildren(MegaNode* p, int order)
         return new MegaNodeListPrivate();
     }
 
+    if (PublishedNodes::cacheableOrder(order))
+    {
+        if (MegaNodeList* published = publishedNodes.children(p->getHandle(), order))
+        {
+            return published;
+        }
+    }
+
     node_vector childrenNodes;
 
     SdkMutexGuard guard(sdkMutex);
 
     Node *parent = client->nodebyhandle(p->getHandle());
+    client->pageInChildren(parent);
     if (parent && parent->type != FILENODE)
     {
-        childrenNodes.reserve(parent->children.size());
-        for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
+        if (std::function<bool(Node*, Node*)> comparatorFunction = getComparatorFunction(order, *client))
         {
-            childrenNodes.push_back(*it++);
+            childrenNodes = parent->sortedChildren(order, comparatorFunction);
         }
-        if (std::function<bool(Node*, Node*)> comparatorFunction = getComparatorFunction(order, *client))
+        else
         {
-            std::sort(childrenNodes.begin(), childrenNodes.end(), comparatorFunction);
+            childrenNodes.assign(parent->children.begin(), parent->children.end());
         }
+        publishedNodes.publishChildren(parent, order, childrenNodes);
     }
     return new MegaNodeListPrivate(childrenNodes.data(), int(childrenNodes.size()));
 }
@@ -17603,10 +17886,11 @@ MegaNodeList *MegaApiImpl::getChildren(MegaNodeList *parentNodes, int order)
         }
 
         Node *parent = client->nodebyhandle(p->getHandle());
+        client->pageInChildren(parent);
         if (parent && parent->type != FILENODE)
         {
             childrenNodes.reserve(childrenNodes.size() + parent->children.size());
-            for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
+            for (NodeChildren::iterator it = parent->children.begin(); it != parent->children.end(); )
             {
                 childrenNodes.push_back(*it++);
             }
@@ -17622,6 +17906,49 @@ MegaNodeList *MegaApiImpl::getChildren(MegaNodeList *parentNodes, int order)
     return new MegaNodeListPrivate(childrenNodes.data(), int(childrenNodes.size()));
 }
 
+MegaNodeList *MegaApiImpl::getChildrenPage(MegaNode* p, int order, int offset, int limit)
+{
+    if (!p || p->getType() == MegaNode::TYPE_FILE || offset < 0 || limit <= 0)
+    {
+        return new MegaNodeListPrivate();
+    }
+
+    vector<MegaHandle> handles;
+    {
+        SdkMutexGuard guard(sdkMutex);
+
+        Node *parent = client->nodebyhandle(p->getHandle());
+        client->pageInChildren(parent);
+        if (parent && parent->type != FILENODE)
+        {
+            if (std::function<bool(Node*, Node*)> comparatorFunction = getComparatorFunction(order, *client))
+            {
+                node_vector page = parent->sortedChildren(order, comparatorFunction, size_t(offset), size_t(limit));
+                handles.reserve(page.size());
+                for (Node* child : page)
+                {
+                    handles.push_back(child->nodehandle);
+                }
+            }
+            else
+            {
+                auto it = parent->children.begin();
+                for (int i = 0; i < offset && it != parent->children.end(); i++)
+                {
+                    ++it;
+                }
+                for (; it != parent->children.end() && int(handles.size()) < limit; ++it)
+                {
+                    handles.push_back((*it)->nodehandle);
+                }
+            }
+        }
+    }
+
+    // the nodes are created by the list, as they are requested
+    return new MegaNodeListLazyPrivate(this, std::move(handles));
+}
+
 MegaNodeList *MegaApiImpl::getVersions(MegaNode *node)
 {
     if (!node || node->getType() != MegaNode::TYPE_FILE)
@@ -17724,6 +18051,7 @@ MegaChildrenLists *MegaApiImpl::getFileFolderChildren(MegaNode *p, int order)
     SdkMutexGuard guard(sdkMutex);
 
     Node *parent = client->nodebyhandle(p->getHandle());
+    client->pageInChildren(parent);
     if (!parent || parent->type == FILENODE)
     {
         return new MegaChildrenListsPrivate();
@@ -17732,7 +18060,7 @@ MegaChildrenLists *MegaApiImpl::getFileFolderChildren(MegaNode *p, int order)
     node_vector files;
     node_vector folders;
 
-    for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
+    for (NodeChildren::iterator it = parent->children.begin(); it != parent->children.end(); )
     {
         Node *n = *it++;
         if (n->type == FILENODE)
@@ -17764,6 +18092,7 @@ bool MegaApiImpl::hasChildren(MegaNode *parent)
 
     sdkMutex.lock();
     Node *p = client->nodebyhandle(parent->getHandle());
+    client->pageInChildren(p);
     if (!p || p->type == FILENODE)
     {
         sdkMutex.unlock();
@@ -17953,6 +18282,19 @@ MegaNode* MegaApiImpl::getParentNode(MegaNode* n)
 {
     if(!n) return NULL;
 
+    MegaHandle parentHandle;
+    if (publishedNodes.parent(n->getHandle(), parentHandle))
+    {
+        if (parentHandle == UNDEF)
+        {
+            return NULL;
+        }
+        if (MegaNode* published = publishedNodes.node(parentHandle))
+        {
+            return published;
+        }
+    }
+
     sdkMutex.lock();
     Node *node = client->nodebyhandle(n->getHandle());
     if(!node)
@@ -17961,6 +18303,8 @@ MegaNode* MegaApiImpl::getParentNode(MegaNode* n)
         return NULL;
     }
 
+    publishedNodes.publish(node);
+    publishedNodes.publish(node->parent);
     MegaNode *result = MegaNodePrivate::fromNode(node->parent);
     sdkMutex.unlock();
 
@@ -17993,7 +18337,16 @@ char* MegaApiImpl::getNodePathByNodeHandle(MegaHandle handle)
 
 MegaNode* MegaApiImpl::getNodeByPath(const char *path, MegaNode* node)
 {
-    SdkMutexGuard guard(sdkMutex);
+    bool cacheable = PublishedNodes::cacheablePath(path);
+    if (cacheable)
+    {
+        if (MegaNode* published = publishedNodes.path(node ? node->getHandle() : UNDEF, path))
+        {
+            return published;
+        }
+    }
+
+    SdkMutexGuard guard(sdkMutex);
 
     Node* root = nullptr;
 
@@ -18007,6 +18360,10 @@ MegaNode* MegaApiImpl::getNodeByPath(const char *path, MegaNode* node)
     }
 
     Node* result = client->nodeByPath(path, root);
+    if (cacheable)
+    {
+        publishedNodes.publishPath(root, path, result);
+    }
 
     return MegaNodePrivate::fromNode(result);
 }
@@ -18014,8 +18371,15 @@ MegaNode* MegaApiImpl::getNodeByPath(const char *path, MegaNode* node)
 MegaNode* MegaApiImpl::getNodeByHandle(handle handle)
 {
     if(handle == UNDEF) return NULL;
+    if (MegaNode* published = publishedNodes.node(handle))
+    {
+        return published;
+    }
+
     sdkMutex.lock();
-    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(handle));
+    Node *node = client->nodebyhandle(handle);
+    publishedNodes.publish(node);
+    MegaNode *result = MegaNodePrivate::fromNode(node);
     sdkMutex.unlock();
     return result;
 }
@@ -22699,9 +23063,10 @@ void MegaApiImpl::sendPendingRequests()
                 break;
             }
 
-            TreeProcFolderInfo folderProcessor;
-            client->proctree(node, &folderProcessor, false, false);
-            MegaFolderInfo *folderInfo = folderProcessor.getResult();
+            // the node itself is not one of its folders
+            NodeCounter nc = node->subnodeCounts();
+            MegaFolderInfo *folderInfo = new MegaFolderInfoPrivate(int(nc.files - nc.versions), int(nc.folders) - (node->type == FOLDERNODE),
+                                                                   int(nc.versions), nc.storage - nc.versionStorage, nc.versionStorage);
             request->setMegaFolderInfo(folderInfo);
             delete folderInfo;
 
@@ -23386,6 +23751,18 @@ bool MegaApiImpl::tryLockMutexFor(long long time)
     }
 }
 
+MegaStringMap* MegaApiImpl::getMutexStats()
+{
+    MegaStringMap* stats = new MegaStringMapPrivate();
+    stats->set("acquisitions", std::to_string(sdkMutex.acquisitions()).c_str());
+    stats->set("contended", std::to_string(sdkMutex.contentions()).c_str());
+    stats->set("waitMicroseconds", std::to_string(sdkMutex.waitMicroseconds()).c_str());
+    stats->set("maxWaitMicroseconds", std::to_string(sdkMutex.maxWaitMicroseconds()).c_str());
+    stats->set("snapshotReads", std::to_string(publishedNodes.hits()).c_str());
+    stats->set("lockedReads", std::to_string(publishedNodes.misses()).c_str());
+    return stats;
+}
+
 void MegaApiImpl::getBanners(MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_BANNERS, listener);
@@ -23830,6 +24207,432 @@ void RequestQueue::removeListener(MegaScheduledCopyListener *listener)
     }
 }
 
+void SdkMutex::lock()
+{
+    if (mMutex.try_lock())
+    {
+        ++mAcquisitions;
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    mMutex.lock();
+    contended(start, true);
+}
+
+void SdkMutex::unlock()
+{
+    mMutex.unlock();
+}
+
+bool SdkMutex::try_lock()
+{
+    if (mMutex.try_lock())
+    {
+        ++mAcquisitions;
+        return true;
+    }
+    return false;
+}
+
+void SdkMutex::contended(std::chrono::steady_clock::time_point start, bool locked)
+{
+    auto waited = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    if (locked)
+    {
+        ++mAcquisitions;
+    }
+    ++mContentions;
+    mWaitMicroseconds += waited;
+
+    uint64_t max = mMaxWaitMicroseconds;
+    while (waited > max && !mMaxWaitMicroseconds.compare_exchange_weak(max, waited))
+    {
+    }
+}
+
+PublishedNodes::Bucket& PublishedNodes::bucket(MegaHandle base, const string& path)
+{
+    return mBuckets[(std::hash<string>()(path) ^ base) % BUCKETS];
+}
+
+bool PublishedNodes::cacheableOrder(int order)
+{
+    // photo and video orders depend on the client's media classification
+    return order != MegaApi::ORDER_PHOTO_ASC && order != MegaApi::ORDER_PHOTO_DESC
+        && order != MegaApi::ORDER_VIDEO_ASC && order != MegaApi::ORDER_VIDEO_DESC;
+}
+
+bool PublishedNodes::cacheablePath(const char* path)
+{
+    // only plain descents: the nodes walked are then the result and its
+    // ancestors, whose entries validate the cached path
+    if (!path || strchr(path, ':') || strchr(path, '\\'))
+    {
+        return false;
+    }
+
+    for (const char* c = path; ; )
+    {
+        const char* end = strchr(c, '/');
+        size_t length = end ? size_t(end - c) : strlen(c);
+        if ((length == 1 && c[0] == '.') || (length == 2 && c[0] == '.' && c[1] == '.'))
+        {
+            return false;
+        }
+        if (!end)
+        {
+            return true;
+        }
+        c = end + 1;
+    }
+}
+
+bool PublishedNodes::publishable(Node* n)
+{
+    MegaClient* client = n ? n->client : nullptr;
+    if (!client || client->fetchingnodes || !client->nodenotify.empty() || n->attrstring)
+    {
+        return false;
+    }
+
+    // GPS coordinates can't be decoded until the unshareable key is known
+    return client->unshareablekey.size() == Base64Str<SymmCipher::KEYLENGTH>::STRLEN
+        || !n->attrs.map.count(AttrMap::string2nameid("gp"));
+}
+
+shared_ptr<const PublishedNodes::Entry> PublishedNodes::entry(MegaHandle h)
+{
+    Bucket& b = bucket(h);
+    std::lock_guard<std::mutex> g(b.mutex);
+    auto it = b.nodes.find(h);
+    return it == b.nodes.end() ? nullptr : it->second;
+}
+
+bool PublishedNodes::resolve(const Chain& chain, vector<shared_ptr<const Entry>>& entries)
+{
+    entries.reserve(chain.size());
+    for (auto& link : chain)
+    {
+        auto e = entry(link.first);
+        if (!e || e->serial != link.second)
+        {
+            return false;
+        }
+        entries.push_back(std::move(e));
+    }
+    return true;
+}
+
+MegaNode* PublishedNodes::node(MegaHandle h)
+{
+    if (mPending)
+    {
+        return hit<MegaNode>(nullptr);
+    }
+
+    auto e = entry(h);
+    return hit(e ? e->node->copy() : nullptr);
+}
+
+bool PublishedNodes::parent(MegaHandle h, MegaHandle& parentHandle)
+{
+    auto e = mPending ? nullptr : entry(h);
+    if (!hit(e.get()))
+    {
+        return false;
+    }
+    parentHandle = e->parent;
+    return true;
+}
+
+MegaNodeList* PublishedNodes::children(MegaHandle parentHandle, int order)
+{
+    if (mPending)
+    {
+        return hit<MegaNodeList>(nullptr);
+    }
+
+    Chain chain;
+    {
+        Bucket& b = bucket(parentHandle);
+        std::lock_guard<std::mutex> g(b.mutex);
+        auto it = b.children.find(parentHandle);
+        auto oit = it == b.children.end() ? std::map<int, Chain>::iterator() : it->second.find(order);
+        if (it == b.children.end() || oit == it->second.end())
+        {
+            return hit<MegaNodeList>(nullptr);
+        }
+        chain = oit->second;
+    }
+
+    vector<shared_ptr<const Entry>> entries;
+    if (!resolve(chain, entries))
+    {
+        return hit<MegaNodeList>(nullptr);
+    }
+
+    vector<std::unique_ptr<MegaNode>> nodes;
+    nodes.reserve(entries.size());
+    for (auto& e : entries)
+    {
+        nodes.emplace_back(e->node->copy());
+    }
+    return hit(new MegaNodeListPrivate(std::move(nodes)));
+}
+
+bool PublishedNodes::childCounts(MegaHandle parentHandle, int& files, int& folders)
+{
+    if (mPending)
+    {
+        ++mMisses;
+        return false;
+    }
+
+    Chain chain;
+    {
+        Bucket& b = bucket(parentHandle);
+        std::lock_guard<std::mutex> g(b.mutex);
+        // any order lists all the children
+        auto it = b.children.find(parentHandle);
+        if (it == b.children.end() || it->second.empty())
+        {
+            ++mMisses;
+            return false;
+        }
+        chain = it->second.begin()->second;
+    }
+
+    vector<shared_ptr<const Entry>> entries;
+    if (!resolve(chain, entries))
+    {
+        ++mMisses;
+        return false;
+    }
+
+    files = folders = 0;
+    for (auto& e : entries)
+    {
+        ++(e->node->getType() == MegaNode::TYPE_FILE ? files : folders);
+    }
+    ++mHits;
+    return true;
+}
+
+MegaNode* PublishedNodes::path(MegaHandle base, const char* path)
+{
+    if (mPending)
+    {
+        return hit<MegaNode>(nullptr);
+    }
+
+    auto key = std::make_pair(base, string(path));
+    Bucket& b = bucket(key.first, key.second);
+    Chain chain;
+    {
+        std::lock_guard<std::mutex> g(b.mutex);
+        auto it = b.paths.find(key);
+        if (it == b.paths.end())
+        {
+            return hit<MegaNode>(nullptr);
+        }
+        chain = it->second;
+    }
+
+    vector<shared_ptr<const Entry>> entries;
+    if (!resolve(chain, entries))
+    {
+        std::lock_guard<std::mutex> g(b.mutex);
+        auto it = b.paths.find(key);
+        if (it != b.paths.end() && it->second == chain)
+        {
+            b.paths.erase(it);
+            --mPathCount;
+        }
+        return hit<MegaNode>(nullptr);
+    }
+
+    // the chain starts with the node the path resolved to
+    return hit(entries.front()->node->copy());
+}
+
+uint64_t PublishedNodes::serial(Node* n)
+{
+    if (!publishable(n))
+    {
+        return 0;
+    }
+
+    if (n->client->mNewLinkFormat != mNewLinkFormat)
+    {
+        // public links embedded in the published nodes change format
+        clear();
+        mNewLinkFormat = n->client->mNewLinkFormat;
+    }
+
+    Bucket& b = bucket(n->nodehandle);
+    {
+        std::lock_guard<std::mutex> g(b.mutex);
+        auto it = b.nodes.find(n->nodehandle);
+        if (it != b.nodes.end())
+        {
+            return it->second->serial;
+        }
+    }
+
+    auto e = std::make_shared<Entry>();
+    e->node.reset(MegaNodePrivate::fromNode(n));
+    if (e->node->getChanges())
+    {
+        return 0;
+    }
+    e->parent = n->parent ? n->parent->nodehandle : UNDEF;
+    e->serial = mNextSerial++;
+
+    if (mNodeCount >= MAX_NODES)
+    {
+        clear();
+    }
+
+    std::lock_guard<std::mutex> g(b.mutex);
+    b.nodes[n->nodehandle] = e;
+    ++mNodeCount;
+    return e->serial;
+}
+
+void PublishedNodes::publish(Node* n)
+{
+    serial(n);
+}
+
+void PublishedNodes::publishChildren(Node* parent, int order, const node_vector& children)
+{
+    if (!cacheableOrder(order) || !publishable(parent))
+    {
+        return;
+    }
+
+    Chain chain;
+    chain.reserve(children.size());
+    for (Node* child : children)
+    {
+        uint64_t s = serial(child);
+        if (!s)
+        {
+            return;
+        }
+        chain.emplace_back(child->nodehandle, s);
+    }
+
+    Bucket& b = bucket(parent->nodehandle);
+    std::lock_guard<std::mutex> g(b.mutex);
+    b.children[parent->nodehandle][order] = std::move(chain);
+}
+
+void PublishedNodes::publishPath(Node* base, const char* path, Node* result)
+{
+    if (!result || !cacheablePath(path))
+    {
+        return;
+    }
+
+    Chain chain;
+    for (Node* n = result; n; n = n->parent)
+    {
+        uint64_t s = serial(n);
+        if (!s)
+        {
+            return;
+        }
+        chain.emplace_back(n->nodehandle, s);
+    }
+    if (base)
+    {
+        // a missing base fails the lookup even for absolute paths
+        uint64_t s = serial(base);
+        if (!s)
+        {
+            return;
+        }
+        chain.emplace_back(base->nodehandle, s);
+    }
+
+    if (mPathCount >= MAX_PATHS)
+    {
+        clearPaths();
+    }
+
+    auto key = std::make_pair(base ? base->nodehandle : UNDEF, string(path));
+    Bucket& b = bucket(key.first, key.second);
+    std::lock_guard<std::mutex> g(b.mutex);
+    auto& stored = b.paths[key];
+    if (stored.empty())
+    {
+        ++mPathCount;
+    }
+    stored = std::move(chain);
+}
+
+void PublishedNodes::drop(MegaHandle h)
+{
+    Bucket& b = bucket(h);
+    std::lock_guard<std::mutex> g(b.mutex);
+    mNodeCount -= b.nodes.erase(h);
+    b.children.erase(h);
+}
+
+void PublishedNodes::invalidate(Node* n)
+{
+    // the previous parent, in case the node was moved
+    auto e = entry(n->nodehandle);
+    if (e && e->parent != UNDEF)
+    {
+        drop(e->parent);
+    }
+    if (n->parent)
+    {
+        drop(n->parent->nodehandle);
+    }
+    drop(n->nodehandle);
+}
+
+void PublishedNodes::pending(Node* n)
+{
+    mPending = true;
+    if (mNodeCount)
+    {
+        invalidate(n);
+    }
+}
+
+void PublishedNodes::notified()
+{
+    mPending = false;
+}
+
+void PublishedNodes::clearPaths()
+{
+    for (auto& b : mBuckets)
+    {
+        std::lock_guard<std::mutex> g(b.mutex);
+        mPathCount -= b.paths.size();
+        b.paths.clear();
+    }
+}
+
+void PublishedNodes::clear()
+{
+    mPending = false;
+    for (auto& b : mBuckets)
+    {
+        std::lock_guard<std::mutex> g(b.mutex);
+        mNodeCount -= b.nodes.size();
+        mPathCount -= b.paths.size();
+        b.nodes.clear();
+        b.children.clear();
+        b.paths.clear();
+    }
+}
+
 MegaHashSignatureImpl::MegaHashSignatureImpl(const char *base64Key)
 {
     hashSignature = new HashSignature(new Hash());
@@ -25208,14 +26011,29 @@ void MegaFolderUploadController::start(MegaNode*)
     // it's mandatory to notify stage change from MegaApiImpl's thread to avoid deadlocks and other issues
     notifyStage(MegaTransfer::STAGE_SCAN);
 
+    mFingerprintCache = megaapiThreadClient()->fingerprintCache();
+
     mWorkerThread = std::thread ([this, path]() {
         // recurse all subfolders on disk, building up tree structure to match
         // not yet existing folders get a temporary upload id instead of a handle
         uint32_t foldercount = 0;
         uint32_t filecount = 0;
         LocalPath lp = path;
+        mScanService.reset(new ScanService(mFingerprintWaiter));
         scanFolder_result scanResult = scanFolder(*mUploadTree.subtrees.front(), lp, foldercount, filecount);
 
+        // fingerprints still being computed must be in place before any upload starts
+        scanFolder_result fingerprintResult = completeFingerprints(0);
+        if (scanResult == scanFolder_succeeded)
+        {
+            scanResult = fingerprintResult;
+        }
+        mScanService.reset();
+        if (mFingerprintCache)
+        {
+            mFingerprintCache->flush();
+        }
+
         // if the thread runs, we always queue a function to execute on MegaApi thread for onFinish()
         // we keep a pointer to it in case we need to execute it early and directly on cancel()
         mCompletionForMegaApiThread.reset(new ExecuteOnce([this, scanResult]() {
@@ -25362,6 +26180,9 @@ MegaFolderUploadController::scanFolder_result MegaFolderUploadController::scanFo
 
     megaApi->fireOnFolderTransferUpdate(transfer, MegaTransfer::STAGE_SCAN, foldercount, 0, filecount, &localPath, nullptr);
 
+    // the cache knows files by their fsid on each filesystem
+    fsfp_t fsfp = mFingerprintCache ? fsaccess->fsFingerprint(localPath) : 0;
+
     LocalPath localname;
     nodetype_t dirEntryType;
     while (da->dnext(localPath, localname, false, &dirEntryType))
@@ -25384,18 +26205,22 @@ MegaFolderUploadController::scanFolder_result MegaFolderUploadController::scanFo
         localPath.appendWithSeparator(localname, false);
         if (dirEntryType == FILENODE)
         {
-            // Do the fingerprinting for uploads on the scan thread, so we don't lock the main mutex for so long
-            FileFingerprint fp;
-            auto fa = fsaccess->newfileaccess();
-            if (fa->fopen(localPath, true, false))
-            {
-                fp.genfingerprint(fa.get());
-            }
-
+            // Do the fingerprinting for uploads off the main thread, so we don't lock the main mutex for so long
             // if we couldn't get the fingerprint, !isvalid and we'll fail the transfer
-            tree.files.emplace_back(localPath, fp);
+            tree.files.emplace_back(localPath, FileFingerprint());
+            mPendingFingerprints.push_back({ &tree, tree.files.size() - 1, mScanService->queueFingerprint(localPath, true, mFingerprintCache, fsfp) });
 
             filecount += 1;
+
+            if (mPendingFingerprints.size() > MAX_PENDING_FINGERPRINTS)
+            {
+                scanFolder_result sr = completeFingerprints(MAX_PENDING_FINGERPRINTS / 2);
+                if (sr != scanFolder_succeeded)
+                {
+                    recursive--;
+                    return sr;
+                }
+            }
         }
         else if (dirEntryType == FOLDERNODE)
         {
@@ -25426,6 +26251,57 @@ MegaFolderUploadController::scanFolder_result MegaFolderUploadController::scanFo
     return scanFolder_succeeded;
 }
 
+MegaFolderUploadController::scanFolder_result MegaFolderUploadController::completeFingerprints(size_t maxPending)
+{
+    while (mPendingFingerprints.size() > maxPending)
+    {
+        auto& pending = mPendingFingerprints.front();
+
+        if (pending.request->completed())
+        {
+            if (pending.request->mIsFile)
+            {
+                pending.tree->files[pending.file].fp = pending.request->mFingerprint;
+            }
+            mPendingFingerprints.pop_front();
+            continue;
+        }
+
+        if (isCancelledByFolderTransferToken() || mWorkerThreadStopFlag)
+        {
+            LOG_debug << "MegaFolderUploadController fingerprinting stopped";
+            break;
+        }
+
+        mFingerprintWaiter.init(10);
+        mFingerprintWaiter.wait();
+    }
+
+    if (mPendingFingerprints.size() <= maxPending)
+    {
+        return scanFolder_succeeded;
+    }
+
+    // requests notify our waiter when they complete, so all of them must have
+    // before we go: only those already being fingerprinted take any time
+    for (auto& pending : mPendingFingerprints)
+    {
+        pending.request->cancel();
+    }
+
+    for (auto& pending : mPendingFingerprints)
+    {
+        while (!pending.request->completed())
+        {
+            mFingerprintWaiter.init(1);
+            mFingerprintWaiter.wait();
+        }
+    }
+
+    mPendingFingerprints.clear();
+    return scanFolder_cancelled;
+}
+
 MegaFolderUploadController::batchResult MegaFolderUploadController::createNextFolderBatch(Tree& tree, vector<NewNode>& newnodes, bool isBatchRootLevel)
 {
     assert(mMainThreadId == std::this_thread::get_id());
@@ -26988,11 +27864,8 @@ bool MegaFolderDownloadController::genDownloadTransfersForFiles(FileSystemType f
 StreamingBuffer::StreamingBuffer()
 {
     this->capacity = 0;
-    this->buffer = NULL;
-    this->inpos = 0;
-    this->outpos = 0;
     this->size = 0;
-    this->free = 0;
+    this->inflightSize = 0;
     this->maxBufferSize = MAX_BUFFER_SIZE;
     this->maxOutputSize = MAX_OUTPUT_SIZE;
     this->fileSize = 0;
@@ -27001,7 +27874,6 @@ StreamingBuffer::StreamingBuffer()
 
 StreamingBuffer::~StreamingBuffer()
 {
-    delete [] buffer;
 }
 
 void StreamingBuffer::init(size_t capacity)
@@ -27030,48 +27902,38 @@ void StreamingBuffer::init(size_t capacity)
     }
 
     this->capacity = static_cast<unsigned>(capacity);
-    this->buffer = new char[this->capacity];
-    this->inpos = 0;
-    this->outpos = 0;
+    this->pending.clear();
+    this->inflight.clear();
     this->size = 0;
-    this->free = this->capacity;
+    this->inflightSize = 0;
 }
 
 size_t StreamingBuffer::append(const char *buf, size_t len)
 {
-    if (!buffer)
+    auto copy = std::make_shared<string>(buf, len);
+    return append(copy->data(), len, copy);
+}
+
+size_t StreamingBuffer::append(const char *buf, size_t len, const std::shared_ptr<void>& owner)
+{
+    if (!capacity)
     {
         // initialize the buffer if it's not initialized yet
         init(len);
     }
 
-    if (free < len)
+    if (availableSpace() < len)
     {
-        LOG_debug << "[Streaming] Not enough available space, len will be truncated. "
+        // the producer is paused when the buffer gets full, but what was on its way is kept
+        LOG_debug << "[Streaming] Not enough available space, buffering beyond capacity. "
                   << " [requested = " << len
-                  << ", buffered = " << free
-                  << ", discarded = " << (len - free) << "]";
-        len = free;
+                  << ", free = " << availableSpace() << "]";
     }
 
-    // update the internal state
-    size_t currentIndex = inpos;
-    inpos += len;
-    int remaining = static_cast<int>(inpos - capacity);
-    inpos %= capacity;
-    size += len;
-    free -= len;
-
-    // append the new data
-    if (remaining <= 0)
-    {
-        memcpy(buffer + currentIndex, buf, len);
-    }
-    else
+    if (len)
     {
-        size_t num = static_cast<size_t>(static_cast<int>(len) - remaining);
-        memcpy(buffer + currentIndex, buf, num);
-        memcpy(buffer, buf + num, static_cast<size_t>(remaining));
+        pending.push_back(Segment{owner, buf, len});
+        size += len;
     }
 
     return len;
@@ -27084,7 +27946,7 @@ size_t StreamingBuffer::availableData() const
 
 size_t StreamingBuffer::availableSpace() const
 {
-    return free;
+    return capacity > size + inflightSize ? capacity - size - inflightSize : 0;
 }
 
 size_t StreamingBuffer::availableCapacity() const
@@ -27092,35 +27954,70 @@ size_t StreamingBuffer::availableCapacity() const
     return capacity;
 }
 
-uv_buf_t StreamingBuffer::nextBuffer()
+size_t StreamingBuffer::nextBuffers(std::vector<uv_buf_t>& bufs, size_t maxBuffers)
 {
-    if (!size)
-    {
-        // no data available
-        return uv_buf_init(NULL, 0);
-    }
+    bufs.clear();
 
-    // prepare output buffer
-    char *outbuf = buffer + outpos;
-    size_t len = size < maxOutputSize ? size : maxOutputSize;
-    if (outpos + len > capacity)
+    size_t len = 0;
+    while (!pending.empty() && len < maxOutputSize && bufs.size() < maxBuffers)
     {
-        len = capacity - outpos;
+        Segment& segment = pending.front();
+        size_t n = std::min(segment.len, maxOutputSize - len);
+
+        bufs.push_back(uv_buf_init(const_cast<char*>(segment.data), (unsigned int)(n)));
+        inflight.push_back(Segment{segment.owner, segment.data, n});
+        len += n;
+
+        if (n == segment.len)
+        {
+            pending.pop_front();
+        }
+        else
+        {
+            segment.data += n;
+            segment.len -= n;
+        }
     }
 
     // update the internal state
     size -= len;
-    outpos += len;
-    outpos %= capacity;
-
-    // return the buffer
-    return uv_buf_init(outbuf, (unsigned int)(len));
+    inflightSize += len;
+    return len;
 }
 
 void StreamingBuffer::freeData(size_t len)
 {
-    // update the internal state
-    free += len;
+    assert(len <= inflightSize);
+    inflightSize -= std::min(len, inflightSize);
+
+    // the owners of the written data can release it
+    while (len && !inflight.empty())
+    {
+        Segment& segment = inflight.front();
+        if (segment.len <= len)
+        {
+            len -= segment.len;
+            inflight.pop_front();
+        }
+        else
+        {
+            segment.data += len;
+            segment.len -= len;
+            len = 0;
+        }
+    }
+}
+
+bool StreamingBuffer::isFullFor(size_t len, m_off_t remaining) const
+{
+    size_t space = availableSpace();
+    return remaining > m_off_t(space) && space < 2 * len;
+}
+
+bool StreamingBuffer::canResumeAfter(size_t len) const
+{
+    // if len is 0, any free space means freeData() has been called before for a similar len
+    return availableSpace() > 2 * len;
 }
 
 void StreamingBuffer::setMaxBufferSize(unsigned int bufferSize)
@@ -27191,8 +28088,8 @@ std::string StreamingBuffer::bufferStatus() const
                .append(std::to_string(size));
     if (duration) bufferState.append(" (").append(std::to_string(partialDuration(size)).append( " secs)"));
     bufferState.append(", free = ")
-               .append(std::to_string(free));
-    if (duration) bufferState.append(" (").append(std::to_string(partialDuration(free)).append( " secs)"));
+               .append(std::to_string(availableSpace()));
+    if (duration) bufferState.append(" (").append(std::to_string(partialDuration(availableSpace())).append( " secs)"));
     bufferState.append(", capacity = ")
                .append(std::to_string(capacity));
     if (duration) bufferState.append(" (").append(std::to_string(partialDuration(capacity)).append( " secs)"));
@@ -27219,15 +28116,10 @@ MegaTCPServer::MegaTCPServer(MegaApiImpl *megaApi, string basePath, bool tls, st
     this->maxOutputSize = 0;
     this->restrictedMode = MegaApi::TCP_SERVER_ALLOW_CREATED_LOCAL_LINKS;
     this->lastHandle = INVALID_HANDLE;
-    this->remainingcloseevents = 0;
-    this->closing = false;
-    this->thread = new MegaThread();
+    this->numLoops = 1;
 #ifdef ENABLE_EVT_TLS
     this->certificatepath = certificatepath;
     this->keypath = keypath;
-    this->closing = false;
-    this->remainingcloseevents = 0;
-    this->evtrequirescleaning = false;
 #endif
     fsAccess = new MegaFileSystemAccess();
 
@@ -27254,10 +28146,8 @@ MegaTCPServer::~MegaTCPServer()
     uv_sem_destroy(&semaphoreEnd);
     delete fsAccess;
 
-    LOG_verbose << " MegaTCPServer::~MegaTCPServer joining uv thread";
-    thread->join();
-    LOG_verbose << " MegaTCPServer::~MegaTCPServer deleting uv thread";
-    delete thread;
+    LOG_verbose << " MegaTCPServer::~MegaTCPServer joining uv threads";
+    joinLoops();
 }
 
 bool MegaTCPServer::start(int port, bool localOnly)
@@ -27272,16 +28162,44 @@ bool MegaTCPServer::start(int port, bool localOnly)
         stop();
     }
 
+    joinLoops();
     this->port = port;
     this->localOnly = localOnly;
 
-    thread->start(threadEntryPoint, this);
-    uv_sem_wait(&semaphoreStartup);
+    // the loops are started one by one, the first one binds the port and the others share its socket
+    loops.reserve(numLoops);
+    for (int i = 0; i < numLoops; i++)
+    {
+        loops.emplace_back(new MegaTCPLoop(this, i));
+        MegaTCPLoop *loop = loops.back().get();
+        loop->thread.start(threadEntryPoint, loop);
+        uv_sem_wait(&semaphoreStartup);
 
-    LOG_verbose << "MegaTCPServer::start. port = " << port << ", returning " << started;
+        if (!loop->running)
+        {
+            loop->thread.join();
+            loops.pop_back();
+            if (i)
+            {
+                LOG_warn << "MegaTCPServer::start. Unable to start uv loop " << i << ", serving with " << i << " loops";
+            }
+            break;
+        }
+    }
+
+    LOG_verbose << "MegaTCPServer::start. port = " << port << ", loops = " << loops.size() << ", returning " << started;
     return started;
 }
 
+void MegaTCPServer::joinLoops()
+{
+    for (auto& loop : loops)
+    {
+        loop->thread.join();
+    }
+    loops.clear();
+}
+
 #ifdef ENABLE_EVT_TLS
 int MegaTCPServer::uv_tls_writer(evt_tls_t *evt_tls, void *bfr, int sz)
 {
@@ -27320,140 +28238,125 @@ int MegaTCPServer::uv_tls_writer(evt_tls_t *evt_tls, void *bfr, int sz)
 }
 #endif
 
-// todo: a lot of this function is the same as initializeAndStartListening, we should factor them (maybe call that one from this one?)
-void MegaTCPServer::run()
+void MegaTCPServer::run(MegaTCPLoop *loop)
 {
-    LOG_debug << " Running tcp server: " << port << " TLS=" << useTLS;
+    LOG_debug << " Running tcp server: " << port << " TLS=" << useTLS << " loop=" << loop->index;
 
 #ifdef ENABLE_EVT_TLS
     if (useTLS)
     {
-        if (evt_ctx_init_ex(&evtctx, certificatepath.c_str(), keypath.c_str()) != 1 )
+        if (evt_ctx_init_ex(&loop->evtctx, certificatepath.c_str(), keypath.c_str()) != 1 )
         {
             LOG_err << "Unable to init evt ctx";
-            port = 0;
+            if (!loop->index)
+            {
+                port = 0;
+            }
             uv_sem_post(&semaphoreStartup);
-            uv_sem_post(&semaphoreEnd);
             return;
         }
-        evt_ctx_set_nio(&evtctx, NULL, uv_tls_writer);
+        evt_ctx_set_nio(&loop->evtctx, NULL, uv_tls_writer);
     }
 #endif
 
-    uv_loop_init(&uv_loop);
-
-    uv_async_init(&uv_loop, &exit_handle, onCloseRequested);
-    exit_handle.data = this;
+    uv_loop_init(&loop->uv_loop);
+    loop->uv_loop.data = loop;
 
-    uv_tcp_init(&uv_loop, &server);
-    server.data = this;
+    uv_async_init(&loop->uv_loop, &loop->exit_handle, onCloseRequested);
+    loop->exit_handle.data = loop;
 
-    uv_tcp_keepalive(&server, 0, 0);
-
-    union {
-        struct sockaddr_in6 ipv6;
-        struct sockaddr_in ipv4;
-    } address;
+    uv_tcp_init(&loop->uv_loop, &loop->listener);
+    loop->listener.data = this;
 
-    if (useIPv6)
+    if (!listen(loop))
     {
-        if (localOnly)
-        {
-            uv_ip6_addr("::1", port, &address.ipv6);
-        }
-        else
-        {
-            uv_ip6_addr("::", port, &address.ipv6);
-        }
-    }
-    else
-    {
-        if (localOnly)
-        {
-            uv_ip4_addr("127.0.0.1", port, &address.ipv4);
-        }
-        else
+        LOG_err << "TCP failed to bind/listen port = " << port << " loop = " << loop->index;
+        if (!loop->index)
         {
-            uv_ip4_addr("0.0.0.0", port, &address.ipv4);
+            port = 0;
         }
-    }
 
-    uv_connection_cb onNewClientCB;
-#ifdef ENABLE_EVT_TLS
-    if (useTLS)
-    {
-         onNewClientCB = onNewClient_tls;
-    }
-    else
-    {
-#endif
-        onNewClientCB = onNewClient;
-#ifdef ENABLE_EVT_TLS
-    }
-#endif
-
-    if(uv_tcp_bind(&server, (const struct sockaddr*)&address, 0)
-        || uv_listen((uv_stream_t*)&server, 32, onNewClientCB))
-    {
-        LOG_err << "TCP failed to bind/listen port = " << port;
-        port = 0;
-
-        uv_close((uv_handle_t *)&exit_handle,NULL);
-        uv_close((uv_handle_t *)&server,NULL);
+        uv_close((uv_handle_t *)&loop->exit_handle,NULL);
+        uv_close((uv_handle_t *)&loop->listener,NULL);
         uv_sem_post(&semaphoreStartup);
-        uv_run(&uv_loop, UV_RUN_ONCE); // so that resources are cleaned peacefully
-        uv_sem_post(&semaphoreEnd);
+        uv_run(&loop->uv_loop, UV_RUN_ONCE); // so that resources are cleaned peacefully
+        uv_loop_close(&loop->uv_loop);
         return;
     }
 
-    LOG_info << "TCP" << (useTLS ? "(tls)" : "") << " server started on port " << port;
-    started = true;
+    loop->running = true;
+    if (!loop->index)
+    {
+        LOG_info << "TCP" << (useTLS ? "(tls)" : "") << " server started on port " << port;
+        started = true;
+    }
     uv_sem_post(&semaphoreStartup);
 
-    LOG_info << "Starting uv loop ...";
-    uv_run(&uv_loop, UV_RUN_DEFAULT);
+    LOG_info << "Starting uv loop " << loop->index << " ...";
+    uv_run(&loop->uv_loop, UV_RUN_DEFAULT);
 
-    LOG_info << "UV loop ended";
+    LOG_info << "UV loop " << loop->index << " ended";
 #ifdef ENABLE_EVT_TLS
     if (useTLS)
     {
         //evt_ctx_free(&evtctx); //This causes invalid free when called second time!! collides with memory allocated elsewhere (e.g: via curl_global_init!)
-        SSL_CTX_free(evtctx.ctx);
+        SSL_CTX_free(loop->evtctx.ctx);
     }
 #endif
-    uv_loop_close(&uv_loop);
-    started = false;
-    port = 0;
+    uv_loop_close(&loop->uv_loop);
+    if (!loop->index)
+    {
+        started = false;
+        port = 0;
+    }
     LOG_debug << "UV loop thread exit";
 }
 
-void MegaTCPServer::initializeAndStartListening()
+bool MegaTCPServer::listen(MegaTCPLoop *loop)
 {
+    uv_connection_cb onNewClientCB;
 #ifdef ENABLE_EVT_TLS
     if (useTLS)
     {
-        if (evt_ctx_init_ex(&evtctx, certificatepath.c_str(), keypath.c_str()) != 1 )
-        {
-            LOG_err << "Unable to init evt ctx";
-            port = 0;
-            uv_sem_post(&semaphoreStartup);
-            uv_sem_post(&semaphoreEnd);
-            return;
-        }
-        evtrequirescleaning = true;
-        evt_ctx_set_nio(&evtctx, NULL, uv_tls_writer);
+         onNewClientCB = onNewClient_tls;
+    }
+    else
+    {
+#endif
+        onNewClientCB = onNewClient;
+#ifdef ENABLE_EVT_TLS
     }
 #endif
 
-    uv_loop_init(&uv_loop);
+    if (loop->index)
+    {
+#ifndef _WIN32
+        // every loop listens on its own descriptor of the socket bound by the first one,
+        // and the kernel hands each connection to one of the loops that are waiting for it
+        uv_os_fd_t fd;
+        if (uv_fileno((uv_handle_t *)&loops.front()->listener, &fd))
+        {
+            return false;
+        }
 
-    uv_async_init(&uv_loop, &exit_handle, onCloseRequested);
-    exit_handle.data = this;
+        int dupfd = dup(fd);
+        if (dupfd < 0)
+        {
+            return false;
+        }
 
-    uv_tcp_init(&uv_loop, &server);
-    server.data = this;
+        if (uv_tcp_open(&loop->listener, dupfd))
+        {
+            close(dupfd);
+            return false;
+        }
+        return !uv_listen((uv_stream_t*)&loop->listener, 32, onNewClientCB);
+#else
+        return false;
+#endif
+    }
 
-    uv_tcp_keepalive(&server, 0, 0);
+    uv_tcp_keepalive(&loop->listener, 0, 0);
 
     union {
         struct sockaddr_in6 ipv6;
@@ -27483,35 +28386,8 @@ void MegaTCPServer::initializeAndStartListening()
         }
     }
 
-    uv_connection_cb onNewClientCB;
-#ifdef ENABLE_EVT_TLS
-    if (useTLS)
-    {
-         onNewClientCB = onNewClient_tls;
-    }
-    else
-    {
-#endif
-        onNewClientCB = onNewClient;
-#ifdef ENABLE_EVT_TLS
-    }
-#endif
-
-    if(uv_tcp_bind(&server, (const struct sockaddr*)&address, 0)
-        || uv_listen((uv_stream_t*)&server, 32, onNewClientCB))
-    {
-        LOG_err << "TCP failed to bind/listen port = " << port;
-        port = 0;
-        uv_async_send(&exit_handle);
-        //This is required in case uv_loop was already running so as to free references to "this".
-        // a uv_sem_post will be required there, so that we can delete the server accordingly
-        return;
-    }
-
-    LOG_info << "TCP" << (useTLS ? "(tls)" : "") << " server started on port " << port;
-    started = true;
-    uv_sem_post(&semaphoreStartup);
-    LOG_debug << "UV loop already alive!";
+    return !uv_tcp_bind(&loop->listener, (const struct sockaddr*)&address, 0)
+            && !uv_listen((uv_stream_t*)&loop->listener, 32, onNewClientCB);
 }
 
 void MegaTCPServer::stop(bool doNotWait)
@@ -27523,11 +28399,17 @@ void MegaTCPServer::stop(bool doNotWait)
     }
 
     LOG_debug << "Stopping MegaTCPServer port = " << port;
-    uv_async_send(&exit_handle);
+    for (auto& loop : loops)
+    {
+        uv_async_send(&loop->exit_handle);
+    }
     if (!doNotWait)
     {
         LOG_verbose << "Waiting for sempahoreEnd to conclude server stop port = " << port;
-        uv_sem_wait(&semaphoreEnd); //this is signaled when closed my last connection
+        for (size_t i = 0; i < loops.size(); i++)
+        {
+            uv_sem_wait(&semaphoreEnd); //this is signaled by each loop when it closed its last connection
+        }
     }
     LOG_debug << "Stopped MegaTCPServer port = " << port;
     started = false;
@@ -27543,6 +28425,46 @@ bool MegaTCPServer::isLocalOnly()
     return localOnly;
 }
 
+void MegaTCPServer::setNumLoops(int numLoops)
+{
+    if (numLoops <= 0)
+    {
+        numLoops = static_cast<int>(std::thread::hardware_concurrency());
+    }
+#ifdef _WIN32
+    // sharing the listening socket between loops is only supported on POSIX
+    numLoops = 1;
+#endif
+    this->numLoops = std::max(numLoops, 1);
+}
+
+int MegaTCPServer::getNumLoops()
+{
+    return numLoops;
+}
+
+std::vector<int> MegaTCPServer::getConnectionsPerLoop()
+{
+    std::vector<int> result;
+    for (auto& loop : loops)
+    {
+        result.push_back(loop->numConnections.load());
+    }
+    return result;
+}
+
+bool MegaTCPServer::isCurrentThread()
+{
+    for (auto& loop : loops)
+    {
+        if (loop->thread.isCurrentThread())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 void MegaTCPServer::setMaxBufferSize(int bufferSize)
 {
     this->maxBufferSize = bufferSize <= 0 ? 0 : bufferSize;
@@ -27670,11 +28592,21 @@ void *MegaTCPServer::threadEntryPoint(void *param)
     ::sigaction(SIGPIPE, &noaction, 0);
 #endif
 
-    MegaTCPServer *tcpServer = (MegaTCPServer *)param;
-    tcpServer->run();
+    MegaTCPLoop *loop = (MegaTCPLoop *)param;
+    loop->server->run(loop);
     return NULL;
 }
 
+MegaTCPLoop::MegaTCPLoop(MegaTCPServer *server, int index)
+    : server(server)
+    , index(index)
+    , numConnections(0)
+    , running(false)
+    , closing(false)
+    , remainingcloseevents(0)
+{
+}
+
 #ifdef ENABLE_EVT_TLS
 void MegaTCPServer::evt_on_rd(evt_tls_t *evt_tls, char *bfr, int sz)
 {
@@ -27742,17 +28674,18 @@ void MegaTCPServer::onNewClient_tls(uv_stream_t *server_handle, int status)
 
     // Create an object to save context information
     MegaTCPContext* tcpctx = ((MegaTCPServer *)server_handle->data)->initializeContext(server_handle);
+    tcpctx->loop = (MegaTCPLoop *)server_handle->loop->data;
 
-    LOG_debug << "Connection received at port " << tcpctx->server->port << " ! " << tcpctx->server->connections.size();
+    LOG_debug << "Connection received at port " << tcpctx->server->port << " ! " << tcpctx->loop->connections.size() << " loop = " << tcpctx->loop->index;
 
     // Mutex to protect the data buffer
     uv_mutex_init(&tcpctx->mutex);
 
     // Async handle to perform writes
-    uv_async_init(&tcpctx->server->uv_loop, &tcpctx->asynchandle, onAsyncEvent);
+    uv_async_init(&tcpctx->loop->uv_loop, &tcpctx->asynchandle, onAsyncEvent);
 
     // Accept the connection
-    uv_tcp_init(&tcpctx->server->uv_loop, &tcpctx->tcphandle);
+    uv_tcp_init(&tcpctx->loop->uv_loop, &tcpctx->tcphandle);
     if (uv_accept(server_handle, (uv_stream_t*)&tcpctx->tcphandle))
     {
         LOG_err << "uv_accept failed";
@@ -27760,7 +28693,7 @@ void MegaTCPServer::onNewClient_tls(uv_stream_t *server_handle, int status)
         return;
     }
 
-    tcpctx->evt_tls = evt_ctx_get_tls(&tcpctx->server->evtctx);
+    tcpctx->evt_tls = evt_ctx_get_tls(&tcpctx->loop->evtctx);
     assert(tcpctx->evt_tls != NULL);
     tcpctx->evt_tls->data = tcpctx;
     if (evt_tls_accept(tcpctx->evt_tls, on_hd_complete))
@@ -27770,7 +28703,8 @@ void MegaTCPServer::onNewClient_tls(uv_stream_t *server_handle, int status)
         return;
     }
 
-    tcpctx->server->connections.push_back(tcpctx);
+    tcpctx->loop->connections.push_back(tcpctx);
+    tcpctx->loop->numConnections++;
 
     tcpctx->server->readData(tcpctx);
 }
@@ -27801,17 +28735,18 @@ void MegaTCPServer::onNewClient(uv_stream_t* server_handle, int status)
 
     // Create an object to save context information
     MegaTCPContext* tcpctx = ((MegaTCPServer *)server_handle->data)->initializeContext(server_handle);
+    tcpctx->loop = (MegaTCPLoop *)server_handle->loop->data;
 
-    LOG_debug << "Connection received at port " << tcpctx->server->port << "! " << tcpctx->server->connections.size() << " tcpctx = " << tcpctx;
+    LOG_debug << "Connection received at port " << tcpctx->server->port << "! " << tcpctx->loop->connections.size() << " tcpctx = " << tcpctx << " loop = " << tcpctx->loop->index;
 
     // Mutex to protect the data buffer
     uv_mutex_init(&tcpctx->mutex);
 
     // Async handle to perform writes
-    uv_async_init(&tcpctx->server->uv_loop, &tcpctx->asynchandle, onAsyncEvent);
+    uv_async_init(&tcpctx->loop->uv_loop, &tcpctx->asynchandle, onAsyncEvent);
 
     // Accept the connection
-    uv_tcp_init(&tcpctx->server->uv_loop, &tcpctx->tcphandle);
+    uv_tcp_init(&tcpctx->loop->uv_loop, &tcpctx->tcphandle);
     if (uv_accept(server_handle, (uv_stream_t*)&tcpctx->tcphandle))
     {
         LOG_err << "uv_accept failed";
@@ -27819,7 +28754,8 @@ void MegaTCPServer::onNewClient(uv_stream_t* server_handle, int status)
         return;
     }
 
-    tcpctx->server->connections.push_back(tcpctx);
+    tcpctx->loop->connections.push_back(tcpctx);
+    tcpctx->loop->numConnections++;
     if (tcpctx->server->respondNewConnection(tcpctx))
     {
         // Start reading
@@ -27878,12 +28814,16 @@ void MegaTCPServer::onClose(uv_handle_t* handle)
 {
     MegaTCPContext* tcpctx = (MegaTCPContext*) handle->data;
 
-    // streaming transfers are automatically stopped when their listener is removed
+    // streaming transfers are automatically stopped when their listener is removed (held ones, too)
+    uv_mutex_lock(&tcpctx->mutex);
+    tcpctx->streamingTransfer = NULL;
+    uv_mutex_unlock(&tcpctx->mutex);
     tcpctx->megaApi->removeTransferListener(tcpctx);
     tcpctx->megaApi->removeRequestListener(tcpctx);
 
-    tcpctx->server->connections.remove(tcpctx);
-    LOG_debug << "Connection closed: " << tcpctx->server->connections.size() << " port = " << tcpctx->server->port << " closing async handle";
+    tcpctx->loop->connections.remove(tcpctx);
+    tcpctx->loop->numConnections--;
+    LOG_debug << "Connection closed: " << tcpctx->loop->connections.size() << " port = " << tcpctx->server->port << " closing async handle";
     uv_close((uv_handle_t *)&tcpctx->asynchandle, onAsyncEventClose);
 }
 
@@ -27893,15 +28833,15 @@ void MegaTCPServer::onAsyncEventClose(uv_handle_t *handle)
     assert(!tcpctx->writePointers.size());
 
     int port = tcpctx->server->port;
+    MegaTCPLoop *loop = tcpctx->loop;
 
-    tcpctx->server->remainingcloseevents--;
+    loop->remainingcloseevents--;
     tcpctx->server->processOnAsyncEventClose(tcpctx);
 
-    LOG_verbose << "At onAsyncEventClose port = " << tcpctx->server->port << " remaining=" << tcpctx->server->remainingcloseevents;
+    LOG_verbose << "At onAsyncEventClose port = " << tcpctx->server->port << " remaining=" << loop->remainingcloseevents;
 
-    if (!tcpctx->server->remainingcloseevents && tcpctx->server->closing && !tcpctx->server->semaphoresdestroyed)
+    if (!loop->remainingcloseevents && loop->closing && !tcpctx->server->semaphoresdestroyed)
     {
-        uv_sem_post(&tcpctx->server->semaphoreStartup);
         uv_sem_post(&tcpctx->server->semaphoreEnd);
     }
 
@@ -27994,7 +28934,9 @@ MegaTCPContext::MegaTCPContext()
     invalid = false;
 #endif
     server = NULL;
+    loop = NULL;
     megaApi = NULL;
+    streamingTransfer = NULL;
 }
 
 MegaTCPContext::~MegaTCPContext()
@@ -28007,6 +28949,15 @@ MegaTCPContext::~MegaTCPContext()
 #endif
 }
 
+void MegaTCPContext::pauseStreaming(bool pause)
+{
+    this->pause = pause;
+    if (streamingTransfer)
+    {
+        megaApi->pauseStreaming(streamingTransfer, pause);
+    }
+}
+
 void MegaTCPServer::onAsyncEvent(uv_async_t* handle)
 {
     MegaTCPContext* tcpctx = (MegaTCPContext*) handle->data;
@@ -28024,40 +28975,41 @@ void MegaTCPServer::onAsyncEvent(uv_async_t* handle)
 
 void MegaTCPServer::onExitHandleClose(uv_handle_t *handle)
 {
-    MegaTCPServer *tcpServer = (MegaTCPServer*) handle->data;
-    assert(tcpServer != NULL);
+    MegaTCPLoop *loop = (MegaTCPLoop*) handle->loop->data;
+    assert(loop != NULL);
+    MegaTCPServer *tcpServer = loop->server;
 
-    tcpServer->remainingcloseevents--;
-    LOG_verbose << "At onExitHandleClose port = " << tcpServer->port << " remainingcloseevent = " << tcpServer->remainingcloseevents;
+    loop->remainingcloseevents--;
+    LOG_verbose << "At onExitHandleClose port = " << tcpServer->port << " remainingcloseevent = " << loop->remainingcloseevents;
 
     tcpServer->processOnExitHandleClose(tcpServer);
 
-    if (!tcpServer->remainingcloseevents && !tcpServer->semaphoresdestroyed)
+    if (!loop->remainingcloseevents && !tcpServer->semaphoresdestroyed)
     {
-        uv_sem_post(&tcpServer->semaphoreStartup);
         uv_sem_post(&tcpServer->semaphoreEnd);
     }
 }
 
 void MegaTCPServer::onCloseRequested(uv_async_t *handle)
 {
-    MegaTCPServer *tcpServer = (MegaTCPServer*) handle->data;
-    LOG_debug << "TCP server stopping port=" << tcpServer->port;
+    MegaTCPLoop *loop = (MegaTCPLoop*) handle->data;
+    MegaTCPServer *tcpServer = loop->server;
+    LOG_debug << "TCP server stopping port=" << tcpServer->port << " loop=" << loop->index;
 
-    tcpServer->closing = true;
+    loop->closing = true;
 
-    for (list<MegaTCPContext*>::iterator it = tcpServer->connections.begin(); it != tcpServer->connections.end(); it++)
+    for (list<MegaTCPContext*>::iterator it = loop->connections.begin(); it != loop->connections.end(); it++)
     {
         MegaTCPContext *tcpctx = (*it);
         closeTCPConnection(tcpctx);
     }
 
-    tcpServer->remainingcloseevents++;
-    LOG_verbose << "At onCloseRequested: closing server port = " << tcpServer->port << " remainingcloseevent = " << tcpServer->remainingcloseevents;
-    uv_close((uv_handle_t *)&tcpServer->server, onExitHandleClose);
-    tcpServer->remainingcloseevents++;
-    LOG_verbose << "At onCloseRequested: closing exit_handle port = " << tcpServer->port << " remainingcloseevent = " << tcpServer->remainingcloseevents;
-    uv_close((uv_handle_t *)&tcpServer->exit_handle, onExitHandleClose);
+    loop->remainingcloseevents++;
+    LOG_verbose << "At onCloseRequested: closing server port = " << tcpServer->port << " remainingcloseevent = " << loop->remainingcloseevents;
+    uv_close((uv_handle_t *)&loop->listener, onExitHandleClose);
+    loop->remainingcloseevents++;
+    LOG_verbose << "At onCloseRequested: closing exit_handle port = " << tcpServer->port << " remainingcloseevent = " << loop->remainingcloseevents;
+    uv_close((uv_handle_t *)&loop->exit_handle, onExitHandleClose);
 }
 
 void MegaTCPServer::closeConnection(MegaTCPContext *tcpctx)
@@ -28083,8 +29035,8 @@ void MegaTCPServer::closeTCPConnection(MegaTCPContext *tcpctx)
     tcpctx->finished = true;
     if (!uv_is_closing((uv_handle_t*)&tcpctx->tcphandle))
     {
-        tcpctx->server->remainingcloseevents++;
-        LOG_verbose << "At closeTCPConnection port = " << tcpctx->server->port << " remainingcloseevent = " << tcpctx->server->remainingcloseevents;
+        tcpctx->loop->remainingcloseevents++;
+        LOG_verbose << "At closeTCPConnection port = " << tcpctx->server->port << " remainingcloseevent = " << tcpctx->loop->remainingcloseevents;
         uv_close((uv_handle_t*)&tcpctx->tcphandle, onClose);
     }
 }
@@ -28219,16 +29171,12 @@ void MegaHTTPServer::processWriteFinished(MegaTCPContext* tcpctx, int status)
 
     if (httpctx->pause)
     {
-        size_t resumeCapacity = httpctx->lastBufferLen * 2; // If httpctx->lastBufferLen is 0, then it's ok if availableSpace is > 0 : this means freeData() has been called before for a similar len
-        if (httpctx->streamingBuffer.availableSpace() > resumeCapacity)
+        if (httpctx->streamingBuffer.canResumeAfter(httpctx->lastBufferLen))
         {
-            httpctx->pause = false;
             m_off_t start = httpctx->rangeStart + httpctx->rangeWritten + httpctx->streamingBuffer.availableData();
-            m_off_t len =  httpctx->rangeEnd - httpctx->rangeStart - httpctx->rangeWritten - httpctx->streamingBuffer.availableData();
-
-            LOG_debug << "[Streaming] Resuming streaming from " << start << " len: " << len
+            LOG_debug << "[Streaming] Resuming streaming from " << start
                       << " " << httpctx->streamingBuffer.bufferStatus();
-            httpctx->megaApi->startStreaming(httpctx->node, start, len, httpctx);
+            httpctx->pauseStreaming(false);
         }
     }
     httpctx->lastBufferLen = 0;
@@ -29921,10 +30869,11 @@ void MegaHTTPServer::sendHeaders(MegaHTTPContext *httpctx, string *headers)
 {
     LOG_debug << "Response headers: " << *headers;
     httpctx->streamingBuffer.append(headers->data(), headers->size());
-    uv_buf_t resbuf = httpctx->streamingBuffer.nextBuffer();
+    size_t len = httpctx->streamingBuffer.nextBuffers(httpctx->writeBuffers, 1);
+    uv_buf_t resbuf = httpctx->writeBuffers.front();
     httpctx->size += headers->size();
     httpctx->lastBuffer = resbuf.base;
-    httpctx->lastBufferLen = resbuf.len;
+    httpctx->lastBufferLen = len;
 
     if (httpctx->transfer)
     {
@@ -30039,25 +30988,25 @@ void MegaHTTPServer::sendNextBytes(MegaHTTPContext *httpctx)
         return;
     }
 
-    uv_buf_t resbuf = httpctx->streamingBuffer.nextBuffer();
+    size_t len = httpctx->streamingBuffer.nextBuffers(httpctx->writeBuffers, httpctx->server->useTLS ? 1 : StreamingBuffer::MAX_OUTPUT_BUFFERS);
     uv_mutex_unlock(&httpctx->mutex);
 
-    if (!resbuf.len)
+    if (!len)
     {
         LOG_verbose << "[Streaming] Skipping write. No data available. " << httpctx->streamingBuffer.bufferStatus();
         return;
     }
 
-    LOG_verbose << "Writing " << resbuf.len << " bytes";
-    httpctx->rangeWritten += resbuf.len;
-    httpctx->lastBuffer = resbuf.base;
-    httpctx->lastBufferLen = resbuf.len;
+    LOG_verbose << "Writing " << len << " bytes in " << httpctx->writeBuffers.size() << " buffers";
+    httpctx->rangeWritten += len;
+    httpctx->lastBuffer = httpctx->writeBuffers.front().base;
+    httpctx->lastBufferLen = len;
 
 #ifdef ENABLE_EVT_TLS
     if (httpctx->server->useTLS)
     {
         //notice this, contrary to !useTLS is synchronous
-        int err = evt_tls_write(httpctx->evt_tls, resbuf.base, resbuf.len, onWriteFinished_tls);
+        int err = evt_tls_write(httpctx->evt_tls, httpctx->lastBuffer, len, onWriteFinished_tls);
         if (err <= 0)
         {
             LOG_warn << "[Streaming] Finishing due to an error sending the response: " << err;
@@ -30070,7 +31019,7 @@ void MegaHTTPServer::sendNextBytes(MegaHTTPContext *httpctx)
         uv_write_t *req = new uv_write_t();
         req->data = httpctx;
 
-        if (int err = uv_write(req, (uv_stream_t*)&httpctx->tcphandle, &resbuf, 1, onWriteFinished))
+        if (int err = uv_write(req, (uv_stream_t*)&httpctx->tcphandle, httpctx->writeBuffers.data(), unsigned(httpctx->writeBuffers.size()), onWriteFinished))
         {
             delete req;
             LOG_warn << "[Streaming] Finishing due to an error in uv_write: " << err;
@@ -30144,25 +31093,38 @@ bool MegaHTTPContext::onTransferData(MegaApi *, MegaTransfer *transfer, char *bu
         return false;
     }
 
-    // append the data to the buffer
+    // append the data to the buffer, keeping the downloaded piece rather than copying it
     uv_mutex_lock(&mutex);
-    long long remaining = size + (transfer->getTotalBytes() - transfer->getTransferredBytes());
-    long long availableSpace = streamingBuffer.availableSpace();
-    if (remaining > availableSpace && availableSpace < (2 * m_off_t(size)))
+    streamingTransfer = static_cast<MegaTransferPrivate*>(transfer);
+    m_off_t remaining = size + (transfer->getTotalBytes() - transfer->getTransferredBytes());
+    if (!pause && streamingBuffer.isFullFor(size, remaining))
     {
         LOG_debug << "[Streaming] Buffer full: Pausing streaming. " << streamingBuffer.bufferStatus();
-        pause = true;
+        pauseStreaming(true);
+    }
+    const std::shared_ptr<void>& owner = streamingTransfer->getLastBytesOwner();
+    if (owner && buffer == streamingTransfer->getLastBytes())
+    {
+        streamingBuffer.append(buffer, size, owner);
+    }
+    else
+    {
+        streamingBuffer.append(buffer, size);
     }
-    streamingBuffer.append(buffer, size);
     uv_mutex_unlock(&mutex);
 
     // notify the HTTP server
     uv_async_send(&asynchandle);
-    return !pause;
+    return true;
 }
 
 void MegaHTTPContext::onTransferFinish(MegaApi *, MegaTransfer *, MegaError *e)
 {
+    // the transfer is about to be deleted
+    uv_mutex_lock(&mutex);
+    streamingTransfer = NULL;
+    uv_mutex_unlock(&mutex);
+
     if (finished)
     {
         LOG_debug << "HTTP link closed, ignoring the result of the transfer";
@@ -32213,13 +33175,10 @@ void MegaFTPDataServer::processWriteFinished(MegaTCPContext *tcpctx, int status)
         {
             if (ftpdatactx->streamingBuffer.availableSpace() > ftpdatactx->streamingBuffer.availableCapacity() / 2)
             {
-                ftpdatactx->pause = false;
                 m_off_t start = ftpdatactx->rangeStart + ftpdatactx->rangeWritten + ftpdatactx->streamingBuffer.availableData();
-                m_off_t len =  ftpdatactx->rangeEnd - ftpdatactx->rangeStart -  ftpdatactx->rangeWritten - ftpdatactx->streamingBuffer.availableData();
-
-                LOG_debug << "[Streaming] Resuming streaming from " << start << " len: " << len
+                LOG_debug << "[Streaming] Resuming streaming from " << start
                           << " " << ftpdatactx->streamingBuffer.bufferStatus();
-                ftpdatactx->megaApi->startStreaming(ftpdatactx->node, start, len, ftpdatactx);
+                ftpdatactx->pauseStreaming(false);
             }
         }
         uv_mutex_unlock(&ftpdatactx->mutex);
@@ -32234,9 +33193,11 @@ void MegaFTPDataServer::sendData()
 
     this->notifyNewConnectionRequired = true;
 
-    if (connections.size())
+    // FTP data servers run a single loop
+    list<MegaTCPContext*> *connections = loops.size() ? &loops.front()->connections : NULL;
+    if (connections && connections->size())
     {
-        tcpctx = connections.back(); //only interested in the last connection received (the one that needs response)
+        tcpctx = connections->back(); //only interested in the last connection received (the one that needs response)
     }
     //Some client might create connections before receiving a 150 in the control channel (e.g: ftp linux command)
     // This could cause never answered / never closed connections.
@@ -32500,7 +33461,7 @@ void MegaFTPDataServer::processOnAsyncEventClose(MegaTCPContext* tcpctx)
     MegaFTPDataContext* ftpdatactx = dynamic_cast<MegaFTPDataContext *>(tcpctx);
     MegaFTPDataServer *fds = ((MegaFTPDataServer *)ftpdatactx->server);
 
-    LOG_verbose << "MegaFTPDataServer::processOnAsyncEventClose. tcpctx=" << tcpctx << " port = " << fds->port << " remaining = " << fds->remainingcloseevents;
+    LOG_verbose << "MegaFTPDataServer::processOnAsyncEventClose. tcpctx=" << tcpctx << " port = " << fds->port << " remaining = " << tcpctx->loop->remainingcloseevents;
 
     fds->remotePathToUpload = "";
 
@@ -32511,7 +33472,7 @@ void MegaFTPDataServer::processOnAsyncEventClose(MegaTCPContext* tcpctx)
         ftpdatactx->transfer = NULL; // this has been deleted in fireOnStreamingFinish
     }
 
-    if (!fds->remainingcloseevents && fds->closing)
+    if (!tcpctx->loop->remainingcloseevents && tcpctx->loop->closing)
     {
         LOG_verbose << "MegaFTPDataServer::processOnAsyncEventClose stopping without waiting. port = " << fds->port;
         fds->stop(true);
@@ -32570,25 +33531,25 @@ void MegaFTPDataServer::sendNextBytes(MegaFTPDataContext *ftpdatactx)
         return;
     }
 
-    uv_buf_t resbuf = ftpdatactx->streamingBuffer.nextBuffer();
+    size_t len = ftpdatactx->streamingBuffer.nextBuffers(ftpdatactx->writeBuffers, ftpdatactx->server->useTLS ? 1 : StreamingBuffer::MAX_OUTPUT_BUFFERS);
     uv_mutex_unlock(&ftpdatactx->mutex);
 
-    if (!resbuf.len)
+    if (!len)
     {
         LOG_verbose << "[Streaming] Skipping write. No data available. " << ftpdatactx->streamingBuffer.bufferStatus();
         return;
     }
 
-    LOG_verbose << "Writing " << resbuf.len << " bytes" << " buffered = " << ftpdatactx->streamingBuffer.availableData();
-    ftpdatactx->rangeWritten += resbuf.len;
-    ftpdatactx->lastBuffer = resbuf.base;
-    ftpdatactx->lastBufferLen = resbuf.len;
+    LOG_verbose << "Writing " << len << " bytes in " << ftpdatactx->writeBuffers.size() << " buffers" << " buffered = " << ftpdatactx->streamingBuffer.availableData();
+    ftpdatactx->rangeWritten += len;
+    ftpdatactx->lastBuffer = ftpdatactx->writeBuffers.front().base;
+    ftpdatactx->lastBufferLen = len;
 
 #ifdef ENABLE_EVT_TLS
     if (ftpdatactx->server->useTLS)
     {
         //notice this, contrary to !useTLS is synchronous
-        int err = evt_tls_write(ftpdatactx->evt_tls, resbuf.base, resbuf.len, onWriteFinished_tls);
+        int err = evt_tls_write(ftpdatactx->evt_tls, ftpdatactx->lastBuffer, len, onWriteFinished_tls);
         if (err <= 0)
         {
             LOG_warn << "[Streaming] Finishing due to an error sending the response: " << err;
@@ -32601,7 +33562,7 @@ void MegaFTPDataServer::sendNextBytes(MegaFTPDataContext *ftpdatactx)
         uv_write_t *req = new uv_write_t();
         req->data = ftpdatactx;
 
-        if (int err = uv_write(req, (uv_stream_t*)&ftpdatactx->tcphandle, &resbuf, 1, onWriteFinished))
+        if (int err = uv_write(req, (uv_stream_t*)&ftpdatactx->tcphandle, ftpdatactx->writeBuffers.data(), unsigned(ftpdatactx->writeBuffers.size()), onWriteFinished))
         {
             delete req;
             LOG_warn << "[Streaming] Finishing due to an error in uv_write: " << err;
@@ -32663,26 +33624,39 @@ bool MegaFTPDataContext::onTransferData(MegaApi *, MegaTransfer *transfer, char
         return false;
     }
 
-    // append the data to the buffer
+    // append the data to the buffer, keeping the downloaded piece rather than copying it
     uv_mutex_lock(&mutex);
-    long long remaining = size + (transfer->getTotalBytes() - transfer->getTransferredBytes());
-    long long availableSpace = streamingBuffer.availableSpace();
-    if (remaining > availableSpace && availableSpace < (2 * m_off_t(size)))
+    streamingTransfer = static_cast<MegaTransferPrivate*>(transfer);
+    m_off_t remaining = size + (transfer->getTotalBytes() - transfer->getTransferredBytes());
+    if (!pause && streamingBuffer.isFullFor(size, remaining))
     {
         LOG_debug << "[Streaming] Buffer full: Pausing streaming. " << streamingBuffer.bufferStatus();
-        pause = true;
+        pauseStreaming(true);
+    }
+    const std::shared_ptr<void>& owner = streamingTransfer->getLastBytesOwner();
+    if (owner && buffer == streamingTransfer->getLastBytes())
+    {
+        streamingBuffer.append(buffer, size, owner);
+    }
+    else
+    {
+        streamingBuffer.append(buffer, size);
     }
-    streamingBuffer.append(buffer, size);
     uv_mutex_unlock(&mutex);
 
     // notify the HTTP server
     uv_async_send(&asynchandle);
-    return !pause;
+    return true;
 }
 
 void MegaFTPDataContext::onTransferFinish(MegaApi *, MegaTransfer *, MegaError *e)
 {
     LOG_verbose << "MegaFTPDataContext::onTransferFinish";
+
+    // the transfer is about to be deleted
+    uv_mutex_lock(&mutex);
+    streamingTransfer = NULL;
+    uv_mutex_unlock(&mutex);
     if (finished)
     {
         LOG_debug << "FTP Data link closed";
@@ -33685,41 +34659,6 @@ long long MegaFolderInfoPrivate::getVersionsSize() const
     return versionsSize;
 }
 
-TreeProcFolderInfo::TreeProcFolderInfo()
-{
-    numFiles = 0;
-    numFolders = 0;
-    numVersions = 0;
-    currentSize = 0;
-    versionsSize = 0;
-}
-
-void TreeProcFolderInfo::proc(MegaClient *, Node *node)
-{
-    if (node->parent && node->parent->type == FILENODE)
-    {
-        numVersions++;
-        versionsSize += node->size;
-    }
-    else
-    {
-        if (node->type == FILENODE)
-        {
-            numFiles++;
-            currentSize += node->size;
-        }
-        else
-        {
-            numFolders++;
-        }
-    }
-}
-
-MegaFolderInfo *TreeProcFolderInfo::getResult()
-{
-    return new MegaFolderInfoPrivate(numFiles, numFolders - 1, numVersions, currentSize, versionsSize);
-}
-
 MegaTimeZoneDetailsPrivate::MegaTimeZoneDetailsPrivate(vector<std::string> *timeZones, vector<int> *timeZoneOffsets, int defaultTimeZone)
 {
     this->timeZones = *timeZones;
@@ -65,6 +65,9 @@ const unsigned MegaClient::MAXTOTALTRANSFERS = 48;
 // maximum number of concurrent transfers (uploads or downloads)
 const unsigned MegaClient::MAXTRANSFERS = 32;
 
+// ceiling of concurrent transfers (uploads or downloads) when throughput keeps growing with them
+const unsigned MegaClient::MAXADAPTIVETRANSFERS = 128;
+
 // maximum number of queued putfa before halting the upload queue
 const int MegaClient::MAXQUEUEDFA = 30;
 
@@ -1041,6 +1044,25 @@ void MegaClient::honorPreviousVersionAttrs(Node *previousNode, AttrMap &attrs)
     }
 }
 
+vector<Node*> MegaClient::childrenByName(const Node* p, const string& name) const
+{
+    if (mLoadedOnDemand)
+    {
+        // loading nodes is not a logical change of the client; placeholder names
+        // (nodes without a decrypted name) are not in the name hashes
+        if (ChildNameIndex::isPlaceholder(name))
+        {
+            const_cast<MegaClient*>(this)->loadChildren(const_cast<Node*>(p));
+        }
+        else
+        {
+            const_cast<MegaClient*>(this)->loadChildrenByName(const_cast<Node*>(p), name);
+        }
+    }
+
+    return p->childrenByName(name);
+}
+
 // returns a matching child node by UTF-8 name (does not resolve name clashes)
 // folder nodes take precedence over file nodes
 const Node* MegaClient::childnodebyname(const Node* p, const char* name, bool skipfolders) const
@@ -1055,26 +1077,23 @@ const Node* MegaClient::childnodebyname(const Node* p, const char* name, bool sk
 
     LocalPath::utf8_normalize(&nname);
 
-    for (node_list::const_iterator it = p->children.begin(); it != p->children.end(); it++)
+    for (const Node* child : childrenByName(p, nname))
     {
-        if (!strcmp(nname.c_str(), (*it)->displayname()))
+        if (child->type == FILENODE)
         {
-            if ((*it)->type == FILENODE)
+            if (skipfolders)
             {
-                if (skipfolders)
-                {
-                    return *it; // FOLDERs ignored, return first FILE
-                }
-                else
-                {
-                    found = *it; // FOLDERs not ignored and with precedence, save FILE in case no FOLDER is found
-                }
+                return child; // FOLDERs ignored, return first FILE
             }
-            else if (!skipfolders)
+            else
             {
-                return *it; // FOLDER not ignored and with precedence, return first FOLDER
+                found = child; // FOLDERs not ignored and with precedence, save FILE in case no FOLDER is found
             }
         }
+        else if (!skipfolders)
+        {
+            return child; // FOLDER not ignored and with precedence, return first FOLDER
+        }
     }
 
     return found;
@@ -1099,12 +1118,11 @@ Node* MegaClient::childnodebynametype(Node* p, const char* name, nodetype_t must
 
     LocalPath::utf8_normalize(&nname);
 
-    for (auto it : p->children)
+    for (Node* child : childrenByName(p, nname))
     {
-        if (it->type == mustBeType &&
-            !strcmp(nname.c_str(), it->displayname()))
+        if (child->type == mustBeType)
         {
-            return it;
+            return child;
         }
     }
 
@@ -1147,14 +1165,11 @@ vector<Node*> MegaClient::childnodesbyname(Node* p, const char* name, bool skipf
 
     LocalPath::utf8_normalize(&nname);
 
-    for (node_list::iterator it = p->children.begin(); it != p->children.end(); it++)
+    for (Node* child : childrenByName(p, nname))
     {
-        if (nname == (*it)->displayname())
+        if (child->type == FILENODE || !skipfolders)
         {
-            if ((*it)->type == FILENODE || !skipfolders)
-            {
-                found.push_back(*it);
-            }
+            found.push_back(child);
         }
     }
 
@@ -1168,19 +1183,17 @@ Node* MegaClient::childNodeTypeByName(Node *p, const char *name, nodetype_t type
         return nullptr;
     }
 
-    Node *found = nullptr;
     string nname = name;
     LocalPath::utf8_normalize(&nname);
-    for (node_list::iterator it = p->children.begin(); it != p->children.end(); it++)
+    for (Node* child : childrenByName(p, nname))
     {
         // if name and node type matches
-        if (((*it)->type == type) && !strcmp(nname.c_str(), (*it)->displayname()))
+        if (child->type == type)
         {
-            found = *it;
-            break;
+            return child;
         }
     }
-    return found;
+    return nullptr;
 }
 
 void MegaClient::init()
@@ -1372,8 +1385,13 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, unique_ptr<FileSystemAc
 
     userid = 0;
 
-    connections[PUT] = 3;
-    connections[GET] = 4;
+    mTransferLimits.setDefaults(PUT, MAXTRANSFERS, 3);
+    mTransferLimits.setDefaults(GET, MAXTRANSFERS, 4);
+    mTransferLimits.setCeilings(PUT, MAXADAPTIVETRANSFERS, MAX_NUM_CONNECTIONS);
+    mTransferLimits.setCeilings(GET, MAXADAPTIVETRANSFERS, MAX_NUM_CONNECTIONS);
+
+    // no more than 100 MB queued per transfer category, whatever the goodput
+    mTransferLimits.setOutstandingCeiling(100 * 1024 * 1024);
 
     reqtag = 0;
 
@@ -1415,6 +1433,25 @@ MegaClient::~MegaClient()
     LOG_debug << clientname << "~MegaClient completing";
 }
 
+shared_ptr<LocalFingerprintCache> MegaClient::fingerprintCache()
+{
+    if (!mFingerprintCacheOpened && dbaccess)
+    {
+        mFingerprintCacheOpened = true;
+
+        if (DbTable* table = dbaccess->open(rng, *fsaccess, "fingerprints", DB_OPEN_FLAG_FINGERPRINTS))
+        {
+            mFingerprintCache = std::make_shared<LocalFingerprintCache>(unique_ptr<DbTable>(table));
+        }
+        else
+        {
+            LOG_warn << "Unable to open the fingerprint cache";
+        }
+    }
+
+    return mFingerprintCache;
+}
+
 void MegaClient::resetId(char *id, size_t length)
 {
     for (size_t i = length; i--; )
@@ -1563,6 +1600,9 @@ void MegaClient::exec()
 
         looprequested = false;
 
+        // putnodes of uploads completed outside of the transfer slots
+        mPutnodesBatcher.flush(this);
+
         if (cachedug && btugexpiration.armed())
         {
             LOG_debug << "Cached user data expired";
@@ -1926,6 +1966,12 @@ void MegaClient::exec()
                         break;
 
                     case REQ_INFLIGHT:
+                        if (pendingcs->mChunked)
+                        {
+                            // parse what arrived so far, and let go of it
+                            pendingcs->purge(reqs.serverchunk(pendingcs->data(), pendingcs->size(), this));
+                        }
+
                         if (pendingcs->contentlength > 0)
                         {
                             if (fetchingnodes && fnstats.timeToFirstByte == NEVER
@@ -1948,9 +1994,9 @@ void MegaClient::exec()
                         abortlockrequest();
                         app->request_response_progress(pendingcs->bufpos, -1);
 
-                        if (pendingcs->in != "-3" && pendingcs->in != "-4")
+                        if (reqs.chunksstarted() || (pendingcs->in != "-3" && pendingcs->in != "-4"))
                         {
-                            if (*pendingcs->in.c_str() == '[')
+                            if (reqs.chunksstarted() || *pendingcs->in.c_str() == '[')
                             {
                                 CodeCounter::ScopeTimer ccst(performanceStats.csSuccessProcessingTime);
 
@@ -1967,7 +2013,14 @@ void MegaClient::exec()
                                 }
 
                                 // request succeeded, process result array
-                                reqs.serverresponse(std::move(pendingcs->in), this);
+                                if (reqs.chunksstarted())
+                                {
+                                    reqs.serverlastchunk(pendingcs->data(), pendingcs->size(), this);
+                                }
+                                else
+                                {
+                                    reqs.serverresponse(std::move(pendingcs->in), this);
+                                }
 
                                 WAIT_CLASS::bumpds();
 
@@ -2152,6 +2205,9 @@ void MegaClient::exec()
                     bool suppressSID = true;
                     reqs.serverrequest(pendingcs->out, suppressSID, pendingcs->includesFetchingNodes);
 
+                    // large responses (fetchnodes) are parsed while they download, instead of buffering them
+                    pendingcs->mChunked = reqs.inflightchunked() && httpio->chunkedresponses();
+
                     pendingcs->posturl = httpio->APIURL;
 
                     pendingcs->posturl.append("cs?id=");
@@ -2573,6 +2629,9 @@ void MegaClient::exec()
             LOG_debug << "skipping slots doio while blocked";
         }
 
+        // one putnodes per folder for the uploads completed in this loop
+        mPutnodesBatcher.flush(this);
+
 #ifdef ENABLE_SYNC
         // verify filesystem fingerprints, disable deviating syncs
         // (this covers mountovers, some device removals and some failures)
@@ -2904,6 +2963,12 @@ void MegaClient::exec()
                 {
                     LOG_debug << "Scan queue processed, triggering a scan";
                     syncdownrequired = true;
+
+                    // the fingerprints of the pass don't wait for a full batch
+                    if (mFingerprintCache)
+                    {
+                        mFingerprintCache->flush();
+                    }
                 }
 
                 notifypurge();
@@ -3266,6 +3331,8 @@ void MegaClient::exec()
     }
 #endif
 
+    evictnodes();
+
     reportLoggedInChanges();
 }
 
@@ -3711,6 +3778,16 @@ void MegaClient::dispatchTransfers()
         }
     }
 
+    // adapt the limits to the throughput of the active transfers
+    std::array<unsigned, 2> active = { 0, 0 };
+    for (TransferSlot* ts : tslots)
+    {
+        assert(ts->transfer->type == PUT || ts->transfer->type == GET);
+        active[ts->transfer->type]++;
+    }
+    mTransferLimits.update(GET, httpio->downloadSpeed, active[GET], Waiter::ds);
+    mTransferLimits.update(PUT, httpio->uploadSpeed, active[PUT], Waiter::ds);
+
     // do we have any transfer slots available?
     if (!slotavail())
     {
@@ -3756,14 +3833,15 @@ void MegaClient::dispatchTransfers()
 
     std::function<bool(direction_t)> continueDirection = [&counters, this](direction_t putget) {
 
-            // hard limit on puts/gets
-            if (counters[putget].total >= MAXTRANSFERS)
+            // limit on puts/gets
+            unsigned maxTransfers = mTransferLimits.limits(putget).transfers;
+            if (counters[putget].total >= maxTransfers)
             {
                 return false;
             }
 
             // only request half the max at most, to get a quicker response from the API and get overlap with transfers going
-            if (counters[putget].added >= MAXTRANSFERS/2)
+            if (counters[putget].added >= std::max(maxTransfers / 2, 1u))
             {
                 return false;
             }
@@ -3783,11 +3861,7 @@ void MegaClient::dispatchTransfers()
 
             // queue up enough transfers that we can expect to keep busy for at least the next 30 seconds in this category
             m_off_t speed = (tc.direction == GET) ? httpio->downloadSpeed : httpio->uploadSpeed;
-            m_off_t targetOutstanding = 30 * speed;
-            targetOutstanding = std::max<m_off_t>(targetOutstanding, 2 * 1024 * 1024);
-            targetOutstanding = std::min<m_off_t>(targetOutstanding, 100 * 1024 * 1024);
-
-            if (counters[tc.index()].remainingsum >= targetOutstanding)
+            if (counters[tc.index()].remainingsum >= mTransferLimits.targetOutstanding(speed))
             {
                 return false;
             }
@@ -4115,7 +4189,11 @@ void MegaClient::dispatchTransfers()
                                     Node *n = nodebyhandle(ph);
                                     if (n)
                                     {
+                                        mFingerprints.remove(n);
+                                        n->countInAncestors(n->subnodeCounts(), false);
                                         n->size = s;
+                                        n->countInAncestors(n->subnodeCounts(), true);
+                                        mFingerprints.add(n);
                                         notifynode(n);
                                     }
                                 }
@@ -4450,6 +4528,7 @@ void MegaClient::locallogout(bool removecaches, bool keepSyncsConfigFile)
     purgenodesusersabortsc(false);
 
     reqs.clear();
+    mPutnodesBatcher.clear();
 
     delete pendingcs;
     pendingcs = NULL;
@@ -5169,15 +5248,23 @@ void MegaClient::initsc()
         if (complete)
         {
             // 3. write new or modified nodes, purge deleted nodes
+            DbTableNodes* table = nodeTable();
             for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
             {
-                if (!(complete = sctable->put(CACHEDNODE, it->second, &key)))
+                if (!(complete = table ? putNodeRecord(*table, it->second) : sctable->put(CACHEDNODE, it->second, &key)))
                 {
                     break;
                 }
             }
         }
 
+        if (complete)
+        {
+            // 3b. write the search index of those nodes
+            mSearchIndex.forgetStored();
+            complete = mSearchIndex.store(*sctable, CACHEDSEARCHINDEX, &key, tscsn);
+        }
+
         if (complete)
         {
             // 4. write new or modified pcrs, purge deleted pcrs
@@ -5208,6 +5295,12 @@ void MegaClient::initsc()
         LOG_debug << "Saving SCSN " << scsn.text() << " with " << nodes.size() << " nodes and " << users.size() << " users and " << pcrindex.size() << " pcrs to local cache (" << complete << ")";
 #endif
         finalizesc(complete);
+
+        if (complete && mNodesOnDemand && nodeTable() && !mLoadedOnDemand)
+        {
+            // all nodes are in the node table now: from here on, they can be evicted and loaded back
+            startLoadedOnDemand();
+        }
     }
 }
 
@@ -5281,7 +5374,12 @@ void MegaClient::updatesc()
             }
         }
 
-        if (complete)
+        if (complete && nodeTable())
+        {
+            // 3. write new or modified nodes, purge deleted nodes
+            complete = updatenodetable(*nodeTable());
+        }
+        else if (complete)
         {
             // 3. write new or modified nodes, purge deleted nodes
             for (node_vector::iterator it = nodenotify.begin(); it != nodenotify.end(); it++)
@@ -5309,6 +5407,12 @@ void MegaClient::updatesc()
             }
         }
 
+        if (complete)
+        {
+            // 3b. write the changes to the search index
+            complete = mSearchIndex.store(*sctable, CACHEDSEARCHINDEX, &key, tscsn);
+        }
+
         if (complete)
         {
             // 4. write new or modified pcrs, purge deleted pcrs
@@ -5359,6 +5463,424 @@ void MegaClient::updatesc()
     }
 }
 
+// write the changed nodes to the typed node table
+bool MegaClient::updatenodetable(DbTableNodes& table)
+{
+    // removals first: removing a node also removes the records still stored below it,
+    // which must not include nodes moved elsewhere in this same batch
+    for (Node* n : nodenotify)
+    {
+        if (n->changed.removed)
+        {
+            LOG_verbose << "Removing node from database: " << toNodeHandle(n->nodehandle);
+            if ((n->dbid && !sctable->del(n->dbid)) || !table.delNodeTree(n->nodeHandle()))
+            {
+                return false;
+            }
+        }
+    }
+
+    for (Node* n : nodenotify)
+    {
+        if (!n->changed.removed)
+        {
+            // nodes read from statecache records move to the typed table
+            if (n->dbid)
+            {
+                if (!sctable->del(n->dbid))
+                {
+                    return false;
+                }
+                n->dbid = 0;
+            }
+
+            LOG_verbose << "Adding node to database: " << toNodeHandle(n->nodehandle);
+            if (!putNodeRecord(table, n))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+DbTableNodes* MegaClient::nodeTable() const
+{
+    auto table = dynamic_cast<DbTableNodes*>(sctable.get());
+    return table && table->hasNodesTable() ? table : nullptr;
+}
+
+bool MegaClient::putNodeRecord(DbTableNodes& table, Node* n)
+{
+    string data;
+
+    if (!n->serialize(&data))
+    {
+        // like DbTable::put(), let the SDK continue and save the rest of the nodes
+        LOG_warn << "Serialization failed: " << toNodeHandle(n->nodehandle);
+        return true;
+    }
+
+    PaddedCBC::encrypt(rng, &data, &key);
+
+    DbTableNodes::NodeColumns columns;
+    columns.handle = n->nodeHandle();
+    columns.parent = n->parent ? n->parent->nodeHandle() : NodeHandle().set6byte(n->parenthandle);
+    columns.type = n->type;
+    columns.size = n->size;
+
+    if (n->type == FILENODE)
+    {
+        columns.mtime = n->mtime;
+        columns.fingerprint = fingerprintColumn(*n);
+    }
+
+    auto it = n->attrs.map.find('n');
+    if (it != n->attrs.map.end())
+    {
+        columns.nameHash = nodeNameHash(it->second);
+    }
+
+    return table.putNode(columns, data);
+}
+
+// what FileFingerprintCmp compares
+string MegaClient::fingerprintColumn(const FileFingerprint& fingerprint)
+{
+    string column;
+    column.append(reinterpret_cast<const char*>(&fingerprint.size), sizeof(fingerprint.size));
+    column.append(reinterpret_cast<const char*>(&fingerprint.mtime), sizeof(fingerprint.mtime));
+    column.append(reinterpret_cast<const char*>(fingerprint.crc.data()), sizeof(fingerprint.crc));
+    return column;
+}
+
+// keyed, so that names can't be guessed from the local cache
+uint64_t MegaClient::nodeNameHash(const string& name) const
+{
+    HMACSHA256 hmac(key.key, sizeof key.key);
+    hmac.add(reinterpret_cast<const byte*>(name.data()), name.size());
+
+    byte digest[32];
+    hmac.get(digest);
+    return MemAccess::get<uint64_t>(reinterpret_cast<const char*>(digest));
+}
+
+Node* MegaClient::loadNodeRecord(string& content)
+{
+    if (!PaddedCBC::decrypt(&content, &key))
+    {
+        LOG_err << "Failed - node record decryption error";
+        return nullptr;
+    }
+
+    // the parent is loaded (if stored) by the lookup in the Node constructor
+    node_vector dp;
+    bool paging = mPagingNodes;
+    mPagingNodes = true;
+    Node* n = Node::unserialize(this, &content, &dp);
+    mPagingNodes = paging;
+    if (!n)
+    {
+        LOG_err << "Failed - node record read error";
+        return nullptr;
+    }
+
+    pagedIn(n);
+    mergenewshares(0);
+    lruMeasure(n);
+    return n;
+}
+
+// a node loaded from the node table was not counted in its ancestors, that already
+// include it: its own aggregate counts come from the table too
+void MegaClient::pagedIn(Node* n)
+{
+    DbTableNodes* table = nodeTable();
+
+    if (n->subtreeCounts && table)
+    {
+        // the node itself, as in the Node constructor, and everything below it
+        NodeCounter nc;
+        nc.folders = n->type == FOLDERNODE;
+        table->getSubtreeCounts(n->nodeHandle(), false, nc);
+        *n->subtreeCounts = nc;
+    }
+    else if (n->type == FILENODE)
+    {
+        // a file adds up its counts from its versions, so they are loaded and evicted with it
+        loadChildren(n);
+    }
+}
+
+void MegaClient::pageInChildren(Node* n)
+{
+    if (mLoadedOnDemand && n)
+    {
+        loadChildren(n);
+    }
+}
+
+void MegaClient::pageInSubtree(Node* n)
+{
+    if (mLoadedOnDemand && n)
+    {
+        loadSubtree(n);
+    }
+}
+
+Node* MegaClient::loadNode(NodeHandle h)
+{
+    DbTableNodes* table = nodeTable();
+    string content;
+
+    if (!table || h.isUndef() || !table->getNode(h, &content))
+    {
+        return nullptr;
+    }
+
+    return loadNodeRecord(content);
+}
+
+node_vector MegaClient::loadNodeRows(DbTableNodes::NodeRows& rows)
+{
+    node_vector loaded;
+    loaded.reserve(rows.size());
+
+    for (auto& row : rows)
+    {
+        auto it = nodes.find(row.first);
+        Node* n = it != nodes.end() ? it->second : loadNodeRecord(row.second);
+        if (n)
+        {
+            loaded.push_back(n);
+        }
+    }
+
+    return loaded;
+}
+
+node_vector MegaClient::loadChildren(Node* parent)
+{
+    DbTableNodes::NodeRows rows;
+    DbTableNodes* table = nodeTable();
+
+    if (table && parent)
+    {
+        table->getChildren(parent->nodeHandle(), rows);
+    }
+
+    return loadNodeRows(rows);
+}
+
+node_vector MegaClient::loadChildrenByName(Node* parent, const string& name)
+{
+    DbTableNodes::NodeRows rows;
+    DbTableNodes* table = nodeTable();
+
+    if (table && parent)
+    {
+        table->getChildrenByNameHash(parent->nodeHandle(), nodeNameHash(name), rows);
+    }
+
+    return loadNodeRows(rows);
+}
+
+node_vector MegaClient::loadNodesByFingerprint(const FileFingerprint& fingerprint)
+{
+    DbTableNodes::NodeRows rows;
+    DbTableNodes* table = nodeTable();
+
+    if (table)
+    {
+        table->getNodesByFingerprint(fingerprintColumn(fingerprint), rows);
+    }
+
+    return loadNodeRows(rows);
+}
+
+size_t MegaClient::loadSubtree(Node* n)
+{
+    DbTableNodes::NodeRows rows;
+    DbTableNodes* table = nodeTable();
+
+    if (table && n)
+    {
+        table->getSubtree(n->nodeHandle(), rows);
+    }
+
+    return loadNodeRows(rows).size();
+}
+
+shared_ptr<const NodeNameSnapshot> MegaClient::nameSnapshot()
+{
+    if (!mNameSnapshot)
+    {
+        node_vector tops;
+        tops.push_back(nodeByHandle(rootnodes.files));
+        tops.push_back(nodeByHandle(rootnodes.vault));
+        tops.push_back(nodeByHandle(rootnodes.rubbish));
+        for (auto& it : users)
+        {
+            for (handle h : it.second.sharing)
+            {
+                Node* n = nodebyhandle(h);
+                if (n && !n->parent)
+                {
+                    tops.push_back(n);
+                }
+            }
+        }
+
+        // with all the names: nodes loaded or evicted later don't change it
+        for (Node* top : tops)
+        {
+            pageInSubtree(top);
+        }
+
+        mNameSnapshot = std::make_shared<const NodeNameSnapshot>(tops);
+        LOG_debug << "Node name snapshot built with " << mNameSnapshot->size() << " nodes";
+    }
+    return mNameSnapshot;
+}
+
+void MegaClient::setNodesMemoryBudget(size_t bytes)
+{
+    mNodesMemoryBudget = bytes;
+    mNodesMemoryFloor = 0;
+}
+
+void MegaClient::lruAdd(Node* n)
+{
+    if (mLoadedOnDemand && n->lru_it == mNodeLru.end())
+    {
+        n->lru_it = mNodeLru.insert(mNodeLru.begin(), n);
+        n->lruMemory = 0;
+    }
+}
+
+void MegaClient::lruRemove(Node* n)
+{
+    if (n->lru_it != mNodeLru.end())
+    {
+        mNodeLru.erase(n->lru_it);
+        n->lru_it = mNodeLru.end();
+        mNodesMemory -= n->lruMemory;
+        n->lruMemory = 0;
+    }
+}
+
+// approximate: the node, its strings and attributes, and its entries in the
+// client's containers (node map, fingerprint set and LRU list)
+void MegaClient::lruMeasure(Node* n)
+{
+    if (n->lru_it == mNodeLru.end())
+    {
+        return;
+    }
+
+    size_t bytes = sizeof(Node) + 3 * 64;
+    bytes += n->nodekeyUnchecked().capacity() + n->fileattrstring.capacity();
+    for (auto& attr : n->attrs.map)
+    {
+        bytes += 64 + attr.second.capacity();
+    }
+
+    mNodesMemory += bytes - n->lruMemory;
+    n->lruMemory = bytes;
+}
+
+void MegaClient::startLoadedOnDemand()
+{
+    mLoadedOnDemand = true;
+    mNodesMemoryFloor = 0;
+
+    for (auto& it : nodes)
+    {
+        lruAdd(it.second);
+        lruMeasure(it.second);
+    }
+}
+
+// the node is stored unchanged in the local cache, and only referenced by its parent
+// (a file together with its versions, that are loaded and evicted with it)
+bool MegaClient::isEvictable(const Node* n) const
+{
+    if (!n->parent || n->parent->type == FILENODE || (n->type != FILENODE && !n->children.empty()))
+    {
+        return false;
+    }
+
+    for (const Node* v = n; v; v = v->children.back())
+    {
+        if (v->children.size() > 1 || v->notified || v->attrstring
+                || v->inshare || v->outshares || v->pendingshares || v->plink
+                || v->sharekey || v->appdata || hdrns.count(v->nodehandle))
+        {
+            return false;
+        }
+
+#ifdef ENABLE_SYNC
+        if (v->localnode || v->syncget || v->todebris_it != toDebris.end() || v->tounlink_it != toUnlink.end())
+        {
+            return false;
+        }
+#endif
+    }
+
+    return true;
+}
+
+// delete a node and its versions, oldest first, leaving the counts as they are
+size_t MegaClient::evictnode(Node* n)
+{
+    size_t evicted = 0;
+    while (!n->children.empty())
+    {
+        evicted += evictnode(n->children.back());
+    }
+
+    nodes.erase(n->nodeHandle());
+    delete n;
+    return evicted + 1;
+}
+
+// delete least recently used nodes until the loaded ones fit the memory budget
+// (called at the end of exec(), so no Node* is held by the caller)
+void MegaClient::evictnodes()
+{
+    if (!mLoadedOnDemand || !mNodesMemoryBudget || !sctable || !scsn.ready()
+            || mNodesMemory <= std::max(mNodesMemoryBudget, mNodesMemoryFloor))
+    {
+        return;
+    }
+
+    size_t evicted = 0;
+    mPagingNodes = true;
+
+    // visit each node at most once: those that can't go now move to the front
+    for (size_t pending = mNodeLru.size(); pending && mNodesMemory > mNodesMemoryBudget && !mNodeLru.empty(); --pending)
+    {
+        Node* n = mNodeLru.back();
+
+        if (isEvictable(n))
+        {
+            evicted += evictnode(n);
+        }
+        else
+        {
+            mNodeLru.splice(mNodeLru.begin(), mNodeLru, n->lru_it);
+        }
+    }
+
+    mPagingNodes = false;
+
+    // don't scan again for every new node when what is left can't be evicted
+    mNodesMemoryFloor = mNodesMemory > mNodesMemoryBudget ? mNodesMemory + mNodesMemoryBudget / 16 : 0;
+
+    LOG_debug << "Evicted " << evicted << " nodes, " << nodes.size() << " left in " << mNodesMemory << " bytes";
+}
+
 // commit or purge local state cache
 void MegaClient::finalizesc(bool complete)
 {
@@ -5374,6 +5896,13 @@ void MegaClient::finalizesc(bool complete)
 
         sctable.reset();
         pendingsccommit = false;
+
+        if (mLoadedOnDemand)
+        {
+            // the nodes that were not loaded, or were evicted, can't be loaded anymore
+            LOG_err << "Nodes loaded on demand - reloading the account";
+            app->reload("Local cache error");
+        }
     }
 }
 
@@ -5526,7 +6055,9 @@ void MegaClient::putfa(NodeOrUploadHandle th, fatype t, SymmCipher* key, int tag
 // has the limit of concurrent transfer tslots been reached?
 bool MegaClient::slotavail() const
 {
-    return !mBlocked && tslots.size() < MAXTOTALTRANSFERS;
+    // the total grows with the per-direction limits, in the proportion of their defaults
+    size_t total = size_t(MAXTOTALTRANSFERS) * (mTransferLimits.limits(PUT).transfers + mTransferLimits.limits(GET).transfers) / (2 * MAXTRANSFERS);
+    return !mBlocked && tslots.size() < std::max<size_t>(total, 1);
 }
 
 bool MegaClient::setstoragestatus(storagestatus_t status)
@@ -7386,6 +7917,18 @@ void MegaClient::notifypurge(void)
 
     if (scsn.ready()) tscsn = scsn.getHandle();
 
+    // new, renamed and removed nodes (and new file attributes, for the categories)
+    for (Node* n : nodenotify)
+    {
+        indexNode(n);
+
+        // anything children are sorted by may have changed
+        if (ChildSortIndex* orders = n->parentSortIndex())
+        {
+            orders->touch(n);
+        }
+    }
+
     if (nodenotify.size() || usernotify.size() || pcrnotify.size()
 #ifdef ENABLE_CHAT
             || chatnotify.size()
@@ -7632,6 +8175,7 @@ void MegaClient::notifypurge(void)
                 n->notified = false;
                 memset(&(n->changed), 0, sizeof(n->changed));
                 n->tag = 0;
+                lruMeasure(n);
             }
         }
 
@@ -7741,14 +8285,7 @@ void MegaClient::notifypurge(void)
 // return node pointer derived from node handle
 Node* MegaClient::nodebyhandle(handle h) const
 {
-    auto it = nodes.find(NodeHandle().set6byte(h));
-
-    if (it != nodes.end())
-    {
-        return it->second;
-    }
-
-    return nullptr;
+    return nodeByHandle(NodeHandle().set6byte(h));
 }
 
 Node* MegaClient::nodeByHandle(NodeHandle h) const
@@ -7756,7 +8293,18 @@ Node* MegaClient::nodeByHandle(NodeHandle h) const
     if (h.isUndef()) return nullptr;
 
     auto it = nodes.find(h);
-    return it != nodes.end() ? it->second : nullptr;
+    if (it != nodes.end())
+    {
+        Node* n = it->second;
+        if (n->lru_it != mNodeLru.end())
+        {
+            mNodeLru.splice(mNodeLru.begin(), mNodeLru, n->lru_it);
+        }
+        return n;
+    }
+
+    // loading a node is not a logical change of the client
+    return mLoadedOnDemand ? const_cast<MegaClient*>(this)->loadNode(h) : nullptr;
 }
 
 Node* MegaClient::nodeByPath(const char* path, Node* node)
@@ -8076,9 +8624,24 @@ error MegaClient::setattr(Node* n, attr_map&& updates, int tag, const char *prev
     n->changed.name = n->attrs.hasUpdate('n', updates);
     n->changed.favourite = n->attrs.hasUpdate(AttrMap::string2nameid("fav"), updates);
 
+    ChildNameIndex* index = n->changed.name ? n->parentNameIndex() : nullptr;
+    if (index)
+    {
+        index->remove(n);
+    }
+    if (n->changed.name)
+    {
+        invalidateNameSnapshot();
+    }
+
     // when we merge SIC removal, the local object won't be changed unless/until the command succeeds
     n->attrs.applyUpdates(updates);
 
+    if (index)
+    {
+        index->add(n);
+    }
+
     n->changed.attrs = true;
     n->tag = tag;
     notifynode(n);
@@ -8706,364 +9269,387 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, vector<NewNod
     }
 
     node_vector dp;
-    Node* n;
     handle previousHandleForAlert = UNDEF;
 
     while (j->enterobject())
     {
-        handle h = UNDEF, ph = UNDEF;
-        handle u = 0, su = UNDEF;
-        nodetype_t t = TYPE_UNKNOWN;
-        const char* a = NULL;
-        const char* k = NULL;
-        const char* fa = NULL;
-        const char *sk = NULL;
-        accesslevel_t rl = ACCESS_UNKNOWN;
-        m_off_t s = NEVER;
-        m_time_t ts = -1, sts = -1;
-        nameid name;
-        int nni = -1;
+        if (!readnode(j, notify, source, nn, tag, applykeys, dp, previousHandleForAlert))
+        {
+            return 0;
+        }
+    }
 
-        while ((name = j->getnameid()) != EOO)
+    readnodesfinish(dp, notify);
+
+    return j->leavearray();
+}
+
+// read and add/verify one node object (already entered, and left positioned at its end)
+// nodes whose parent is not known yet are added to dp, see readnodesfinish()
+int MegaClient::readnode(JSON* j, int notify, putsource_t source, vector<NewNode>* nn, int tag, bool applykeys, node_vector& dp, handle& previousHandleForAlert)
+{
+    Node* n;
+
+    handle h = UNDEF, ph = UNDEF;
+    handle u = 0, su = UNDEF;
+    nodetype_t t = TYPE_UNKNOWN;
+    const char* a = NULL;
+    const char* k = NULL;
+    const char* fa = NULL;
+    const char *sk = NULL;
+    accesslevel_t rl = ACCESS_UNKNOWN;
+    m_off_t s = NEVER;
+    m_time_t ts = -1, sts = -1;
+    nameid name;
+    int nni = -1;
+
+    while ((name = j->getnameid()) != EOO)
+    {
+        switch (name)
         {
-            switch (name)
-            {
-                case 'h':   // new node: handle
-                    h = j->gethandle();
-                    break;
+            case 'h':   // new node: handle
+                h = j->gethandle();
+                break;
 
-                case 'p':   // parent node
-                    ph = j->gethandle();
-                    break;
+            case 'p':   // parent node
+                ph = j->gethandle();
+                break;
 
-                case 'u':   // owner user
-                    u = j->gethandle(USERHANDLE);
-                    break;
+            case 'u':   // owner user
+                u = j->gethandle(USERHANDLE);
+                break;
 
-                case 't':   // type
-                    t = (nodetype_t)j->getint();
-                    break;
+            case 't':   // type
+                t = (nodetype_t)j->getint();
+                break;
 
-                case 'a':   // attributes
-                    a = j->getvalue();
-                    break;
+            case 'a':   // attributes
+                a = j->getvalue();
+                break;
 
-                case 'k':   // key(s)
-                    k = j->getvalue();
-                    break;
+            case 'k':   // key(s)
+                k = j->getvalue();
+                break;
 
-                case 's':   // file size
-                    s = j->getint();
-                    break;
+            case 's':   // file size
+                s = j->getint();
+                break;
 
-                case 'i':   // related source NewNode index
-                    nni = int(j->getint());
-                    break;
+            case 'i':   // related source NewNode index
+                nni = int(j->getint());
+                break;
 
-                case MAKENAMEID2('t', 's'):  // actual creation timestamp
-                    ts = j->getint();
-                    break;
+            case MAKENAMEID2('t', 's'):  // actual creation timestamp
+                ts = j->getint();
+                break;
 
-                case MAKENAMEID2('f', 'a'):  // file attributes
-                    fa = j->getvalue();
-                    break;
+            case MAKENAMEID2('f', 'a'):  // file attributes
+                fa = j->getvalue();
+                break;
 
-                    // inbound share attributes
-                case 'r':   // share access level
-                    rl = (accesslevel_t)j->getint();
-                    break;
+                // inbound share attributes
+            case 'r':   // share access level
+                rl = (accesslevel_t)j->getint();
+                break;
 
-                case MAKENAMEID2('s', 'k'):  // share key
-                    sk = j->getvalue();
-                    break;
+            case MAKENAMEID2('s', 'k'):  // share key
+                sk = j->getvalue();
+                break;
 
-                case MAKENAMEID2('s', 'u'):  // sharing user
-                    su = j->gethandle(USERHANDLE);
-                    break;
+            case MAKENAMEID2('s', 'u'):  // sharing user
+                su = j->gethandle(USERHANDLE);
+                break;
 
-                case MAKENAMEID3('s', 't', 's'):  // share timestamp
-                    sts = j->getint();
-                    break;
+            case MAKENAMEID3('s', 't', 's'):  // share timestamp
+                sts = j->getint();
+                break;
 
-                default:
-                    if (!j->storeobject())
-                    {
-                        return 0;
-                    }
-            }
+            default:
+                if (!j->storeobject())
+                {
+                    return 0;
+                }
         }
+    }
 
-        if (ISUNDEF(h))
+    if (ISUNDEF(h))
+    {
+        warn("Missing node handle");
+    }
+    else
+    {
+        if (t == TYPE_UNKNOWN)
         {
-            warn("Missing node handle");
+            warn("Unknown node type");
         }
-        else
+        else if (t == FILENODE || t == FOLDERNODE)
         {
-            if (t == TYPE_UNKNOWN)
+            if (ISUNDEF(ph))
             {
-                warn("Unknown node type");
+                warn("Missing parent");
             }
-            else if (t == FILENODE || t == FOLDERNODE)
+            else if (!a)
             {
-                if (ISUNDEF(ph))
-                {
-                    warn("Missing parent");
-                }
-                else if (!a)
-                {
-                    warn("Missing node attributes");
-                }
-                else if (!k)
-                {
-                    warn("Missing node key");
-                }
+                warn("Missing node attributes");
+            }
+            else if (!k)
+            {
+                warn("Missing node key");
+            }
 
-                if (t == FILENODE && ISUNDEF(s))
-                {
-                    warn("File node without file size");
-                }
+            if (t == FILENODE && ISUNDEF(s))
+            {
+                warn("File node without file size");
             }
         }
+    }
 
-        if (fa && t != FILENODE)
-        {
-            warn("Spurious file attributes");
-        }
+    if (fa && t != FILENODE)
+    {
+        warn("Spurious file attributes");
+    }
 
-        if (!warnlevel())
+    if (!warnlevel())
+    {
+        if ((n = nodebyhandle(h)))
         {
-            if ((n = nodebyhandle(h)))
+            Node* p = NULL;
+            if (!ISUNDEF(ph))
             {
-                Node* p = NULL;
-                if (!ISUNDEF(ph))
-                {
-                    p = nodebyhandle(ph);
-                }
+                p = nodebyhandle(ph);
+            }
 
-                if (n->changed.removed)
-                {
-                    // node marked for deletion is being resurrected, possibly
-                    // with a new parent (server-client move operation)
-                    n->changed.removed = false;
-                }
-                else
+            if (n->changed.removed)
+            {
+                // node marked for deletion is being resurrected, possibly
+                // with a new parent (server-client move operation)
+                n->changed.removed = false;
+            }
+            else
+            {
+                // node already present - check for race condition
+                if ((n->parent && ph != n->parent->nodehandle && p &&  p->type != FILENODE) || n->type != t)
                 {
-                    // node already present - check for race condition
-                    if ((n->parent && ph != n->parent->nodehandle && p &&  p->type != FILENODE) || n->type != t)
-                    {
-                        app->reload("Node inconsistency");
+                    app->reload("Node inconsistency");
 
-                        static bool reloadnotified = false;
-                        if (!reloadnotified)
-                        {
-                            sendevent(99437, "Node inconsistency", 0);
-                            reloadnotified = true;
-                        }
+                    static bool reloadnotified = false;
+                    if (!reloadnotified)
+                    {
+                        sendevent(99437, "Node inconsistency", 0);
+                        reloadnotified = true;
                     }
                 }
+            }
 
-                if (!ISUNDEF(ph))
+            if (!ISUNDEF(ph))
+            {
+                if (p)
                 {
-                    if (p)
-                    {
-                        if (n->setparent(p))
-                        {
-                            n->changed.parent = true;
-                        }
-                    }
-                    else
+                    if (n->setparent(p))
                     {
-                        n->setparent(NULL);
-                        n->parenthandle = ph;
-                        dp.push_back(n);
+                        n->changed.parent = true;
                     }
                 }
-
-                if (a && k && n->attrstring)
+                else
                 {
-                    LOG_warn << "Updating the key of a NO_KEY node";
-                    JSON::copystring(n->attrstring.get(), a);
-                    n->setkeyfromjson(k);
+                    n->setparent(NULL);
+                    n->parenthandle = ph;
+                    dp.push_back(n);
                 }
             }
-            else
+
+            if (a && k && n->attrstring)
             {
-                byte buf[SymmCipher::KEYLENGTH];
+                LOG_warn << "Updating the key of a NO_KEY node";
+                JSON::copystring(n->attrstring.get(), a);
+                n->setkeyfromjson(k);
+            }
+        }
+        else
+        {
+            byte buf[SymmCipher::KEYLENGTH];
 
-                if (!ISUNDEF(su))
+            if (!ISUNDEF(su))
+            {
+                if (t != FOLDERNODE)
                 {
-                    if (t != FOLDERNODE)
-                    {
-                        warn("Invalid share node type");
-                    }
+                    warn("Invalid share node type");
+                }
 
-                    if (rl == ACCESS_UNKNOWN)
-                    {
-                        warn("Missing access level");
-                    }
+                if (rl == ACCESS_UNKNOWN)
+                {
+                    warn("Missing access level");
+                }
 
-                    if (!sk)
-                    {
-                        LOG_warn << "Missing share key for inbound share";
-                    }
+                if (!sk)
+                {
+                    LOG_warn << "Missing share key for inbound share";
+                }
 
-                    if (warnlevel())
-                    {
-                        su = UNDEF;
-                    }
-                    else
+                if (warnlevel())
+                {
+                    su = UNDEF;
+                }
+                else
+                {
+                    if (sk)
                     {
-                        if (sk)
-                        {
-                            decryptkey(sk, buf, sizeof buf, &key, 1, h);
-                        }
+                        decryptkey(sk, buf, sizeof buf, &key, 1, h);
                     }
                 }
+            }
 
-                string fas;
+            string fas;
 
-                JSON::copystring(&fas, fa);
+            JSON::copystring(&fas, fa);
 
-                // fallback timestamps
-                if (!(ts + 1))
-                {
-                    ts = m_time();
-                }
+            // fallback timestamps
+            if (!(ts + 1))
+            {
+                ts = m_time();
+            }
 
-                if (!(sts + 1))
-                {
-                    sts = ts;
-                }
+            if (!(sts + 1))
+            {
+                sts = ts;
+            }
 
-                n = new Node(this, &dp, NodeHandle().set6byte(h), NodeHandle().set6byte(ph), t, s, u, fas.c_str(), ts);
-                n->changed.newnode = true;
+            n = new Node(this, &dp, NodeHandle().set6byte(h), NodeHandle().set6byte(ph), t, s, u, fas.c_str(), ts);
+            n->changed.newnode = true;
 
-                n->tag = tag;
+            n->tag = tag;
 
-                n->attrstring.reset(new string);
-                JSON::copystring(n->attrstring.get(), a);
-                n->setkeyfromjson(k);
+            n->attrstring.reset(new string);
+            JSON::copystring(n->attrstring.get(), a);
+            n->setkeyfromjson(k);
 
-                if (loggedIntoFolder())
+            if (loggedIntoFolder())
+            {
+                // folder link access: first returned record defines root node and identity
+                // (this code used to be in Node::Node but is not suitable for session resume)
+                if (rootnodes.files.isUndef())
                 {
-                    // folder link access: first returned record defines root node and identity
-                    // (this code used to be in Node::Node but is not suitable for session resume)
-                    if (rootnodes.files.isUndef())
-                    {
-                        rootnodes.files.set6byte(h);
+                    rootnodes.files.set6byte(h);
 
-                        if (loggedIntoWritableFolder())
-                        {
-                            // If logged into writable folder, we need the sharekey set in the root node
-                            // so as to include it in subsequent put nodes
-                            n->sharekey = new SymmCipher(key); //we use the "master key", in this case the secret share key
-                        }
+                    if (loggedIntoWritableFolder())
+                    {
+                        // If logged into writable folder, we need the sharekey set in the root node
+                        // so as to include it in subsequent put nodes
+                        n->sharekey = new SymmCipher(key); //we use the "master key", in this case the secret share key
                     }
                 }
+            }
 
-                if (!ISUNDEF(su))
-                {
-                    newshares.push_back(new NewShare(h, 0, su, rl, sts, sk ? buf : NULL));
-                }
+            if (!ISUNDEF(su))
+            {
+                newshares.push_back(new NewShare(h, 0, su, rl, sts, sk ? buf : NULL));
+            }
 
-                if (u != me && !ISUNDEF(u) && !fetchingnodes)
-                {
-                    useralerts.noteSharedNode(u, t, ts, n, UserAlert::type_put);
-                }
+            if (u != me && !ISUNDEF(u) && !fetchingnodes)
+            {
+                useralerts.noteSharedNode(u, t, ts, n, UserAlert::type_put);
+            }
+
+            if (nn && nni >= 0 && nni < int(nn->size()))
+            {
+                auto& nn_nni = (*nn)[nni];
+                nn_nni.added = true;
+                nn_nni.mAddedHandle = h;
 
-                if (nn && nni >= 0 && nni < int(nn->size()))
+                if (nn_nni.ovhandle != UNDEF && nn_nni.mVersioningOption == ReplaceOldVersion)
                 {
-                    auto& nn_nni = (*nn)[nni];
-                    nn_nni.added = true;
-                    nn_nni.mAddedHandle = h;
+                    // replacing an existing file (eg, by uploading a same-name file), with versioning off.
+                    assert(n->type == FILENODE);
 
-                    if (nn_nni.ovhandle != UNDEF && nn_nni.mVersioningOption == ReplaceOldVersion)
+                    // The API replaces the existing node ('ov') by the new node, so
+                    // the existing one is effectively removed, but the deletion of that node
+                    // can't be delivered by command reply, and this client can't
+                    // see the generated delete actionpacket due to the `i` scheme.
+                    // However the command reply will already rearrange the versions of the old node
+                    // to be the versions of this new node.
+                    // So, we manually delete this node that the API must have deleted
+                    // (Full and proper solution to this is in sync rework with SIC removal)
+                    if (Node *ovNode = nodeByHandle(nn_nni.ovhandle))
                     {
-                        // replacing an existing file (eg, by uploading a same-name file), with versioning off.
-                        assert(n->type == FILENODE);
-
-                        // The API replaces the existing node ('ov') by the new node, so
-                        // the existing one is effectively removed, but the deletion of that node
-                        // can't be delivered by command reply, and this client can't
-                        // see the generated delete actionpacket due to the `i` scheme.
-                        // However the command reply will already rearrange the versions of the old node
-                        // to be the versions of this new node.
-                        // So, we manually delete this node that the API must have deleted
-                        // (Full and proper solution to this is in sync rework with SIC removal)
-                        if (Node *ovNode = nodeByHandle(nn_nni.ovhandle))
-                        {
-                            assert(ovNode->type == FILENODE);
+                        assert(ovNode->type == FILENODE);
 
-                            TreeProcDel td;
-                            proctree(ovNode, &td, false, true);
-                            LOG_debug << "File " << nn_nni.ovhandle << " replaced by " << Base64Str<MegaClient::NODEHANDLE>(h);
-                        }
+                        TreeProcDel td;
+                        proctree(ovNode, &td, false, true);
+                        LOG_debug << "File " << nn_nni.ovhandle << " replaced by " << Base64Str<MegaClient::NODEHANDLE>(h);
                     }
+                }
 
 #ifdef ENABLE_SYNC
-                    if (source == PUTNODES_SYNC)
+                if (source == PUTNODES_SYNC)
+                {
+                    if (nn_nni.localnode)
                     {
-                        if (nn_nni.localnode)
-                        {
-                            // overwrites/updates: associate LocalNode with newly created Node
-                            nn_nni.localnode->setnode(n);
-                            nn_nni.localnode->treestate(TREESTATE_SYNCED);
+                        // overwrites/updates: associate LocalNode with newly created Node
+                        nn_nni.localnode->setnode(n);
+                        nn_nni.localnode->treestate(TREESTATE_SYNCED);
 
-                            // updates cache with the new node associated
-                            nn_nni.localnode->sync->statecacheadd(nn_nni.localnode);
-                            nn_nni.localnode->newnode.reset(); // localnode ptr now null also
+                        // updates cache with the new node associated
+                        nn_nni.localnode->sync->statecacheadd(nn_nni.localnode);
+                        nn_nni.localnode->newnode.reset(); // localnode ptr now null also
 
-                            // scan in case we had pending moves.
-                            if (n->type == FOLDERNODE)
-                            {
-                                // mark this and folders below to be rescanned
-                                n->localnode->setSubtreeNeedsRescan(false);
-
-                                // queue this one to be scanned, recursion is by notify of subdirs
-                                n->localnode->sync->dirnotify->notify(DirNotify::DIREVENTS,
-                                                                      n->localnode,
-                                                                      LocalPath(),
-                                                                      true,
-                                                                      false);
-                            }
+                        // scan in case we had pending moves.
+                        if (n->type == FOLDERNODE)
+                        {
+                            // mark this and folders below to be rescanned
+                            n->localnode->setSubtreeNeedsRescan(false);
+
+                            // queue this one to be scanned, recursion is by notify of subdirs
+                            n->localnode->sync->dirnotify->notify(DirNotify::DIREVENTS,
+                                                                  n->localnode,
+                                                                  LocalPath(),
+                                                                  true,
+                                                                  false);
                         }
                     }
-#endif
                 }
+#endif
             }
+        }
 
-            if (notify)
-            {
-                notifynode(n);
-            }
+        if (notify)
+        {
+            notifynode(n);
+        }
+
+        if (applykeys)
+        {
+            n->applykey();
+        }
 
-            if (applykeys)
+        // update-alerts for shared-nodes management
+        if (!ISUNDEF(ph))
+        {
+            if (useralerts.isHandleInAlertsAsRemoved(h) && ISUNDEF(previousHandleForAlert))
             {
-                n->applykey();
+                useralerts.setNewNodeAlertToUpdateNodeAlert(nodebyhandle(ph));
+                useralerts.removeNodeAlerts(nodebyhandle(h));
+                previousHandleForAlert = h;
             }
-
-            // update-alerts for shared-nodes management
-            if (!ISUNDEF(ph))
+            else if ((t == FILENODE) || (t == FOLDERNODE))
             {
-                if (useralerts.isHandleInAlertsAsRemoved(h) && ISUNDEF(previousHandleForAlert))
+                if (previousHandleForAlert == ph)
                 {
-                    useralerts.setNewNodeAlertToUpdateNodeAlert(nodebyhandle(ph));
                     useralerts.removeNodeAlerts(nodebyhandle(h));
                     previousHandleForAlert = h;
                 }
-                else if ((t == FILENODE) || (t == FOLDERNODE))
-                {
-                    if (previousHandleForAlert == ph)
-                    {
-                        useralerts.removeNodeAlerts(nodebyhandle(h));
-                        previousHandleForAlert = h;
-                    }
-                    // otherwise, the added TYPE_NEWSHAREDNODE is kept
-                }
+                // otherwise, the added TYPE_NEWSHAREDNODE is kept
             }
         }
     }
 
+    return 1;
+}
+
+// link the nodes that arrived before their parents
+void MegaClient::readnodesfinish(node_vector& dp, int notify)
+{
+    Node* n;
+
     // any child nodes arrived before their parents?
     size_t count = 0;
     node_vector orphans;
@@ -9104,8 +9690,6 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, vector<NewNod
     {
        sendevent(99455, "Orphan node(s) detected");
     }
-
-    return j->leavearray();
 }
 
 // decrypt and set encrypted sharekey
@@ -10185,9 +10769,15 @@ void MegaClient::opensctable()
 
         if (dbname.size())
         {
-            sctable.reset(dbaccess->open(rng, *fsaccess, dbname));
+            sctable.reset(dbaccess->open(rng, *fsaccess, dbname, DB_OPEN_FLAG_NODES));
             pendingsccommit = false;
 
+            if (sctable && mWriteBehindStateCache && nodeTable())
+            {
+                unique_ptr<DbTable> table(std::move(sctable));
+                sctable.reset(new WriteBehindDbTable(rng, std::move(table)));
+            }
+
             if (sctable)
             {
                 // sctable always has a transaction started.
@@ -10553,7 +11143,7 @@ void MegaClient::proctree(Node* n, TreeProc* tp, bool skipinshares, bool skipver
 
     if (!skipversions || n->type != FILENODE)
     {
-        for (node_list::iterator it = n->children.begin(); it != n->children.end(); )
+        for (NodeChildren::iterator it = n->children.begin(); it != n->children.end(); )
         {
             Node *child = *it++;
             if (!(skipinshares && child->inshare))
@@ -11119,6 +11709,8 @@ void MegaClient::notifynode(Node* n)
         n->notified = true;
         nodenotify.push_back(n);
     }
+
+    app->node_pending(n);
 }
 
 void MegaClient::transfercacheadd(Transfer *transfer, TransferDbCommitter* committer)
@@ -12431,10 +13023,63 @@ void MegaClient::setkeypair()
                                       unsigned(pubks.size())));
 }
 
+// records read from the local cache, decrypted and (for nodes) parsed by the worker threads
+struct MegaClient::CacheBatch
+{
+    struct Record
+    {
+        uint32_t id;
+        string data;
+        Node::Unserialized node;
+        bool parsed = false;
+
+        // from the typed node table, rather than statecache
+        bool typed = false;
+    };
+
+    vector<Record> records;
+
+    // records from this one on could not be decrypted (reading stops there)
+    size_t decrypted = 0;
+
+    bool done = false;
+};
+
+void MegaClient::decodeCacheBatch(CacheBatch& batch, SymmCipher& cipher)
+{
+    for (auto& r : batch.records)
+    {
+        if (r.id && !PaddedCBC::decrypt(&r.data, &cipher))
+        {
+            break;
+        }
+
+        if ((r.id & 15) == CACHEDNODE)
+        {
+            r.parsed = Node::unserialize(&r.data, r.node);
+        }
+
+        batch.decrypted++;
+    }
+}
+
 bool MegaClient::fetchsc(DbTable* sctable)
 {
+    // reading from the database, decryption and parsing run in parallel (pipelined)
+    // with the creation of the objects and their linkage on this thread
+    struct Pipeline
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<shared_ptr<CacheBatch>> batches;
+        bool readerFinished = false;
+        bool cancelled = false;
+    };
+
+    static const size_t BATCHRECORDS = 1024;
+    static const size_t MAXBATCHES = 16;
+
     uint32_t id;
-    string data;
     Node* n;
     User* u;
     PendingContactRequest* pcr;
@@ -12442,83 +13087,317 @@ bool MegaClient::fetchsc(DbTable* sctable)
 
     LOG_info << "Loading session from local cache";
 
-    sctable->rewind();
+    // nodes are not loaded on demand while the cache is being read by another thread;
+    // if enabled, only the top nodes are loaded now
+    bool onDemand = mNodesOnDemand && dynamic_cast<DbTableNodes*>(sctable);
+    mLoadedOnDemand = false;
+    mSearchIndex.clear();
+    handle storedScsn = UNDEF;
 
-    bool hasNext = sctable->next(&id, &data, &key);
-    WAIT_CLASS::bumpds();
-    fnstats.timeToFirstByte = Waiter::ds - fnstats.startTime;
+    auto pipeline = std::make_shared<Pipeline>();
+    auto masterkey = std::make_shared<string>(reinterpret_cast<const char*>(key.key), sizeof key.key);
+    bool firstBatch = true;
+    bool threaded = false;
 
-    while (hasNext)
+    auto reader = [this, sctable, pipeline, masterkey, &onDemand, &firstBatch, &threaded]()
     {
-        switch (id & 15)
+        DbTableNodes* nodeTable = dynamic_cast<DbTableNodes*>(sctable);
+        DbTableNodes::NodeRows topNodes;
+        size_t topNode = 0;
+        bool searchIndex = false;
+        bool statecacheNodes = false;
+        enum { STATECACHE, NODES, DONE } source = STATECACHE;
+
+        // statecache records, then the typed node records
+        auto next = [&](CacheBatch::Record& r)
         {
-            case CACHEDSCSN:
-                if (data.size() != sizeof cachedscsn)
+            if (source == STATECACHE)
+            {
+                if (sctable->next(&r.id, &r.data))
                 {
-                    return false;
+                    sctable->updateNextId(r.id);
+                    searchIndex |= (r.id & 15) == CACHEDSEARCHINDEX;
+                    statecacheNodes |= (r.id & 15) == CACHEDNODE;
+                    return true;
                 }
-                break;
 
-            case CACHEDNODE:
-                if ((n = Node::unserialize(this, &data, &dp)))
+                source = nodeTable ? NODES : DONE;
+                if (onDemand && !searchIndex)
                 {
-                    n->dbid = id;
+                    // the search index is built from all the nodes (only the main thread
+                    // reads this flag, once the reader has finished)
+                    LOG_info << "No search index in the local cache: loading all nodes";
+                    onDemand = false;
                 }
-                else
+                else if (onDemand && statecacheNodes)
                 {
-                    LOG_err << "Failed - node record read error";
-                    return false;
+                    // the counts of the nodes below the top ones come from the node table
+                    LOG_info << "Nodes in statecache records: loading all nodes";
+                    onDemand = false;
                 }
-                break;
-
-            case CACHEDPCR:
-                if ((pcr = PendingContactRequest::unserialize(&data)))
+                if (nodeTable && onDemand)
                 {
-                    mappcr(pcr->id, unique_ptr<PendingContactRequest>(pcr));
-                    pcr->dbid = id;
+                    nodeTable->getTopNodes(topNodes);
                 }
-                else
+                else if (nodeTable)
                 {
-                    LOG_err << "Failed - pcr record read error";
-                    return false;
+                    nodeTable->rewindNodes();
                 }
-                break;
+            }
 
-            case CACHEDUSER:
-                if ((u = User::unserialize(this, &data)))
+            if (source == NODES)
+            {
+                NodeHandle h;
+                r.id = CACHEDNODE;
+                r.typed = true;
+
+                if (onDemand ? topNode < topNodes.size() : nodeTable->nextNode(&h, &r.data))
                 {
-                    u->dbid = id;
+                    if (onDemand)
+                    {
+                        r.data = std::move(topNodes[topNode++].second);
+                    }
+                    return true;
                 }
-                else
+
+                source = DONE;
+            }
+
+            return false;
+        };
+
+        sctable->rewind();
+
+        for (bool more = true; more; )
+        {
+            auto batch = std::make_shared<CacheBatch>();
+            batch->records.reserve(BATCHRECORDS);
+
+            for (CacheBatch::Record r; batch->records.size() < BATCHRECORDS; )
+            {
+                if (!(more = next(r)))
                 {
-                    LOG_err << "Failed - user record read error";
-                    return false;
+                    break;
                 }
-                break;
 
-            case CACHEDCHAT:
-#ifdef ENABLE_CHAT
+                batch->records.push_back(std::move(r));
+            }
+
+            if (firstBatch)
+            {
+                WAIT_CLASS::bumpds();
+                fnstats.timeToFirstByte = Waiter::ds - fnstats.startTime;
+                firstBatch = false;
+            }
+
+            {
+                std::unique_lock<std::mutex> g(pipeline->mutex);
+                pipeline->cv.wait(g, [&]() { return !threaded || pipeline->cancelled || pipeline->batches.size() < MAXBATCHES; });
+                if (pipeline->cancelled)
                 {
-                    TextChat *chat;
-                    if ((chat = TextChat::unserialize(this, &data)))
+                    break;
+                }
+                pipeline->batches.push_back(batch);
+            }
+
+            mAsyncQueue.push([batch, pipeline, masterkey](SymmCipher& cipher)
+            {
+                cipher.setkey(reinterpret_cast<const byte*>(masterkey->data()));
+                decodeCacheBatch(*batch, cipher);
+
+                std::lock_guard<std::mutex> g(pipeline->mutex);
+                batch->done = true;
+                pipeline->cv.notify_all();
+            }, false);
+        }
+
+        std::lock_guard<std::mutex> g(pipeline->mutex);
+        pipeline->readerFinished = true;
+        pipeline->cv.notify_all();
+    };
+
+    std::thread readerThread;
+    try
+    {
+        threaded = true;
+        readerThread = std::thread(reader);
+    }
+    catch (std::system_error& e)
+    {
+        LOG_err << "Failed to start cache reader thread: " << e.what();
+        threaded = false;
+        reader();
+    }
+
+    // stops the reader (if still running) on every exit path
+    auto stopReader = [&]()
+    {
+        if (readerThread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> g(pipeline->mutex);
+                pipeline->cancelled = true;
+                pipeline->cv.notify_all();
+            }
+            readerThread.join();
+        }
+    };
+
+    bool ok = true;
+    for (bool more = true; more && ok; )
+    {
+        shared_ptr<CacheBatch> batch;
+        {
+            std::unique_lock<std::mutex> g(pipeline->mutex);
+            pipeline->cv.wait(g, [&]()
+            {
+                return pipeline->batches.empty() ? pipeline->readerFinished : pipeline->batches.front()->done;
+            });
+
+            if (pipeline->batches.empty())
+            {
+                break;
+            }
+
+            batch = std::move(pipeline->batches.front());
+            pipeline->batches.pop_front();
+            pipeline->cv.notify_all();
+        }
+
+        // a record that can't be decrypted ends the load, as with DbTable::next()
+        more = batch->decrypted == batch->records.size();
+
+        for (size_t i = 0; i < batch->decrypted && ok; i++)
+        {
+            auto& r = batch->records[i];
+            id = r.id;
+
+            switch (id & 15)
+            {
+                case CACHEDSCSN:
+                    if (r.data.size() != sizeof cachedscsn)
                     {
-                        chat->dbid = id;
+                        ok = false;
                     }
                     else
                     {
-                        LOG_err << "Failed - chat record read error";
-                        return false;
+                        storedScsn = MemAccess::get<handle>(r.data.data());
+                    }
+                    break;
+
+                case CACHEDSEARCHINDEX:
+                    if (!mSearchIndex.unserializeRecord(r.data, id))
+                    {
+                        // not fatal: the index is built again from the nodes
+                        LOG_warn << "Failed - search index record read error";
+                    }
+                    break;
+
+                case CACHEDNODE:
+                    if (r.parsed && (n = Node::unserialize(this, r.node, &dp)))
+                    {
+                        n->dbid = r.typed ? 0 : id;
+                    }
+                    else
+                    {
+                        LOG_err << "Failed - node record read error";
+                        ok = false;
+                    }
+                    break;
+
+                case CACHEDPCR:
+                    if ((pcr = PendingContactRequest::unserialize(&r.data)))
+                    {
+                        mappcr(pcr->id, unique_ptr<PendingContactRequest>(pcr));
+                        pcr->dbid = id;
+                    }
+                    else
+                    {
+                        LOG_err << "Failed - pcr record read error";
+                        ok = false;
+                    }
+                    break;
+
+                case CACHEDUSER:
+                    if ((u = User::unserialize(this, &r.data)))
+                    {
+                        u->dbid = id;
+                    }
+                    else
+                    {
+                        LOG_err << "Failed - user record read error";
+                        ok = false;
+                    }
+                    break;
+
+                case CACHEDCHAT:
+#ifdef ENABLE_CHAT
+                    {
+                        TextChat *chat;
+                        if ((chat = TextChat::unserialize(this, &r.data)))
+                        {
+                            chat->dbid = id;
+                        }
+                        else
+                        {
+                            LOG_err << "Failed - chat record read error";
+                            ok = false;
+                        }
                     }
-                }
 #endif
-                break;
+                    break;
+            }
+        }
+    }
+
+    stopReader();
+
+    if (ok && onDemand)
+    {
+        startLoadedOnDemand();
+
+        // the counts of the top nodes' subtrees, that are not loaded
+        node_vector tops;
+        for (auto& it : nodes)
+        {
+            tops.push_back(it.second);
         }
-        hasNext = sctable->next(&id, &data, &key);
+        for (Node* top : tops)
+        {
+            pagedIn(top);
+            if (rootnodes.isRootNode(top->nodeHandle()) || top->inshare)
+            {
+                mNodeCounters[top->nodeHandle()] = top->subnodeCounts();
+            }
+        }
+    }
+
+    if (!ok)
+    {
+        return false;
     }
 
     WAIT_CLASS::bumpds();
     fnstats.timeToLastByte = Waiter::ds - fnstats.startTime;
 
+    if (!mSearchIndex.loaded(storedScsn))
+    {
+        if (!onDemand)
+        {
+            LOG_info << "Building the search index of " << nodes.size() << " nodes";
+            for (auto& it : nodes)
+            {
+                indexNode(it.second);
+            }
+            mSearchIndex.setComplete(true);
+        }
+        else
+        {
+            // dropped from the cache when stored, so that all nodes are loaded next time
+            LOG_warn << "Search index outdated: searches will walk the loaded nodes";
+        }
+    }
+
     // any child nodes arrived before their parents?
     for (size_t i = dp.size(); i--; )
     {
@@ -13651,10 +14530,14 @@ void MegaClient::purgenodesusersabortsc(bool keepOwnUser)
 {
     app->clearing();
 
+    // the nodes that will replace these are not loaded from the local cache
+    mLoadedOnDemand = false;
+
     while (!hdrns.empty())
     {
         delete hdrns.begin()->second;
     }
+    directReadCache.clear();
 
     // sync configs don't need to be changed.  On session resume we'll resume the ones still enabled.
 #ifdef ENABLE_SYNC
@@ -13664,6 +14547,8 @@ void MegaClient::purgenodesusersabortsc(bool keepOwnUser)
     mOptimizePurgeNodes = true;
     mFingerprints.clear();
     mNodeCounters.clear();
+    mNameSnapshot.reset();
+    mSearchIndex.clear();
     for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
     {
         delete it->second;
@@ -13841,9 +14726,13 @@ void MegaClient::abortreads(handle h, bool p, m_off_t offset, m_off_t count)
 
         for (dr_list::iterator it = drn->reads.begin(); it != drn->reads.end(); )
         {
-            if ((offset < 0 || offset == (*it)->offset) && (count < 0 || count == (*it)->count))
+            // read-aheads (no app behind them anymore) are only aborted all together
+            if ((offset < 0 || ((*it)->appdata && offset == (*it)->offset)) && (count < 0 || count == (*it)->count))
             {
-                app->pread_failure(API_EINCOMPLETE, (*it)->drn->retries, (*it)->appdata, 0);
+                if ((*it)->appdata)
+                {
+                    app->pread_failure(API_EINCOMPLETE, (*it)->drn->retries, (*it)->appdata, 0);
+                }
 
                 delete *(it++);
             }
@@ -13863,12 +14752,30 @@ bool MegaClient::execdirectreads()
     if (drq.size() < MAXDRSLOTS)
     {
         // fill slots
-        for (dr_list::iterator it = drq.begin(); it != drq.end(); it++)
+        for (dr_list::iterator it = drq.begin(); it != drq.end(); )
         {
-            if (!(*it)->drs)
+            DirectRead* dr = *(it++);
+
+            if (!dr->drs)
             {
-                drs = new DirectReadSlot(*it);
-                (*it)->drs = drs;
+                if (dr->drbuf.tempUrlVector().empty())
+                {
+                    // not started yet: serve what the cache already has (this may complete the read)
+                    if (!dr->serveFromCache())
+                    {
+                        r = true;
+                        continue;
+                    }
+
+                    // a read-ahead is about to provide the next part
+                    if (dr->readaheadPending())
+                    {
+                        continue;
+                    }
+                }
+
+                drs = new DirectReadSlot(dr);
+                dr->drs = drs;
                 r = true;
 
                 if (drq.size() >= MAXDRSLOTS) break;
@@ -14778,7 +15685,7 @@ bool MegaClient::syncdown(LocalNode* l, LocalPath& localpath, SyncdownContext& c
     string localname;
 
     // build child hash - nameclash resolution: use newest/largest version
-    for (node_list::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
+    for (NodeChildren::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
     {
         attr_map::iterator ait;
 
@@ -15278,7 +16185,7 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds, size_t& parentPending)
     {
         // corresponding remote node present: build child hash - nameclash
         // resolution: use newest version
-        for (node_list::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
+        for (NodeChildren::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
         {
             // node must be alive
             if ((*it)->syncdeleted == SYNCDEL_NONE)
@@ -16688,9 +17595,13 @@ void MegaClient::setmaxconnections(direction_t d, int num)
             num = MegaClient::MAX_NUM_CONNECTIONS;
         }
 
-        if (connections[d] != num)
+        // the adaptive limits may lower the connections, but no longer raise them beyond the value set
+        unsigned previous = mTransferLimits.limits(d).connections;
+        mTransferLimits.setCeilings(d, MAXADAPTIVETRANSFERS, num);
+        mTransferLimits.setDefaults(d, mTransferLimits.limits(d).transfers, num);
+
+        if (previous != unsigned(num))
         {
-            connections[d] = (unsigned char)num;
             for (transferslot_list::iterator it = tslots.begin(); it != tslots.end(); )
             {
                 TransferSlot *slot = *it++;
@@ -16710,12 +17621,21 @@ void MegaClient::setmaxconnections(direction_t d, int num)
 
 Node* MegaClient::nodebyfingerprint(FileFingerprint* fingerprint)
 {
+    if (mLoadedOnDemand)
+    {
+        loadNodesByFingerprint(*fingerprint);
+    }
     return mFingerprints.nodebyfingerprint(fingerprint);
 }
 
 #ifdef ENABLE_SYNC
 Node* MegaClient::nodebyfingerprint(LocalNode* localNode)
 {
+    if (mLoadedOnDemand)
+    {
+        loadNodesByFingerprint(*localNode);
+    }
+
     std::unique_ptr<const node_vector>
       remoteNodes(mFingerprints.nodesbyfingerprint(localNode));
 
@@ -16772,6 +17692,10 @@ Node* MegaClient::nodebyfingerprint(LocalNode* localNode)
 
 node_vector *MegaClient::nodesbyfingerprint(FileFingerprint* fingerprint)
 {
+    if (mLoadedOnDemand)
+    {
+        loadNodesByFingerprint(*fingerprint);
+    }
     return mFingerprints.nodesbyfingerprint(fingerprint);
 }
 
@@ -16978,6 +17902,47 @@ bool MegaClient::nodeIsDocument(const Node *n) const
     return false;
 }
 
+uint8_t MegaClient::searchCategories(const Node* n) const
+{
+    string ext;
+    if (n->type != FILENODE || !action_bucket_compare::getExtensionDotted(n, ext, *this))
+    {
+        return 0;
+    }
+
+    uint8_t categories = 0;
+    if (action_bucket_compare::nodeIsPhoto(n, ext, false))
+    {
+        categories |= NodeSearchIndex::PHOTO;
+    }
+    if (action_bucket_compare::nodeIsAudio(n, ext))
+    {
+        categories |= NodeSearchIndex::AUDIO;
+    }
+    // the media attributes can only rule a video out, which searches check on the node
+    if (action_bucket_compare::webclient_mime_video_extensions.find(ext) != string::npos)
+    {
+        categories |= NodeSearchIndex::VIDEO;
+    }
+    if (action_bucket_compare::nodeIsDocument(n, ext))
+    {
+        categories |= NodeSearchIndex::DOCUMENT;
+    }
+    return categories;
+}
+
+void MegaClient::indexNode(Node* n)
+{
+    if (n->changed.removed)
+    {
+        mSearchIndex.remove(n->nodeHandle());
+    }
+    else if (n->type == FILENODE || n->type == FOLDERNODE)
+    {
+        mSearchIndex.set(n->nodeHandle(), n->type, n->displayname(), searchCategories(n));
+    }
+}
+
 recentactions_vector MegaClient::getRecentActions(unsigned maxcount, m_time_t since)
 {
     recentactions_vector rav;
@@ -17032,7 +17997,7 @@ void MegaClient::nodesbyoriginalfingerprint(const char* originalfingerprint, Nod
 {
     if (parent)
     {
-        for (node_list::iterator i = parent->children.begin(); i != parent->children.end(); ++i)
+        for (NodeChildren::iterator i = parent->children.begin(); i != parent->children.end(); ++i)
         {
             if ((*i)->type == FILENODE)
             {
@@ -17452,7 +18417,8 @@ std::string MegaClient::PerformanceStats::report(bool reset, HttpIO* httpio, Wai
         << " transfers active time: " << transfersActiveTime.report(reset) << "\n"
         << " transfer starts/finishes: " << transferStarts << " " << transferFinishes << "\n"
         << " transfer temperror/fails: " << transferTempErrors << " " << transferFails << "\n"
-        << " nowait reason: immedate: " << prepwaitImmediate << " zero: " << prepwaitZero << " httpio: " << prepwaitHttpio << " fsaccess: " << prepwaitFsaccess << " nonzero waits: " << nonzeroWait << "\n";
+        << " nowait reason: immedate: " << prepwaitImmediate << " zero: " << prepwaitZero << " httpio: " << prepwaitHttpio << " fsaccess: " << prepwaitFsaccess << " nonzero waits: " << nonzeroWait << "\n"
+        << " " << g_bufferPool.report(reset) << "\n";
 #ifdef USE_CURL
     if (auto curlhttpio = dynamic_cast<CurlHttpIO*>(httpio))
     {
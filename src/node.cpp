@@ -32,8 +32,125 @@
 #include "mega/heartbeats.h"
 #include "megafs.h"
 
+#include <thread>
+
 namespace mega {
 
+namespace {
+
+// Fixed-size blocks for nodes, carved from slabs. Nodes go to the slab with the lowest
+// address that has room, so the others empty out and are returned once no node is left.
+// Shared by all clients, as a node doesn't know its client once destroyed.
+class NodeAllocator
+{
+public:
+    void* allocate()
+    {
+        lock_guard<mutex> g(mMutex);
+
+        if (mAvailable.empty())
+        {
+            char* start = static_cast<char*>(::operator new(SLABNODES * sizeof(Block)));
+            Slab& slab = mSlabs[start];
+            for (size_t i = SLABNODES; i--; )
+            {
+                Block* b = reinterpret_cast<Block*>(start + i * sizeof(Block));
+                b->next = slab.free;
+                slab.free = b;
+            }
+            mAvailable.insert(start);
+        }
+
+        auto it = mSlabs.find(*mAvailable.begin());
+        Slab& slab = it->second;
+
+        Block* b = slab.free;
+        slab.free = b->next;
+        if (++slab.used == SLABNODES)
+        {
+            mAvailable.erase(it->first);
+        }
+        return b;
+    }
+
+    void release(void* p)
+    {
+        lock_guard<mutex> g(mMutex);
+
+        // the slab starting at or before the block
+        auto it = mSlabs.upper_bound(static_cast<char*>(p));
+        assert(it != mSlabs.begin());
+        --it;
+        Slab& slab = it->second;
+
+        if (slab.used-- == SLABNODES)
+        {
+            mAvailable.insert(it->first);
+        }
+
+        if (!slab.used)
+        {
+            mAvailable.erase(it->first);
+            ::operator delete(it->first);
+            mSlabs.erase(it);
+            return;
+        }
+
+        Block* b = static_cast<Block*>(p);
+        b->next = slab.free;
+        slab.free = b;
+    }
+
+    // never destroyed, so nodes may outlive static destructors
+    static NodeAllocator& instance()
+    {
+        static NodeAllocator* allocator = new NodeAllocator;
+        return *allocator;
+    }
+
+private:
+    static const size_t SLABNODES = 256;
+
+    union Block
+    {
+        Block* next;
+        std::aligned_storage<sizeof(Node), alignof(Node)>::type node;
+    };
+
+    struct Slab
+    {
+        Block* free = nullptr;
+        size_t used = 0;
+    };
+
+    mutex mMutex;
+    std::map<char*, Slab> mSlabs;   // by start address
+    std::set<char*> mAvailable;     // slabs with free blocks
+};
+
+}
+
+void* Node::operator new(size_t size)
+{
+    if (size != sizeof(Node))
+    {
+        return ::operator new(size);
+    }
+    return NodeAllocator::instance().allocate();
+}
+
+void Node::operator delete(void* p, size_t size)
+{
+    if (size != sizeof(Node))
+    {
+        ::operator delete(p);
+    }
+    else if (p)
+    {
+        NodeAllocator::instance().release(p);
+    }
+}
+
 Node::Node(MegaClient* cclient, node_vector* dp, NodeHandle h, NodeHandle ph,
            nodetype_t t, m_off_t s, handle u, const char* fa, m_time_t ts)
 {
@@ -61,6 +178,12 @@ Node::Node(MegaClient* cclient, node_vector* dp, NodeHandle h, NodeHandle ph,
     size = s;
     owner = u;
 
+    if (type != FILENODE)
+    {
+        subtreeCounts.reset(new NodeCounter);
+        subtreeCounts->folders = type == FOLDERNODE;
+    }
+
     JSON::copystring(&fileattrstring, fa);
 
     ctime = ts;
@@ -93,6 +216,13 @@ Node::Node(MegaClient* cclient, node_vector* dp, NodeHandle h, NodeHandle ph,
     }
 
     client->mFingerprints.newnode(this);
+    if (!client->mPagingNodes)
+    {
+        client->invalidateNameSnapshot();
+    }
+
+    lru_it = client->mNodeLru.end();
+    client->lruAdd(this);
 }
 
 Node::~Node()
@@ -106,6 +236,8 @@ Node::~Node()
     // abort pending direct reads
     client->preadabort(this);
 
+    client->lruRemove(this);
+
     // remove node's fingerprint from hash
     if (!client->mOptimizePurgeNodes)
     {
@@ -152,14 +284,28 @@ Node::~Node()
         // remove from parent's children
         if (parent)
         {
-            parent->children.erase(child_it);
+            if (ChildNameIndex* index = parentNameIndex())
+            {
+                index->remove(this);
+            }
+            if (ChildSortIndex* orders = parentSortIndex())
+            {
+                orders->forget(this);
+            }
+            parent->children.erase(this);
         }
 
-        const Node* fa = firstancestor();
-        NodeHandle ancestor = fa->nodeHandle();
-        if (client->rootnodes.isRootNode(ancestor) || fa->inshare)
+        // evicted nodes are still counted: they are only out of memory
+        if (!client->mPagingNodes)
         {
-            client->mNodeCounters[firstancestor()->nodeHandle()] -= subnodeCounts();
+            countInAncestors(subnodeCounts(), false);
+
+            const Node* fa = firstancestor();
+            NodeHandle ancestor = fa->nodeHandle();
+            if (client->rootnodes.isRootNode(ancestor) || fa->inshare)
+            {
+                client->mNodeCounters[firstancestor()->nodeHandle()] -= subnodeCounts();
+            }
         }
 
         if (inshare)
@@ -169,9 +315,9 @@ Node::~Node()
 
         // delete child-parent associations (normally not used, as nodes are
         // deleted bottom-up)
-        for (node_list::iterator it = children.begin(); it != children.end(); it++)
+        for (Node* child : children)
         {
-            (*it)->parent = NULL;
+            child->parent = NULL;
         }
     }
 
@@ -234,11 +380,22 @@ void Node::setkey(const byte* newkey)
 // parse serialized node and return Node object - updates nodes hash and parent
 // mismatch vector
 Node* Node::unserialize(MegaClient* client, const string* d, node_vector* dp)
+{
+    Unserialized u;
+    if (!unserialize(d, u))
+    {
+        return NULL;
+    }
+
+    return unserialize(client, u, dp);
+}
+
+// parse serialized node - does not access the client
+bool Node::unserialize(const string* d, Unserialized& u)
 {
     handle h, ph;
     nodetype_t t;
     m_off_t s;
-    handle u;
     const byte* k = NULL;
     const char* fa;
     m_time_t ts;
@@ -246,14 +403,13 @@ Node* Node::unserialize(MegaClient* client, const string* d, node_vector* dp)
     const char* ptr = d->data();
     const char* end = ptr + d->size();
     unsigned short ll;
-    Node* n;
     int i;
     char isExported = '\0';
     char hasLinkCreationTs = '\0';
 
     if (ptr + sizeof s + 2 * MegaClient::NODEHANDLE + MegaClient::USERHANDLE + 2 * sizeof ts + sizeof ll > end)
     {
-        return NULL;
+        return false;
     }
 
     s = MemAccess::get<m_off_t>(ptr);
@@ -281,8 +437,8 @@ Node* Node::unserialize(MegaClient* client, const string* d, node_vector* dp)
         ph = UNDEF;
     }
 
-    u = 0;
-    memcpy((char*)&u, ptr, MegaClient::USERHANDLE);
+    u.owner = 0;
+    memcpy((char*)&u.owner, ptr, MegaClient::USERHANDLE);
     ptr += MegaClient::USERHANDLE;
 
     // FIME: use m_time_t / Serialize64 instead
@@ -297,7 +453,7 @@ Node* Node::unserialize(MegaClient* client, const string* d, node_vector* dp)
 
         if (ptr + keylen + 8 + sizeof(short) > end)
         {
-            return NULL;
+            return false;
         }
 
         k = (const byte*)ptr;
@@ -311,7 +467,7 @@ Node* Node::unserialize(MegaClient* client, const string* d, node_vector* dp)
 
         if (ptr + ll > end)
         {
-            return NULL;
+            return false;
         }
 
         fa = ptr;
@@ -324,7 +480,7 @@ Node* Node::unserialize(MegaClient* client, const string* d, node_vector* dp)
 
     if (ptr + sizeof isExported + sizeof hasLinkCreationTs > end)
     {
-        return NULL;
+        return false;
     }
 
     isExported = MemAccess::get<char>(ptr);
@@ -353,7 +509,7 @@ Node* Node::unserialize(MegaClient* client, const string* d, node_vector* dp)
 
     if (ptr + sizeof(short) > end)
     {
-        return NULL;
+        return false;
     }
 
     short numshares = MemAccess::get<short>(ptr);
@@ -363,7 +519,7 @@ Node* Node::unserialize(MegaClient* client, const string* d, node_vector* dp)
     {
         if (ptr + SymmCipher::KEYLENGTH > end)
         {
-            return NULL;
+            return false;
         }
 
         skey = (const byte*)ptr;
@@ -374,13 +530,19 @@ Node* Node::unserialize(MegaClient* client, const string* d, node_vector* dp)
         skey = NULL;
     }
 
-    n = new Node(client, dp, NodeHandle().set6byte(h), NodeHandle().set6byte(ph), t, s, u, fa, ts);
+    u.h = h;
+    u.ph = ph;
+    u.type = t;
+    u.size = s;
+    u.ctime = ts;
 
     if (k)
     {
-        n->setkey(k);
+        u.key.assign(reinterpret_cast<const char*>(k), (t == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
     }
 
+    JSON::copystring(&u.fileattrstring, fa);
+
     // read inshare, outshares, or pending shares
     while (numshares)   // inshares: -1, outshare/s: num_shares
     {
@@ -392,7 +554,7 @@ Node* Node::unserialize(MegaClient* client, const string* d, node_vector* dp)
             break;
         }
 
-        client->newshares.push_back(newShare);
+        u.shares.emplace_back(newShare);
         if (numshares > 0)  // outshare/s
         {
             numshares--;
@@ -403,63 +565,86 @@ Node* Node::unserialize(MegaClient* client, const string* d, node_vector* dp)
         }
     }
 
-    ptr = n->attrs.unserialize(ptr, end);
+    ptr = u.attrs.unserialize(ptr, end);
     if (!ptr)
     {
-        delete n;
-        return NULL;
+        return false;
     }
 
     // It's needed to re-normalize node names because
     // the updated version of utf8proc doesn't provide
     // exactly the same output as the previous one that
     // we were using
-    attr_map::iterator it = n->attrs.map.find('n');
-    if (it != n->attrs.map.end())
+    attr_map::iterator it = u.attrs.map.find('n');
+    if (it != u.attrs.map.end())
     {
         LocalPath::utf8_normalize(&(it->second));
     }
 
-    PublicLink *plink = NULL;
     if (isExported)
     {
         if (ptr + MegaClient::NODEHANDLE + sizeof(m_time_t) + sizeof(bool) > end)
         {
-            delete n;
-            return NULL;
+            return false;
         }
 
-        handle ph = 0;
-        memcpy((char*)&ph, ptr, MegaClient::NODEHANDLE);
+        u.isExported = true;
+        u.plinkHandle = 0;
+        memcpy((char*)&u.plinkHandle, ptr, MegaClient::NODEHANDLE);
         ptr += MegaClient::NODEHANDLE;
-        m_time_t ets = MemAccess::get<m_time_t>(ptr);
-        ptr += sizeof(ets);
-        bool takendown = MemAccess::get<bool>(ptr);
-        ptr += sizeof(takendown);
+        u.plinkEts = MemAccess::get<m_time_t>(ptr);
+        ptr += sizeof(u.plinkEts);
+        u.plinkTakendown = MemAccess::get<bool>(ptr);
+        ptr += sizeof(u.plinkTakendown);
 
-        m_time_t cts = 0;
         if (hasLinkCreationTs)
         {
-            cts = MemAccess::get<m_time_t>(ptr);
-            ptr += sizeof(cts);
+            u.plinkCts = MemAccess::get<m_time_t>(ptr);
+            ptr += sizeof(u.plinkCts);
         }
 
-        plink = new PublicLink(ph, cts, ets, takendown, authKey ? authKey : "");
-        client->mPublicLinks[n->nodehandle] = plink->ph;
+        if (authKey)
+        {
+            u.plinkAuthKey = authKey;
+        }
     }
-    n->plink = plink;
 
-    n->setfingerprint();
+    return ptr == end;
+}
 
-    if (ptr == end)
+Node* Node::unserialize(MegaClient* client, Unserialized& u, node_vector* dp)
+{
+    Node* n = new Node(client, dp, NodeHandle().set6byte(u.h), NodeHandle().set6byte(u.ph), u.type, u.size, u.owner, NULL, u.ctime);
+
+    n->fileattrstring = std::move(u.fileattrstring);
+
+    if (!u.key.empty())
     {
-        return n;
+        n->setkey(reinterpret_cast<const byte*>(u.key.data()));
     }
-    else
+
+    for (auto& share : u.shares)
     {
-        delete n;
-        return NULL;
+        client->newshares.push_back(share.release());
+    }
+
+    n->attrs = std::move(u.attrs);
+
+    // the node was linked to its parent (if already loaded) before it had a name
+    if (ChildNameIndex* index = n->parentNameIndex())
+    {
+        index->add(n);
+    }
+
+    if (u.isExported)
+    {
+        n->plink = new PublicLink(u.plinkHandle, u.plinkCts, u.plinkEts, u.plinkTakendown, u.plinkAuthKey.c_str());
+        client->mPublicLinks[n->nodehandle] = n->plink->ph;
     }
+
+    n->setfingerprint();
+
+    return n;
 }
 
 // serialize node - nodes with pending or RSA keys are unsupported
@@ -711,6 +896,14 @@ void Node::setattr()
         nameid name;
         string* t;
 
+        ChildNameIndex* index = parentNameIndex();
+        if (index)
+        {
+            index->remove(this);
+        }
+
+        client->invalidateNameSnapshot();
+
         AttrMap oldAttrs(attrs);
         attrs.map.clear();
         json.begin((char*)buf + 5);
@@ -724,6 +917,17 @@ void Node::setattr()
                 LocalPath::utf8_normalize(t);
             }
         }
+        attrs.map.shrink_to_fit();
+
+        if (index)
+        {
+            index->add(this);
+        }
+
+        if (ChildSortIndex* orders = parentSortIndex())
+        {
+            orders->touch(this);
+        }
 
         changed.name = attrs.hasDifferentValue('n', oldAttrs.map);
         changed.favourite = attrs.hasDifferentValue(AttrMap::string2nameid("fav"), oldAttrs.map);
@@ -733,6 +937,8 @@ void Node::setattr()
         delete[] buf;
 
         attrstring.reset();
+
+        client->indexNode(this);
     }
 }
 
@@ -835,6 +1041,64 @@ bool Node::hasName(const string& name) const
     return it != attrs.map.end() && it->second == name;
 }
 
+ChildNameIndex* Node::parentNameIndex() const
+{
+    return parent ? parent->childNames.get() : nullptr;
+}
+
+vector<Node*> Node::childrenByName(const string& name) const
+{
+    if (!ChildNameIndex::isPlaceholder(name))
+    {
+        if (!childNames && children.size() >= ChildNameIndex::MINCHILDREN)
+        {
+            childNames.reset(new ChildNameIndex(children));
+        }
+
+        if (childNames)
+        {
+            return childNames->find(name, children);
+        }
+    }
+
+    vector<Node*> found;
+    for (Node* child : children)
+    {
+        if (name == child->displayname())
+        {
+            found.push_back(child);
+        }
+    }
+    return found;
+}
+
+ChildSortIndex* Node::parentSortIndex() const
+{
+    return parent ? parent->childOrders.get() : nullptr;
+}
+
+node_vector Node::sortedChildren(int key, const ChildSortIndex::Comparator& less, size_t offset, size_t limit) const
+{
+    node_vector small;
+    if (!childOrders && children.size() < ChildSortIndex::MINCHILDREN)
+    {
+        small.assign(children.begin(), children.end());
+        std::sort(small.begin(), small.end(), less);
+    }
+    else if (!childOrders)
+    {
+        childOrders.reset(new ChildSortIndex(this));
+    }
+
+    const node_vector& all = childOrders ? childOrders->sorted(key, less) : small;
+    if (offset >= all.size())
+    {
+        return node_vector();
+    }
+    auto first = all.begin() + static_cast<ptrdiff_t>(offset);
+    return node_vector(first, first + static_cast<ptrdiff_t>(std::min(limit, all.size() - offset)));
+}
+
 // return file/folder name or special status strings
 const char* Node::displayname() const
 {
@@ -1040,6 +1304,11 @@ bool Node::applykey()
 
 NodeCounter Node::subnodeCounts() const
 {
+    if (subtreeCounts)
+    {
+        return *subtreeCounts;
+    }
+
     NodeCounter nc;
     for (Node *child : children)
     {
@@ -1062,6 +1331,25 @@ NodeCounter Node::subnodeCounts() const
     return nc;
 }
 
+void Node::countInAncestors(const NodeCounter& nc, bool add) const
+{
+    // files have no counts of their own: theirs are added up from their versions
+    for (Node* p = parent; p; p = p->parent)
+    {
+        if (p->subtreeCounts)
+        {
+            if (add)
+            {
+                *p->subtreeCounts += nc;
+            }
+            else
+            {
+                *p->subtreeCounts -= nc;
+            }
+        }
+    }
+}
+
 // returns whether node was moved
 bool Node::setparent(Node* p)
 {
@@ -1070,23 +1358,38 @@ bool Node::setparent(Node* p)
         return false;
     }
 
-    NodeCounter nc;
-    bool gotnc = false;
+    // nodes loaded from (or evicted to) the node table are already counted in their ancestors
+    bool counted = !client->mPagingNodes;
 
+    NodeCounter nc = subnodeCounts();
     const Node *originalancestor = firstancestor();
     NodeHandle oah = originalancestor->nodeHandle();
-    if (client->rootnodes.isRootNode(oah) || originalancestor->inshare)
+    if (counted)
     {
-        nc = subnodeCounts();
-        gotnc = true;
+        countInAncestors(nc, false);
 
-        // nodes moving from cloud drive to rubbish for example, or between inshares from the same user.
-        client->mNodeCounters[oah] -= nc;
+        if (client->rootnodes.isRootNode(oah) || originalancestor->inshare)
+        {
+            // nodes moving from cloud drive to rubbish for example, or between inshares from the same user.
+            client->mNodeCounters[oah] -= nc;
+        }
     }
 
     if (parent)
     {
-        parent->children.erase(child_it);
+        if (ChildNameIndex* index = parentNameIndex())
+        {
+            index->remove(this);
+        }
+        if (ChildSortIndex* orders = parentSortIndex())
+        {
+            orders->forget(this);
+        }
+        parent->children.erase(this);
+    }
+    if (counted)
+    {
+        client->invalidateNameSnapshot();
     }
 
 #ifdef ENABLE_SYNC
@@ -1097,19 +1400,33 @@ bool Node::setparent(Node* p)
 
     if (parent)
     {
-        child_it = parent->children.insert(parent->children.end(), this);
+        parent->children.push_back(this);
+        if (ChildNameIndex* index = parentNameIndex())
+        {
+            index->add(this);
+        }
+        if (ChildSortIndex* orders = parentSortIndex())
+        {
+            orders->touch(this);
+        }
+    }
+
+    // a file becomes a version, or stops being one, depending on its parent
+    if (type == FILENODE)
+    {
+        nc = subnodeCounts();
     }
 
     const Node* newancestor = firstancestor();
     NodeHandle nah = newancestor->nodeHandle();
-    if (client->rootnodes.isRootNode(nah) || newancestor->inshare)
+    if (counted)
     {
-        if (!gotnc)
+        countInAncestors(nc, true);
+
+        if (client->rootnodes.isRootNode(nah) || newancestor->inshare)
         {
-            nc = subnodeCounts();
+            client->mNodeCounters[nah] += nc;
         }
-
-        client->mNodeCounters[nah] += nc;
     }
 
 #ifdef ENABLE_SYNC
@@ -1947,34 +2264,76 @@ LocalNode* LocalNode::unserialize(Sync* sync, const string* d)
 
 void Fingerprints::newnode(Node* n)
 {
-    if (n->type == FILENODE)
-    {
-        n->fingerprint_it = mFingerprints.end();
-    }
+    n->fingerprintIndexed = false;
 }
 
 void Fingerprints::add(Node* n)
 {
     if (n->type == FILENODE)
     {
-        n->fingerprint_it = mFingerprints.insert(n);
+        if ((mCount + 1) * 4 > mSlots.size() * 3)
+        {
+            rehash(std::max(MINSLOTS, 2 * mSlots.size()));
+        }
+
+        Slot slot(*n);
+        slot.node = n;
+        insert(slot);
+        ++mCount;
+        n->fingerprintIndexed = true;
         mSumSizes += n->size;
     }
 }
 
 void Fingerprints::remove(Node* n)
 {
-    if (n->type == FILENODE && n->fingerprint_it != mFingerprints.end())
+    if (n->type != FILENODE || !n->fingerprintIndexed || !mCount)
+    {
+        return;
+    }
+
+    // the node's fingerprint is the one it was added with (it's removed before any change)
+    size_t i = first(Slot(*n));
+    while (mSlots[i].node && mSlots[i].node != n)
     {
-        mSumSizes -= n->size;
-        mFingerprints.erase(n->fingerprint_it);
-        n->fingerprint_it = mFingerprints.end();
+        i = next(i);
     }
+
+    if (!mSlots[i].node)
+    {
+        // not where its fingerprint says: it was changed without updating the index
+        LOG_warn << "Fingerprint index out of date for " << toNodeHandle(n->nodehandle);
+        assert(false);
+        for (i = 0; i < mSlots.size() && mSlots[i].node != n; ++i);
+        if (i == mSlots.size())
+        {
+            return;
+        }
+    }
+
+    // shift the rest of the run back into the freed slot, where their probe allows it
+    // (no tombstones, and the order of equal fingerprints is kept)
+    for (size_t j = next(i); mSlots[j].node; j = next(j))
+    {
+        size_t home = first(mSlots[j]);
+        bool movable = i <= j ? (home <= i || home > j) : (home <= i && home > j);
+        if (movable)
+        {
+            mSlots[i] = mSlots[j];
+            i = j;
+        }
+    }
+    mSlots[i].node = nullptr;
+
+    --mCount;
+    n->fingerprintIndexed = false;
+    mSumSizes -= n->size;
 }
 
 void Fingerprints::clear()
 {
-    mFingerprints.clear();
+    mSlots.clear();
+    mCount = 0;
     mSumSizes = 0;
 }
 
@@ -1985,19 +2344,977 @@ m_off_t Fingerprints::getSumSizes()
 
 Node* Fingerprints::nodebyfingerprint(FileFingerprint* fingerprint)
 {
-    fingerprint_set::iterator it = mFingerprints.find(fingerprint);
-    return it == mFingerprints.end() ? nullptr : static_cast<Node*>(*it);
+    if (!mCount)
+    {
+        return nullptr;
+    }
+
+    Slot key(*fingerprint);
+    for (size_t i = first(key); mSlots[i].node; i = next(i))
+    {
+        if (mSlots[i].matches(key))
+        {
+            return mSlots[i].node;
+        }
+    }
+    return nullptr;
 }
 
 node_vector *Fingerprints::nodesbyfingerprint(FileFingerprint* fingerprint)
 {
     node_vector *nodes = new node_vector();
-    auto p = mFingerprints.equal_range(fingerprint);
-    for (iterator it = p.first; it != p.second; ++it)
+    if (!mCount)
+    {
+        return nodes;
+    }
+
+    Slot key(*fingerprint);
+    for (size_t i = first(key); mSlots[i].node; i = next(i))
     {
-        nodes->push_back(static_cast<Node*>(*it));
+        if (mSlots[i].matches(key))
+        {
+            nodes->push_back(mSlots[i].node);
+        }
     }
     return nodes;
 }
 
+Fingerprints::Slot::Slot(const FileFingerprint& f)
+    : size(f.size)
+    , mtime(f.mtime)
+    , crc(f.crc)
+{
+}
+
+bool Fingerprints::Slot::matches(const Slot& o) const
+{
+    return size == o.size && mtime == o.mtime && crc == o.crc;
+}
+
+size_t Fingerprints::hash(const Slot& key)
+{
+    // the CRCs are well distributed already: mix in size and mtime, then spread the bits
+    uint64_t h = uint64_t(uint32_t(key.crc[0])) | uint64_t(uint32_t(key.crc[1])) << 32;
+    h ^= uint64_t(key.size) * 0x9e3779b97f4a7c15ULL;
+    h ^= uint64_t(key.mtime) * 0xc2b2ae3d27d4eb4fULL;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 32;
+    return size_t(h);
+}
+
+void Fingerprints::insert(const Slot& slot)
+{
+    size_t i = first(slot);
+    while (mSlots[i].node)
+    {
+        i = next(i);
+    }
+    mSlots[i] = slot;
+}
+
+void Fingerprints::rehash(size_t slots)
+{
+    vector<Slot> old(slots);
+    old.swap(mSlots);
+
+    if (old.empty())
+    {
+        return;
+    }
+
+    // start after a free slot, so that each run (even one wrapping around the end)
+    // is added back in order, keeping equal fingerprints in the order they were added
+    size_t start = 0;
+    while (old[start].node)
+    {
+        ++start;
+    }
+
+    for (size_t k = 1; k <= old.size(); ++k)
+    {
+        const Slot& slot = old[(start + k) % old.size()];
+        if (slot.node)
+        {
+            insert(slot);
+        }
+    }
+}
+
+void NodeChildren::push_back(Node* n)
+{
+    n->prevSibling = mLast;
+    n->nextSibling = nullptr;
+    (mLast ? mLast->nextSibling : mFirst) = n;
+    mLast = n;
+    ++mSize;
+    mFiles += n->type == FILENODE;
+}
+
+void NodeChildren::erase(Node* n)
+{
+    (n->prevSibling ? n->prevSibling->nextSibling : mFirst) = n->nextSibling;
+    (n->nextSibling ? n->nextSibling->prevSibling : mLast) = n->prevSibling;
+    n->prevSibling = n->nextSibling = nullptr;
+    --mSize;
+    mFiles -= n->type == FILENODE;
+}
+
+ChildNameIndex::ChildNameIndex(const NodeChildren& children)
+{
+    mNames.reserve(children.size());
+    for (Node* n : children)
+    {
+        add(n);
+    }
+}
+
+const string* ChildNameIndex::key(const Node* n)
+{
+    auto it = n->attrs.map.find('n');
+    return it != n->attrs.map.end() && !it->second.empty() ? &it->second : nullptr;
+}
+
+bool ChildNameIndex::isPlaceholder(const string& name)
+{
+    return name == "NO_KEY" || name == "CRYPTO_ERROR" || name == "BLANK";
+}
+
+void ChildNameIndex::add(Node* n)
+{
+    if (const string* name = key(n))
+    {
+        mNames.emplace(*name, n);
+    }
+}
+
+void ChildNameIndex::remove(Node* n)
+{
+    const string* name = key(n);
+    if (!name)
+    {
+        return;
+    }
+
+    auto range = mNames.equal_range(*name);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == n)
+        {
+            mNames.erase(it);
+            return;
+        }
+    }
+
+    // not where its name says: the name was changed without updating the index
+    for (auto it = mNames.begin(); it != mNames.end(); ++it)
+    {
+        if (it->second == n)
+        {
+            LOG_warn << "Child name index out of date for " << toNodeHandle(n->nodehandle);
+            assert(false);
+            mNames.erase(it);
+            return;
+        }
+    }
+}
+
+vector<Node*> ChildNameIndex::find(const string& name, const NodeChildren& children) const
+{
+    vector<Node*> found;
+
+    auto range = mNames.equal_range(name);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        // nodes pending decryption keep their last name in attrs, but don't display it
+        if (!it->second->attrstring)
+        {
+            found.push_back(it->second);
+        }
+    }
+
+    if (found.size() > 1)
+    {
+        // name clashes: callers pick among them by position, so return them in children order
+        vector<Node*> ordered;
+        ordered.reserve(found.size());
+        for (auto it = children.begin(); it != children.end() && ordered.size() < found.size(); ++it)
+        {
+            if (std::find(found.begin(), found.end(), *it) != found.end())
+            {
+                ordered.push_back(*it);
+            }
+        }
+        assert(ordered.size() == found.size());
+        found.swap(ordered);
+    }
+
+    return found;
+}
+
+const node_vector& ChildSortIndex::sorted(int key, const Comparator& less)
+{
+    merge();
+
+    auto it = mOrders.find(key);
+    if (it == mOrders.end())
+    {
+        Order& order = mOrders[key];
+        order.less = less;
+        order.nodes.assign(mFolder->children.begin(), mFolder->children.end());
+        std::sort(order.nodes.begin(), order.nodes.end(), order.less);
+        return order.nodes;
+    }
+    return it->second.nodes;
+}
+
+void ChildSortIndex::touch(Node* n)
+{
+    if (mOrders.empty())
+    {
+        return;
+    }
+
+    mGone.erase(n);
+    mPending.insert(n);
+
+    // changes to most of the folder: sorting again is cheaper than merging
+    if (mPending.size() > MINCHILDREN && mPending.size() > mFolder->children.size())
+    {
+        mOrders.clear();
+        mPending.clear();
+        mGone.clear();
+    }
+}
+
+void ChildSortIndex::forget(Node* n)
+{
+    if (mOrders.empty())
+    {
+        return;
+    }
+
+    touch(n);
+    if (!mOrders.empty())
+    {
+        mGone.insert(n);
+    }
+}
+
+void ChildSortIndex::merge()
+{
+    if (mPending.empty())
+    {
+        return;
+    }
+
+    // the pending nodes that are (still) children, in their current state
+    node_vector placed;
+    for (Node* n : mPending)
+    {
+        if (!mGone.count(n) && n->parent == mFolder)
+        {
+            placed.push_back(n);
+        }
+    }
+
+    for (auto& it : mOrders)
+    {
+        Order& order = it.second;
+        node_vector& nodes = order.nodes;
+
+        nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [this](Node* n) { return mPending.count(n) > 0; }), nodes.end());
+
+        auto middle = static_cast<ptrdiff_t>(nodes.size());
+        nodes.insert(nodes.end(), placed.begin(), placed.end());
+        std::sort(nodes.begin() + middle, nodes.end(), order.less);
+        std::inplace_merge(nodes.begin(), nodes.begin() + middle, nodes.end(), order.less);
+    }
+
+    mPending.clear();
+    mGone.clear();
+}
+
+NodeNameSnapshot::NodeNameSnapshot(const node_vector& tops)
+{
+    // post-order walk: a node is added once all its children are, so its subtree
+    // starts where the node was first reached
+    struct Step
+    {
+        Node* node;
+        NodeChildren::const_iterator next;
+        size_t first;
+    };
+    vector<Step> stack;
+
+    auto add = [this](Node* n, size_t first)
+    {
+        string name(n->displayname());
+        fold(name);
+        mNameStart.push_back(mNames.size());
+        mNames.append(name);
+        mNames.push_back('\0');
+
+        mFirst.push_back(static_cast<uint32_t>(first));
+        mHandles.push_back(n->nodeHandle());
+        mTypes.push_back(n->type);
+    };
+
+    for (Node* top : tops)
+    {
+        if (!top)
+        {
+            continue;
+        }
+
+        stack.push_back(Step{top, top->children.begin(), mHandles.size()});
+        while (!stack.empty())
+        {
+            Step& step = stack.back();
+            if (step.node->type != FILENODE && step.next != step.node->children.end())
+            {
+                Node* child = *step.next++;
+                stack.push_back(Step{child, child->children.begin(), mHandles.size()});
+            }
+            else
+            {
+                add(step.node, step.first);
+                stack.pop_back();
+            }
+        }
+    }
+    mNameStart.push_back(mNames.size());
+
+    mPositions.reserve(mHandles.size());
+    for (size_t i = 0; i < mHandles.size(); ++i)
+    {
+        mPositions.emplace_back(mHandles[i], static_cast<uint32_t>(i));
+    }
+    std::sort(mPositions.begin(), mPositions.end());
+}
+
+bool NodeNameSnapshot::subtree(NodeHandle h, Range& range) const
+{
+    auto it = std::lower_bound(mPositions.begin(), mPositions.end(), std::make_pair(h, uint32_t(0)));
+    if (it == mPositions.end() || it->first != h)
+    {
+        return false;
+    }
+
+    range = Range(mFirst[it->second], it->second + 1);
+    return true;
+}
+
+void NodeNameSnapshot::fold(string& s)
+{
+    for (char& c : s)
+    {
+        if (c >= 'A' && c <= 'Z')
+        {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+    }
+}
+
+void NodeNameSnapshot::searchRange(Range range, const string& text, const CancelToken& cancelToken, Matches& matches) const
+{
+    // the names of the range are scanned as one buffer, for the first byte of the text with
+    // memchr() (vectorized by the C library), then compared.  The '\0' after each name keeps
+    // matches from spanning two names.
+    const char* names = mNames.data();
+    const size_t* starts = mNameStart.data();
+    const char* end = names + starts[range.second];
+    const char* p = names + starts[range.first];
+    size_t checked = range.first;
+
+    while (p < end)
+    {
+        const char* found = text.empty() ? p : static_cast<const char*>(memchr(p, text[0], static_cast<size_t>(end - p)));
+        if (!found)
+        {
+            break;
+        }
+
+        if (static_cast<size_t>(end - found) < text.size() || memcmp(found, text.data(), text.size()))
+        {
+            p = found + 1;
+            continue;
+        }
+
+        // the node whose name contains the match
+        size_t i = static_cast<size_t>(std::upper_bound(starts + range.first, starts + range.second, static_cast<size_t>(found - names)) - starts) - 1;
+        if (mTypes[i] == FILENODE || mTypes[i] == FOLDERNODE)
+        {
+            matches.push_back(mHandles[i]);
+        }
+        p = names + starts[i + 1];
+
+        if (i - checked >= MINNODESPERTHREAD)
+        {
+            if (cancelToken.isCancelled())
+            {
+                return;
+            }
+            checked = i;
+        }
+    }
+}
+
+auto NodeNameSnapshot::search(const vector<Range>& ranges, const string& text, CancelToken cancelToken, unsigned threads, PartCallback onPart) const -> Matches
+{
+    string folded(text);
+    fold(folded);
+
+    size_t total = 0;
+    for (auto& r : ranges)
+    {
+        total += r.second - r.first;
+    }
+
+    if (!threads)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t numParts = std::max<size_t>(1, std::min<size_t>(threads, total / MINNODESPERTHREAD));
+
+    // each part takes the same number of nodes, from one or more consecutive ranges
+    vector<vector<Range>> parts(numParts);
+    size_t r = 0;
+    size_t offset = ranges.empty() ? 0 : ranges[0].first;
+    for (size_t i = 0; i < numParts; ++i)
+    {
+        size_t count = total / numParts + (i < total % numParts);
+        while (count && r < ranges.size())
+        {
+            size_t n = std::min(count, ranges[r].second - offset);
+            if (n)
+            {
+                parts[i].emplace_back(offset, offset + n);
+            }
+            offset += n;
+            count -= n;
+            if (offset == ranges[r].second && ++r < ranges.size())
+            {
+                offset = ranges[r].first;
+            }
+        }
+    }
+
+    vector<Matches> results(numParts);
+    auto searchPart = [&](size_t i)
+    {
+        for (auto& range : parts[i])
+        {
+            if (cancelToken.isCancelled())
+            {
+                break;
+            }
+            searchRange(range, folded, cancelToken, results[i]);
+        }
+
+        if (onPart)
+        {
+            onPart(i, results[i]);
+        }
+    };
+
+    vector<std::thread> workers;
+    for (size_t i = 1; i < numParts; ++i)
+    {
+        workers.emplace_back(searchPart, i);
+    }
+    searchPart(0);
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    Matches matches = std::move(results[0]);
+    for (size_t i = 1; i < numParts; ++i)
+    {
+        matches.insert(matches.end(), results[i].begin(), results[i].end());
+    }
+    return matches;
+}
+
+namespace {
+
+size_t countCategories(uint8_t categories)
+{
+    size_t count = 0;
+    for (; categories; categories &= static_cast<uint8_t>(categories - 1))
+    {
+        ++count;
+    }
+    return count;
+}
+
+}
+
+vector<uint32_t> NodeSearchIndex::grams(const string& folded, bool prefix)
+{
+    // names are indexed with the marker: a prefix query's first trigram only matches
+    // names that start with it
+    string s;
+    s.reserve(folded.size() + 1);
+    if (prefix)
+    {
+        s.push_back('\x01');
+    }
+    s.append(folded);
+
+    vector<uint32_t> result;
+    for (size_t i = 0; i + 3 <= s.size(); ++i)
+    {
+        result.push_back(uint32_t(uint8_t(s[i])) << 16 | uint32_t(uint8_t(s[i + 1])) << 8 | uint8_t(s[i + 2]));
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+void NodeSearchIndex::addPostings(uint32_t id, const vector<uint32_t>& grams, uint8_t categories)
+{
+    for (uint32_t gram : grams)
+    {
+        mGramPostings[gram].push_back(id);
+    }
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (categories & (1 << i))
+        {
+            mCategoryPostings[i].push_back(id);
+        }
+    }
+    mLivePostings += grams.size() + countCategories(categories);
+}
+
+void NodeSearchIndex::rebuildPostings()
+{
+    mGramPostings.clear();
+    for (auto& postings : mCategoryPostings)
+    {
+        postings.clear();
+    }
+    mLivePostings = 0;
+    mStalePostings = 0;
+
+    for (uint32_t id = 0; id < mEntries.size(); ++id)
+    {
+        const Entry& e = mEntries[id];
+        if (e.used)
+        {
+            addPostings(id, grams(e.name, true), e.categories);
+        }
+    }
+}
+
+void NodeSearchIndex::changed(uint32_t id)
+{
+    mChangedRecords.insert(id / RECORDENTRIES);
+
+    // stale postings slow the queries down, and take memory: rebuilt when they are the most
+    if (mStalePostings > std::max<size_t>(mLivePostings, 1 << 16))
+    {
+        rebuildPostings();
+    }
+}
+
+void NodeSearchIndex::set(NodeHandle h, nodetype_t type, const string& name, uint8_t categories)
+{
+    string folded(name);
+    NodeNameSnapshot::fold(folded);
+
+    uint32_t id;
+    vector<uint32_t> oldGrams;
+    uint8_t oldCategories = 0;
+
+    auto it = mIds.find(h.as8byte());
+    if (it != mIds.end())
+    {
+        id = it->second;
+        const Entry& e = mEntries[id];
+        if (e.type == type && e.categories == categories && e.name == folded)
+        {
+            return;
+        }
+        oldGrams = grams(e.name, true);
+        oldCategories = e.categories;
+    }
+    else
+    {
+        if (mFreeIds.empty())
+        {
+            id = static_cast<uint32_t>(mEntries.size());
+            mEntries.emplace_back();
+        }
+        else
+        {
+            id = mFreeIds.back();
+            mFreeIds.pop_back();
+        }
+        mIds.emplace(h.as8byte(), id);
+    }
+
+    // only what the node didn't have gets a posting: the rest is kept, or becomes stale
+    vector<uint32_t> newGrams = grams(folded, true);
+    vector<uint32_t> addedGrams;
+    std::set_difference(newGrams.begin(), newGrams.end(), oldGrams.begin(), oldGrams.end(), std::back_inserter(addedGrams));
+    uint8_t addedCategories = static_cast<uint8_t>(categories & ~oldCategories);
+
+    size_t stale = (oldGrams.size() - (newGrams.size() - addedGrams.size()))
+                 + (countCategories(oldCategories) - countCategories(static_cast<uint8_t>(oldCategories & categories)));
+    mLivePostings -= stale;
+    mStalePostings += stale;
+    addPostings(id, addedGrams, addedCategories);
+
+    Entry& e = mEntries[id];
+    e.handle = h;
+    e.type = type;
+    e.categories = categories;
+    e.used = true;
+    e.name = std::move(folded);
+
+    changed(id);
+}
+
+void NodeSearchIndex::remove(NodeHandle h)
+{
+    auto it = mIds.find(h.as8byte());
+    if (it == mIds.end())
+    {
+        return;
+    }
+
+    uint32_t id = it->second;
+    mIds.erase(it);
+
+    Entry& e = mEntries[id];
+    size_t stale = grams(e.name, true).size() + countCategories(e.categories);
+    mLivePostings -= stale;
+    mStalePostings += stale;
+    e = Entry();
+    mFreeIds.push_back(id);
+
+    changed(id);
+}
+
+void NodeSearchIndex::clear()
+{
+    *this = NodeSearchIndex();
+}
+
+bool NodeSearchIndex::matches(const Entry& e, const string& text, bool prefix, uint8_t categories) const
+{
+    return e.used
+        && (!categories || (e.categories & categories))
+        && (prefix ? !e.name.compare(0, text.size(), text) : e.name.find(text) != string::npos);
+}
+
+vector<NodeHandle> NodeSearchIndex::find(const char* text, bool prefix, uint8_t categories) const
+{
+    string folded(text ? text : "");
+    NodeNameSnapshot::fold(folded);
+
+    // candidates: the postings of the text's rarest trigram, or of the categories if fewer,
+    // or else all the entries (text too short to have a trigram, and no categories)
+    const vector<uint32_t>* rarest = nullptr;
+    for (uint32_t gram : grams(folded, prefix))
+    {
+        auto it = mGramPostings.find(gram);
+        if (it == mGramPostings.end())
+        {
+            return vector<NodeHandle>();
+        }
+        if (!rarest || it->second.size() < rarest->size())
+        {
+            rarest = &it->second;
+        }
+    }
+
+    vector<const vector<uint32_t>*> candidates;
+    size_t categoryPostings = 0;
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (categories & (1 << i))
+        {
+            candidates.push_back(&mCategoryPostings[i]);
+            categoryPostings += mCategoryPostings[i].size();
+        }
+    }
+    if (rarest && (candidates.empty() || rarest->size() < categoryPostings))
+    {
+        candidates.assign(1, rarest);
+    }
+
+    vector<NodeHandle> found;
+    if (candidates.empty())
+    {
+        for (auto& e : mEntries)
+        {
+            if (matches(e, folded, prefix, categories))
+            {
+                found.push_back(e.handle);
+            }
+        }
+        return found;
+    }
+
+    // stale postings may repeat an entry, when it was given back the same trigram
+    vector<bool> seen(mEntries.size());
+    for (auto postings : candidates)
+    {
+        for (uint32_t id : *postings)
+        {
+            if (!seen[id] && matches(mEntries[id], folded, prefix, categories))
+            {
+                seen[id] = true;
+                found.push_back(mEntries[id].handle);
+            }
+        }
+    }
+    return found;
+}
+
+bool NodeSearchIndex::Record::serialize(string* d)
+{
+    CacheableWriter w(*d);
+    w.serializeu32(mNumber);
+
+    if (mNumber == SCSNRECORD)
+    {
+        w.serializehandle(mIndex.mStoredScsn);
+    }
+    else
+    {
+        size_t first = size_t(mNumber) * RECORDENTRIES;
+        size_t last = std::min(first + RECORDENTRIES, mIndex.mEntries.size());
+
+        uint64_t count = 0;
+        for (size_t id = first; id < last; ++id)
+        {
+            count += mIndex.mEntries[id].used;
+        }
+        w.serializecompressedu64(count);
+
+        for (size_t id = first; id < last; ++id)
+        {
+            const Entry& e = mIndex.mEntries[id];
+            if (e.used)
+            {
+                w.serializecompressedu64(id - first);
+                w.serializenodehandle(e.handle.as8byte());
+                w.serializebyte(static_cast<byte>(e.type));
+                w.serializebyte(e.categories);
+                w.serializestring(e.name);
+            }
+        }
+    }
+
+    w.serializeexpansionflags();
+    return true;
+}
+
+bool NodeSearchIndex::store(DbTable& table, uint32_t type, SymmCipher* key, handle scsn)
+{
+    if (!mComplete)
+    {
+        // dropped altogether, so that it is built again when the cache is loaded next time
+        mDiscardedRecordIds.insert(mDiscardedRecordIds.end(), mRecordIds.begin(), mRecordIds.end());
+        mDiscardedRecordIds.push_back(mScsnRecordId);
+        mRecordIds.clear();
+        mScsnRecordId = 0;
+        mChangedRecords.clear();
+    }
+
+    for (uint32_t dbid : mDiscardedRecordIds)
+    {
+        if (dbid && !table.del(dbid))
+        {
+            return false;
+        }
+    }
+    mDiscardedRecordIds.clear();
+
+    if (!mComplete)
+    {
+        return true;
+    }
+
+    while (!mChangedRecords.empty())
+    {
+        uint32_t number = *mChangedRecords.begin();
+        if (mRecordIds.size() <= number)
+        {
+            mRecordIds.resize(number + 1);
+        }
+
+        size_t first = size_t(number) * RECORDENTRIES;
+        size_t last = std::min(first + RECORDENTRIES, mEntries.size());
+        bool empty = std::none_of(mEntries.begin() + static_cast<ptrdiff_t>(std::min(first, last)), mEntries.begin() + static_cast<ptrdiff_t>(last),
+                                  [](const Entry& e) { return e.used; });
+
+        if (!empty)
+        {
+            Record record(*this, number);
+            record.dbid = mRecordIds[number];
+            if (!table.put(type, &record, key))
+            {
+                return false;
+            }
+            mRecordIds[number] = record.dbid;
+        }
+        else if (mRecordIds[number])
+        {
+            if (!table.del(mRecordIds[number]))
+            {
+                return false;
+            }
+            mRecordIds[number] = 0;
+        }
+
+        mChangedRecords.erase(mChangedRecords.begin());
+    }
+
+    mStoredScsn = scsn;
+    Record record(*this, SCSNRECORD);
+    record.dbid = mScsnRecordId;
+    if (!table.put(type, &record, key))
+    {
+        return false;
+    }
+    mScsnRecordId = record.dbid;
+    return true;
+}
+
+bool NodeSearchIndex::unserializeRecord(const string& data, uint32_t dbid)
+{
+    CacheableReader r(data);
+    uint32_t number;
+    unsigned char expansions[8];
+
+    if (!r.unserializeu32(number))
+    {
+        mDiscardedRecordIds.push_back(dbid);
+        return false;
+    }
+
+    if (number == SCSNRECORD)
+    {
+        handle scsn;
+        if (mScsnRecordId || !r.unserializehandle(scsn) || !r.unserializeexpansionflags(expansions, 0))
+        {
+            mDiscardedRecordIds.push_back(dbid);
+            return false;
+        }
+        mScsnRecordId = dbid;
+        mStoredScsn = scsn;
+        return true;
+    }
+
+    uint64_t count;
+    if (number >= ~uint32_t(0) / RECORDENTRIES
+            || (number < mRecordIds.size() && mRecordIds[number])
+            || !r.unserializecompressedu64(count)
+            || count > RECORDENTRIES)
+    {
+        mDiscardedRecordIds.push_back(dbid);
+        return false;
+    }
+
+    if (mRecordIds.size() <= number)
+    {
+        mRecordIds.resize(number + 1);
+    }
+    mRecordIds[number] = dbid;
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t offset;
+        handle h;
+        byte type;
+        byte categories;
+        string name;
+
+        if (!r.unserializecompressedu64(offset) || offset >= RECORDENTRIES
+                || !r.unserializenodehandle(h)
+                || !r.unserializebyte(type)
+                || !r.unserializebyte(categories)
+                || !r.unserializestring(name))
+        {
+            mDiscardedRecordIds.push_back(dbid);
+            return false;
+        }
+
+        size_t id = size_t(number) * RECORDENTRIES + size_t(offset);
+        if (mEntries.size() <= id)
+        {
+            mEntries.resize(id + 1);
+        }
+
+        Entry& e = mEntries[id];
+        e.handle.set6byte(h);
+        e.type = static_cast<nodetype_t>(static_cast<signed char>(type));
+        e.categories = categories;
+        e.used = true;
+        e.name = std::move(name);
+    }
+
+    if (!r.unserializeexpansionflags(expansions, 0))
+    {
+        mDiscardedRecordIds.push_back(dbid);
+        return false;
+    }
+    return true;
+}
+
+bool NodeSearchIndex::loaded(handle scsn)
+{
+    bool valid = mScsnRecordId && mStoredScsn == scsn && !ISUNDEF(scsn) && mDiscardedRecordIds.empty();
+
+    for (uint32_t id = 0; valid && id < mEntries.size(); ++id)
+    {
+        if (!mEntries[id].used)
+        {
+            mFreeIds.push_back(id);
+        }
+        else if (!mIds.emplace(mEntries[id].handle.as8byte(), id).second)
+        {
+            valid = false;
+        }
+    }
+
+    if (valid)
+    {
+        // the highest ids are reused last, so that the last records empty first
+        std::reverse(mFreeIds.begin(), mFreeIds.end());
+        rebuildPostings();
+        mComplete = true;
+        return true;
+    }
+
+    // what was read is dropped from the cache when the index is stored next time
+    vector<uint32_t> discarded(std::move(mDiscardedRecordIds));
+    discarded.insert(discarded.end(), mRecordIds.begin(), mRecordIds.end());
+    discarded.push_back(mScsnRecordId);
+
+    clear();
+    mDiscardedRecordIds = std::move(discarded);
+    mComplete = false;
+    return false;
+}
+
+void NodeSearchIndex::forgetStored()
+{
+    mScsnRecordId = 0;
+    mDiscardedRecordIds.clear();
+    mStoredScsn = UNDEF;
+    mRecordIds.clear();
+
+    for (uint32_t number = 0; size_t(number) * RECORDENTRIES < mEntries.size(); ++number)
+    {
+        mChangedRecords.insert(number);
+    }
+}
+
 } // namespace
@@ -28,6 +28,9 @@
 #include <sys/ioctl.h>
 #include <sys/statvfs.h>
 #include <sys/resource.h>
+#ifdef USE_IOURING
+#include <sys/eventfd.h>
+#endif
 #ifdef TARGET_OS_MAC
 #include "mega/osx/osxutils.h"
 #endif
@@ -157,10 +160,12 @@ int platformCompareUtf(const LocalPath& p1, bool unescape1, const LocalPath& p2,
     return compareUtf(p1, unescape1, p2, unescape2, false);
 }
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
 PosixAsyncIOContext::PosixAsyncIOContext() : AsyncIOContext()
 {
+#ifdef HAVE_AIO_RT
     aiocb = NULL;
+#endif
 }
 
 PosixAsyncIOContext::~PosixAsyncIOContext()
@@ -171,6 +176,20 @@ PosixAsyncIOContext::~PosixAsyncIOContext()
 
 void PosixAsyncIOContext::finish()
 {
+#ifdef USE_IOURING
+    if (ring)
+    {
+        if (!finished)
+        {
+            LOG_debug << "Synchronously waiting for io_uring operation";
+            ring->reap(this);
+        }
+        assert(finished);
+        return;
+    }
+#endif
+
+#ifdef HAVE_AIO_RT
     if (aiocb)
     {
         if (!finished)
@@ -181,10 +200,183 @@ void PosixAsyncIOContext::finish()
         delete aiocb;
         aiocb = NULL;
     }
+#endif
     assert(finished);
 }
 #endif
 
+#ifdef USE_IOURING
+unique_ptr<PosixIOUring> PosixIOUring::create(unsigned entries)
+{
+    unique_ptr<PosixIOUring> r(new PosixIOUring());
+
+    int e = io_uring_queue_init(entries, &r->ring, 0);
+    if (e < 0)
+    {
+        LOG_info << "io_uring not available, using POSIX AIO instead: " << strerror(-e);
+        return nullptr;
+    }
+
+    r->eventfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (r->eventfd < 0 || io_uring_register_eventfd(&r->ring, r->eventfd) < 0)
+    {
+        LOG_warn << "Unable to set up io_uring completion notifications: " << errno;
+        if (r->eventfd >= 0)
+        {
+            close(r->eventfd);
+        }
+        io_uring_queue_exit(&r->ring);
+        return nullptr;
+    }
+
+    LOG_debug << "Using io_uring for asynchronous file I/O";
+    return r;
+}
+
+PosixIOUring::~PosixIOUring()
+{
+    // every context waits for its own operation when deleted, and they are all deleted before their files
+    io_uring_queue_exit(&ring);
+    close(eventfd);
+}
+
+bool PosixIOUring::queue(int fd, PosixAsyncIOContext* context)
+{
+    std::lock_guard<std::mutex> g(mutex);
+
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    if (!sqe)
+    {
+        // submission queue full; send what we have to make room
+        submit();
+        sqe = io_uring_get_sqe(&ring);
+        if (!sqe)
+        {
+            return false;
+        }
+    }
+
+    if (context->op == AsyncIOContext::READ)
+    {
+        io_uring_prep_read(sqe, fd, context->dataBuffer, context->dataBufferLen, static_cast<uint64_t>(context->posOfBuffer));
+    }
+    else
+    {
+        io_uring_prep_write(sqe, fd, context->dataBuffer, context->dataBufferLen, static_cast<uint64_t>(context->posOfBuffer));
+    }
+    io_uring_sqe_set_data(sqe, context);
+
+    context->ring = this;
+    queued++;
+    return true;
+}
+
+void PosixIOUring::submit()
+{
+    if (queued)
+    {
+        int e = io_uring_submit(&ring);
+        if (e < 0)
+        {
+            // the entries stay in the queue and will go with the next submission
+            LOG_warn << "io_uring submission failed: " << strerror(-e);
+            return;
+        }
+        queued = 0;
+    }
+}
+
+void PosixIOUring::addevents(Waiter* w)
+{
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        submit();
+    }
+
+    PosixWaiter* pw = (PosixWaiter*)w;
+
+    MEGA_FD_SET(eventfd, &pw->rfds);
+    MEGA_FD_SET(eventfd, &pw->ignorefds);
+
+    pw->bumpmaxfd(eventfd);
+}
+
+int PosixIOUring::reap(PosixAsyncIOContext* waitFor)
+{
+    std::lock_guard<std::mutex> g(mutex);
+
+    uint64_t count;
+    while (read(eventfd, &count, sizeof count) > 0);
+
+    if (waitFor)
+    {
+        submit();
+    }
+
+    int r = 0;
+    for (;;)
+    {
+        io_uring_cqe* cqe = nullptr;
+        int e = waitFor && !waitFor->finished ? io_uring_wait_cqe(&ring, &cqe)
+                                              : io_uring_peek_cqe(&ring, &cqe);
+        if (e == -EINTR)
+        {
+            continue;
+        }
+
+        if (e < 0 || !cqe)
+        {
+            if (waitFor && !waitFor->finished)
+            {
+                LOG_err << "Error waiting for io_uring completion: " << strerror(-e);
+            }
+            break;
+        }
+
+        complete(cqe);
+        io_uring_cqe_seen(&ring, cqe);
+        r |= Waiter::NEEDEXEC;
+    }
+    return r;
+}
+
+void PosixIOUring::complete(const io_uring_cqe* cqe)
+{
+    PosixAsyncIOContext* context = static_cast<PosixAsyncIOContext*>(io_uring_cqe_get_data(cqe));
+
+    context->ring = nullptr;
+    context->retry = cqe->res == -EAGAIN;
+    context->failed = cqe->res < 0 || static_cast<unsigned>(cqe->res) != context->dataBufferLen;
+    if (!context->failed)
+    {
+        if (context->op == AsyncIOContext::READ && context->pad)
+        {
+            memset(context->dataBuffer + context->dataBufferLen, 0, context->pad);
+            LOG_verbose << "Async read finished OK";
+        }
+        else
+        {
+            LOG_verbose << "Async write finished OK";
+        }
+    }
+    else
+    {
+        if (cqe->res >= 0)
+        {
+            // short transfer, worth trying again
+            context->retry = true;
+        }
+        LOG_warn << "Async operation finished with error: " << cqe->res;
+    }
+
+    context->finished = true;
+    if (context->userCallback)
+    {
+        context->userCallback(context->userData);
+    }
+}
+#endif
+
 PosixFileAccess::PosixFileAccess(Waiter *w, int defaultfilepermissions, bool followSymLinks) : FileAccess(w)
 {
     fd = -1;
@@ -284,6 +476,13 @@ void PosixFileAccess::sysclose()
 
 bool PosixFileAccess::asyncavailable()
 {
+#ifdef USE_IOURING
+    if (ioUringOwner && ioUringOwner->asyncRing())
+    {
+        return true;
+    }
+#endif
+
 #ifdef HAVE_AIO_RT
     #ifdef __APPLE__
         return false;
@@ -295,11 +494,14 @@ bool PosixFileAccess::asyncavailable()
 #endif
 }
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
 AsyncIOContext *PosixFileAccess::newasynccontext()
 {
     return new PosixAsyncIOContext();
 }
+#endif
+
+#ifdef HAVE_AIO_RT
 
 void PosixFileAccess::asyncopfinished(sigval sigev_value)
 {
@@ -338,7 +540,7 @@ void PosixFileAccess::asyncopfinished(sigval sigev_value)
 
 void PosixFileAccess::asyncsysopen(AsyncIOContext *context)
 {
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
     context->failed = !fopen(context->openPath, context->access & AsyncIOContext::ACCESS_READ,
                              context->access & AsyncIOContext::ACCESS_WRITE);
     context->retry = retry;
@@ -352,7 +554,7 @@ void PosixFileAccess::asyncsysopen(AsyncIOContext *context)
 
 void PosixFileAccess::asyncsysread(AsyncIOContext *context)
 {
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
     if (!context)
     {
         return;
@@ -370,7 +572,28 @@ void PosixFileAccess::asyncsysread(AsyncIOContext *context)
         }
         return;
     }
+#endif
+
+#ifdef USE_IOURING
+    if (PosixIOUring* ioUring = ioUringOwner ? ioUringOwner->asyncRing() : nullptr)
+    {
+        if (!ioUring->queue(fd, posixContext))
+        {
+            posixContext->retry = true;
+            posixContext->failed = true;
+            posixContext->finished = true;
+
+            LOG_warn << "Async read failed at startup: io_uring queue full";
+            if (posixContext->userCallback)
+            {
+                posixContext->userCallback(posixContext->userData);
+            }
+        }
+        return;
+    }
+#endif
 
+#ifdef HAVE_AIO_RT
     struct aiocb *aiocbp = new struct aiocb;
     memset(aiocbp, 0, sizeof (struct aiocb));
 
@@ -401,7 +624,7 @@ void PosixFileAccess::asyncsysread(AsyncIOContext *context)
 
 void PosixFileAccess::asyncsyswrite(AsyncIOContext *context)
 {
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
     if (!context)
     {
         return;
@@ -419,7 +642,28 @@ void PosixFileAccess::asyncsyswrite(AsyncIOContext *context)
         }
         return;
     }
+#endif
+
+#ifdef USE_IOURING
+    if (PosixIOUring* ioUring = ioUringOwner ? ioUringOwner->asyncRing() : nullptr)
+    {
+        if (!ioUring->queue(fd, posixContext))
+        {
+            posixContext->retry = true;
+            posixContext->failed = true;
+            posixContext->finished = true;
 
+            LOG_warn << "Async write failed at startup: io_uring queue full";
+            if (posixContext->userCallback)
+            {
+                posixContext->userCallback(posixContext->userData);
+            }
+        }
+        return;
+    }
+#endif
+
+#ifdef HAVE_AIO_RT
     struct aiocb *aiocbp = new struct aiocb;
     memset(aiocbp, 0, sizeof (struct aiocb));
 
@@ -586,6 +830,7 @@ bool PosixFileAccess::fopen(const LocalPath& f, bool read, bool write, DirAccess
 
             size = 0;
             mtime = statbuf.st_mtime;
+            ctime = statbuf.st_ctime;
             type = FOLDERNODE;
             fsid = (handle)statbuf.st_ino;
             fsidvalid = true;
@@ -657,6 +902,7 @@ bool PosixFileAccess::fopen(const LocalPath& f, bool read, bool write, DirAccess
             type = S_ISDIR(statbuf.st_mode) ? FOLDERNODE : FILENODE;
             size = (type == FILENODE || mIsSymLink) ? statbuf.st_size : 0;
             mtime = statbuf.st_mtime;
+            ctime = statbuf.st_ctime;
             // in the future we might want to add LINKNODE to type and set it here using S_ISLNK
             fsid = (handle)statbuf.st_ino;
             fsidvalid = true;
@@ -716,6 +962,18 @@ PosixFileSystemAccess::~PosixFileSystemAccess()
     }
 }
 
+#ifdef USE_IOURING
+PosixIOUring* PosixFileSystemAccess::asyncRing()
+{
+    if (!ioUringSetUp)
+    {
+        ioUringSetUp = true;
+        ioUring = PosixIOUring::create();
+    }
+    return ioUring.get();
+}
+#endif
+
 bool PosixFileSystemAccess::cwd(LocalPath& path) const
 {
     return cwd_static(path);
@@ -745,6 +1003,13 @@ bool PosixFileSystemAccess::cwd_static(LocalPath& path)
 // wake up from filesystem updates
 void PosixFileSystemAccess::addevents(Waiter* w, int /*flags*/)
 {
+#ifdef USE_IOURING
+    if (ioUring)
+    {
+        ioUring->addevents(w);
+    }
+#endif
+
     if (notifyfd >= 0)
     {
         PosixWaiter* pw = (PosixWaiter*)w;
@@ -760,6 +1025,14 @@ void PosixFileSystemAccess::addevents(Waiter* w, int /*flags*/)
 int PosixFileSystemAccess::checkevents(Waiter* w)
 {
     int r = 0;
+
+#ifdef USE_IOURING
+    if (ioUring)
+    {
+        r |= ioUring->reap();
+    }
+#endif
+
     if (notifyfd < 0)
     {
         return r;
@@ -1939,7 +2212,11 @@ bool PosixFileSystemAccess::hardLink(const LocalPath& source, const LocalPath& t
 
 std::unique_ptr<FileAccess> PosixFileSystemAccess::newfileaccess(bool followSymLinks)
 {
-    return std::unique_ptr<FileAccess>{new PosixFileAccess{waiter, defaultfilepermissions, followSymLinks}};
+    PosixFileAccess* fa = new PosixFileAccess{waiter, defaultfilepermissions, followSymLinks};
+#ifdef USE_IOURING
+    fa->ioUringOwner = this;
+#endif
+    return std::unique_ptr<FileAccess>{fa};
 }
 
 unique_ptr<DirAccess>  PosixFileSystemAccess::newdiraccess()
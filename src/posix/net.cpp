@@ -258,6 +258,8 @@ CurlHttpIO::CurlHttpIO()
     reset = false;
     statechange = false;
     disconnecting = false;
+    multiplexing = false;
+    maxhostconnections = 0;
     maxspeed[GET] = 0;
     maxspeed[PUT] = 0;
     pkpErrors = 0;
@@ -356,6 +358,8 @@ CurlHttpIO::CurlHttpIO()
     curltimeoutreset[PUT] = -1;
     arerequestspaused[PUT] = false;
 
+    setmultiplexingoptions();
+
     curlsh = curl_share_init();
     curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
     curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
@@ -916,6 +920,8 @@ void CurlHttpIO::disconnect()
     curltimeoutreset[PUT] = -1;
     arerequestspaused[PUT] = false;
 
+    setmultiplexingoptions();
+
     disconnecting = false;
 #ifdef MEGA_USE_C_ARES
     if (dnsservers.size())
@@ -958,6 +964,36 @@ m_off_t CurlHttpIO::getmaxuploadspeed()
     return maxspeed[PUT];
 }
 
+void CurlHttpIO::setmultiplexing(bool enable, unsigned maxconnections)
+{
+#if LIBCURL_VERSION_NUM >= 0x072f00 // At least cURL 7.47.0
+    if (enable && !(curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP2))
+    {
+        LOG_warn << "cURL built without HTTP/2 support. Multiplexing not enabled";
+        return;
+    }
+
+    LOG_info << "HTTP/2 multiplexing " << (enable ? "enabled" : "disabled")
+             << ". Connections per host: " << (maxconnections ? std::to_string(maxconnections) : "unlimited");
+    multiplexing = enable;
+    maxhostconnections = enable ? maxconnections : 0;
+    setmultiplexingoptions();
+#else
+    LOG_warn << "cURL too old for HTTP/2 multiplexing";
+#endif
+}
+
+void CurlHttpIO::setmultiplexingoptions()
+{
+#if LIBCURL_VERSION_NUM >= 0x072f00 // At least cURL 7.47.0
+    for (direction_t d : { API, GET, PUT })
+    {
+        curl_multi_setopt(curlm[d], CURLMOPT_PIPELINING, multiplexing ? long(CURLPIPE_MULTIPLEX) : long(CURLPIPE_NOTHING));
+        curl_multi_setopt(curlm[d], CURLMOPT_MAX_HOST_CONNECTIONS, long(maxhostconnections));
+    }
+#endif
+}
+
 bool CurlHttpIO::cacheresolvedurls(const std::vector<string>& urls, std::vector<string>&& ips)
 {
     // for each URL there should be 2 IPs (IPv4 first, IPv6 second)
@@ -1548,6 +1584,21 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         // Some networks (eg vodafone UK) seem to block TLS 1.3 ClientHello.  1.2 is secure, and works:
         curl_easy_setopt(curl, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2 | CURL_SSLVERSION_MAX_TLSv1_2);
 
+    #if LIBCURL_VERSION_NUM >= 0x072f00 // At least cURL 7.47.0
+        if (httpio->multiplexing)
+        {
+            // HTTP/2 when the server offers it over TLS, and rather than opening a new connection,
+            // wait for one to the same host that can take another stream
+            curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, long(CURL_HTTP_VERSION_2TLS));
+            curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+        }
+        else
+        {
+            // recent cURL versions default to HTTP/2 over TLS
+            curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, long(CURL_HTTP_VERSION_1_1));
+        }
+    #endif
+
         if (httpio->maxspeed[GET] && httpio->maxspeed[GET] <= 102400)
         {
             curl_easy_setopt(curl, CURLOPT_BUFFERSIZE, 4096L);
@@ -2125,6 +2176,17 @@ void CurlHttpIO::cancel(HttpReq* req)
     }
 }
 
+void CurlHttpIO::setpaused(HttpReq* req, bool paused)
+{
+    CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
+
+    // (a request without a handle yet is paused by write_data() when its data arrives)
+    if (httpctx && httpctx->curl)
+    {
+        curl_easy_pause(httpctx->curl, paused ? CURLPAUSE_RECV : CURLPAUSE_CONT);
+    }
+}
+
 // real-time progress information on POST data
 m_off_t CurlHttpIO::postpos(void* handle)
 {
@@ -2313,7 +2375,7 @@ bool CurlHttpIO::multidoio(CURLM *curlmhandle)
                 req->status = (req->httpstatus == 200
                                && errorCode != CURLE_PARTIAL_FILE
                                && (req->contentlength < 0
-                                   || req->contentlength == (req->buf ? req->bufpos : (int)req->in.size())))
+                                   || req->contentlength == ((req->buf || req->mChunked) ? req->bufpos : (int)req->in.size())))
                         ? REQ_SUCCESS : REQ_FAILURE;
 
                 if (req->status == REQ_SUCCESS)
@@ -2561,6 +2623,12 @@ size_t CurlHttpIO::write_data(void* ptr, size_t size, size_t nmemb, void* target
     CurlHttpIO* httpio = (CurlHttpIO*)req->httpio;
     if (httpio)
     {
+        if (req->paused)
+        {
+            // curl keeps the data, and delivers it again once resumed
+            return CURL_WRITEFUNC_PAUSE;
+        }
+
         if (httpio->maxspeed[GET])
         {
             CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
@@ -27,6 +27,17 @@
 
 #undef min //avoids issues with std::min
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define MEGA_RAID_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MEGA_TARGET_AVX2
+#else
+#define MEGA_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 namespace mega
 {
 
@@ -108,20 +119,20 @@ FaultyServers g_faultyServers;
 
 RaidBufferManager::FilePiece::FilePiece()
     : pos(0)
-    , buf(NULL, 0, 0)
+    , buf(NULL, 0, 0, 0)
 {
 }
 
 RaidBufferManager::FilePiece::FilePiece(m_off_t p, size_t len)
     : pos(p)
-    , buf(new byte[len + std::min<size_t>(SymmCipher::BLOCKSIZE, RAIDSECTOR)], 0, len)   // SymmCipher::ctr_crypt requirement: decryption: data must be padded to BLOCKSIZE.  Also make sure we can xor up to RAIDSECTOR more for convenience
+    , buf(g_bufferPool.get(len + std::min<size_t>(SymmCipher::BLOCKSIZE, RAIDSECTOR)), 0, len, len + std::min<size_t>(SymmCipher::BLOCKSIZE, RAIDSECTOR))   // SymmCipher::ctr_crypt requirement: decryption: data must be padded to BLOCKSIZE.  Also make sure we can xor up to RAIDSECTOR more for convenience
 {
 }
 
 
 RaidBufferManager::FilePiece::FilePiece(m_off_t p, HttpReq::http_buf_t* b) // taking ownership
     : pos(p)
-    , buf(NULL, 0, 0)
+    , buf(NULL, 0, 0, 0)
 {
     buf.swap(*b);  // take its buffer and copy other members
     delete b;  // client no longer owns it so we must delete.  Similar to move semantics where we would just assign
@@ -376,7 +387,7 @@ std::pair<m_off_t, m_off_t> RaidBufferManager::nextNPosForConnection(unsigned co
         m_off_t npos = std::min<m_off_t>(curpos + raidLinesPerChunk * RAIDSECTOR * RaidMaxChunksPerRead, maxpos);
         if (unusedRaidConnection == connectionNum && npos > curpos)
         {
-            submitBuffer(connectionNum, new RaidBufferManager::FilePiece(curpos, new HttpReq::http_buf_t(NULL, 0, size_t(npos - curpos))));
+            submitBuffer(connectionNum, new RaidBufferManager::FilePiece(curpos, new HttpReq::http_buf_t(NULL, 0, size_t(npos - curpos), 0)));
             transferPos(connectionNum) = npos;
             newInputBufferSupplied = true;
         }
@@ -428,6 +439,252 @@ m_off_t RaidBufferManager::raidPartSize(unsigned part, m_off_t filesize)
 }
 
 
+namespace {
+
+// Kernels that rebuild whole raid lines.  interleave: all 5 data parts are present.
+// recover: in[0] is the parity part and in[1..4] the present data parts, whose sectors go to
+// slot[1..4] of each line; the sector at slot "missing" is the xor of all of them.
+typedef void (*RaidInterleaveFn)(byte* dest, const byte* const* data, size_t partslen);
+typedef void (*RaidRecoverFn)(byte* dest, const byte* const* in, const unsigned* slot, unsigned missing, size_t partslen);
+
+#ifndef MEGA_RAID_SIMD
+
+void interleaveScalar(byte* dest, const byte* const* data, size_t partslen)
+{
+    for (size_t i = 0; i < partslen; i += RAIDSECTOR)
+    {
+        for (unsigned j = 0; j < RAIDPARTS - 1; ++j, dest += RAIDSECTOR)
+        {
+            memcpy(dest, data[j] + i, RAIDSECTOR);
+        }
+    }
+}
+
+void recoverScalar(byte* dest, const byte* const* in, const unsigned* slot, unsigned missing, size_t partslen)
+{
+    for (size_t i = 0; i < partslen; i += RAIDSECTOR, dest += RAIDLINE)
+    {
+        uint64_t x[2], v[2];
+        memcpy(x, in[0] + i, RAIDSECTOR);
+        for (unsigned k = 1; k < RAIDPARTS - 1; ++k)
+        {
+            memcpy(v, in[k] + i, RAIDSECTOR);
+            x[0] ^= v[0];
+            x[1] ^= v[1];
+            memcpy(dest + slot[k] * RAIDSECTOR, v, RAIDSECTOR);
+        }
+        memcpy(dest + missing * RAIDSECTOR, x, RAIDSECTOR);
+    }
+}
+
+#else
+
+void interleaveSse2(byte* dest, const byte* const* data, size_t partslen)
+{
+    for (size_t i = 0; i < partslen; i += RAIDSECTOR, dest += RAIDLINE)
+    {
+        for (unsigned j = 0; j < RAIDPARTS - 1; ++j)
+        {
+            _mm_storeu_si128((__m128i*)(dest + j * RAIDSECTOR), _mm_loadu_si128((const __m128i*)(data[j] + i)));
+        }
+    }
+}
+
+void recoverSse2(byte* dest, const byte* const* in, const unsigned* slot, unsigned missing, size_t partslen)
+{
+    for (size_t i = 0; i < partslen; i += RAIDSECTOR, dest += RAIDLINE)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*)(in[0] + i));
+        for (unsigned k = 1; k < RAIDPARTS - 1; ++k)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(in[k] + i));
+            x = _mm_xor_si128(x, v);
+            _mm_storeu_si128((__m128i*)(dest + slot[k] * RAIDSECTOR), v);
+        }
+        _mm_storeu_si128((__m128i*)(dest + missing * RAIDSECTOR), x);
+    }
+}
+
+// two raid lines per iteration: a 256 bit load takes the same sector of both lines from a part,
+// and the 128 bit halves are then regrouped into the two consecutive 80 byte output lines
+MEGA_TARGET_AVX2 void storeTwoLinesAvx2(byte* dest, const __m256i* d)
+{
+    _mm256_storeu_si256((__m256i*)dest, _mm256_permute2x128_si256(d[0], d[1], 0x20));
+    _mm256_storeu_si256((__m256i*)(dest + 32), _mm256_permute2x128_si256(d[2], d[3], 0x20));
+    _mm256_storeu_si256((__m256i*)(dest + 64), _mm256_permute2x128_si256(d[4], d[0], 0x30));
+    _mm256_storeu_si256((__m256i*)(dest + 96), _mm256_permute2x128_si256(d[1], d[2], 0x31));
+    _mm256_storeu_si256((__m256i*)(dest + 128), _mm256_permute2x128_si256(d[3], d[4], 0x31));
+}
+
+MEGA_TARGET_AVX2 void interleaveAvx2(byte* dest, const byte* const* data, size_t partslen)
+{
+    size_t i = 0;
+    for (; i + 2 * RAIDSECTOR <= partslen; i += 2 * RAIDSECTOR, dest += 2 * RAIDLINE)
+    {
+        __m256i d[RAIDPARTS - 1];
+        for (unsigned j = 0; j < RAIDPARTS - 1; ++j)
+        {
+            d[j] = _mm256_loadu_si256((const __m256i*)(data[j] + i));
+        }
+        storeTwoLinesAvx2(dest, d);
+    }
+
+    if (i < partslen)
+    {
+        const byte* rest[RAIDPARTS - 1];
+        for (unsigned j = 0; j < RAIDPARTS - 1; ++j)
+        {
+            rest[j] = data[j] + i;
+        }
+        interleaveSse2(dest, rest, partslen - i);
+    }
+}
+
+MEGA_TARGET_AVX2 void recoverAvx2(byte* dest, const byte* const* in, const unsigned* slot, unsigned missing, size_t partslen)
+{
+    size_t i = 0;
+    for (; i + 2 * RAIDSECTOR <= partslen; i += 2 * RAIDSECTOR, dest += 2 * RAIDLINE)
+    {
+        __m256i d[RAIDPARTS - 1];
+        __m256i x = _mm256_loadu_si256((const __m256i*)(in[0] + i));
+        for (unsigned k = 1; k < RAIDPARTS - 1; ++k)
+        {
+            d[slot[k]] = _mm256_loadu_si256((const __m256i*)(in[k] + i));
+            x = _mm256_xor_si256(x, d[slot[k]]);
+        }
+        d[missing] = x;
+        storeTwoLinesAvx2(dest, d);
+    }
+
+    if (i < partslen)
+    {
+        const byte* rest[RAIDPARTS - 1];
+        for (unsigned k = 0; k < RAIDPARTS - 1; ++k)
+        {
+            rest[k] = in[k] + i;
+        }
+        recoverSse2(dest, rest, slot, missing, partslen - i);
+    }
+}
+
+bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+
+    // AVX2 also needs the OS to save the ymm registers
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+    {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif
+
+struct RaidKernels
+{
+    RaidInterleaveFn interleave;
+    RaidRecoverFn recover;
+};
+
+const RaidKernels& raidKernels()
+{
+#ifdef MEGA_RAID_SIMD
+    static const RaidKernels kernels = cpuHasAvx2() ? RaidKernels{ interleaveAvx2, recoverAvx2 }
+                                                    : RaidKernels{ interleaveSse2, recoverSse2 };
+#else
+    static const RaidKernels kernels = { interleaveScalar, recoverScalar };
+#endif
+    return kernels;
+}
+
+} // anonymous
+
+void combineRaidLines(byte* dest, byte* const inputbufs[RAIDPARTS], size_t partslen)
+{
+    assert(partslen % RAIDSECTOR == 0);
+
+    const byte* in[RAIDPARTS - 1];
+    unsigned slot[RAIDPARTS - 1];
+    unsigned missing = RAIDPARTS - 1;
+    unsigned n = 0;
+
+    // usual case: the parity part is the one not downloaded
+    for (unsigned j = 1; j < RAIDPARTS; ++j)
+    {
+        if (inputbufs[j])
+        {
+            in[n++] = inputbufs[j];
+        }
+        else if (missing == RAIDPARTS - 1)
+        {
+            missing = j - 1;
+        }
+        else
+        {
+            missing = RAIDPARTS; // more than one data part missing
+        }
+    }
+
+    if (missing == RAIDPARTS - 1)
+    {
+        raidKernels().interleave(dest, in, partslen);
+        return;
+    }
+
+    if (missing < RAIDPARTS - 1 && inputbufs[0])
+    {
+        // rebuild the missing data part from the parity part and the other four
+        in[0] = inputbufs[0];
+        n = 1;
+        for (unsigned j = 1; j < RAIDPARTS; ++j)
+        {
+            if (inputbufs[j])
+            {
+                slot[n] = j - 1;
+                in[n++] = inputbufs[j];
+            }
+        }
+        raidKernels().recover(dest, in, slot, missing, partslen);
+        return;
+    }
+
+    // not recoverable; keep the historical behaviour of xoring whatever is present
+    for (size_t i = 0; i < partslen; i += RAIDSECTOR)
+    {
+        for (unsigned j = 1; j < RAIDPARTS; ++j, dest += RAIDSECTOR)
+        {
+            if (inputbufs[j])
+            {
+                memcpy(dest, inputbufs[j] + i, RAIDSECTOR);
+                continue;
+            }
+
+            memset(dest, 0, RAIDSECTOR);
+            for (unsigned k = RAIDPARTS; k--; )
+            {
+                if (inputbufs[k])
+                {
+                    SymmCipher::xorblock(inputbufs[k] + i, dest);
+                }
+            }
+        }
+    }
+}
+
 void RaidBufferManager::combineRaidParts(unsigned connectionNum)
 {
     assert(asyncoutputbuffers.find(connectionNum) == asyncoutputbuffers.end() || !asyncoutputbuffers[connectionNum]);
@@ -543,51 +800,12 @@ RaidBufferManager::FilePiece* RaidBufferManager::combineRaidParts(size_t partsle
         }
 
         byte* b = result->buf.datastart() + prevleftoverchunk.buf.datalen();
-        byte* endpos = b + partslen * (RAIDPARTS-1);
-
-        for (unsigned i = 0; b < endpos; i += RAIDSECTOR)
-        {
-            for (unsigned j = 1; j < RAIDPARTS; ++j)
-            {
-                assert(b + RAIDSECTOR <= result->buf.datastart() + result->buf.datalen());
-                if (inputbufs[j])
-                {
-                    memcpy(b, inputbufs[j] + i, RAIDSECTOR);
-                }
-                else
-                {
-                    recoverSectorFromParity(b, inputbufs, i);
-                }
-                b += RAIDSECTOR;
-            }
-        }
-        assert(b == endpos);
+        assert(b + partslen * (RAIDPARTS - 1) <= result->buf.datastart() + result->buf.datalen());
+        combineRaidLines(b, inputbufs, partslen);
     }
     return result;
 }
 
-void RaidBufferManager::recoverSectorFromParity(byte* dest, byte* inputbufs[], unsigned offset)
-{
-    assert(sizeof(m_off_t)*2 == RAIDSECTOR);
-    bool set = false;
-    for (unsigned i = RAIDPARTS; i--; )
-    {
-        if (inputbufs[i])
-        {
-            if (!set)
-            {
-                memcpy(dest, inputbufs[i] + offset, RAIDSECTOR);
-                set = true;
-            }
-            else
-            {
-                *(m_off_t*)dest ^= *(m_off_t*)(inputbufs[i] + offset);
-                *(m_off_t*)(dest + sizeof(m_off_t)) ^= *(m_off_t*)(inputbufs[i] + offset + sizeof(m_off_t));
-            }
-        }
-    }
-}
-
 void RaidBufferManager::combineLastRaidLine(byte* dest, size_t remainingbytes)
 {
     // we have to be careful to use the right number of bytes from each sector
@@ -664,6 +882,9 @@ bool RaidBufferManager::FilePiece::finalize(bool parallel, m_off_t filesize, int
     m_off_t endpos = ChunkedHash::chunkceil(startpos, finalpos);
     unsigned chunksize = static_cast<unsigned>(endpos - startpos);
 
+    // chunks finished in parallel mode are independent, so they are decrypted together
+    vector<chunkmac_map::CtrPiece> finishing;
+
     while (chunksize)
     {
         m_off_t chunkid = ChunkedHash::chunkfloor(startpos);
@@ -679,7 +900,7 @@ bool RaidBufferManager::FilePiece::finalize(bool parallel, m_off_t filesize, int
                 {
                     // executing on a worker thread (or synchronously on transferslot destruction)
                     // these are independent chunks, or the earlier part of the chunk is already done.
-                    chunkmacs.ctr_decrypt(chunkid, cipher, chunkstart, chunksize, startpos, ctriv, true);
+                    finishing.push_back({ chunkid, chunkstart, chunksize, startpos });
                     LOG_debug << "Finished chunk: " << startpos << " - " << endpos << "   Size: " << chunksize;
                 }
                 else
@@ -700,6 +921,11 @@ bool RaidBufferManager::FilePiece::finalize(bool parallel, m_off_t filesize, int
         chunksize = static_cast<unsigned>(endpos - startpos);
     }
 
+    if (!finishing.empty())
+    {
+        chunkmacs.ctr_decrypt(finishing, cipher, ctriv, true);
+    }
+
     finalized = !queueParallel;
     if (finalized)
         finalizedCV.notify_one();
@@ -31,6 +31,69 @@ bool Request::isFetchNodes() const
     return cmds.size() == 1 && dynamic_cast<CommandFetchNodes*>(cmds.back());
 }
 
+bool Request::isChunked() const
+{
+    return cmds.size() == 1 && !cmds.back()->mFilters.empty();
+}
+
+size_t Request::processChunk(const char* data, size_t len, MegaClient* client)
+{
+    if (cmds.empty())
+    {
+        // cleared while in progress (eg. logout)
+        return len;
+    }
+
+    if (!mSplitter.hasStarted())
+    {
+        // only the command's own result ([{...}]) is parsed as it arrives.  Short
+        // responses, such as errors, are processed by serverresponse() as usual
+        const char* start = data;
+        const char* end = data + len;
+        while (start < end && *start <= ' ')
+        {
+            start++;
+        }
+        if (end - start < 2 || start[0] != '[')
+        {
+            return 0;
+        }
+        for (start++; start < end && *start <= ' '; start++);
+        if (start == end || *start != '{')
+        {
+            return 0;
+        }
+    }
+
+    Command* cmd = cmds.back();
+    client->restag = cmd->tag;
+    cmd->client = client;
+
+    bool failed = mSplitter.hasFailed();
+    size_t consumed = mSplitter.processChunk(cmd->mFilters, data, len);
+
+    if (!failed && mSplitter.hasFailed())
+    {
+        LOG_err << "Invalid chunked response";
+        cmd->procresult(Command::Result(Command::CmdError, API_EINTERNAL));
+    }
+
+    return consumed;
+}
+
+void Request::processLastChunk(const char* data, size_t len, MegaClient* client)
+{
+    processChunk(data, len, client);
+
+    if (!cmds.empty() && !mSplitter.hasFinished() && !mSplitter.hasFailed())
+    {
+        LOG_err << "Incomplete chunked response";
+        cmds.back()->procresult(Command::Result(Command::CmdError, API_EINTERNAL));
+    }
+
+    clear();
+}
+
 void Request::add(Command* c)
 {
     cmds.push_back(c);
@@ -182,6 +245,7 @@ void Request::clear()
     json.pos = NULL;
     processindex = 0;
     stopProcessing = false;
+    mSplitter.clear();
 }
 
 bool Request::empty() const
@@ -196,6 +260,10 @@ void Request::swap(Request& r)
     assert(jsonresponse.empty() && r.jsonresponse.empty());
     assert(json.pos == NULL && r.json.pos == NULL);
     assert(processindex == 0 && r.processindex == 0);
+
+    // a request sent again parses its new response from the start
+    mSplitter.clear();
+    r.mSplitter.clear();
 }
 
 RequestDispatcher::RequestDispatcher()
@@ -296,6 +364,38 @@ void RequestDispatcher::serverresponse(std::string&& movestring, MegaClient *cli
     }
 }
 
+size_t RequestDispatcher::serverchunk(const char* data, size_t len, MegaClient* client)
+{
+    CodeCounter::ScopeTimer ccst(client->performanceStats.csResponseProcessingTime);
+
+    processing = true;
+    size_t consumed = inflightreq.processChunk(data, len, client);
+    processing = false;
+    if (clearWhenSafe)
+    {
+        clear();
+    }
+    return consumed;
+}
+
+void RequestDispatcher::serverlastchunk(const char* data, size_t len, MegaClient* client)
+{
+    CodeCounter::ScopeTimer ccst(client->performanceStats.csResponseProcessingTime);
+
+#ifdef MEGA_MEASURE_CODE
+    csBatchesReceived += 1;
+    csRequestsCompleted += inflightreq.size();
+#endif
+    processing = true;
+    inflightreq.processLastChunk(data, len, client);
+    assert(inflightreq.empty());
+    processing = false;
+    if (clearWhenSafe)
+    {
+        clear();
+    }
+}
+
 void RequestDispatcher::servererror(const std::string& e, MegaClient *client)
 {
     // notify all the commands in the batch of the failure
@@ -40,6 +40,9 @@ const int Sync::EXTRA_SCANNING_DELAY_DS = 150;
 const int Sync::FILE_UPDATE_DELAY_DS = 30;
 const int Sync::FILE_UPDATE_MAX_DELAY_SECS = 60;
 const dstime Sync::RECENT_VERSION_INTERVAL_SECS = 10800;
+const size_t Sync::FINGERPRINT_LOOKAHEAD = 64;
+const int Sync::FINGERPRINT_RETRY_DS = 1;
+const dstime Sync::FINGERPRINT_MAX_AGE_DS = 600;
 
 namespace {
 
@@ -1389,8 +1392,10 @@ bool Sync::scan(LocalPath* localpath, FileAccess* fa)
                         LocalNode *l = NULL;
                         if (initializing)
                         {
-                            // preload all cached LocalNodes
-                            l = checkpath(NULL, localpath, nullptr, nullptr, false, da.get());
+                            // preload all cached LocalNodes, leaving the files to be
+                            // fingerprinted to the scan service and the notification queue
+                            dstime backoffds = 0;
+                            l = checkpath(NULL, localpath, nullptr, &backoffds, false, da.get());
                         }
 
                         if (!l || l == (LocalNode*)~0)
@@ -1679,6 +1684,12 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                         // no fsid change detected or overwrite with unknown file:
                         if (fa->mtime != l->mtime || fa->size != l->size)
                         {
+                            if (backoffds && fingerprintPending(*localpathNew))
+                            {
+                                *backoffds = FINGERPRINT_RETRY_DS;
+                                return NULL;
+                            }
+
                             if (fa->fsidvalid && l->fsid != fa->fsid)
                             {
                                 l->setfsid(fa->fsid, client->fsidnode);
@@ -1686,7 +1697,7 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
 
                             m_off_t dsize = l->size > 0 ? l->size : 0;
 
-                            if (l->genfingerprint(fa.get()) && l->size >= 0)
+                            if (genfingerprint(*l, fa.get(), *localpathNew) && l->size >= 0)
                             {
                                 localbytes -= dsize - l->size;
                             }
@@ -1935,6 +1946,12 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                 }
                 else
                 {
+                    if (fa->type == FILENODE && backoffds && fingerprintPending(*localpathNew))
+                    {
+                        *backoffds = FINGERPRINT_RETRY_DS;
+                        return NULL;
+                    }
+
                     // this is a new node: add
                     LOG_debug << "New localnode.  Parent: " << (parent ? parent->name : "NO") << " fsid " << (fa->fsidvalid ? toHandle(fa->fsid) : "NO");
                     l = new LocalNode(this);
@@ -1985,6 +2002,12 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                 }
                 else
                 {
+                    if (backoffds && fingerprintPending(*localpathNew))
+                    {
+                        *backoffds = FINGERPRINT_RETRY_DS;
+                        return NULL;
+                    }
+
                     if (fa->fsidvalid && l->fsid != fa->fsid)
                     {
                         l->setfsid(fa->fsid, client->fsidnode);
@@ -1995,7 +2018,7 @@ LocalNode* Sync::checkpath(LocalNode* l, LocalPath* input_localpath, string* con
                         localbytes -= l->size;
                     }
 
-                    if (l->genfingerprint(fa.get()))
+                    if (genfingerprint(*l, fa.get(), *localpathNew))
                     {
                         changed = true;
                         l->bumpnagleds();
@@ -2146,6 +2169,8 @@ dstime Sync::procscanq(int q)
     dstime dsmin = Waiter::ds - SCANNING_DELAY_DS;
     LocalNode* l;
 
+    prefetchFingerprints(q);
+
     Notification notification;
     while (dirnotify->notifyq[q].popFront(notification))
     {
@@ -2203,6 +2228,7 @@ dstime Sync::procscanq(int q)
                 }
             }
 
+            mFingerprintedInline = false;
             l = checkpath(l, &notification.path, NULL, &backoffds, false, nullptr);
             if (backoffds)
             {
@@ -2229,10 +2255,11 @@ dstime Sync::procscanq(int q)
         }
 
         // we return control to the application in case a filenode was added
-        // (in order to avoid lengthy blocking episodes due to multiple
-        // consecutive fingerprint calculations)
+        // and fingerprinted here (in order to avoid lengthy blocking episodes
+        // due to multiple consecutive fingerprint calculations - those computed
+        // by the scan service cost nothing to apply)
         // or if new nodes are being added due to a copy/delete operation
-        if ((l && l != (LocalNode*)~0 && l->type == FILENODE) || client->syncadding)
+        if ((l && l != (LocalNode*)~0 && l->type == FILENODE && mFingerprintedInline) || client->syncadding)
         {
             break;
         }
@@ -2253,6 +2280,126 @@ dstime Sync::procscanq(int q)
     return dstime(~0);
 }
 
+void Sync::prefetchFingerprints(int q)
+{
+    // forget what the notifications won't be asking for
+    for (auto it = mFingerprintRequests.begin(); it != mFingerprintRequests.end(); )
+    {
+        auto& request = *it->second;
+
+        if (request.completed() && Waiter::ds - request.mQueued > FINGERPRINT_MAX_AGE_DS)
+        {
+            it = mFingerprintRequests.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for (auto& notification : dirnotify->notifyq[q].peekFront(FINGERPRINT_LOOKAHEAD))
+    {
+        if (notification.localnode == (LocalNode*)~0 || notification.recursive)
+        {
+            continue;
+        }
+
+        auto path = notification.localnode ? notification.localnode->getLocalPath() : LocalPath();
+
+        if (path.empty())
+        {
+            path = notification.path;
+        }
+        else if (!notification.path.empty())
+        {
+            path.appendWithSeparator(notification.path, false);
+        }
+
+        // a request older than the notification may have read the file before it changed
+        auto it = mFingerprintRequests.find(path);
+
+        if (it != mFingerprintRequests.end() && it->second->mQueued >= notification.timestamp)
+        {
+            continue;
+        }
+
+        // nothing to read for a known file with the same size and mtime, or for a folder
+        if (LocalNode* ll = localnodebypath(notification.localnode, notification.path))
+        {
+            if (ll->type != FILENODE)
+            {
+                continue;
+            }
+
+            auto fa = client->fsaccess->newfileaccess(false);
+            if (fa->fopen(path, false, false) && fa->type == FILENODE
+                && fa->size == ll->size && fa->mtime == ll->mtime)
+            {
+                continue;
+            }
+        }
+
+        if (!mScanService)
+        {
+            mScanService.reset(new ScanService(*client->waiter));
+        }
+
+        mFingerprintRequests[path] = mScanService->queueFingerprint(path, false, client->fingerprintCache(), fsfp);
+    }
+}
+
+bool Sync::fingerprintPending(const LocalPath& path)
+{
+    auto it = mFingerprintRequests.find(path);
+
+    if (it != mFingerprintRequests.end())
+    {
+        // once completed, genfingerprint() either uses the result or, if the
+        // file changed since, reads it again itself
+        return !it->second->completed();
+    }
+
+    if (!mScanService)
+    {
+        mScanService.reset(new ScanService(*client->waiter));
+    }
+
+    mFingerprintRequests.emplace(path, mScanService->queueFingerprint(path, false, client->fingerprintCache(), fsfp));
+    return true;
+}
+
+bool Sync::genfingerprint(FileFingerprint& f, FileAccess* fa, const LocalPath& path)
+{
+    auto it = mFingerprintRequests.find(path);
+
+    if (it != mFingerprintRequests.end() && it->second->completed())
+    {
+        auto request = std::move(it->second);
+        mFingerprintRequests.erase(it);
+
+        if (request->mIsFile
+            && request->mSize == fa->size
+            && request->mMtime == fa->mtime
+            && request->mFsid == (fa->fsidvalid ? fa->fsid : UNDEF))
+        {
+            // same outcome as f.genfingerprint(fa), without touching the file
+            return f.takefingerprint(request->mFingerprint);
+        }
+    }
+
+    if (auto cache = client->fingerprintCache())
+    {
+        // (other threads may miss meanwhile, that only makes us yield sooner)
+        size_t misses = cache->misses;
+        bool changed = cache->genfingerprint(f, fa, fsfp);
+        mFingerprintedInline = cache->misses != misses;
+        return changed;
+    }
+
+    mFingerprintedInline = true;
+    return f.genfingerprint(fa);
+}
+
 // delete all child LocalNodes that have been missing for two consecutive scans (*l must still exist)
 void Sync::deletemissing(LocalNode* l)
 {
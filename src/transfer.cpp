@@ -58,6 +58,274 @@ unsigned TransferCategory::directionIndex()
     return direction;
 }
 
+void TransferLimits::setDefaults(direction_t d, unsigned transfers, unsigned connections)
+{
+    assert(d == GET || d == PUT);
+    Direction& dir = mDirections[d];
+    dir.limits.transfers = std::max(transfers, 1u);
+    dir.limits.connections = std::max(connections, 1u);
+    dir.limits.reason = "default";
+    dir.maxTransfers = std::max(dir.maxTransfers, dir.limits.transfers);
+    dir.maxConnections = std::max(dir.maxConnections, dir.limits.connections);
+}
+
+void TransferLimits::setCeilings(direction_t d, unsigned transfers, unsigned connections)
+{
+    assert(d == GET || d == PUT);
+    Direction& dir = mDirections[d];
+    dir.maxTransfers = std::max(transfers, 1u);
+    dir.maxConnections = std::max(connections, 1u);
+
+    if (dir.limits.transfers > dir.maxTransfers || dir.limits.connections > dir.maxConnections)
+    {
+        dir.limits.transfers = std::min(dir.limits.transfers, dir.maxTransfers);
+        dir.limits.connections = std::min(dir.limits.connections, dir.maxConnections);
+        dir.limits.reason = "ceiling";
+    }
+}
+
+m_off_t TransferLimits::targetOutstanding(m_off_t goodput) const
+{
+    m_off_t target = 30 * goodput;
+    target = std::max<m_off_t>(target, 2 * 1024 * 1024);
+    return std::min(target, std::max<m_off_t>(mMaxOutstanding, 2 * 1024 * 1024));
+}
+
+void TransferLimits::requestCompleted(direction_t d, m_off_t bytes, dstime elapsed)
+{
+    assert(d == GET || d == PUT);
+    if (bytes <= 0)
+    {
+        return;
+    }
+
+    // time per MB, so that the growing chunk sizes don't look like slower requests
+    Direction& dir = mDirections[d];
+    double t = std::max<dstime>(elapsed, 1) * 1048576.0 / bytes;
+    dir.requestTime = dir.requestTime > 0 ? 0.8 * dir.requestTime + 0.2 * t : t;
+    dir.requests++;
+}
+
+bool TransferLimits::raise(Direction& dir, Knob knob)
+{
+    if (knob == TRANSFERS && dir.limits.transfers < dir.maxTransfers)
+    {
+        dir.limits.transfers = std::min(dir.maxTransfers, dir.limits.transfers + std::max(1u, dir.limits.transfers / 4));
+        return true;
+    }
+    if (knob == CONNECTIONS && dir.limits.connections < dir.maxConnections)
+    {
+        dir.limits.connections++;
+        return true;
+    }
+    return false;
+}
+
+bool TransferLimits::lower(Direction& dir, Knob knob)
+{
+    unsigned minTransfers = dir.maxTransfers < MINTRANSFERS ? dir.maxTransfers : MINTRANSFERS;
+    if (knob == TRANSFERS && dir.limits.transfers > minTransfers)
+    {
+        dir.limits.transfers = std::max(minTransfers, dir.limits.transfers - std::max(1u, dir.limits.transfers / 5));
+        return true;
+    }
+    if (knob == CONNECTIONS && dir.limits.connections > 1)
+    {
+        dir.limits.connections--;
+        return true;
+    }
+    return false;
+}
+
+bool TransferLimits::update(direction_t d, m_off_t goodput, unsigned active, dstime now)
+{
+    assert(d == GET || d == PUT);
+    Direction& dir = mDirections[d];
+    if (dir.lastAdjustment && now - dir.lastAdjustment < ADJUSTDS)
+    {
+        return false;
+    }
+
+    unsigned requests = dir.requests;
+    dir.requests = 0;
+    dir.lastAdjustment = now ? now : 1;
+
+    if (!active || !requests || goodput <= 0)
+    {
+        // nothing to compare with: start again from the next measurement
+        dir.lastGoodput = 0;
+        dir.lastRequestTime = 0;
+        dir.raised = NOKNOB;
+        return false;
+    }
+
+    bool measured = dir.lastGoodput > 0 && dir.lastRequestTime > 0 && !dir.hold;
+    double gain = measured ? double(goodput) / double(dir.lastGoodput) : 1;
+    double slowdown = measured ? dir.requestTime / dir.lastRequestTime : 1;
+    dir.lastGoodput = goodput;
+    dir.lastRequestTime = dir.requestTime;
+
+    if (dir.hold)
+    {
+        dir.hold--;
+        return false;
+    }
+    if (!measured)
+    {
+        return false;
+    }
+
+    std::ostringstream reason;
+    reason.precision(2);
+    bool transfersInUse = active >= dir.limits.transfers;
+    Knob raised = dir.raised;
+    bool changed = false;
+    dir.raised = NOKNOB;
+
+    if (raised != NOKNOB && gain < 1.05 && slowdown > 1.25)
+    {
+        changed = lower(dir, raised);
+        dir.hold = HOLDINTERVALS;
+        reason << "more " << (raised == TRANSFERS ? "transfers" : "connections")
+               << " made requests " << slowdown << "x slower for " << gain << "x goodput";
+    }
+    else if (raised != NOKNOB && gain < 1.10)
+    {
+        // the last raise didn't pay off: keep it, but wait before trying again
+        dir.hold = HOLDINTERVALS;
+    }
+    else if (raised != NOKNOB && (raised == CONNECTIONS || transfersInUse))
+    {
+        changed = raise(dir, raised);
+        dir.raised = changed ? raised : NOKNOB;
+        reason << "goodput grew " << gain << "x with more " << (raised == TRANSFERS ? "transfers" : "connections");
+    }
+    else if (slowdown > 2 && gain < 1.05)
+    {
+        changed = lower(dir, TRANSFERS);
+        dir.hold = HOLDINTERVALS;
+        reason << "requests " << slowdown << "x slower for " << gain << "x goodput";
+    }
+    else if (transfersInUse)
+    {
+        changed = raise(dir, TRANSFERS);
+        dir.raised = changed ? TRANSFERS : NOKNOB;
+        reason << "all " << active << " transfers in use";
+    }
+    else if (active * 2 <= dir.limits.transfers)
+    {
+        changed = raise(dir, CONNECTIONS);
+        dir.raised = changed ? CONNECTIONS : NOKNOB;
+        reason << "only " << active << " of " << dir.limits.transfers << " transfers in use";
+    }
+
+    if (changed)
+    {
+        dir.limits.reason = reason.str();
+        LOG_info << (d == GET ? "Download" : "Upload") << " limits: " << dir.limits.transfers << " transfers, "
+                 << dir.limits.connections << " connections per transfer (" << dir.limits.reason
+                 << ", goodput " << goodput << " B/s)";
+    }
+    return changed;
+}
+
+bool PutnodesBatcher::Target::operator<(const Target& other) const
+{
+    if (handle != other.handle) return handle < other.handle;
+    if (versioning != other.versioning) return versioning < other.versioning;
+    if (source != other.source) return source < other.source;
+    return canChangeVault < other.canChangeVault;
+}
+
+void PutnodesBatcher::add(MegaClient* client, NodeHandle target, VersioningOption vo, NewNode&& newnode, int tag, putsource_t source, CommandPutNodes::Completion&& completion, bool canChangeVault)
+{
+    Target t = { target, vo, source, canChangeVault };
+    Batch& batch = mBatches[t];
+    batch.nodes.push_back(std::move(newnode));
+    batch.tags.push_back(tag);
+    batch.completions.push_back(std::move(completion));
+    mNumNodes++;
+
+    if (batch.nodes.size() >= size_t(MegaClient::MAX_NEWNODES))
+    {
+        send(client, t, std::move(batch));
+        mBatches.erase(t);
+    }
+}
+
+void PutnodesBatcher::flush(MegaClient* client)
+{
+    for (auto& b : mBatches)
+    {
+        send(client, b.first, std::move(b.second));
+    }
+    mBatches.clear();
+}
+
+void PutnodesBatcher::clear()
+{
+    mBatches.clear();
+    mNumNodes = 0;
+}
+
+void PutnodesBatcher::send(MegaClient* client, const Target& target, Batch&& batch)
+{
+    mNumNodes -= batch.nodes.size();
+
+    if (batch.nodes.size() == 1)
+    {
+        client->reqs.add(new CommandPutNodes(client, target.handle, NULL, target.versioning, std::move(batch.nodes),
+                                             batch.tags.front(), target.source, nullptr,
+                                             std::move(batch.completions.front()), target.canChangeVault));
+        return;
+    }
+
+    LOG_debug << "Putnodes for " << batch.nodes.size() << " uploads to " << target.handle;
+
+    auto tags = batch.tags;
+    auto completions = std::make_shared<vector<CommandPutNodes::Completion>>(std::move(batch.completions));
+
+    auto completion = [client, target, tags, completions](const Error& e, targettype_t t, vector<NewNode>& nn, bool targetOverride)
+    {
+        // the nodes are handed back unless the command failed before they were sent
+        bool resend = nn.size() == tags.size();
+
+        for (size_t i = 0; i < tags.size(); i++)
+        {
+            if (resend && (e != API_OK || !nn[i].added))
+            {
+                // rejected along with the batch, or not created: put it alone, so that
+                // one bad node or a failed batch doesn't fail the other uploads
+                LOG_debug << "Putnodes of batched upload " << tags[i] << " sent alone (" << error(e) << ")";
+
+                vector<NewNode> own;
+                own.push_back(std::move(nn[i]));
+                own.back().added = false;
+                client->reqs.add(new CommandPutNodes(client, target.handle, NULL, target.versioning, std::move(own),
+                                                     tags[i], target.source, nullptr,
+                                                     std::move((*completions)[i]), target.canChangeVault));
+                continue;
+            }
+
+            // each upload gets the result of its own node, as if it had been put alone
+            vector<NewNode> own;
+            if (i < nn.size())
+            {
+                own.push_back(std::move(nn[i]));
+            }
+
+            client->restag = tags[i];
+            if ((*completions)[i]) (*completions)[i](e, t, own, targetOverride);
+            else client->app->putnodes_result(e, t, own, targetOverride);
+        }
+    };
+
+    auto command = new CommandPutNodes(client, target.handle, NULL, target.versioning, std::move(batch.nodes),
+                                       tags.front(), target.source, nullptr, std::move(completion), target.canChangeVault);
+    command->mBatchTags = std::move(tags);
+    client->reqs.add(command);
+}
+
 Transfer::Transfer(MegaClient* cclient, direction_t ctype)
     : bt(cclient->rng, cclient->transferRetryBackoffs[ctype])
 {
@@ -1241,6 +1509,23 @@ void DirectReadNode::retry(const Error& e, dstime timeleft)
         client->usealtdownport = !client->usealtdownport;
     }
 
+    // read-aheads are not worth retrying
+    for (dr_list::iterator it = reads.begin(); it != reads.end(); )
+    {
+        DirectRead* dr = *it++;
+        if (!dr->appdata)
+        {
+            delete dr;
+        }
+    }
+
+    if (reads.empty())
+    {
+        LOG_debug << "Removing DirectReadNode. Only read-aheads to retry.";
+        delete this;
+        return;
+    }
+
     // signal failure to app , obtain minimum desired retry time
     for (dr_list::iterator it = reads.begin(); it != reads.end(); it++)
     {
@@ -1306,16 +1591,12 @@ void DirectReadNode::cmdresult(const Error &e, dstime timeleft)
             DirectRead* dr = *it;
             assert(dr->drq_it == client->drq.end());
 
-            if (dr->drbuf.tempUrlVector().empty())
-            {
-                // DirectRead starting
-                dr->drbuf.setIsRaid(dr->drn->tempurls, dr->offset, dr->offset + dr->count, dr->drn->size, 2097152);  // 2 MB max buffer usage approx for streaming
-            }
-            else
+            if (!dr->drbuf.tempUrlVector().empty())
             {
                 // URLs have been re-requested, eg. due to temp URL expiry.  Keep any parts downloaded already
                 dr->drbuf.updateUrlsAndResetPos(dr->drn->tempurls);
             }
+            // (otherwise the DirectRead is starting: its slot sets the range up, after the cache served what it can)
 
             dr->drq_it = client->drq.insert(client->drq.end(), *it);
         }
@@ -1355,13 +1636,31 @@ bool DirectReadSlot::processAnyOutputPieces()
 {
     bool continueDirectRead = true;
     std::shared_ptr<TransferBufferManager::FilePiece> outputPiece;
-    while (continueDirectRead && (outputPiece = dr->drbuf.getAsyncOutputBufferPointer(0)))
+    while (continueDirectRead && !dr->paused() && (outputPiece = dr->drbuf.getAsyncOutputBufferPointer(0)))
     {
         size_t len = outputPiece->buf.datalen();
         speed = speedController.calculateSpeed();
         meanSpeed = speedController.getMeanSpeed();
-        dr->drn->client->httpio->updatedownloadspeed(len);
-        continueDirectRead = dr->drn->client->app->pread_data(outputPiece->buf.datastart(), len, pos, speed, meanSpeed, dr->appdata);
+        MegaClient* client = dr->drn->client;
+        client->httpio->updatedownloadspeed(len);
+        client->directReadCache.put(dr->drn->h, pos, outputPiece->buf.datastart(), len);
+
+        if (dr->appdata)
+        {
+            continueDirectRead = client->app->pread_piece(outputPiece->buf.datastart(), len, pos, speed, meanSpeed, dr->appdata, outputPiece);
+
+            if (!continueDirectRead
+                    && pos + m_off_t(len) < dr->offset + dr->count
+                    && client->directReadCache.maxBytes() >= size_t(4 * DirectReadCache::READAHEAD))
+            {
+                // the app stopped reading (or paused, eg. a full streaming buffer): keep going
+                // for a while, so that it finds the next part in the cache when it resumes
+                dr->appdata = nullptr;
+                dr->readaheadpos = std::min(pos + DirectReadCache::READAHEAD, dr->offset + dr->count);
+                continueDirectRead = true;
+                LOG_debug << "Streaming read-ahead up to " << dr->readaheadpos;
+            }
+        }
 
         dr->drbuf.bufferWriteCompleted(0, true);
 
@@ -1370,6 +1669,12 @@ bool DirectReadSlot::processAnyOutputPieces()
             pos += len;
             dr->drn->partiallen += len;
             dr->progress += len;
+
+            if (!dr->appdata && pos >= dr->readaheadpos)
+            {
+                // read-ahead complete
+                continueDirectRead = false;
+            }
         }
     }
     return continueDirectRead;
@@ -1377,6 +1682,26 @@ bool DirectReadSlot::processAnyOutputPieces()
 
 bool DirectReadSlot::doio()
 {
+    if (dr->paused())
+    {
+        // hold back, without the inactivity and minimum speed checks failing the read,
+        // and without the connections receiving more meanwhile
+        for (HttpReq* req : reqs)
+        {
+            req->setpaused(true);
+        }
+
+        dr->drn->schedule(DirectReadSlot::TIMEOUT_DS);
+        dr->drn->partiallen = 0;
+        dr->drn->partialstarttime = Waiter::ds;
+        return false;
+    }
+
+    for (HttpReq* req : reqs)
+    {
+        req->setpaused(false);
+    }
+
     for (unsigned connectionNum = unsigned(reqs.size()); connectionNum--; )
     {
         HttpReq* req = reqs[connectionNum];
@@ -1537,6 +1862,53 @@ void DirectRead::abort()
     }
 }
 
+bool DirectRead::serveFromCache()
+{
+    MegaClient* client = drn->client;
+    const byte* data;
+    size_t len;
+
+    while (progress < count && !paused() && (len = client->directReadCache.get(drn->h, offset + progress, &data)))
+    {
+        len = size_t(std::min<m_off_t>(m_off_t(len), count - progress));
+
+        // the app may keep the data after it's delivered: give it its own piece
+        auto piece = std::make_shared<RaidBufferManager::FilePiece>(offset + progress, len);
+        memcpy(piece->buf.datastart(), data, len);
+        bool continueRead = client->app->pread_piece(piece->buf.datastart(), m_off_t(len), offset + progress, 0, 0, appdata, piece);
+        progress += len;
+
+        if (!continueRead || progress == count)
+        {
+            LOG_debug << "DirectRead " << (continueRead ? "served" : "aborted") << " from the cache";
+            delete this;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool DirectRead::paused() const
+{
+    return appdata && drn->client->app->pread_paused(appdata);
+}
+
+bool DirectRead::readaheadPending() const
+{
+    m_off_t next = offset + progress;
+
+    for (DirectRead* other : drn->reads)
+    {
+        if (!other->appdata && other->drs && other->drs->pos == next && next < other->readaheadpos)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 DirectRead::DirectRead(DirectReadNode* cdrn, m_off_t ccount, m_off_t coffset, int creqtag, void* cappdata)
     : drbuf(this)
 {
@@ -1555,7 +1927,6 @@ DirectRead::DirectRead(DirectReadNode* cdrn, m_off_t ccount, m_off_t coffset, in
     if (!drn->tempurls.empty())
     {
         // we already have tempurl(s): queue for immediate fetching
-        drbuf.setIsRaid(drn->tempurls, offset, offset + count, drn->size, 2097152);  // 2 MB max buffer usage approx
         drq_it = drn->client->drq.insert(drn->client->drq.end(), this);
     }
     else
@@ -1613,6 +1984,12 @@ DirectReadSlot::DirectReadSlot(DirectRead* cdr)
     pos = dr->offset + dr->progress;
     dr->nextrequestpos = pos;
 
+    if (dr->drbuf.tempUrlVector().empty())
+    {
+        // DirectRead starting (from wherever the cache left it)
+        dr->drbuf.setIsRaid(dr->drn->tempurls, pos, dr->offset + dr->count, dr->drn->size, 2097152);  // 2 MB max buffer usage approx for streaming
+    }
+
     speed = meanSpeed = 0;
 
     assert(reqs.empty());
@@ -2124,4 +2501,94 @@ bool TransferList::isReady(Transfer *transfer)
             && transfer->bt.armed());
 }
 
+const m_off_t DirectReadCache::BLOCKSIZE;
+const m_off_t DirectReadCache::READAHEAD;
+
+void DirectReadCache::setMaxBytes(size_t maxBytes)
+{
+    mMaxBytes = maxBytes;
+    trim();
+}
+
+void DirectReadCache::put(handle h, m_off_t pos, const byte* data, size_t len)
+{
+    if (!mMaxBytes)
+    {
+        return;
+    }
+
+    while (len)
+    {
+        m_off_t blockStart = pos - pos % BLOCKSIZE;
+        size_t offsetInBlock = size_t(pos - blockStart);
+        size_t n = std::min(len, size_t(BLOCKSIZE) - offsetInBlock);
+
+        auto it = mBlocks.find(BlockKey(h, blockStart));
+
+        if (it == mBlocks.end() && !offsetInBlock)
+        {
+            mLru.emplace_front(h, blockStart);
+            it = mBlocks.emplace(mLru.front(), Block()).first;
+            it->second.lru = mLru.begin();
+        }
+
+        if (it != mBlocks.end())
+        {
+            Block& block = it->second;
+            mLru.splice(mLru.begin(), mLru, block.lru);
+
+            // only extend the block contiguously
+            size_t have = block.data.size();
+            if (have >= offsetInBlock && have < offsetInBlock + n)
+            {
+                size_t skip = have - offsetInBlock;
+                block.data.append(reinterpret_cast<const char*>(data) + skip, n - skip);
+                mBytes += n - skip;
+            }
+        }
+
+        pos += m_off_t(n);
+        data += n;
+        len -= n;
+    }
+
+    trim();
+}
+
+size_t DirectReadCache::get(handle h, m_off_t pos, const byte** data)
+{
+    m_off_t blockStart = pos - pos % BLOCKSIZE;
+    size_t offsetInBlock = size_t(pos - blockStart);
+
+    auto it = mBlocks.find(BlockKey(h, blockStart));
+    if (it == mBlocks.end() || it->second.data.size() <= offsetInBlock)
+    {
+        return 0;
+    }
+
+    Block& block = it->second;
+    mLru.splice(mLru.begin(), mLru, block.lru);
+
+    *data = reinterpret_cast<const byte*>(block.data.data()) + offsetInBlock;
+    return block.data.size() - offsetInBlock;
+}
+
+void DirectReadCache::clear()
+{
+    mBlocks.clear();
+    mLru.clear();
+    mBytes = 0;
+}
+
+void DirectReadCache::trim()
+{
+    while (mBytes > mMaxBytes && !mLru.empty())
+    {
+        auto it = mBlocks.find(mLru.back());
+        mBytes -= it->second.data.size();
+        mBlocks.erase(it);
+        mLru.pop_back();
+    }
+}
+
 } // namespace
@@ -148,7 +148,7 @@ bool TransferSlot::createconnectionsonce()
             return false;   // too soon, we don't know raid / non-raid yet
         }
 
-        connections = transferbuf.isRaid() ? RAIDPARTS : (transfer->size > 131072 ? transfer->client->connections[transfer->type] : 1);
+        connections = transferbuf.isRaid() ? unsigned(RAIDPARTS) : (transfer->size > 131072 ? transfer->client->mTransferLimits.limits(transfer->type).connections : 1);
         LOG_debug << "Populating transfer slot with " << connections << " connections, max request size of " << maxRequestSize << " bytes";
         reqs.resize(connections);
         mReqSpeeds.resize(connections);
@@ -619,6 +619,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                 {
                     m_off_t delta = mReqSpeeds[i].requestProgressed(reqs[i]->size);
                     mTransferSpeed.calculateSpeed(delta);
+                    client->mTransferLimits.requestCompleted(transfer->type, reqs[i]->size, mReqSpeeds[i].requestElapsedDs());
 
                     if (client->orderdownloadedchunks && transfer->type == GET && !transferbuf.isRaid() && transfer->progresscompleted != static_cast<HttpReqDL*>(reqs[i].get())->dlpos)
                     {
@@ -1210,11 +1211,33 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                             }
                         }
 
-                        reqs[i]->prepare(finaltempurl.c_str(), transfer->transfercipher(),
-                                                               transfer->ctriv,
-                                                               posrange.first, posrange.second);
-                        reqs[i]->pos = posrange.first;
-                        reqs[i]->status = REQ_PREPARED;
+                        if (transfer->type == PUT)
+                        {
+                            // encrypt on a worker thread, as for async reads, so that many small
+                            // uploads don't serialize their encryption on this thread
+                            auto req = reqs[i];
+                            auto transferkey = transfer->transferkey;
+                            auto ctriv = transfer->ctriv;
+                            auto pos = posrange.first;
+                            auto npos = posrange.second;
+                            req->pos = pos;
+                            req->status = REQ_ENCRYPTING;
+
+                            client->mAsyncQueue.push([req, transferkey, ctriv, finaltempurl, pos, npos](SymmCipher& sc)
+                                {
+                                    sc.setkey(transferkey.data());
+                                    req->prepare(finaltempurl.c_str(), &sc, ctriv, pos, npos);
+                                    req->status = REQ_PREPARED;
+                                }, true);   // discardable - if the transfer or client are being destroyed, we won't be sending that data.
+                        }
+                        else
+                        {
+                            reqs[i]->prepare(finaltempurl.c_str(), transfer->transfercipher(),
+                                                                   transfer->ctriv,
+                                                                   posrange.first, posrange.second);
+                            reqs[i]->pos = posrange.first;
+                            reqs[i]->status = REQ_PREPARED;
+                        }
                     }
 
                     transferbuf.transferPos(i) = std::max<m_off_t>(transferbuf.transferPos(i), posrange.second);
@@ -496,6 +496,60 @@ void chunkmac_map::ctr_decrypt(m_off_t chunkid, SymmCipher *cipher, byte *chunks
     }
 }
 
+void chunkmac_map::ctr_encrypt(const vector<CtrPiece>& pieces, SymmCipher *cipher, int64_t ctriv, bool finishesChunk)
+{
+    vector<SymmCipher::CtrLane> lanes;
+    lanes.reserve(pieces.size());
+
+    for (auto& p : pieces)
+    {
+        assert(p.chunkid == p.startpos);
+        assert(p.startpos > macsmacSoFarPos);
+
+        auto& chunk = mMacMap[p.chunkid];
+        chunk.offset = 0;
+        chunk.finished = finishesChunk;
+        lanes.push_back({ p.chunkstart, p.chunksize, p.startpos, chunk.mac, true });
+    }
+
+    cipher->ctr_crypt_lanes(lanes.data(), lanes.size(), ctriv, true);
+}
+
+void chunkmac_map::ctr_decrypt(const vector<CtrPiece>& pieces, SymmCipher *cipher, int64_t ctriv, bool finishesChunk)
+{
+    vector<SymmCipher::CtrLane> lanes;
+    lanes.reserve(pieces.size());
+
+    for (auto& p : pieces)
+    {
+        assert(p.chunkid > macsmacSoFarPos);
+        assert(p.startpos >= p.chunkid);
+        assert(p.startpos + p.chunksize <= ChunkedHash::chunkceil(p.chunkid));
+
+        ChunkMAC& chunk = mMacMap[p.chunkid];
+        lanes.push_back({ p.chunkstart, p.chunksize, p.startpos, chunk.mac, chunk.notStarted() });
+    }
+
+    cipher->ctr_crypt_lanes(lanes.data(), lanes.size(), ctriv, false);
+
+    for (auto& p : pieces)
+    {
+        ChunkMAC& chunk = mMacMap[p.chunkid];
+
+        if (finishesChunk)
+        {
+            chunk.finished = true;
+            chunk.offset = 0;
+        }
+        else
+        {
+            assert(p.startpos + p.chunksize < ChunkedHash::chunkceil(p.chunkid));
+            chunk.finished = false;
+            chunk.offset += p.chunksize;
+        }
+    }
+}
+
 void chunkmac_map::finishedUploadChunks(chunkmac_map& macs)
 {
     for (auto& m : macs.mMacMap)
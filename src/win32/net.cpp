@@ -293,7 +293,12 @@ VOID CALLBACK WinHttpIO::asynccallback(HINTERNET hInternet, DWORD_PTR dwContext,
                            !req->buf && (char*)lpvStatusInformation >= req->in.data() && (char*)lpvStatusInformation + dwStatusInformationLength <= req->in.data() + req->in.size());
                 }
 
-                if (!WinHttpQueryDataAvailable(httpctx->hRequest, NULL))
+                if (req->paused)
+                {
+                    // the next read is issued by setpaused() when the request is resumed
+                    httpctx->held = true;
+                }
+                else if (!WinHttpQueryDataAvailable(httpctx->hRequest, NULL))
                 {
                     LOG_err << "Error on WinHttpQueryDataAvailable. Code: " << GetLastError();
                     httpio->cancel(req);
@@ -564,6 +569,7 @@ void WinHttpIO::post(HttpReq* req, const char* data, unsigned len)
     httpctx->httpio = this;
     httpctx->req = req;
     httpctx->gzip = false;
+    httpctx->held = false;
 
     req->httpiohandle = (void*)httpctx;
 
@@ -697,6 +703,24 @@ void WinHttpIO::cancel(HttpReq* req)
     }
 }
 
+// stop reading the response of a request, or read on from where it was held
+void WinHttpIO::setpaused(HttpReq* req, bool paused)
+{
+    WinHttpContext* httpctx = (WinHttpContext*)req->httpiohandle;
+
+    if (httpctx && !paused && httpctx->held)
+    {
+        httpctx->held = false;
+
+        if (!WinHttpQueryDataAvailable(httpctx->hRequest, NULL))
+        {
+            LOG_err << "Error on WinHttpQueryDataAvailable. Code: " << GetLastError();
+            cancel(req);
+            httpevent();
+        }
+    }
+}
+
 // supply progress information on POST data
 m_off_t WinHttpIO::postpos(void* handle)
 {
@@ -26,6 +26,12 @@
 #include "megaapi_impl.h"
 #include <algorithm>
 
+#if defined(HAVE_LIBUV) && !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
 #define SSTR( x ) static_cast< const std::ostringstream & >( \
         (  std::ostringstream() << std::dec << x ) ).str()
 
@@ -8075,6 +8081,180 @@ TEST_F(SdkTest, SdkTestAudioFileThumbnail)
 
 #endif
 
+#if defined(HAVE_LIBUV) && !defined(_WIN32)
+namespace
+{
+// Fetches a local link of the HTTP server, returning the size of the body received, or -1 on error
+long long httpServerGet(int port, const string& path)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    string request = "GET " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n";
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr))
+            || send(fd, request.data(), request.size(), 0) != ssize_t(request.size()))
+    {
+        close(fd);
+        return -1;
+    }
+
+    string header;
+    long long body = -1;
+    char buffer[65536];
+    ssize_t received;
+    while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+    {
+        if (body >= 0)
+        {
+            body += received;
+            continue;
+        }
+
+        header.append(buffer, static_cast<size_t>(received));
+        size_t end = header.find("\r\n\r\n");
+        if (end != string::npos)
+        {
+            body = static_cast<long long>(header.size() - end - 4);
+        }
+    }
+    close(fd);
+    return body;
+}
+}
+
+/**
+ * @brief TEST_F SdkHttpServerLoops
+ *
+ * Streams a file to many concurrent clients of the HTTP server with 1, 2 and 4 server
+ * threads: every response is complete. The file is fetched once first, so that the
+ * following requests are served from the cache of streamed blocks.
+ */
+TEST_F(SdkTest, SdkHttpServerLoops)
+{
+    LOG_info << "___TEST SdkHttpServerLoops___";
+    ASSERT_NO_FATAL_FAILURE(getAccountsForTest());
+
+    std::unique_ptr<MegaNode> rootnode{megaApi[0]->getRootNode()};
+    deleteFile(UPFILE);
+    ASSERT_TRUE(createFile(UPFILE, true)) << "Couldn't create " << UPFILE;
+    MegaHandle uploadedNodeHandle = UNDEF;
+    ASSERT_EQ(MegaError::API_OK, doStartUpload(0, &uploadedNodeHandle, UPFILE.c_str(),
+                                                        rootnode.get(),
+                                                        nullptr /*fileName*/,
+                                                        ::mega::MegaApi::INVALID_CUSTOM_MOD_TIME,
+                                                        nullptr /*appData*/,
+                                                        false   /*isSourceTemporary*/,
+                                                        false   /*startFirst*/,
+                                                        nullptr /*cancelToken*/)) << "Upload transfer failed";
+    std::unique_ptr<MegaNode> node{megaApi[0]->getNodeByHandle(uploadedNodeHandle)};
+    ASSERT_TRUE(node);
+
+    const int port = 4443;
+    const int clients = 16;
+    const int requestsPerClient = 4;
+
+    for (int numThreads : {1, 2, 4})
+    {
+        ASSERT_TRUE(megaApi[0]->httpServerStart(true, port, false, nullptr, nullptr, false, numThreads));
+
+        std::unique_ptr<char[]> link{megaApi[0]->httpServerGetLocalLink(node.get())};
+        ASSERT_TRUE(link);
+        string url = link.get();
+        string path = url.substr(url.find('/', strlen("http://")));
+
+        ASSERT_EQ(node->getSize(), httpServerGet(port, path));
+
+        std::atomic<long long> bytes{0};
+        std::atomic<int> failures{0};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < clients; i++)
+        {
+            threads.emplace_back([&]()
+            {
+                for (int j = 0; j < requestsPerClient; j++)
+                {
+                    long long received = httpServerGet(port, path);
+                    if (received != node->getSize())
+                    {
+                        failures++;
+                    }
+                    bytes += std::max(received, 0LL);
+                }
+            });
+        }
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+
+        megaApi[0]->httpServerStop();
+
+        ASSERT_EQ(0, failures.load()) << "Incomplete responses with " << numThreads << " server threads";
+        ASSERT_EQ(clients * requestsPerClient * node->getSize(), bytes.load());
+    }
+
+    deleteFile(UPFILE);
+}
+#endif
+
+TEST_F(SdkTest, SdkPublishedNodeReads)
+{
+    LOG_info << "___TEST SdkPublishedNodeReads___";
+    ASSERT_NO_FATAL_FAILURE(getAccountsForTest());
+
+    std::unique_ptr<MegaNode> rootnode{megaApi[0]->getRootNode()};
+    MegaHandle folderHandle = createFolder(0, "published-reads", rootnode.get());
+    ASSERT_NE(folderHandle, UNDEF);
+    std::unique_ptr<MegaNode> folder{megaApi[0]->getNodeByHandle(folderHandle)};
+    ASSERT_TRUE(folder);
+    MegaHandle childHandle = createFolder(0, "child", folder.get());
+    ASSERT_NE(childHandle, UNDEF);
+
+    // the second round is answered from what the first one published
+    for (int i = 2; i--; )
+    {
+        std::unique_ptr<MegaNodeList> children{megaApi[0]->getChildren(folder.get(), MegaApi::ORDER_DEFAULT_ASC)};
+        ASSERT_EQ(1, children->size());
+        ASSERT_STREQ("child", children->get(0)->getName());
+        ASSERT_EQ(1, megaApi[0]->getNumChildFolders(folder.get()));
+        std::unique_ptr<MegaNode> byPath{megaApi[0]->getNodeByPath("child", folder.get())};
+        ASSERT_TRUE(byPath);
+        ASSERT_EQ(childHandle, byPath->getHandle());
+    }
+
+    std::unique_ptr<MegaStringMap> stats{megaApi[0]->getMutexStats()};
+    ASSERT_TRUE(stats->get("snapshotReads"));
+    ASSERT_LT(0, atoll(stats->get("snapshotReads")));
+    ASSERT_LT(0, atoll(stats->get("acquisitions")));
+
+    // changes are visible as soon as they are notified
+    std::unique_ptr<MegaNode> child{megaApi[0]->getNodeByHandle(childHandle)};
+    ASSERT_EQ(API_OK, doRenameNode(0, child.get(), "renamed"));
+    ASSERT_TRUE(WaitFor([&]()
+    {
+        std::unique_ptr<MegaNode> n{megaApi[0]->getNodeByPath("renamed", folder.get())};
+        return n && n->getHandle() == childHandle;
+    }, 60000));
+    std::unique_ptr<MegaNode> oldPath{megaApi[0]->getNodeByPath("child", folder.get())};
+    ASSERT_FALSE(oldPath);
+    std::unique_ptr<MegaNodeList> children{megaApi[0]->getChildren(folder.get(), MegaApi::ORDER_DEFAULT_ASC)};
+    ASSERT_EQ(1, children->size());
+    ASSERT_STREQ("renamed", children->get(0)->getName());
+
+    MegaHandle secondHandle = createFolder(0, "second", folder.get());
+    ASSERT_NE(secondHandle, UNDEF);
+    ASSERT_TRUE(WaitFor([&]() { return megaApi[0]->getNumChildren(folder.get()) == 2; }, 60000));
+}
+
 /*
 TEST_F(SdkTest, CheckRecoveryKey_MANUAL)
 {
@@ -19,6 +19,8 @@
 #include "mega.h"
 #include "../src/crypto/sodium.cpp"
 #include <math.h>
+#include <array>
+#include <numeric>
 #include "gtest/gtest.h"
 
 using namespace mega;
@@ -355,3 +357,116 @@ TEST(Crypto, SymmCipher_xorblock_block_unaligned)
     
     ASSERT_EQ(memcmp(dest, result, sizeof(dest)), 0);
 }
+
+namespace {
+
+// The original implementation of SymmCipher::ctr_crypt, one AES call per block for the
+// counter and one more for the MAC. Kept as the reference for the bulk implementation.
+void ctr_crypt_per_block(SymmCipher& cipher, byte* data, unsigned len, m_off_t pos, SymmCipher::ctr_iv ctriv, byte* mac, bool encrypt)
+{
+    byte ctr[SymmCipher::BLOCKSIZE], tmp[SymmCipher::BLOCKSIZE];
+
+    MemAccess::set<int64_t>(ctr, ctriv);
+    SymmCipher::setint64(pos / SymmCipher::BLOCKSIZE, ctr + sizeof ctriv);
+
+    memcpy(mac, ctr, sizeof ctriv);
+    memcpy(mac + sizeof ctriv, ctr, sizeof ctriv);
+
+    while ((int)len > 0)
+    {
+        if (encrypt)
+        {
+            SymmCipher::xorblock(data, mac);
+            cipher.ecb_encrypt(mac);
+            cipher.ecb_encrypt(ctr, tmp);
+            SymmCipher::xorblock(tmp, data);
+        }
+        else
+        {
+            cipher.ecb_encrypt(ctr, tmp);
+            SymmCipher::xorblock(tmp, data);
+
+            if (len >= (unsigned)SymmCipher::BLOCKSIZE)
+            {
+                SymmCipher::xorblock(data, mac);
+            }
+            else
+            {
+                SymmCipher::xorblock(data, mac, len);
+            }
+            cipher.ecb_encrypt(mac);
+        }
+
+        len -= SymmCipher::BLOCKSIZE;
+        data += SymmCipher::BLOCKSIZE;
+
+        SymmCipher::incblock(ctr);
+    }
+}
+
+string testBuffer(size_t size, unsigned seed)
+{
+    // NUL padded to BLOCKSIZE, as required by ctr_crypt
+    string buffer(size + SymmCipher::BLOCKSIZE, '\0');
+    for (size_t i = 0; i < size; i++)
+    {
+        buffer[i] = static_cast<char>(i * 31 + seed);
+    }
+    return buffer;
+}
+
+} // anonymous
+
+TEST(Crypto, SymmCipher_ctr_crypt_matches_per_block)
+{
+    byte keyBytes[SymmCipher::KEYLENGTH];
+    std::iota(keyBytes, keyBytes + sizeof(keyBytes), (byte)7);
+    SymmCipher cipher(keyBytes);
+    SymmCipher::ctr_iv ctriv = 0x0123456789abcdefULL;
+
+    for (bool encrypt : { true, false })
+    {
+        for (unsigned size : { 0u, 1u, 15u, 16u, 17u, 4095u, 4096u, 131072u, 262149u })
+        {
+            string expected = testBuffer(size, size);
+            string actual = expected;
+            byte expectedMac[SymmCipher::BLOCKSIZE], actualMac[SymmCipher::BLOCKSIZE];
+
+            ctr_crypt_per_block(cipher, (byte*)expected.data(), size, 393216, ctriv, expectedMac, encrypt);
+            cipher.ctr_crypt((byte*)actual.data(), size, 393216, ctriv, actualMac, encrypt);
+
+            ASSERT_EQ(expected, actual) << "encrypt: " << encrypt << " size: " << size;
+            ASSERT_EQ(0, memcmp(expectedMac, actualMac, sizeof(actualMac))) << "encrypt: " << encrypt << " size: " << size;
+        }
+
+        // lanes of different lengths, more than fit in one pass
+        const size_t numLanes = SymmCipher::MAXLANES + 3;
+        vector<string> expected, actual;
+        vector<std::array<byte, SymmCipher::BLOCKSIZE>> expectedMacs(numLanes), actualMacs(numLanes);
+        vector<SymmCipher::CtrLane> lanes;
+
+        for (size_t i = 0; i < numLanes; i++)
+        {
+            unsigned size = 131072u - unsigned(i % 4) * 1000u - unsigned(!encrypt) * 5u;
+            expected.push_back(testBuffer(size, unsigned(i)));
+            actual.push_back(expected.back());
+        }
+
+        for (size_t i = 0; i < numLanes; i++)
+        {
+            unsigned size = unsigned(expected[i].size()) - SymmCipher::BLOCKSIZE;
+            m_off_t pos = m_off_t(i) * 131072;
+
+            ctr_crypt_per_block(cipher, (byte*)expected[i].data(), size, pos, ctriv, expectedMacs[i].data(), encrypt);
+            lanes.push_back({ (byte*)actual[i].data(), size, pos, actualMacs[i].data(), true });
+        }
+
+        cipher.ctr_crypt_lanes(lanes.data(), lanes.size(), ctriv, encrypt);
+
+        for (size_t i = 0; i < numLanes; i++)
+        {
+            ASSERT_EQ(expected[i], actual[i]) << "encrypt: " << encrypt << " lane: " << i;
+            ASSERT_EQ(expectedMacs[i], actualMacs[i]) << "encrypt: " << encrypt << " lane: " << i;
+        }
+    }
+}
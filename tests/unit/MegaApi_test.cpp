@@ -218,3 +218,89 @@ TEST(MegaApi, getMimeType)
 
     ASSERT_EQ(600, successCount);
 }
+
+#ifdef HAVE_LIBUV
+TEST(MegaApi, StreamingBuffer_appendConsumeAndFree)
+{
+    StreamingBuffer buffer;
+    buffer.setFileSize(1000);
+    buffer.setMaxOutputSize(50);
+    buffer.init(100);
+
+    // a copy, and a piece kept by its owner
+    string copied(60, 'c');
+    auto owner = std::make_shared<string>(30, 'o');
+    ASSERT_EQ(60u, buffer.append(copied.data(), copied.size()));
+    ASSERT_EQ(30u, buffer.append(owner->data(), owner->size(), owner));
+    ASSERT_EQ(90u, buffer.availableData());
+    ASSERT_EQ(10u, buffer.availableSpace());
+    ASSERT_EQ(2, owner.use_count());
+
+    // the first segment is split at the output size
+    vector<uv_buf_t> bufs;
+    ASSERT_EQ(50u, buffer.nextBuffers(bufs, StreamingBuffer::MAX_OUTPUT_BUFFERS));
+    ASSERT_EQ(1u, bufs.size());
+    ASSERT_EQ(string(50, 'c'), string(bufs[0].base, bufs[0].len));
+    ASSERT_EQ(40u, buffer.availableData());
+    ASSERT_EQ(10u, buffer.availableSpace());
+
+    // the rest of the copy and the owned piece, without copying it
+    vector<uv_buf_t> next;
+    ASSERT_EQ(40u, buffer.nextBuffers(next, StreamingBuffer::MAX_OUTPUT_BUFFERS));
+    ASSERT_EQ(2u, next.size());
+    ASSERT_EQ(string(10, 'c'), string(next[0].base, next[0].len));
+    ASSERT_EQ(owner->data(), next[1].base);
+    ASSERT_EQ(30u, next[1].len);
+    ASSERT_EQ(0u, buffer.availableData());
+
+    // written data is released in order, the owner once all of its piece is written
+    buffer.freeData(50);
+    ASSERT_EQ(60u, buffer.availableSpace());
+    ASSERT_EQ(2, owner.use_count());
+    buffer.freeData(25);
+    ASSERT_EQ(85u, buffer.availableSpace());
+    ASSERT_EQ(2, owner.use_count());
+    buffer.freeData(15);
+    ASSERT_EQ(100u, buffer.availableSpace());
+    ASSERT_EQ(1, owner.use_count());
+
+    // nothing left to write
+    ASSERT_EQ(0u, buffer.nextBuffers(bufs, StreamingBuffer::MAX_OUTPUT_BUFFERS));
+    ASSERT_TRUE(bufs.empty());
+}
+
+TEST(MegaApi, StreamingBuffer_pauseAndResumeAtCapacity)
+{
+    StreamingBuffer buffer;
+    buffer.setFileSize(1000);
+    buffer.init(100);
+
+    string data(95, 'd');
+    ASSERT_FALSE(buffer.isFullFor(10, 1000));
+    buffer.append(data.data(), data.size());
+
+    // no room for twice the incoming piece, unless the rest of the file fits
+    ASSERT_TRUE(buffer.isFullFor(10, 905));
+    ASSERT_FALSE(buffer.isFullFor(5, 5));
+
+    // what arrives while the producer is being paused is kept beyond the capacity
+    ASSERT_EQ(10u, buffer.append(data.data(), 10));
+    ASSERT_EQ(105u, buffer.availableData());
+    ASSERT_EQ(0u, buffer.availableSpace());
+    ASSERT_TRUE(buffer.isFullFor(1, 1));
+
+    // nothing written yet
+    vector<uv_buf_t> bufs;
+    size_t written = buffer.nextBuffers(bufs, StreamingBuffer::MAX_OUTPUT_BUFFERS);
+    ASSERT_EQ(105u, written);
+    ASSERT_FALSE(buffer.canResumeAfter(0));
+
+    // resumed once there is room for twice what was written
+    buffer.freeData(written);
+    ASSERT_EQ(100u, buffer.availableSpace());
+    ASSERT_FALSE(buffer.canResumeAfter(written));
+    ASSERT_TRUE(buffer.canResumeAfter(40));
+    ASSERT_TRUE(buffer.canResumeAfter(0));
+    ASSERT_FALSE(buffer.isFullFor(10, 1000));
+}
+#endif
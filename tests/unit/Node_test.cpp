@@ -0,0 +1,854 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include <mega.h>
+
+#include "DefaultedDbTable.h"
+#include "utils.h"
+
+namespace {
+
+struct MockClient
+{
+    mega::MegaApp app;
+    std::shared_ptr<mega::MegaClient> cli = mt::makeClient(app);
+};
+
+mega::Node& makeNamedNode(mega::MegaClient& client, mega::nodetype_t type, mega::handle h, const std::string& name, mega::Node& parent)
+{
+    auto& n = mt::makeNode(client, type, ::mega::NodeHandle().set6byte(h));
+    n.attrs.map['n'] = name;
+    n.setparent(&parent);
+    return n;
+}
+
+// deletes a node without children the way the client does, leaving the others in place
+void deleteNode(mega::MegaClient& client, mega::Node* n)
+{
+    client.nodes.erase(n->nodeHandle());
+    delete n;
+}
+
+// what the lookup must return: a plain scan of the children list
+std::vector<mega::Node*> scanChildren(const mega::Node& parent, const std::string& name)
+{
+    std::vector<mega::Node*> found;
+    for (auto child : parent.children)
+    {
+        if (name == child->displayname())
+        {
+            found.push_back(child);
+        }
+    }
+    return found;
+}
+
+void setFingerprint(mega::FileFingerprint& f, size_t i)
+{
+    f.size = static_cast<m_off_t>(i % 1000);
+    f.mtime = static_cast<mega::m_time_t>(i);
+    f.crc = {{int32_t(i * 2654435761u), int32_t(i), int32_t(~i), 7}};
+}
+
+void rename(mega::Node& n, const std::string& name)
+{
+    // the way remote renames arrive: new encrypted attributes, then decryption
+    n.attrstring.reset(new std::string);
+    mega::MegaClient::makeattr(n.nodecipher(), n.attrstring, ("\"n\":\"" + name + "\"").c_str());
+    n.setattr();
+}
+
+// what a search must return: the file and folder nodes below `n` (and `n` itself) whose name
+// contains `text` ignoring case, children before their parent
+void walkSearch(mega::Node* n, const char* text, std::vector<mega::NodeHandle>& found)
+{
+    if (n->type != mega::FILENODE)
+    {
+        for (auto child : n->children)
+        {
+            walkSearch(child, text, found);
+        }
+    }
+    std::string name(n->displayname());
+    auto sameLetter = [](char a, char b) { return tolower(a) == tolower(b); };
+    if (n->type <= mega::FOLDERNODE && std::search(name.begin(), name.end(), text, text + strlen(text), sameLetter) != name.end())
+    {
+        found.push_back(n->nodeHandle());
+    }
+}
+
+std::vector<mega::NodeHandle> snapshotSearch(mega::MegaClient& client, mega::Node& n, const std::string& text, unsigned threads)
+{
+    auto snapshot = client.nameSnapshot();
+    mega::NodeNameSnapshot::Range range;
+    EXPECT_TRUE(snapshot->subtree(n.nodeHandle(), range));
+    return snapshot->search({range}, text, mega::CancelToken(), threads);
+}
+
+// what the search index must return: the entries whose name has the text, ignoring ASCII case,
+// and any of the categories
+struct IndexedName
+{
+    std::string name;
+    uint8_t categories;
+};
+
+std::vector<mega::NodeHandle> scanNames(const std::map<mega::NodeHandle, IndexedName>& names, std::string text, bool prefix, uint8_t categories)
+{
+    mega::NodeNameSnapshot::fold(text);
+    std::vector<mega::NodeHandle> found;
+    for (auto& entry : names)
+    {
+        std::string name(entry.second.name);
+        mega::NodeNameSnapshot::fold(name);
+        size_t pos = name.find(text);
+        if ((prefix ? !pos : pos != std::string::npos) && (!categories || (entry.second.categories & categories)))
+        {
+            found.push_back(entry.first);
+        }
+    }
+    return found;
+}
+
+std::vector<mega::NodeHandle> sorted(std::vector<mega::NodeHandle> handles)
+{
+    std::sort(handles.begin(), handles.end());
+    return handles;
+}
+
+// a state cache table in memory
+class MemoryTable : public mt::DefaultedDbTable
+{
+public:
+    using mt::DefaultedDbTable::DefaultedDbTable;
+
+    std::map<uint32_t, std::string> records;
+
+    bool put(uint32_t id, char* data, unsigned len) override
+    {
+        records[id].assign(data, len);
+        return true;
+    }
+
+    bool del(uint32_t id) override
+    {
+        records.erase(id);
+        return true;
+    }
+
+    bool inTransaction() const override
+    {
+        return true;
+    }
+
+    // reads back the search index records
+    void load(mega::NodeSearchIndex& index, mega::SymmCipher& key)
+    {
+        for (auto& record : records)
+        {
+            std::string data(record.second);
+            ASSERT_TRUE(mega::PaddedCBC::decrypt(&data, &key));
+            ASSERT_EQ(uint32_t(mega::MegaClient::CACHEDSEARCHINDEX), record.first & 15);
+            ASSERT_TRUE(index.unserializeRecord(data, record.first));
+        }
+    }
+};
+
+}
+
+TEST(Node, childrenByName_smallFolderIsNotIndexed)
+{
+    MockClient client;
+    auto& folder = mt::makeNode(*client.cli, mega::FOLDERNODE, ::mega::NodeHandle().set6byte(1));
+    auto& a = makeNamedNode(*client.cli, mega::FILENODE, 2, "a", folder);
+    makeNamedNode(*client.cli, mega::FILENODE, 3, "b", folder);
+
+    ASSERT_EQ(std::vector<mega::Node*>{&a}, folder.childrenByName("a"));
+    ASSERT_FALSE(folder.childNames);
+}
+
+TEST(Node, childrenByName_indexFollowsMovesRenamesAndDeletions)
+{
+    MockClient client;
+    auto& folder = mt::makeNode(*client.cli, mega::FOLDERNODE, ::mega::NodeHandle().set6byte(1));
+    auto& other = mt::makeNode(*client.cli, mega::FOLDERNODE, ::mega::NodeHandle().set6byte(2));
+
+    const size_t count = 2 * mega::ChildNameIndex::MINCHILDREN;
+    std::vector<mega::Node*> nodes;
+    for (size_t i = 0; i < count; ++i)
+    {
+        // every tenth name is repeated, alternating files and folders
+        auto name = "child" + std::to_string(i % 10 ? i : 0);
+        auto type = i % 2 ? mega::FILENODE : mega::FOLDERNODE;
+        nodes.push_back(&makeNamedNode(*client.cli, type, 100 + i, name, folder));
+    }
+
+    ASSERT_EQ(scanChildren(folder, "child1"), folder.childrenByName("child1"));
+    ASSERT_TRUE(folder.childNames);
+
+    auto clashes = folder.childrenByName("child0");
+    ASSERT_EQ(scanChildren(folder, "child0"), clashes);
+    ASSERT_EQ(count / 10, clashes.size());
+
+    // moving out, and back in at the end of the children list
+    nodes[10]->setparent(&other);
+    ASSERT_EQ(scanChildren(folder, "child0"), folder.childrenByName("child0"));
+    nodes[10]->setparent(&folder);
+    ASSERT_EQ(scanChildren(folder, "child0"), folder.childrenByName("child0"));
+    ASSERT_EQ(nodes[10], folder.childrenByName("child0").back());
+
+    rename(*nodes[3], "renamed");
+    ASSERT_TRUE(folder.childrenByName("child3").empty());
+    ASSERT_EQ(std::vector<mega::Node*>{nodes[3]}, folder.childrenByName("renamed"));
+
+    // pending decryption: displayed as NO_KEY, so not found by its old name
+    nodes[5]->attrstring.reset(new std::string("x"));
+    ASSERT_TRUE(folder.childrenByName("child5").empty());
+    ASSERT_EQ(scanChildren(folder, "NO_KEY"), folder.childrenByName("NO_KEY"));
+    nodes[5]->attrstring.reset();
+
+    delete nodes[7];
+    ASSERT_TRUE(folder.childrenByName("child7").empty());
+}
+
+TEST(Node, childnodebyname_foldersTakePrecedenceInLargeFolders)
+{
+    MockClient client;
+    auto& folder = mt::makeNode(*client.cli, mega::FOLDERNODE, ::mega::NodeHandle().set6byte(1));
+
+    for (size_t i = 0; i < mega::ChildNameIndex::MINCHILDREN; ++i)
+    {
+        makeNamedNode(*client.cli, mega::FILENODE, 100 + i, "f" + std::to_string(i), folder);
+    }
+    auto& file = makeNamedNode(*client.cli, mega::FILENODE, 10, "clash", folder);
+    auto& subfolder = makeNamedNode(*client.cli, mega::FOLDERNODE, 11, "clash", folder);
+    auto& file2 = makeNamedNode(*client.cli, mega::FILENODE, 12, "clash", folder);
+
+    ASSERT_EQ(&subfolder, client.cli->childnodebyname(&folder, "clash"));
+    ASSERT_EQ(&file, client.cli->childnodebyname(&folder, "clash", true));
+    ASSERT_EQ(&subfolder, client.cli->childNodeTypeByName(&folder, "clash", mega::FOLDERNODE));
+    ASSERT_EQ((std::vector<mega::Node*>{&file, &file2}), client.cli->childnodesbyname(&folder, "clash", true));
+    ASSERT_EQ(nullptr, client.cli->childnodebyname(&folder, "missing"));
+}
+
+// what a listing must return: the children sorted from scratch
+std::vector<mega::Node*> sortChildren(const mega::Node& parent, const mega::ChildSortIndex::Comparator& less)
+{
+    std::vector<mega::Node*> sorted(parent.children.begin(), parent.children.end());
+    std::stable_sort(sorted.begin(), sorted.end(), less);
+    return sorted;
+}
+
+TEST(Node, sortedChildren_smallFolderIsNotIndexed)
+{
+    MockClient client;
+    auto& folder = mt::makeNode(*client.cli, mega::FOLDERNODE, ::mega::NodeHandle().set6byte(1));
+    auto& b = makeNamedNode(*client.cli, mega::FILENODE, 2, "b", folder);
+    auto& a = makeNamedNode(*client.cli, mega::FILENODE, 3, "a", folder);
+
+    auto byName = [](mega::Node* i, mega::Node* j) { return strcmp(i->displayname(), j->displayname()) < 0; };
+    ASSERT_EQ((std::vector<mega::Node*>{&a, &b}), folder.sortedChildren(1, byName));
+    ASSERT_EQ(std::vector<mega::Node*>{&b}, folder.sortedChildren(1, byName, 1, 10));
+    ASSERT_TRUE(folder.sortedChildren(1, byName, 2, 10).empty());
+    ASSERT_FALSE(folder.childOrders);
+}
+
+TEST(Node, sortedChildren_ordersFollowAdditionsMovesRenamesAndDeletions)
+{
+    MockClient client;
+    auto& folder = mt::makeNode(*client.cli, mega::FOLDERNODE, ::mega::NodeHandle().set6byte(1));
+    auto& other = mt::makeNode(*client.cli, mega::FOLDERNODE, ::mega::NodeHandle().set6byte(2));
+
+    // names are unique, so both orders are total and the results comparable
+    auto byName = [](mega::Node* i, mega::Node* j) { return strcmp(i->displayname(), j->displayname()) < 0; };
+    auto byNameDesc = [](mega::Node* i, mega::Node* j) { return strcmp(i->displayname(), j->displayname()) > 0; };
+
+    const size_t count = 4 * mega::ChildSortIndex::MINCHILDREN;
+    std::vector<mega::Node*> nodes;
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto name = "child" + std::to_string((i * 7919) % count);
+        nodes.push_back(&makeNamedNode(*client.cli, mega::FILENODE, 100 + i, name, folder));
+    }
+
+    ASSERT_EQ(sortChildren(folder, byName), folder.sortedChildren(1, byName));
+    ASSERT_TRUE(folder.childOrders);
+    ASSERT_EQ(sortChildren(folder, byNameDesc), folder.sortedChildren(2, byNameDesc));
+
+    const std::vector<std::pair<int, mega::ChildSortIndex::Comparator>> orders{{1, byName}, {2, byNameDesc}};
+    auto expectPages = [&]()
+    {
+        for (auto& order : orders)
+        {
+            auto expected = sortChildren(folder, order.second);
+            std::vector<mega::Node*> paged;
+            for (size_t offset = 0; offset < expected.size(); offset += 10)
+            {
+                auto page = folder.sortedChildren(order.first, order.second, offset, 10);
+                ASSERT_EQ(std::min<size_t>(10, expected.size() - offset), page.size());
+                paged.insert(paged.end(), page.begin(), page.end());
+            }
+            ASSERT_EQ(expected, paged);
+        }
+    };
+    expectPages();
+
+    // moving out, and back in
+    nodes[10]->setparent(&other);
+    nodes[11]->setparent(&other);
+    expectPages();
+    nodes[10]->setparent(&folder);
+    expectPages();
+
+    rename(*nodes[3], "a first");
+    rename(*nodes[4], "z last");
+    expectPages();
+    ASSERT_EQ(nodes[3], folder.sortedChildren(1, byName, 0, 1).front());
+    ASSERT_EQ(nodes[4], folder.sortedChildren(2, byNameDesc, 0, 1).front());
+
+    delete nodes[7];
+    makeNamedNode(*client.cli, mega::FILENODE, 99, "child new", folder);
+    expectPages();
+
+    // most of the folder changed: the orders are sorted again
+    for (size_t i = 20; i < count; ++i)
+    {
+        nodes[i]->setparent(&other);
+    }
+    expectPages();
+}
+
+// Builds a synthetic tree of a million named nodes, reporting the memory taken per node
+// what the aggregated counts must be: a walk of the subtree
+mega::NodeCounter walkCounts(const mega::Node& n)
+{
+    mega::NodeCounter nc;
+    for (auto child : n.children)
+    {
+        nc += walkCounts(*child);
+    }
+    if (n.type == mega::FILENODE)
+    {
+        nc.files += 1;
+        nc.storage += n.size;
+        if (n.parent && n.parent->type == mega::FILENODE)
+        {
+            nc.versions += 1;
+            nc.versionStorage += n.size;
+        }
+    }
+    else if (n.type == mega::FOLDERNODE)
+    {
+        nc.folders += 1;
+    }
+    return nc;
+}
+
+void expectCounts(const mega::Node& n)
+{
+    auto expected = walkCounts(n);
+    auto counted = n.subnodeCounts();
+    EXPECT_EQ(expected.files, counted.files);
+    EXPECT_EQ(expected.folders, counted.folders);
+    EXPECT_EQ(expected.versions, counted.versions);
+    EXPECT_EQ(expected.storage, counted.storage);
+    EXPECT_EQ(expected.versionStorage, counted.versionStorage);
+}
+
+TEST(Node, subtreeCounts_followAdditionsMovesVersionsAndRemovals)
+{
+    MockClient client;
+    auto& root = mt::makeNode(*client.cli, mega::ROOTNODE, ::mega::NodeHandle().set6byte(1));
+    auto& rubbish = mt::makeNode(*client.cli, mega::RUBBISHNODE, ::mega::NodeHandle().set6byte(2));
+    auto& a = makeNamedNode(*client.cli, mega::FOLDERNODE, 10, "a", root);
+    auto& b = makeNamedNode(*client.cli, mega::FOLDERNODE, 11, "b", a);
+
+    auto makeFile = [&](mega::handle h, m_off_t size, mega::Node& parent) -> mega::Node&
+    {
+        auto& n = mt::makeNode(*client.cli, mega::FILENODE, ::mega::NodeHandle().set6byte(h));
+        n.size = size;
+        n.setparent(&parent);
+        return n;
+    };
+
+    std::vector<mega::Node*> files;
+    for (mega::handle i = 0; i < 10; ++i)
+    {
+        files.push_back(&makeFile(100 + i, m_off_t(1000 + i), i % 2 ? a : b));
+    }
+    expectCounts(root);
+    ASSERT_EQ(10u, root.subnodeCounts().files);
+    ASSERT_EQ(2u, root.subnodeCounts().folders);
+    ASSERT_EQ(5u, b.children.files());
+    ASSERT_EQ(1u, a.children.folders());
+
+    // a new version of files[0]: the old one goes below it
+    auto& latest = makeFile(200, 5000, b);
+    files[0]->setparent(&latest);
+    expectCounts(root);
+    expectCounts(b);
+    ASSERT_EQ(1u, root.subnodeCounts().versions);
+    ASSERT_EQ(1000, root.subnodeCounts().versionStorage);
+
+    // moving a folder with everything below it
+    b.setparent(&rubbish);
+    expectCounts(root);
+    expectCounts(rubbish);
+    ASSERT_EQ(6u, rubbish.subnodeCounts().files);
+
+    // removing a version, and then a file
+    deleteNode(*client.cli, files[0]);
+    expectCounts(rubbish);
+    ASSERT_EQ(0u, rubbish.subnodeCounts().versions);
+    deleteNode(*client.cli, files[1]);
+    expectCounts(root);
+    expectCounts(a);
+    ASSERT_EQ(4u, a.children.files());
+}
+
+// Nodes are allocated from shared slabs: many of them, freed in any order and allocated again
+TEST(Node, manyNodesFreedAndAllocatedAgain)
+{
+    const size_t folders = 1000;
+    const size_t filesPerFolder = 999;
+
+    MockClient client;
+
+    auto& root = mt::makeNode(*client.cli, mega::ROOTNODE, ::mega::NodeHandle().set6byte(1));
+    for (size_t i = 0; i < folders; ++i)
+    {
+        auto& folder = makeNamedNode(*client.cli, mega::FOLDERNODE, 1000000 + i, "folder" + std::to_string(i), root);
+        for (size_t j = 0; j < filesPerFolder; ++j)
+        {
+            auto& file = makeNamedNode(*client.cli, mega::FILENODE, 2000000 + i * filesPerFolder + j, "file" + std::to_string(j) + ".jpg", folder);
+            file.size = static_cast<m_off_t>(j);
+        }
+    }
+
+    ASSERT_EQ(1 + folders * (1 + filesPerFolder), client.cli->nodes.size());
+    ASSERT_EQ(folders, root.children.size());
+
+    // every other file, then the files of every other folder, leaving blocks free across the slabs
+    for (size_t i = 0; i < folders; ++i)
+    {
+        for (size_t j = i % 2 ? 0 : 1; j < filesPerFolder; j += i % 2 ? 1 : 2)
+        {
+            deleteNode(*client.cli, client.cli->nodeByHandle(::mega::NodeHandle().set6byte(2000000 + i * filesPerFolder + j)));
+        }
+    }
+    size_t left = 1 + folders + folders / 2 * (filesPerFolder - filesPerFolder / 2);
+    ASSERT_EQ(left, client.cli->nodes.size());
+
+    for (size_t i = 0; i < folders; i += 2)
+    {
+        mega::Node* folder = client.cli->nodeByHandle(::mega::NodeHandle().set6byte(1000000 + i));
+        ASSERT_EQ(filesPerFolder - filesPerFolder / 2, folder->children.size());
+        for (size_t j = 1; j < filesPerFolder; j += 2)
+        {
+            auto& file = makeNamedNode(*client.cli, mega::FILENODE, 2000000 + i * filesPerFolder + j, "file" + std::to_string(j) + ".jpg", *folder);
+            ASSERT_EQ(folder, file.parent);
+        }
+        ASSERT_EQ(filesPerFolder, folder->children.size());
+    }
+    ASSERT_EQ(left + folders / 2 * (filesPerFolder / 2), client.cli->nodes.size());
+}
+
+TEST(Node, fingerprintIndex_sameResultsAsAnOrderedMultimap)
+{
+    MockClient client;
+    auto& index = client.cli->mFingerprints;
+
+    // every fingerprint is shared by three nodes
+    const size_t count = 3000;
+    std::map<size_t, std::vector<mega::Node*>> expected;
+    std::vector<mega::Node*> nodes;
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto& n = mt::makeNode(*client.cli, mega::FILENODE, ::mega::NodeHandle().set6byte(100 + i));
+        setFingerprint(n, i / 3);
+        index.add(&n);
+        expected[i / 3].push_back(&n);
+        nodes.push_back(&n);
+    }
+
+    auto check = [&]()
+    {
+        for (auto& e : expected)
+        {
+            mega::FileFingerprint f;
+            setFingerprint(f, e.first);
+            std::unique_ptr<mega::node_vector> found(index.nodesbyfingerprint(&f));
+            ASSERT_EQ(e.second, *found);
+            ASSERT_EQ(e.second.empty() ? nullptr : e.second.front(), index.nodebyfingerprint(&f));
+        }
+    };
+
+    check();
+    ASSERT_EQ(count, index.size());
+
+    mega::FileFingerprint missing;
+    setFingerprint(missing, count);
+    ASSERT_EQ(nullptr, index.nodebyfingerprint(&missing));
+
+    // removals shift the following slots back: equal fingerprints keep their order
+    for (size_t i = 0; i < count; i += 2)
+    {
+        index.remove(nodes[i]);
+        auto& same = expected[i / 3];
+        same.erase(std::find(same.begin(), same.end(), nodes[i]));
+    }
+    check();
+    ASSERT_EQ(count / 2, index.size());
+
+    // and added back, they go last
+    for (size_t i = 0; i < count; i += 4)
+    {
+        index.add(nodes[i]);
+        expected[i / 3].push_back(nodes[i]);
+    }
+    check();
+}
+
+// Builds the index with many fingerprints, and looks them up and missing ones: it finds
+// what an ordered set of fingerprints finds
+TEST(Node, fingerprintIndex_manyFingerprintsAsAnOrderedSet)
+{
+    const size_t count = 200000;
+
+    // the index keeps a copy of the fingerprint, so one node can stand for all of them
+    MockClient client;
+    auto& n = mt::makeNode(*client.cli, mega::FILENODE, ::mega::NodeHandle().set6byte(1));
+
+    mega::Fingerprints index;
+    std::vector<mega::FileFingerprint> fingerprints(count);
+    std::multiset<mega::FileFingerprint*, mega::FileFingerprintCmp> ordered;
+    for (size_t i = 0; i < count; ++i)
+    {
+        setFingerprint(n, i);
+        index.add(&n);
+        setFingerprint(fingerprints[i], i);
+        ordered.insert(&fingerprints[i]);
+    }
+    ASSERT_EQ(count, index.size());
+
+    mega::FileFingerprint f;
+    size_t found = 0;
+    for (size_t i = 0; i < 2 * count; ++i)
+    {
+        setFingerprint(f, i);
+        bool inIndex = index.nodebyfingerprint(&f) != nullptr;
+        ASSERT_EQ(ordered.find(&f) != ordered.end(), inIndex);
+        found += inIndex;
+    }
+    ASSERT_EQ(count, found);
+
+    index.clear();
+    n.fingerprintIndexed = false;
+}
+
+TEST(Node, nameSnapshot_sameResultsAsATreeWalk)
+{
+    MockClient client;
+    auto& root = mt::makeNode(*client.cli, mega::ROOTNODE, ::mega::NodeHandle().set6byte(1));
+    auto& rubbish = mt::makeNode(*client.cli, mega::RUBBISHNODE, ::mega::NodeHandle().set6byte(2));
+
+    // a few levels of folders, with names in mixed case
+    mega::handle h = 100;
+    std::vector<mega::Node*> folders{&root};
+    for (size_t i = 0; i < 40; ++i)
+    {
+        auto& folder = makeNamedNode(*client.cli, mega::FOLDERNODE, h++, "Folder" + std::to_string(i), *folders[i / 3]);
+        folders.push_back(&folder);
+        for (size_t j = 0; j < 50; ++j)
+        {
+            makeNamedNode(*client.cli, mega::FILENODE, h++, "Photo_" + std::to_string(i) + "_" + std::to_string(j) + ".JPG", folder);
+        }
+    }
+    auto& trashed = makeNamedNode(*client.cli, mega::FILENODE, h++, "photo_trashed.jpg", rubbish);
+
+    for (const char* text : {"photo_1", "FOLDER1", "jpg", "_3_", "", "missing"})
+    {
+        for (mega::Node* top : {&root, folders[3], &rubbish})
+        {
+            std::vector<mega::NodeHandle> expected;
+            walkSearch(top, text, expected);
+            ASSERT_EQ(expected, snapshotSearch(*client.cli, *top, text, 1)) << text;
+            ASSERT_EQ(expected, snapshotSearch(*client.cli, *top, text, 7)) << text;
+        }
+    }
+
+    // the snapshot is built again after renames and moves
+    auto before = client.cli->nameSnapshot();
+    rename(*folders[5], "Renamed");
+    ASSERT_NE(before, client.cli->nameSnapshot());
+    ASSERT_EQ(1u, snapshotSearch(*client.cli, root, "renamed", 1).size());
+
+    before = client.cli->nameSnapshot();
+    trashed.setparent(folders[5]);
+    ASSERT_NE(before, client.cli->nameSnapshot());
+    ASSERT_EQ(std::vector<mega::NodeHandle>{trashed.nodeHandle()}, snapshotSearch(*client.cli, root, "TRASHED", 4));
+    ASSERT_TRUE(snapshotSearch(*client.cli, rubbish, "trashed", 4).empty());
+}
+
+// Searches a large synthetic tree of named nodes, walking it as the search did before, and
+// scanning the name snapshot with one thread and with one per core: all find the same nodes
+TEST(Node, nameSnapshot_largeTreeWithAnyThreads)
+{
+    const size_t folders = 200;
+    const size_t filesPerFolder = 999;
+
+    MockClient client;
+    auto& root = mt::makeNode(*client.cli, mega::ROOTNODE, ::mega::NodeHandle().set6byte(1));
+    for (size_t i = 0; i < folders; ++i)
+    {
+        auto& folder = makeNamedNode(*client.cli, mega::FOLDERNODE, 1000000 + i, "Folder" + std::to_string(i), root);
+        for (size_t j = 0; j < filesPerFolder; ++j)
+        {
+            makeNamedNode(*client.cli, mega::FILENODE, 2000000 + i * filesPerFolder + j, "IMG_" + std::to_string(i * filesPerFolder + j) + ".jpg", folder);
+        }
+    }
+
+    const char* text = "g_12345";
+    std::vector<mega::NodeHandle> walked;
+    walkSearch(&root, text, walked);
+
+    auto snapshot = client.cli->nameSnapshot();
+    ASSERT_EQ(1 + folders * (1 + filesPerFolder), snapshot->size());
+
+    mega::NodeNameSnapshot::Range range;
+    ASSERT_TRUE(snapshot->subtree(root.nodeHandle(), range));
+
+    auto single = snapshot->search({range}, text, mega::CancelToken(), 1);
+
+    std::atomic<size_t> parts{0};
+    auto parallel = snapshot->search({range}, text, mega::CancelToken(), 0, [&parts](size_t, const mega::NodeNameSnapshot::Matches&) { ++parts; });
+
+    ASSERT_EQ(walked, single);
+    ASSERT_EQ(walked, parallel);
+    ASSERT_EQ(11u, walked.size());
+    ASSERT_LE(1u, parts.load());
+}
+
+TEST(Node, searchIndex_sameResultsAsAScan)
+{
+    mega::NodeSearchIndex index;
+    std::map<mega::NodeHandle, IndexedName> names;
+
+    auto set = [&](mega::handle h, const std::string& name, uint8_t categories)
+    {
+        auto nh = mega::NodeHandle().set6byte(h);
+        index.set(nh, mega::FILENODE, name, categories);
+        names[nh] = IndexedName{name, categories};
+    };
+
+    const char* extensions[] = {".JPG", ".mp3", ".pdf", ".txt", ""};
+    const uint8_t categories[] = {mega::NodeSearchIndex::PHOTO, mega::NodeSearchIndex::AUDIO, mega::NodeSearchIndex::DOCUMENT, mega::NodeSearchIndex::DOCUMENT, 0};
+    for (mega::handle h = 1; h <= 5000; ++h)
+    {
+        set(h, "Holiday_" + std::to_string(h) + extensions[h % 5], categories[h % 5]);
+    }
+
+    auto check = [&]()
+    {
+        ASSERT_EQ(names.size(), index.size());
+        for (const char* text : {"holiday_12", "HOLIDAY", "day_3", "_4", "g", "", ".jpg", "renamed", "missing"})
+        {
+            for (bool prefix : {false, true})
+            {
+                for (uint8_t c : {0, 1, 2, 8, 9})
+                {
+                    ASSERT_EQ(scanNames(names, text, prefix, c), sorted(index.find(text, prefix, c))) << text << " " << prefix << " " << int(c);
+                }
+            }
+        }
+    };
+    check();
+
+    // enough renames and removals to have the postings rebuilt
+    for (mega::handle h = 1; h <= 5000; h += 2)
+    {
+        set(h, "Renamed_" + std::to_string(h) + ".jpg", mega::NodeSearchIndex::PHOTO);
+    }
+    for (mega::handle h = 1; h <= 5000; h += 3)
+    {
+        index.remove(mega::NodeHandle().set6byte(h));
+        names.erase(mega::NodeHandle().set6byte(h));
+    }
+    check();
+
+    // and the ids removed are reused
+    for (mega::handle h = 10000; h < 11000; ++h)
+    {
+        set(h, "holiday_new_" + std::to_string(h), 0);
+    }
+    check();
+
+    index.clear();
+    names.clear();
+    check();
+    ASSERT_TRUE(index.complete());
+}
+
+TEST(Node, searchIndex_followsNodeRenamesAndRemovals)
+{
+    MockClient client;
+    auto& root = mt::makeNode(*client.cli, mega::ROOTNODE, ::mega::NodeHandle().set6byte(1));
+    auto& folder = makeNamedNode(*client.cli, mega::FOLDERNODE, 2, "Photos", root);
+    auto& photo = makeNamedNode(*client.cli, mega::FILENODE, 3, "beach.jpg", folder);
+    auto& song = makeNamedNode(*client.cli, mega::FILENODE, 4, "song.mp3", folder);
+    for (mega::Node* n : {&root, &folder, &photo, &song})
+    {
+        client.cli->indexNode(n);
+    }
+
+    auto& index = client.cli->mSearchIndex;
+    ASSERT_EQ(3u, index.size());
+    ASSERT_EQ(std::vector<mega::NodeHandle>{photo.nodeHandle()}, index.find(nullptr, false, mega::NodeSearchIndex::PHOTO));
+    ASSERT_EQ(std::vector<mega::NodeHandle>{song.nodeHandle()}, index.find(nullptr, false, mega::NodeSearchIndex::AUDIO));
+    ASSERT_EQ(std::vector<mega::NodeHandle>{folder.nodeHandle()}, index.find("PHO", true, 0));
+
+    // decrypted names are indexed as they arrive
+    rename(photo, "Sunset.png");
+    ASSERT_TRUE(index.find("beach", false, 0).empty());
+    ASSERT_EQ(std::vector<mega::NodeHandle>{photo.nodeHandle()}, index.find("sunset", true, mega::NodeSearchIndex::PHOTO));
+
+    rename(song, "notes.txt");
+    ASSERT_TRUE(index.find(nullptr, false, mega::NodeSearchIndex::AUDIO).empty());
+    ASSERT_EQ(std::vector<mega::NodeHandle>{song.nodeHandle()}, index.find("otes", false, mega::NodeSearchIndex::DOCUMENT));
+
+    song.changed.removed = true;
+    client.cli->indexNode(&song);
+    ASSERT_TRUE(index.find("notes", false, 0).empty());
+    ASSERT_EQ(2u, index.size());
+}
+
+TEST(Node, searchIndex_storedAndLoaded)
+{
+    mega::PrnGen rng;
+    MemoryTable table(rng, false);
+    table.nextid = 0;
+
+    mega::SymmCipher key;
+    mega::byte keyData[mega::SymmCipher::KEYLENGTH] = {1, 2, 3};
+    key.setkey(keyData);
+
+    mega::NodeSearchIndex index;
+    std::map<mega::NodeHandle, IndexedName> names;
+    const size_t count = 3 * mega::NodeSearchIndex::RECORDENTRIES + 10;
+    for (mega::handle h = 1; h <= count; ++h)
+    {
+        auto nh = mega::NodeHandle().set6byte(h);
+        std::string name = "file" + std::to_string(h) + (h % 2 ? ".jpg" : ".doc");
+        uint8_t categories = h % 2 ? mega::NodeSearchIndex::PHOTO : mega::NodeSearchIndex::DOCUMENT;
+        index.set(nh, h % 7 ? mega::FILENODE : mega::FOLDERNODE, name, categories);
+        names[nh] = IndexedName{name, categories};
+    }
+    ASSERT_TRUE(index.store(table, mega::MegaClient::CACHEDSEARCHINDEX, &key, 42));
+    ASSERT_EQ(5u, table.records.size());
+
+    auto reload = [&](mega::handle scsn)
+    {
+        mega::NodeSearchIndex loaded;
+        table.load(loaded, key);
+        bool valid = loaded.loaded(scsn);
+        return std::make_pair(valid, std::move(loaded));
+    };
+
+    auto result = reload(42);
+    ASSERT_TRUE(result.first);
+    ASSERT_TRUE(result.second.complete());
+    ASSERT_EQ(count, result.second.size());
+    ASSERT_EQ(scanNames(names, "file12", true, mega::NodeSearchIndex::PHOTO), sorted(result.second.find("FILE12", true, mega::NodeSearchIndex::PHOTO)));
+
+    // only the changed records are written again, and the empty ones deleted
+    for (mega::handle h = 1; h <= mega::NodeSearchIndex::RECORDENTRIES; ++h)
+    {
+        index.remove(mega::NodeHandle().set6byte(h));
+        names.erase(mega::NodeHandle().set6byte(h));
+    }
+    index.set(mega::NodeHandle().set6byte(count), mega::FILENODE, "renamed.jpg", mega::NodeSearchIndex::PHOTO);
+    names[mega::NodeHandle().set6byte(count)] = IndexedName{"renamed.jpg", mega::NodeSearchIndex::PHOTO};
+    ASSERT_TRUE(index.store(table, mega::MegaClient::CACHEDSEARCHINDEX, &key, 43));
+    ASSERT_EQ(4u, table.records.size());
+
+    result = reload(43);
+    ASSERT_TRUE(result.first);
+    ASSERT_EQ(names.size(), result.second.size());
+    for (const char* text : {"file1", "renamed", ".doc", ""})
+    {
+        ASSERT_EQ(scanNames(names, text, false, 0), sorted(result.second.find(text, false, 0))) << text;
+    }
+
+    // records that don't match the cache's scsn are not used, and dropped when stored
+    result = reload(44);
+    ASSERT_FALSE(result.first);
+    ASSERT_FALSE(result.second.complete());
+    ASSERT_EQ(0u, result.second.size());
+    ASSERT_TRUE(result.second.store(table, mega::MegaClient::CACHEDSEARCHINDEX, &key, 44));
+    ASSERT_TRUE(table.records.empty());
+}
+
+// Indexes many names, and searches them by prefix, substring and category: the index finds
+// what a scan of all the names finds
+TEST(Node, searchIndex_manyNamesAsAScan)
+{
+    const size_t count = 200000;
+
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        names.push_back("IMG_" + std::to_string(i) + (i % 10 ? ".jpg" : ".mp4"));
+    }
+
+    mega::NodeSearchIndex index;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint8_t categories = i % 10 ? mega::NodeSearchIndex::PHOTO : mega::NodeSearchIndex::VIDEO;
+        index.set(mega::NodeHandle().set6byte(i + 1), mega::FILENODE, names[i], categories);
+    }
+
+    size_t scannedInfix = 0;
+    size_t scannedPrefix = 0;
+    for (auto& name : names)
+    {
+        std::string folded(name);
+        mega::NodeNameSnapshot::fold(folded);
+        scannedInfix += folded.find("g_12345") != std::string::npos;
+        scannedPrefix += !folded.compare(0, 9, "img_19999");
+    }
+
+    auto infix = index.find("g_12345", false, 0);
+    auto prefix = index.find("img_19999", true, 0);
+    auto videos = index.find(nullptr, false, mega::NodeSearchIndex::VIDEO);
+
+    ASSERT_EQ(scannedInfix, infix.size());
+    ASSERT_EQ(11u, infix.size());
+    ASSERT_EQ(scannedPrefix, prefix.size());
+    ASSERT_EQ(11u, prefix.size());
+    ASSERT_EQ(count / 10, videos.size());
+}
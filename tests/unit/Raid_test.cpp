@@ -0,0 +1,144 @@
+/**
+ * (c) 2021 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <gtest/gtest.h>
+
+#include <mega/raid.h>
+#include "mega.h"
+
+using namespace mega;
+
+namespace
+{
+
+// the six parts of a raid file: 0 is the parity of the five data parts 1-5
+struct RaidParts
+{
+    std::vector<byte> part[RAIDPARTS];
+    std::vector<byte> file;
+
+    explicit RaidParts(size_t partslen)
+    {
+        file.resize(partslen * (RAIDPARTS - 1));
+        for (size_t i = 0; i < file.size(); ++i)
+        {
+            file[i] = static_cast<byte>((i * 131) ^ (i >> 7));
+        }
+
+        for (auto& p : part)
+        {
+            p.assign(partslen, 0);
+        }
+
+        for (size_t line = 0; line < partslen / RAIDSECTOR; ++line)
+        {
+            for (unsigned j = 1; j < RAIDPARTS; ++j)
+            {
+                for (unsigned k = 0; k < RAIDSECTOR; ++k)
+                {
+                    byte b = file[line * RAIDLINE + (j - 1) * RAIDSECTOR + k];
+                    part[j][line * RAIDSECTOR + k] = b;
+                    part[0][line * RAIDSECTOR + k] = static_cast<byte>(part[0][line * RAIDSECTOR + k] ^ b);
+                }
+            }
+        }
+    }
+
+    // inputs as downloaded with one part (possibly the parity) missing
+    void inputs(unsigned missingPart, byte* inputbufs[RAIDPARTS])
+    {
+        for (unsigned j = 0; j < RAIDPARTS; ++j)
+        {
+            inputbufs[j] = j == missingPart ? nullptr : part[j].data();
+        }
+    }
+};
+
+} // anonymous
+
+TEST(Raid, combineRaidLines_all_missing_parts)
+{
+    // odd number of sectors, to exercise the tail of the wide kernels too
+    for (size_t partslen : { size_t(RAIDSECTOR), size_t(3 * RAIDSECTOR), size_t(1023 * RAIDSECTOR) })
+    {
+        RaidParts parts(partslen);
+
+        for (unsigned missing = 0; missing < RAIDPARTS; ++missing)
+        {
+            byte* inputbufs[RAIDPARTS];
+            parts.inputs(missing, inputbufs);
+
+            std::vector<byte> output(parts.file.size(), 0);
+            combineRaidLines(output.data(), inputbufs, partslen);
+
+            ASSERT_EQ(parts.file, output) << "partslen: " << partslen << " missing part: " << missing;
+        }
+    }
+}
+
+TEST(Raid, bufferPool_reusesBuffersOfTheSameSizeClassUpToTheCap)
+{
+    BufferPool pool;
+
+    // chunk sizes with and without the cipher/raid padding share a class
+    byte* b = pool.get((1 << 20) + 16);
+    b[(1 << 20) + 15] = 1;
+    pool.put(b, (1 << 20) + 16);
+    ASSERT_EQ(b, pool.get(1 << 20));
+    pool.put(b, 1 << 20);
+
+    // but not a class a quarter bigger
+    byte* c = pool.get((1 << 20) + (1 << 18));
+    ASSERT_NE(b, c);
+    pool.put(c, (1 << 20) + (1 << 18));
+
+    auto stats = pool.stats();
+    ASSERT_EQ(1u, stats.hits);
+    ASSERT_EQ(2u, stats.misses);
+    ASSERT_LT(stats.idleBytes, size_t(3 << 20));
+
+    // buffers beyond the cap are freed
+    pool.setMaxIdleBytes(size_t(3) << 19);
+    ASSERT_LE(pool.stats().idleBytes, size_t(3) << 19);
+    pool.setMaxIdleBytes(0);
+    ASSERT_EQ(0u, pool.stats().idleBytes);
+    pool.put(pool.get(1 << 20), 1 << 20);
+    ASSERT_EQ(0u, pool.stats().idleBytes);
+
+    // small buffers are left to the allocator
+    pool.setMaxIdleBytes(1 << 30);
+    pool.put(pool.get(100), 100);
+    ASSERT_EQ(0u, pool.stats().idleBytes);
+}
+
+// A GB downloaded in 1 MB raid pieces takes its buffers from the pool
+TEST(Raid, bufferPool_filePiecesAllocateNearlyNothingPerGB)
+{
+    auto before = g_bufferPool.stats();
+
+    const size_t len = 1 << 20;
+    for (unsigned i = 0; i < 1024; ++i)
+    {
+        RaidBufferManager::FilePiece piece(m_off_t(i) * len, len);
+        piece.buf.datastart()[len + RAIDSECTOR - 1] = byte(i);
+    }
+
+    auto after = g_bufferPool.stats();
+    ASSERT_LE(after.misses - before.misses, 1u);
+    ASSERT_GE(after.hits - before.hits, 1023u);
+}
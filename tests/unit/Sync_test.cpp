@@ -16,8 +16,10 @@
  * program.
  */
 
+#include <chrono>
 #include <memory>
 #include <numeric>
+#include <thread>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -1107,5 +1109,73 @@ TEST_F(SyncConfigStoreTest, Write)
 
 } // SyncConfigTests
 
+namespace ScanServiceTests
+{
+
+using namespace mega;
+using SyncConfigTests::Directory;
+using SyncConfigTests::Utilities;
+
+TEST(ScanService, fingerprintsMatchThoseComputedInline)
+{
+    FSACCESS_CLASS fsAccess;
+    Directory root(fsAccess, Utilities::randomPathAbsolute());
+
+    // sizes either side of the tiny, small and large fingerprint cases
+    vector<LocalPath> paths;
+    for (size_t size : { 0, 1, 16, 17, 8192, 16384, 16385, 100000 })
+    {
+        paths.emplace_back(Utilities::randomPath(root));
+        ASSERT_TRUE(Utilities::randomFile(paths.back(), size));
+    }
+
+    WAIT_CLASS waiter;
+    ScanService service(waiter);
+
+    vector<ScanService::FingerprintRequestPtr> requests;
+    for (auto& path : paths)
+    {
+        requests.emplace_back(service.queueFingerprint(path, false));
+    }
+    auto missing = service.queueFingerprint(Utilities::randomPath(root), false);
+    auto folder = service.queueFingerprint(root, false);
+
+    auto completed = [&]()
+    {
+        for (auto& request : requests)
+        {
+            if (!request->completed()) return false;
+        }
+        return missing->completed() && folder->completed();
+    };
+
+    for (auto start = std::chrono::steady_clock::now(); !completed(); )
+    {
+        ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(30));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        auto fa = fsAccess.newfileaccess(false);
+        ASSERT_TRUE(fa->fopen(paths[i], true, false));
+
+        FileFingerprint expected;
+        expected.genfingerprint(fa.get());
+
+        auto& request = *requests[i];
+        ASSERT_TRUE(request.mIsFile);
+        ASSERT_EQ(fa->size, request.mSize);
+        ASSERT_EQ(fa->mtime, request.mMtime);
+        ASSERT_TRUE(request.mFingerprint.isvalid);
+        ASSERT_EQ(expected, request.mFingerprint);
+    }
+
+    ASSERT_FALSE(missing->mIsFile);
+    ASSERT_FALSE(folder->mIsFile);
+}
+
+} // ScanServiceTests
+
 #endif
 
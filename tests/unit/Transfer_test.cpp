@@ -87,3 +87,307 @@ TEST(Transfer, serialize_unserialize)
 }
 
 
+
+TEST(Transfer, directReadCache_blocksAreFilledSequentiallyAndEvictedLeastRecentlyUsedFirst)
+{
+    using ::mega::byte;
+    using Cache = mega::DirectReadCache;
+
+    const size_t blocksize = size_t(Cache::BLOCKSIZE);
+    std::string content(3 * blocksize, 0);
+    for (size_t i = 0; i < content.size(); ++i)
+    {
+        content[i] = char(i * 31 / 7);
+    }
+    auto at = [&](size_t pos) { return reinterpret_cast<const byte*>(content.data() + pos); };
+
+    Cache cache;
+    cache.setMaxBytes(2 * blocksize);
+    const byte* data = nullptr;
+
+    // not starting on a block boundary: not cached
+    cache.put(1, 100, at(100), 1000);
+    ASSERT_EQ(0u, cache.get(1, 100, &data));
+    ASSERT_EQ(0u, cache.bytes());
+
+    // overlapping and spanning two blocks: only the new tail is appended
+    cache.put(1, 0, at(0), 1000);
+    cache.put(1, 500, at(500), blocksize);
+    ASSERT_EQ(blocksize + 500, cache.bytes());
+    ASSERT_EQ(blocksize - 200, cache.get(1, 200, &data));
+    ASSERT_TRUE(std::equal(data, data + blocksize - 200, at(200)));
+    ASSERT_EQ(500u, cache.get(1, blocksize, &data));
+    ASSERT_TRUE(std::equal(data, data + 500, at(blocksize)));
+
+    // a gap is not filled
+    cache.put(1, blocksize + 600, at(blocksize + 600), 100);
+    ASSERT_EQ(500u, cache.get(1, blocksize, &data));
+
+    // the same positions of another file are separate
+    ASSERT_EQ(0u, cache.get(2, 0, &data));
+
+    // over the budget, the least recently used block goes first
+    ASSERT_EQ(blocksize, cache.get(1, 0, &data));
+    cache.put(2, 0, at(0), blocksize);
+    ASSERT_EQ(blocksize, cache.get(1, 0, &data));
+    ASSERT_EQ(0u, cache.get(1, blocksize, &data));
+    ASSERT_EQ(blocksize, cache.get(2, 0, &data));
+    ASSERT_EQ(2 * blocksize, cache.bytes());
+
+    cache.setMaxBytes(0);
+    ASSERT_EQ(0u, cache.bytes());
+    cache.put(1, 0, at(0), 10);
+    ASSERT_EQ(0u, cache.get(1, 0, &data));
+}
+
+namespace
+{
+
+// one adjustment interval in which `requests` chunk requests of 1 MB took `ds` each
+bool adjustLimits(mega::TransferLimits& limits, mega::direction_t d, mega::dstime& now, m_off_t goodput, unsigned active, mega::dstime ds = 10, unsigned requests = 1)
+{
+    for (unsigned i = 0; i < requests; ++i)
+    {
+        limits.requestCompleted(d, 1024 * 1024, ds);
+    }
+    now += mega::TransferLimits::ADJUSTDS;
+    return limits.update(d, goodput, active, now);
+}
+
+}
+
+TEST(Transfer, transferLimits_riseWhileGoodputGrowsWithAllTransfersInUse)
+{
+    mega::TransferLimits limits;
+    limits.setDefaults(mega::GET, 8, 2);
+    limits.setCeilings(mega::GET, 20, 4);
+    mega::dstime now = 1;
+
+    // the first interval only gives a measurement to compare with
+    ASSERT_FALSE(adjustLimits(limits, mega::GET, now, 1 << 20, 8));
+    ASSERT_EQ(8u, limits.limits(mega::GET).transfers);
+
+    ASSERT_TRUE(adjustLimits(limits, mega::GET, now, 1 << 20, 8));
+    ASSERT_EQ(10u, limits.limits(mega::GET).transfers);
+    ASSERT_NE(std::string::npos, limits.limits(mega::GET).reason.find("in use"));
+
+    m_off_t goodput = 1 << 20;
+    for (int i = 0; i < 10; ++i)
+    {
+        goodput *= 2;
+        adjustLimits(limits, mega::GET, now, goodput, limits.limits(mega::GET).transfers);
+        ASSERT_LE(limits.limits(mega::GET).transfers, 20u);
+    }
+    ASSERT_EQ(20u, limits.limits(mega::GET).transfers);
+    ASSERT_EQ(2u, limits.limits(mega::GET).connections);
+
+    // uploads are not affected
+    ASSERT_EQ(0u, limits.limits(mega::PUT).transfers);
+
+    // no adjustment before the interval elapses
+    ASSERT_FALSE(limits.update(mega::GET, goodput * 2, 20, now + 1));
+}
+
+TEST(Transfer, transferLimits_backOffWhenRequestsGetSlowerWithoutMoreGoodput)
+{
+    mega::TransferLimits limits;
+    limits.setDefaults(mega::PUT, 16, 3);
+    limits.setCeilings(mega::PUT, 64, 6);
+    mega::dstime now = 1;
+
+    ASSERT_FALSE(adjustLimits(limits, mega::PUT, now, 1 << 20, 16));
+    ASSERT_TRUE(adjustLimits(limits, mega::PUT, now, 1 << 20, 16));
+    ASSERT_EQ(20u, limits.limits(mega::PUT).transfers);
+
+    // the extra transfers only made each request slower
+    ASSERT_TRUE(adjustLimits(limits, mega::PUT, now, 1 << 20, 20, 40, 5));
+    ASSERT_EQ(16u, limits.limits(mega::PUT).transfers);
+    ASSERT_NE(std::string::npos, limits.limits(mega::PUT).reason.find("slower"));
+
+    // and the limits hold for a while, even with all transfers in use
+    for (unsigned i = 0; i < mega::TransferLimits::HOLDINTERVALS; ++i)
+    {
+        ASSERT_FALSE(adjustLimits(limits, mega::PUT, now, 1 << 20, 16, 40));
+    }
+    ASSERT_EQ(16u, limits.limits(mega::PUT).transfers);
+
+    // idle intervals don't count as measurements
+    ASSERT_FALSE(limits.update(mega::PUT, 0, 0, now += mega::TransferLimits::ADJUSTDS));
+    ASSERT_FALSE(adjustLimits(limits, mega::PUT, now, 1 << 20, 16, 40));
+}
+
+TEST(Transfer, transferLimits_connectionsRiseWithFewTransfersUpToTheCeiling)
+{
+    mega::TransferLimits limits;
+    limits.setDefaults(mega::GET, 32, 4);
+    limits.setCeilings(mega::GET, 128, 6);
+    mega::dstime now = 1;
+
+    m_off_t goodput = 1 << 20;
+    adjustLimits(limits, mega::GET, now, goodput, 1);
+    for (int i = 0; i < 10; ++i)
+    {
+        goodput *= 2;
+        adjustLimits(limits, mega::GET, now, goodput, 1);
+    }
+    ASSERT_EQ(6u, limits.limits(mega::GET).connections);
+    ASSERT_EQ(32u, limits.limits(mega::GET).transfers);
+
+    // a lower ceiling applies immediately
+    limits.setCeilings(mega::GET, 16, 2);
+    ASSERT_EQ(16u, limits.limits(mega::GET).transfers);
+    ASSERT_EQ(2u, limits.limits(mega::GET).connections);
+
+    // 30 seconds of goodput, between 2 MB and the ceiling
+    limits.setOutstandingCeiling(100 * 1024 * 1024);
+    ASSERT_EQ(2 * 1024 * 1024, limits.targetOutstanding(0));
+    ASSERT_EQ(30 * 1024 * 1024, limits.targetOutstanding(1024 * 1024));
+    ASSERT_EQ(100 * 1024 * 1024, limits.targetOutstanding(1024 * 1024 * 1024));
+}
+
+namespace
+{
+
+// putnodes commands in a serialized request
+size_t putnodesCommands(const std::string& request)
+{
+    size_t commands = 0;
+    for (size_t pos = 0; (pos = request.find("\"a\":\"p\"", pos)) != std::string::npos; ++pos)
+    {
+        ++commands;
+    }
+    return commands;
+}
+
+}
+
+TEST(Transfer, putnodesBatcher_oneCommandPerFolderAndBatchWithOneResultPerUpload)
+{
+    struct App : mega::MegaApp
+    {
+        std::map<int, size_t> results;
+
+        void putnodes_result(const mega::Error& e, mega::targettype_t, std::vector<mega::NewNode>& nn, bool) override
+        {
+            ASSERT_EQ(mega::API_EACCESS, mega::error(e));
+            results[client->restag] += nn.size();
+        }
+    } app;
+
+    auto client = mt::makeClient(app);
+    mega::byte masterKey[mega::SymmCipher::KEYLENGTH] = {};
+    client->key.setkey(masterKey);
+
+    mega::NodeHandle folder1, folder2;
+    folder1.set6byte(1);
+    folder2.set6byte(2);
+    const int numFiles = 2 * mega::MegaClient::MAX_NEWNODES + 10;
+
+    // completed uploads of small files: all but the last go to the same folder
+    for (int i = 0; i < numFiles; ++i)
+    {
+        mega::NewNode newnode;
+        newnode.source = mega::NEW_UPLOAD;
+        newnode.type = mega::FILENODE;
+        newnode.nodekey.assign(mega::FILENODEKEYLENGTH, 'k');
+        newnode.attrstring.reset(new std::string("attributes"));
+
+        client->mPutnodesBatcher.add(client.get(), i < numFiles - 1 ? folder1 : folder2, mega::NoVersioning,
+                                     std::move(newnode), i + 1, mega::PUTNODES_APP, nullptr, false);
+    }
+    client->mPutnodesBatcher.flush(client.get());
+    ASSERT_EQ(0u, client->mPutnodesBatcher.size());
+
+    // 2000 + 2000 + 9 nodes to the first folder, 1 to the second
+    std::string request;
+    bool suppressSID, includesFetchingNodes;
+    ASSERT_TRUE(client->reqs.cmdspending());
+    client->reqs.serverrequest(&request, suppressSID, includesFetchingNodes);
+    ASSERT_EQ(4u, putnodesCommands(request));
+
+    // the upload put alone gets the error, those of the failed batches are put again one by one
+    client->reqs.servererror(std::to_string(mega::API_EACCESS), client.get());
+    ASSERT_EQ(1u, app.results.size());
+    ASSERT_EQ(1u, app.results[numFiles]);
+
+    size_t commands = 0;
+    while (client->reqs.cmdspending())
+    {
+        client->reqs.serverrequest(&request, suppressSID, includesFetchingNodes);
+        commands += putnodesCommands(request);
+        client->reqs.servererror(std::to_string(mega::API_EACCESS), client.get());
+    }
+    ASSERT_EQ(size_t(numFiles - 1), commands);
+
+    // every upload gets the result of its own node
+    ASSERT_EQ(size_t(numFiles), app.results.size());
+    for (auto& r : app.results)
+    {
+        ASSERT_EQ(1u, r.second);
+    }
+}
+
+TEST(Transfer, putnodesBatcher_eachUploadGetsItsOwnNewNode)
+{
+    struct App : mega::MegaApp
+    {
+        std::map<int, std::pair<mega::error, mega::handle>> results;
+
+        void putnodes_result(const mega::Error& e, mega::targettype_t, std::vector<mega::NewNode>& nn, bool) override
+        {
+            ASSERT_EQ(1u, nn.size());
+            results[client->restag] = std::make_pair(mega::error(e), nn[0].mAddedHandle);
+        }
+    } app;
+
+    auto client = mt::makeClient(app);
+    mega::byte masterKey[mega::SymmCipher::KEYLENGTH] = {};
+    client->key.setkey(masterKey);
+    client->me = 1;
+
+    mega::NodeHandle folder;
+    folder.set6byte(1);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        mega::NewNode newnode;
+        newnode.source = mega::NEW_UPLOAD;
+        newnode.type = mega::FILENODE;
+        newnode.nodekey.assign(mega::FILENODEKEYLENGTH, 'k');
+        newnode.attrstring.reset(new std::string("attributes"));
+
+        client->mPutnodesBatcher.add(client.get(), folder, mega::NoVersioning,
+                                     std::move(newnode), i + 1, mega::PUTNODES_APP, nullptr, false);
+    }
+    client->mPutnodesBatcher.flush(client.get());
+
+    std::string request;
+    bool suppressSID, includesFetchingNodes;
+    client->reqs.serverrequest(&request, suppressSID, includesFetchingNodes);
+
+    // the API creates the first and the third nodes
+    auto created = [&](mega::handle h, int index)
+    {
+        return "{\"h\":\"" + mega::toNodeHandle(h) + "\",\"p\":\"" + mega::toNodeHandle(folder)
+             + "\",\"u\":\"" + mega::toHandle(client->me) + "\",\"t\":0,\"a\":\"attributes\",\"k\":\"AAAAAAAA:key\""
+             + ",\"s\":1,\"i\":" + std::to_string(index) + ",\"ts\":1}";
+    };
+    client->reqs.serverresponse("[{\"f\":[" + created(10, 0) + "," + created(30, 2) + "]}]", client.get());
+
+    ASSERT_EQ(2u, app.results.size());
+    ASSERT_EQ(mega::API_OK, app.results[1].first);
+    ASSERT_EQ(mega::handle(10), app.results[1].second);
+    ASSERT_EQ(mega::API_OK, app.results[3].first);
+    ASSERT_EQ(mega::handle(30), app.results[3].second);
+
+    // the second one is put again alone, and gets its own node
+    ASSERT_TRUE(client->reqs.cmdspending());
+    client->reqs.serverrequest(&request, suppressSID, includesFetchingNodes);
+    ASSERT_EQ(1u, putnodesCommands(request));
+    client->reqs.serverresponse("[{\"f\":[" + created(20, 0) + "]}]", client.get());
+
+    ASSERT_EQ(3u, app.results.size());
+    ASSERT_EQ(mega::API_OK, app.results[2].first);
+    ASSERT_EQ(mega::handle(20), app.results[2].second);
+    ASSERT_FALSE(client->reqs.cmdspending());
+}
@@ -44,7 +44,7 @@ mega::handle nextFsId()
     return fsId++;
 }
 
-std::shared_ptr<mega::MegaClient> makeClient(mega::MegaApp& app)
+std::shared_ptr<mega::MegaClient> makeClient(mega::MegaApp& app, mega::Waiter* waiter, unsigned workerThreadCount)
 {
     struct HttpIo : mega::HttpIO
     {
@@ -65,7 +65,7 @@ std::shared_ptr<mega::MegaClient> makeClient(mega::MegaApp& app)
     };
 
     std::shared_ptr<mega::MegaClient> client{new mega::MegaClient{
-            &app, nullptr, httpio, ::mega::make_unique<::mega::FSACCESS_CLASS>(), nullptr, nullptr, "XXX", "unit_test", 0
+            &app, waiter, httpio, ::mega::make_unique<::mega::FSACCESS_CLASS>(), nullptr, nullptr, "XXX", "unit_test", workerThreadCount
         }, deleter};
 
     return client;
@@ -31,7 +31,8 @@ class FsNode;
 
 mega::handle nextFsId();
 
-std::shared_ptr<mega::MegaClient> makeClient(mega::MegaApp& app);
+// the waiter is required if the client has worker threads
+std::shared_ptr<mega::MegaClient> makeClient(mega::MegaApp& app, mega::Waiter* waiter = nullptr, unsigned workerThreadCount = 0);
 
 mega::Node& makeNode(mega::MegaClient& client, mega::nodetype_t type, mega::NodeHandle handle, mega::Node* parent = nullptr);
 
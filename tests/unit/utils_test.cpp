@@ -29,6 +29,9 @@
 #include <mega/db.h>
 #include <mega/db/sqlite.h>
 #include <mega/json.h>
+#include <mega.h>
+
+#include "utils.h"
 
 TEST(utils, hashCombine_integer)
 {
@@ -627,6 +630,38 @@ TEST_F(SqliteDBTest, OpenCurrent)
     EXPECT_EQ(dbAccess.currentDbVersion, DbAccess::DB_VERSION);
 }
 
+TEST_F(SqliteDBTest, OpenPrevious)
+{
+    SqliteDbAccess dbAccess(rootPath);
+
+    auto previousFile = dbAccess.databasePath(fsAccess, name, DbAccess::PREVIOUS_DB_VERSION);
+    auto currentFile = dbAccess.databasePath(fsAccess, name, DbAccess::DB_VERSION);
+
+    // Create a database of the previous version.
+    {
+        SqliteDbAccess previousAccess(rootPath);
+        DbTablePtr dbTable(previousAccess.open(rng, fsAccess, name));
+        ASSERT_TRUE(!!dbTable);
+
+        string record("record");
+        ASSERT_TRUE(dbTable->put(7, &record));
+    }
+
+    ASSERT_TRUE(fsAccess.renamelocal(currentFile, previousFile, false));
+
+    // It is taken over by the current version, with its records.
+    DbTablePtr dbTable(dbAccess.open(rng, fsAccess, name, DB_OPEN_FLAG_NODES));
+    ASSERT_TRUE(!!dbTable);
+
+    EXPECT_EQ(dbAccess.currentDbVersion, DbAccess::DB_VERSION);
+    EXPECT_TRUE(fsAccess.fileExistsAt(currentFile));
+    EXPECT_FALSE(fsAccess.fileExistsAt(previousFile));
+
+    string record;
+    EXPECT_TRUE(dbTable->get(7, &record));
+    EXPECT_EQ(record, "record");
+}
+
 TEST_F(SqliteDBTest, ProbeCurrent)
 {
     SqliteDbAccess dbAccess(rootPath);
@@ -676,6 +711,432 @@ TEST_F(SqliteDBTest, RootPath)
     EXPECT_EQ(dbAccess.rootPath(), rootPath);
 }
 
+namespace {
+
+const size_t SYNTHETIC_FOLDERS = 500;
+const size_t SYNTHETIC_FILES_PER_FOLDER = 199;
+const size_t SYNTHETIC_NODES = 1 + SYNTHETIC_FOLDERS * (1 + SYNTHETIC_FILES_PER_FOLDER);
+const byte SYNTHETIC_KEY[SymmCipher::KEYLENGTH] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+
+NodeHandle syntheticFolder(size_t i)
+{
+    return NodeHandle().set6byte(1000000 + i);
+}
+
+NodeHandle syntheticFile(size_t i, size_t j)
+{
+    return NodeHandle().set6byte(2000000 + i * SYNTHETIC_FILES_PER_FOLDER + j);
+}
+
+// a root with SYNTHETIC_FOLDERS folders of SYNTHETIC_FILES_PER_FOLDER files, as statecache
+// records (children before their parents, so they have to be linked at the end) or typed records
+void writeSyntheticCache(DbTable& table, bool typed)
+{
+    MegaApp app;
+    auto source = mt::makeClient(app);
+    source->key.setkey(SYNTHETIC_KEY);
+
+    auto& root = mt::makeNode(*source, ROOTNODE, NodeHandle().set6byte(1));
+    vector<Node*> nodes;
+    for (size_t i = 0; i < SYNTHETIC_FOLDERS; ++i)
+    {
+        auto& folder = mt::makeNode(*source, FOLDERNODE, syntheticFolder(i), &root);
+        folder.attrs.map['n'] = "folder" + std::to_string(i);
+        for (size_t j = 0; j < SYNTHETIC_FILES_PER_FOLDER; ++j)
+        {
+            auto& file = mt::makeNode(*source, FILENODE, syntheticFile(i, j), &folder);
+            file.attrs.map['n'] = "file" + std::to_string(j) + ".txt";
+            file.size = m_off_t(j);
+            file.ctime = m_time_t(i * SYNTHETIC_FILES_PER_FOLDER + j); // unique fingerprints
+            file.setfingerprint();
+            nodes.push_back(&file);
+        }
+        nodes.push_back(&folder);
+    }
+    nodes.push_back(&root);
+
+    table.begin();
+    if (typed)
+    {
+        source->sctable.reset(&table);
+        source->initsc();
+        source->sctable.release();
+    }
+    else
+    {
+        for (auto n : nodes)
+        {
+            ASSERT_TRUE(table.put(MegaClient::CACHEDNODE, n, &source->key));
+        }
+    }
+    table.commit();
+}
+
+}
+
+// Loads a synthetic session cache with and without worker threads: both build the same tree
+TEST_F(SqliteDBTest, fetchscWithWorkerThreads)
+{
+    for (bool typed : { false, true })
+    {
+        SqliteDbAccess dbAccess(rootPath);
+        unique_ptr<DbTable> table(dbAccess.open(rng, fsAccess, name, DB_OPEN_FLAG_NODES));
+        ASSERT_TRUE(!!table);
+        table->truncate();
+        writeSyntheticCache(*table, typed);
+
+        for (unsigned threads : { 0u, 4u })
+        {
+            MegaApp app;
+            WAIT_CLASS waiter;
+            auto client = mt::makeClient(app, &waiter, threads);
+            client->key.setkey(SYNTHETIC_KEY);
+
+            ASSERT_TRUE(client->fetchsc(table.get()));
+
+            ASSERT_EQ(SYNTHETIC_NODES, client->nodes.size());
+            Node* root = client->nodeByHandle(NodeHandle().set6byte(1));
+            ASSERT_TRUE(root);
+            ASSERT_EQ(SYNTHETIC_FOLDERS, root->children.size());
+            Node* folder = client->childnodebyname(root, "folder7");
+            ASSERT_TRUE(folder);
+            ASSERT_EQ(SYNTHETIC_FILES_PER_FOLDER, folder->children.size());
+            Node* file = client->childnodebyname(folder, "file5.txt");
+            ASSERT_TRUE(file);
+            ASSERT_EQ(5, file->size);
+        }
+    }
+}
+
+// Loads the whole account and nodes on demand from the typed node table: lookups by handle,
+// name and fingerprint find the same nodes, loading them from disk when needed
+TEST_F(SqliteDBTest, nodeTableOnDemand)
+{
+    SqliteDbAccess dbAccess(rootPath);
+    unique_ptr<DbTable> table(dbAccess.open(rng, fsAccess, name, DB_OPEN_FLAG_NODES));
+    ASSERT_TRUE(!!table);
+    writeSyntheticCache(*table, true);
+
+    const size_t lookups = 1000;
+
+    for (bool onDemand : { false, true })
+    {
+        MegaApp app;
+        auto client = mt::makeClient(app);
+        client->key.setkey(SYNTHETIC_KEY);
+        client->sctable.reset(table.get());
+        client->mNodesOnDemand = onDemand;
+
+        ASSERT_TRUE(client->fetchsc(table.get()));
+        ASSERT_EQ(onDemand ? 1 : SYNTHETIC_NODES, client->nodes.size());
+
+        // each file of a different folder, so every one of them has to be read when loading on demand
+        for (size_t i = 0; i < lookups; ++i)
+        {
+            Node* n = client->nodeByHandle(syntheticFile(i % SYNTHETIC_FOLDERS, i / SYNTHETIC_FOLDERS));
+            ASSERT_TRUE(n);
+            ASSERT_EQ(syntheticFolder(i % SYNTHETIC_FOLDERS), n->parent->nodeHandle());
+        }
+
+        Node* root = client->nodeByHandle(NodeHandle().set6byte(1));
+        for (size_t i = 0; i < lookups; ++i)
+        {
+            Node* folder = client->childnodebyname(root, ("folder" + std::to_string(i % SYNTHETIC_FOLDERS)).c_str());
+            ASSERT_TRUE(folder);
+            Node* file = client->childnodebyname(folder, ("file" + std::to_string(SYNTHETIC_FILES_PER_FOLDER - 1 - i / SYNTHETIC_FOLDERS) + ".txt").c_str());
+            ASSERT_TRUE(file);
+        }
+
+        FileFingerprint fingerprint = *client->nodeByHandle(syntheticFile(3, 42));
+        unique_ptr<node_vector> sameFingerprint(client->nodesbyfingerprint(&fingerprint));
+        ASSERT_EQ(1u, sameFingerprint->size());
+
+        if (onDemand)
+        {
+            Node* folder = client->nodeByHandle(syntheticFolder(SYNTHETIC_FOLDERS - 1));
+            ASSERT_EQ(SYNTHETIC_FILES_PER_FOLDER, client->loadChildren(folder).size());
+            ASSERT_EQ(SYNTHETIC_FILES_PER_FOLDER, folder->children.size());
+
+            ASSERT_EQ(SYNTHETIC_NODES - 1, client->loadSubtree(root));
+            ASSERT_EQ(SYNTHETIC_NODES, client->nodes.size());
+            ASSERT_EQ(SYNTHETIC_FOLDERS, root->children.size());
+        }
+
+        client->sctable.release();
+    }
+}
+
+// Only a table opened with the node table answers the typed node queries
+TEST_F(SqliteDBTest, nodeTableNeedsNodesFlag)
+{
+    SqliteDbAccess dbAccess(rootPath);
+
+    unique_ptr<DbTable> plain(dbAccess.open(rng, fsAccess, name, 0));
+    ASSERT_TRUE(!!plain);
+    auto plainNodes = dynamic_cast<DbTableNodes*>(plain.get());
+    ASSERT_TRUE(plainNodes);
+    ASSERT_FALSE(plainNodes->hasNodesTable());
+
+    unique_ptr<DbTable> typed(dbAccess.open(rng, fsAccess, name + "_nodes", DB_OPEN_FLAG_NODES));
+    ASSERT_TRUE(!!typed);
+    auto typedNodes = dynamic_cast<DbTableNodes*>(typed.get());
+    ASSERT_TRUE(typedNodes);
+    ASSERT_TRUE(typedNodes->hasNodesTable());
+}
+
+// Touches every node of the synthetic account with a memory budget for a small part of them:
+// the least recently used ones are evicted, and loaded back when looked up again, while the
+// counts of the account stay the same
+TEST_F(SqliteDBTest, nodesMemoryBudget)
+{
+    SqliteDbAccess dbAccess(rootPath);
+    unique_ptr<DbTable> table(dbAccess.open(rng, fsAccess, name, DB_OPEN_FLAG_NODES));
+    ASSERT_TRUE(!!table);
+    writeSyntheticCache(*table, true);
+
+    const size_t budget = 1 << 20;
+
+    MegaApp app;
+    auto client = mt::makeClient(app);
+    client->key.setkey(SYNTHETIC_KEY);
+    client->sctable.reset(table.get());
+    client->mNodesOnDemand = true;
+    client->setNodesMemoryBudget(budget);
+
+    ASSERT_TRUE(client->fetchsc(table.get()));
+    client->scsn.setScsn(1);
+
+    auto checkCounts = [&client]()
+    {
+        NodeHandle rootHandle = NodeHandle().set6byte(1);
+        Node* root = client->nodeByHandle(rootHandle);
+        ASSERT_TRUE(root);
+        for (const NodeCounter& nc : { root->subnodeCounts(), client->mNodeCounters[rootHandle] })
+        {
+            ASSERT_EQ(SYNTHETIC_FOLDERS * SYNTHETIC_FILES_PER_FOLDER, nc.files);
+            ASSERT_EQ(SYNTHETIC_FOLDERS, nc.folders);
+            ASSERT_EQ(m_off_t(SYNTHETIC_FOLDERS * SYNTHETIC_FILES_PER_FOLDER * (SYNTHETIC_FILES_PER_FOLDER - 1) / 2), nc.storage);
+            ASSERT_EQ(0u, nc.versions);
+        }
+    };
+    checkCounts();
+
+    for (size_t i = 0; i < SYNTHETIC_FOLDERS; ++i)
+    {
+        for (size_t j = 0; j < SYNTHETIC_FILES_PER_FOLDER; ++j)
+        {
+            ASSERT_TRUE(client->nodeByHandle(syntheticFile(i, j)));
+        }
+        client->evictnodes();
+        ASSERT_LE(client->nodesMemory(), budget);
+    }
+    checkCounts();
+
+    // the most recently used nodes are still loaded, and evicted ones are loaded back
+    size_t loaded = client->nodes.size();
+    Node* last = client->nodeByHandle(syntheticFile(SYNTHETIC_FOLDERS - 1, 0));
+    ASSERT_TRUE(last);
+    ASSERT_EQ(loaded, client->nodes.size());
+    Node* first = client->nodeByHandle(syntheticFile(0, 0));
+    ASSERT_TRUE(first);
+    ASSERT_EQ(syntheticFolder(0), first->parent->nodeHandle());
+    ASSERT_LT(loaded, client->nodes.size());
+
+    // listings get all the children, and the counts don't change as they are loaded
+    client->pageInChildren(first->parent);
+    ASSERT_EQ(SYNTHETIC_FILES_PER_FOLDER, first->parent->children.size());
+    client->pageInSubtree(first->parent->parent);
+    ASSERT_EQ(SYNTHETIC_NODES, client->nodes.size());
+    checkCounts();
+
+    client->sctable.release();
+}
+
+// Fingerprints a folder of files twice through the cache: the second time needs no reads
+TEST_F(SqliteDBTest, fingerprintCache)
+{
+    SqliteDbAccess dbAccess(rootPath);
+    LocalFingerprintCache cache(unique_ptr<DbTable>(dbAccess.open(rng, fsAccess, name, DB_OPEN_FLAG_FINGERPRINTS)));
+
+    const size_t count = 2000;
+    vector<LocalPath> paths;
+    for (size_t i = 0; i < count; ++i)
+    {
+        paths.push_back(rootPath);
+        paths.back().appendWithSeparator(LocalPath::fromRelativePath("file" + std::to_string(i)), false);
+
+        auto fa = fsAccess.newfileaccess(false);
+        ASSERT_TRUE(fa->fopen(paths.back(), false, true));
+        string data = rng.genstring(i * 37 % 40000);
+        ASSERT_TRUE(fa->fwrite(reinterpret_cast<const byte*>(data.data()), static_cast<unsigned>(data.size()), 0));
+    }
+    fsfp_t fsfp = fsAccess.fsFingerprint(rootPath);
+
+    vector<FileFingerprint> fingerprints(count);
+    auto fingerprintAll = [&]()
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto fa = fsAccess.newfileaccess(false);
+            ASSERT_TRUE(fa->fopen(paths[i], true, false));
+
+            FileFingerprint expected;
+            expected.genfingerprint(fa.get());
+
+            cache.genfingerprint(fingerprints[i], fa.get(), fsfp);
+            ASSERT_EQ(expected, fingerprints[i]);
+        }
+    };
+
+    fingerprintAll();
+    ASSERT_EQ(count, cache.misses);
+    ASSERT_EQ(0u, cache.hits);
+
+    // full batches are committed without waiting for the end of the scan
+    {
+        LocalFingerprintCache other(unique_ptr<DbTable>(dbAccess.open(rng, fsAccess, name, DB_OPEN_FLAG_FINGERPRINTS)));
+        auto fa = fsAccess.newfileaccess(false);
+        ASSERT_TRUE(fa->fopen(paths[0], true, false));
+        FileFingerprint f;
+        other.genfingerprint(f, fa.get(), fsfp);
+        ASSERT_EQ(fingerprints[0], f);
+        ASSERT_EQ(1u, other.hits);
+    }
+    cache.flush();
+
+    fingerprintAll();
+    ASSERT_EQ(count, cache.misses);
+    ASSERT_EQ(count, cache.hits);
+
+    // a rewritten file is read again
+    {
+        auto fa = fsAccess.newfileaccess(false);
+        ASSERT_TRUE(fa->fopen(paths[1], false, true));
+        string data = rng.genstring(50000);
+        ASSERT_TRUE(fa->fwrite(reinterpret_cast<const byte*>(data.data()), static_cast<unsigned>(data.size()), 0));
+    }
+    auto fa = fsAccess.newfileaccess(false);
+    ASSERT_TRUE(fa->fopen(paths[1], true, false));
+    ASSERT_TRUE(cache.genfingerprint(fingerprints[1], fa.get(), fsfp));
+    ASSERT_EQ(50000, fingerprints[1].size);
+    ASSERT_EQ(count + 1, cache.misses);
+}
+
+// Writes the synthetic account to the state cache directly and through a WriteBehindDbTable;
+// both store the same nodes
+TEST_F(SqliteDBTest, writeBehindStateCache)
+{
+    for (bool writeBehind : { false, true })
+    {
+        SqliteDbAccess dbAccess(rootPath);
+        unique_ptr<DbTable> table(dbAccess.open(rng, fsAccess, name, DB_OPEN_FLAG_NODES));
+        ASSERT_TRUE(!!table);
+        table->truncate();
+        if (writeBehind)
+        {
+            unique_ptr<DbTable> direct(std::move(table));
+            table.reset(new WriteBehindDbTable(rng, std::move(direct)));
+        }
+
+        writeSyntheticCache(*table, true);
+
+        // closing the table waits for the queued writes
+        table.reset();
+
+        table.reset(dbAccess.open(rng, fsAccess, name, DB_OPEN_FLAG_NODES));
+        MegaApp app;
+        auto client = mt::makeClient(app);
+        client->key.setkey(SYNTHETIC_KEY);
+        ASSERT_TRUE(client->fetchsc(table.get()));
+        ASSERT_EQ(SYNTHETIC_NODES, client->nodes.size());
+    }
+}
+
+// Reads see the queued writes, replaced puts are not stored, and the queued commits are done
+TEST_F(SqliteDBTest, writeBehindReadsQueuedWrites)
+{
+    SqliteDbAccess dbAccess(rootPath);
+    unique_ptr<DbTable> direct(dbAccess.open(rng, fsAccess, name, DB_OPEN_FLAG_NODES));
+    ASSERT_TRUE(!!direct);
+    direct->truncate();
+
+    WriteBehindDbTable writeBehind(rng, std::move(direct));
+    DbTable& table = writeBehind;
+
+    string first("first");
+    string second("second");
+    string data;
+
+    table.begin();
+    ASSERT_TRUE(table.inTransaction());
+    ASSERT_TRUE(table.put(17, &first));
+    ASSERT_TRUE(table.put(17, &second));
+    ASSERT_TRUE(table.get(17, &data));
+    ASSERT_EQ(second, data);
+    ASSERT_TRUE(table.put(33, &first));
+    ASSERT_TRUE(table.del(33));
+    ASSERT_FALSE(table.get(33, &data));
+    table.commit();
+    table.begin();
+
+    // a node is removed with its parent's subtree
+    DbTableNodes::NodeColumns parent;
+    parent.handle = NodeHandle().set6byte(4);
+    parent.type = FOLDERNODE;
+    DbTableNodes::NodeColumns child;
+    child.handle = NodeHandle().set6byte(5);
+    child.parent = parent.handle;
+    child.type = FILENODE;
+    ASSERT_TRUE(writeBehind.putNode(parent, "parent"));
+    ASSERT_TRUE(writeBehind.putNode(child, "child"));
+    ASSERT_TRUE(writeBehind.getNode(child.handle, &data));
+    ASSERT_EQ("child", data);
+    ASSERT_TRUE(writeBehind.delNodeTree(parent.handle));
+    ASSERT_FALSE(writeBehind.getNode(child.handle, &data));
+    table.commit();
+    table.begin();
+
+    writeBehind.flush();
+    ASSERT_LE(1u, writeBehind.commits());
+    ASSERT_TRUE(table.get(17, &data));
+    ASSERT_EQ(second, data);
+    ASSERT_FALSE(table.get(33, &data));
+    ASSERT_FALSE(writeBehind.getNode(parent.handle, &data));
+
+    // the node queries merge the queued nodes into the stored ones
+    child.parent = parent.handle;
+    ASSERT_TRUE(writeBehind.putNode(parent, "parent"));
+    ASSERT_TRUE(writeBehind.putNode(child, "child"));
+    writeBehind.flush();
+
+    DbTableNodes::NodeColumns added = child;
+    added.handle = NodeHandle().set6byte(6);
+    ASSERT_TRUE(writeBehind.putNode(added, "added"));
+    child.parent = NodeHandle().set6byte(7);
+    ASSERT_TRUE(writeBehind.putNode(child, "moved"));
+
+    DbTableNodes::NodeRows rows;
+    ASSERT_TRUE(writeBehind.getChildren(parent.handle, rows));
+    ASSERT_EQ(1u, rows.size());
+    ASSERT_EQ(added.handle, rows[0].first);
+    ASSERT_EQ("added", rows[0].second);
+
+    rows.clear();
+    ASSERT_TRUE(writeBehind.getChildren(child.parent, rows));
+    ASSERT_EQ(1u, rows.size());
+    ASSERT_EQ("moved", rows[0].second);
+
+    rows.clear();
+    ASSERT_TRUE(writeBehind.getSubtree(parent.handle, rows));
+    ASSERT_EQ(1u, rows.size());
+    ASSERT_EQ(added.handle, rows[0].first);
+
+    NodeCounter counts;
+    ASSERT_TRUE(writeBehind.getSubtreeCounts(parent.handle, false, counts));
+    ASSERT_EQ(1u, counts.files);
+    table.commit();
+}
+
 #ifdef WIN32
 #define SEP "\\"
 #else // WIN32
@@ -789,6 +1250,126 @@ TEST(JSON, stripWhitespace)
     ASSERT_EQ(computed, expected);
 }
 
+namespace {
+
+// a fetchnodes-like response with `count` nodes
+string makeFetchNodesResponse(size_t count)
+{
+    string response = "[{\"f\":[";
+    for (size_t i = 0; i < count; ++i)
+    {
+        response += (i ? ",{\"h\":\"" : "{\"h\":\"") + std::to_string(i)
+                  + "\",\"p\":\"parent\",\"t\":" + std::to_string(i % 2)
+                  + ",\"a\":\"esc\\\"aped" + std::to_string(i) + "\",\"s\":" + std::to_string(i * 10) + "}";
+    }
+    response += "],\"u\":[{\"u\":\"me\",\"c\":2}],\"other\":{\"a\":[1,{\"b\":null}]},\"sn\":\"AbCdEfGh\",\"f2\":[]}]";
+    return response;
+}
+
+struct SplitterResult
+{
+    size_t nodes = 0;
+    size_t maxBuffered = 0;
+    vector<string> calls;
+};
+
+// feeds `response` to a JSONSplitter `chunkSize` bytes at a time, releasing what it doesn't need
+SplitterResult split(const string& response, size_t chunkSize)
+{
+    SplitterResult result;
+    JSONSplitter splitter;
+    JSONSplitter::FilterMap filters;
+
+    filters["<"] = [&](JSON*) { result.calls.push_back("<"); return true; };
+    filters["[{[f{"] = [&](JSON* json)
+    {
+        // each node is given whole, with nothing after it
+        result.nodes++;
+        return json->enterobject() && json->getnameid() == 'h' && json->pos[strlen(json->pos) - 1] == '}';
+    };
+    filters["[{[f"] = [&](JSON* json) { result.calls.push_back(string("f ") + json->pos); return true; };
+    filters["[{[f2"] = [&](JSON* json) { result.calls.push_back(string("f2 ") + json->pos); return true; };
+    filters["[{[u"] = [&](JSON* json) { result.calls.push_back(string("u ") + json->pos); return true; };
+    filters["[{\"sn"] = [&](JSON* json) { result.calls.push_back(string("sn ") + json->pos); return true; };
+    filters["[{"] = [&](JSON* json) { result.calls.push_back(string("end ") + json->pos); return true; };
+
+    string buffer;
+    for (size_t pos = 0; pos < response.size(); pos += chunkSize)
+    {
+        buffer.append(response, pos, chunkSize);
+        result.maxBuffered = std::max(result.maxBuffered, buffer.size());
+        buffer.erase(0, splitter.processChunk(filters, buffer.data(), buffer.size()));
+    }
+
+    EXPECT_TRUE(splitter.hasFinished());
+    EXPECT_FALSE(splitter.hasFailed());
+    return result;
+}
+
+}
+
+TEST(JSONSplitter, sameResultForAnyChunkSize)
+{
+    auto response = makeFetchNodesResponse(100);
+    auto whole = split(response, response.size());
+
+    const vector<string> expected = {
+        "<",
+        "f []",
+        "u [{\"u\":\"me\",\"c\":2}]",
+        "sn \"AbCdEfGh\"",
+        "f2 []",
+        "end {}"
+    };
+    ASSERT_EQ(expected, whole.calls);
+    ASSERT_EQ(100u, whole.nodes);
+
+    for (size_t chunkSize : { 1, 2, 3, 7, 64 })
+    {
+        auto chunked = split(response, chunkSize);
+        ASSERT_EQ(whole.calls, chunked.calls) << chunkSize;
+        ASSERT_EQ(whole.nodes, chunked.nodes) << chunkSize;
+
+        // only a partial node is held back between chunks
+        ASSERT_LT(chunked.maxBuffered, 100 + chunkSize) << chunkSize;
+    }
+}
+
+TEST(JSONSplitter, malformedAndTruncated)
+{
+    JSONSplitter::FilterMap filters;
+    filters["[{[f{"] = [](JSON*) { return true; };
+
+    string bad = "[{\"f\":[{\"h\":1]}]";
+    JSONSplitter splitter;
+    splitter.processChunk(filters, bad.data(), bad.size());
+    ASSERT_TRUE(splitter.hasFailed());
+
+    auto response = makeFetchNodesResponse(10);
+    splitter.clear();
+    splitter.processChunk(filters, response.data(), response.size() / 2);
+    ASSERT_FALSE(splitter.hasFailed());
+    ASSERT_FALSE(splitter.hasFinished());
+
+    // a filter can stop the parsing
+    filters["[{[f{"] = [](JSON*) { return false; };
+    splitter.clear();
+    splitter.processChunk(filters, response.data(), response.size());
+    ASSERT_TRUE(splitter.hasFailed());
+}
+
+TEST(JSONSplitter, largeResponseInNetworkSizedChunks)
+{
+    // a large response streamed in 16 KB network reads holds at most a partial node besides the chunk
+    const size_t count = 50000;
+    auto response = makeFetchNodesResponse(count);
+
+    auto streamed = split(response, 16384);
+    ASSERT_FALSE(streamed.calls.empty());
+    ASSERT_EQ(count, streamed.nodes);
+    ASSERT_LT(streamed.maxBuffered, 100u + 16384);
+}
+
 TEST(Utils, replace_char)
 {
     ASSERT_EQ(Utils::replace(string(""), '*', '@'), "");